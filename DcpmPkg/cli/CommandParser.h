@@ -81,12 +81,14 @@
 #define OUTPUT_OPTION_NVMXML            L"nvmxml"                              //!< 'output' option value for nvmxml
 #define OUTPUT_OPTION_ESX_XML           L"esx"                                 //!< 'output' option value for esx xml
 #define OUTPUT_OPTION_ESX_TABLE_XML     L"esxtable"                            //!< 'output' option value for esx xml
-#define OUTPUT_OPTION_HELP              L"text|nvmxml"                         //!< 'output' option help text
+#define OUTPUT_OPTION_JSON              L"json"                                //!< 'output' option value for json
+#define OUTPUT_OPTION_HELP              L"text|nvmxml|json"                    //!< 'output' option help text
 #define VERBOSE_OPTION_SHORT            L"-v"                                  //!< 'verbose' option short form
 #define VERBOSE_OPTION                  L"-verbose"                            //!< 'verbose' option name
 #define MASTER_OPTION                   L"-master"                             //!< 'master' option name
 #define DEFAULT_OPTION                  L"-default"                            //!< 'default' option name
 #define PBR_MODE_OPTION                 L"-mode"                               //!< 'mode' option name
+#define PBR_LATENCY_OPTION              L"-latency"                            //!< 'latency' option name
 #define PROTOCOL_OPTION_DDRT            L"-ddrt"                               //!< 'ddrt' option name
 #define PROTOCOL_OPTION_SMBUS           L"-smbus"                              //!< 'smbus' option name
 #define LARGE_PAYLOAD_OPTION            L"-lpmb"                               //!< 'large payload mailbox' option name
@@ -289,6 +291,7 @@
 #define HELP_SMBUS_DETAILS_TEXT         L"Used to specify SMBUS as the desired transport protocol"
 #define HELP_LPAYLOAD_DETAILS_TEXT      L"Used to specify large transport payload size"
 #define HELP_SPAYLOAD_DETAILS_TEXT      L"Used to specify small transport payload size"
+#define HELP_PBR_LATENCY_DETAILS_TEXT   L"Shows the recorded firmware command time per opcode"
 #define HELP_TEXT_DIMM_IDS              L"DimmIDs"
 #define HELP_TEXT_DIMM_ID               L"DimmID"
 #define HELP_TEXT_ATTRIBUTES            L"Attributes"
@@ -2431,6 +2431,9 @@ ReadCmdLinePrintOptions(
         *pFormatType = XML;
         PRINTER_ENABLE_ESX_TABLE_XML_FORMAT(pCmd->pPrintCtx);
       }
+      else if (0 == StrICmp(Toks[Index], OUTPUT_OPTION_JSON)) {
+        *pFormatType = JSON;
+      }
       else {
         // Print out syntax specific help message for invalid -output option
         CHAR16 * pHelpStr = getCommandHelp(pCmd, TRUE);
@@ -2476,6 +2479,11 @@ CreateCmdLineOutputStr(
     return EFI_INVALID_PARAMETER;
   }
 
+  if (JSON == pCmd->pPrintCtx->FormatType) {
+    *ppOutputStr = CatSPrint(NULL, OUTPUT_OPTION_SHORT L" " OUTPUT_OPTION_JSON L" ");
+    return EFI_SUCCESS;
+  }
+
   if (XML != pCmd->pPrintCtx->FormatType) {
     *ppOutputStr = CatSPrint(NULL, L"");
     return EFI_SUCCESS;
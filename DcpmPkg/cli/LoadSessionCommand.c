@@ -15,7 +15,10 @@
 #include "Utility.h"
 #include <PbrDcpmm.h>
 
-#define SUCCESSFULLY_LOADED_BUFFER_MSG    L"Successfully loaded %d bytes to session buffer."
+#define SUCCESSFULLY_LOADED_BUFFER_MSG    L"Successfully loaded %lld bytes to session buffer."
+
+STATIC EFI_STATUS LoadLogSegments(CHAR16 *pFirstSegmentPath, EFI_DEVICE_PATH_PROTOCOL *pDevicePath, UINT32 FirstSegmentNumber, UINT64 *pLoadedSize);
+STATIC VOID ReadLogSegment(CHAR16 *pSegmentPath, UINTN NumberStart, UINTN NumberEnd, EFI_DEVICE_PATH_PROTOCOL *pDevicePath, UINT32 SegmentNumber, UINT8 **ppSegment, UINT64 *pSegmentSize);
 
 /**
   Command syntax definition
@@ -58,6 +61,11 @@ LoadSession(
   CHAR16 *pLoadUserPath = NULL;
   UINT64 FileBufferSize = 0;
   UINT8 *pFileBuffer = NULL;
+  UINT8 *pSession = NULL;
+#ifdef OS_BUILD
+  UINT8 *pMappedImage = NULL;
+  UINT32 MappedImageSize = 0;
+#endif
   PRINT_CONTEXT *pPrinterCtx = NULL;
 
   NVDIMM_ENTRY();
@@ -102,25 +110,59 @@ LoadSession(
     goto Finish;
   }
 
-  ReturnCode = FileRead(pLoadFilePath, pDevicePathProtocol, 0, &FileBufferSize, (VOID **)&pFileBuffer);
-  if (EFI_ERROR(ReturnCode) || pFileBuffer == NULL) {
-    PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_FAILED_TO_READ_FILE);
-    goto Finish;
+#ifdef OS_BUILD
+  //the session is played back from the mapped file, the session module releases the mapping
+  ReturnCode = PbrSetSessionFile(pLoadFilePath, (VOID **)&pMappedImage, &MappedImageSize);
+  if (EFI_UNSUPPORTED != ReturnCode) {
+    if (EFI_ERROR(ReturnCode)) {
+      PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_FAILED_TO_SET_SESSION_BUFFER);
+      goto Finish;
+    }
+    pSession = pMappedImage;
+    FileBufferSize = MappedImageSize;
   }
+#endif
 
-  //session module responsible for freeing buffer.
-  ReturnCode = pNvmDimmPbrProtocol->PbrSetSession(pFileBuffer, (UINT32)FileBufferSize);
-  if (EFI_ERROR(ReturnCode)) {
-    PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_FAILED_TO_SET_SESSION_BUFFER);
-    goto Finish;
+  if (NULL == pSession) {
+    ReturnCode = FileRead(pLoadFilePath, pDevicePathProtocol, 0, &FileBufferSize, (VOID **)&pFileBuffer);
+    if (EFI_ERROR(ReturnCode) || pFileBuffer == NULL) {
+      PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_FAILED_TO_READ_FILE);
+      goto Finish;
+    }
+
+    if (FileBufferSize > MAX_UINT32) {
+      ReturnCode = EFI_BAD_BUFFER_SIZE;
+      PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_FAILED_TO_READ_FILE);
+      goto Finish;
+    }
+
+    //the session module copies the buffer
+    ReturnCode = pNvmDimmPbrProtocol->PbrSetSession(pFileBuffer, (UINT32)FileBufferSize);
+    if (EFI_ERROR(ReturnCode)) {
+      PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_FAILED_TO_SET_SESSION_BUFFER);
+      goto Finish;
+    }
+    pSession = pFileBuffer;
+  }
+
+  //a record log is loaded from its first segment, the others follow it
+  if (FileBufferSize >= sizeof(PbrLogSegmentHeader) &&
+    PBR_LOG_SEGMENT_SIG == ((PbrLogSegmentHeader *)pSession)->Signature) {
+    ReturnCode = LoadLogSegments(pLoadFilePath, pDevicePathProtocol,
+      ((PbrLogSegmentHeader *)pSession)->SegmentNumber, &FileBufferSize);
+    if (EFI_ERROR(ReturnCode)) {
+      PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_FAILED_TO_SET_SESSION_BUFFER);
+      goto Finish;
+    }
   }
 
   //reset the tagid to 0 (first tag)
   PbrDcpmmSerializeTagId(0);
 
-  PRINTER_SET_MSG(pPrinterCtx, ReturnCode, SUCCESSFULLY_LOADED_BUFFER_MSG, (UINT32)FileBufferSize);
+  PRINTER_SET_MSG(pPrinterCtx, ReturnCode, SUCCESSFULLY_LOADED_BUFFER_MSG, FileBufferSize);
 Finish:
   PRINTER_PROCESS_SET_BUFFER(pPrinterCtx);
+  FREE_POOL_SAFE(pFileBuffer);
   FREE_POOL_SAFE(pLoadFilePath);
   FREE_POOL_SAFE(pLoadUserPath);
   NVDIMM_EXIT_I64(ReturnCode);
@@ -128,6 +170,140 @@ Finish:
 }
 
 
+/**
+  Add the segments that follow the first segment of a record log to the session
+  loaded from it, one segment at a time. The next segment has the number at the end
+  of the file name incremented, i.e. pbr_log_0001.seg follows pbr_log_0000.seg.
+  The segment files are only read, they stay in place.
+
+  @param[in] pFirstSegmentPath file path of the segment already loaded
+  @param[in] pDevicePath device path of the file
+  @param[in] FirstSegmentNumber segment number in the header of the loaded segment
+  @param[in, out] pLoadedSize size of the loaded segment, increased by every segment added
+
+  @retval EFI_SUCCESS the session holds every segment found
+  @retval EFI_OUT_OF_RESOURCES memory allocation failure
+  @retval EFI_BAD_BUFFER_SIZE a segment is too large to be loaded
+**/
+STATIC
+EFI_STATUS
+LoadLogSegments(
+  IN     CHAR16 *pFirstSegmentPath,
+  IN     EFI_DEVICE_PATH_PROTOCOL *pDevicePath,
+  IN     UINT32 FirstSegmentNumber,
+  IN OUT UINT64 *pLoadedSize
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  CHAR16 *pSegmentPath = NULL;
+  UINT8 *pSegment = NULL;
+  UINT8 *pNextSegment = NULL;
+  UINT64 SegmentSize = 0;
+  UINT64 NextSegmentSize = 0;
+  UINTN PathLen = 0;
+  UINTN NumberEnd = 0;
+  UINTN NumberStart = 0;
+  UINT32 SegmentNumber = FirstSegmentNumber;
+
+  NVDIMM_ENTRY();
+
+  //the segment number is the run of digits before the extension
+  PathLen = StrLen(pFirstSegmentPath);
+  for (NumberEnd = PathLen; NumberEnd > 0 && pFirstSegmentPath[NumberEnd - 1] != L'.'; --NumberEnd) {
+  }
+  NumberEnd = (NumberEnd > 0) ? NumberEnd - 1 : PathLen;
+  for (NumberStart = NumberEnd; NumberStart > 0 &&
+    pFirstSegmentPath[NumberStart - 1] >= L'0' && pFirstSegmentPath[NumberStart - 1] <= L'9'; --NumberStart) {
+  }
+  if (NumberStart == NumberEnd) {
+    goto Finish;
+  }
+
+  pSegmentPath = AllocateCopyPool((PathLen + 1) * sizeof(CHAR16), pFirstSegmentPath);
+  if (pSegmentPath == NULL) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    goto Finish;
+  }
+
+  //the segment after the one being added is read first, the last one saves the session
+  ReadLogSegment(pSegmentPath, NumberStart, NumberEnd, pDevicePath, SegmentNumber + 1, &pNextSegment, &NextSegmentSize);
+  while (pNextSegment != NULL) {
+    pSegment = pNextSegment;
+    SegmentSize = NextSegmentSize;
+    pNextSegment = NULL;
+    ++SegmentNumber;
+    if (SegmentSize > MAX_UINT32) {
+      ReturnCode = EFI_BAD_BUFFER_SIZE;
+      goto Finish;
+    }
+
+    ReadLogSegment(pSegmentPath, NumberStart, NumberEnd, pDevicePath, SegmentNumber + 1, &pNextSegment, &NextSegmentSize);
+    ReturnCode = PbrAppendSessionLog(pSegment, (UINT32)SegmentSize, pNextSegment == NULL);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_ERR("Failed to load record log segment %d", SegmentNumber);
+      goto Finish;
+    }
+    *pLoadedSize += SegmentSize;
+    FREE_POOL_SAFE(pSegment);
+  }
+
+Finish:
+  FREE_POOL_SAFE(pSegment);
+  FREE_POOL_SAFE(pNextSegment);
+  FREE_POOL_SAFE(pSegmentPath);
+  NVDIMM_EXIT_I64(ReturnCode);
+  return ReturnCode;
+}
+
+/**
+  Read a segment of a record log, if it exists and is the expected one
+
+  @param[in, out] pSegmentPath file path of a segment, its number is replaced
+  @param[in] NumberStart index of the first digit of the segment number in pSegmentPath
+  @param[in] NumberEnd index after the last digit of the segment number in pSegmentPath
+  @param[in] pDevicePath device path of the file
+  @param[in] SegmentNumber segment to read
+  @param[out] ppSegment contents of the segment file, NULL if there is no such segment
+  @param[out] pSegmentSize size of ppSegment
+**/
+STATIC
+VOID
+ReadLogSegment(
+  IN OUT CHAR16 *pSegmentPath,
+  IN     UINTN NumberStart,
+  IN     UINTN NumberEnd,
+  IN     EFI_DEVICE_PATH_PROTOCOL *pDevicePath,
+  IN     UINT32 SegmentNumber,
+  OUT    UINT8 **ppSegment,
+  OUT    UINT64 *pSegmentSize
+  )
+{
+  UINT32 Number = 0;
+  UINTN Index = 0;
+
+  *ppSegment = NULL;
+  *pSegmentSize = 0;
+
+  //the number must fit the digits of the file name
+  for (Number = SegmentNumber, Index = NumberEnd; Index > NumberStart; --Index, Number /= 10) {
+    pSegmentPath[Index - 1] = (CHAR16)(L'0' + Number % 10);
+  }
+  if (Number != 0) {
+    return;
+  }
+
+  if (EFI_ERROR(FileRead(pSegmentPath, pDevicePath, 0, pSegmentSize, (VOID **)ppSegment)) || *ppSegment == NULL) {
+    FREE_POOL_SAFE(*ppSegment);
+    return;
+  }
+  if (*pSegmentSize < sizeof(PbrLogSegmentHeader) ||
+    PBR_LOG_SEGMENT_SIG != ((PbrLogSegmentHeader *)*ppSegment)->Signature ||
+    SegmentNumber != ((PbrLogSegmentHeader *)*ppSegment)->SegmentNumber) {
+    NVDIMM_WARN("The file after record log segment %d is not the next segment", SegmentNumber - 1);
+    FREE_POOL_SAFE(*ppSegment);
+  }
+}
+
 /**
   Register the Load Session command
 
@@ -82,6 +82,7 @@ extern int cov_dumpData(void);
 #include "DumpSupportCommand.h"
 #include <stdio.h>
 extern void nvm_current_cmd(struct Command Command);
+extern void start_cli_output_capture();
 extern BOOLEAN ConfigIsDdrtProtocolDisabled();
 extern BOOLEAN ConfigIsLargePayloadDisabled();
 #else
@@ -97,7 +98,6 @@ extern EFI_SHELL_INTERFACE *mEfiShellInterface;
 
 #ifdef OS_BUILD
 EFI_HANDLE gNvmDimmCliHiiHandle = (EFI_HANDLE)0x1;
-extern EFI_SHELL_PARAMETERS_PROTOCOL gOsShellParametersProtocol;
 extern EFI_DRIVER_BINDING_PROTOCOL gNvmDimmDriverDriverBinding;
 #else
 EFI_HANDLE gNvmDimmCliHiiHandle = NULL;
@@ -111,12 +111,20 @@ extern volatile   UINT32  _gPcd_BinaryPatch_PcdDebugPrintErrorLevel;
 
 EFI_GUID gNvmDimmCliHiiGuid = NVMDIMM_CLI_HII_GUID;
 
+#ifdef OS_BUILD
+STATIC BOOLEAN mDriverBindingStarted = FALSE;
+STATIC BOOLEAN mDriverBindingWarm = FALSE;
+#endif
+
 /* Local fns */
 static EFI_STATUS showVersion(struct Command *pCmd);
 static EFI_STATUS GetPbrMode(UINT32 *Mode);
 static EFI_STATUS SetPbrTag(CHAR16 *pName, CHAR16 *pDescription);
 static EFI_STATUS ResetPbrSession(UINT32 TagId);
 static EFI_STATUS SetDefaultProtocolAndPayloadSizeOptions();
+#ifdef OS_BUILD
+static BOOLEAN IsReadOnlyCommand(struct Command *pCmd);
+#endif
 
 /**
   Supported commands
@@ -494,6 +502,9 @@ UefiMain(
         }
       } else {
         /* user did not enter a command */
+#ifdef OS_BUILD
+        start_cli_output_capture();
+#endif
         showHelp(NULL);
         HelpShown = TRUE;
         break;
@@ -533,6 +544,9 @@ UefiMain(
     /* Fix the passed tokens as needed */
     FixHelp(Input.ppTokens, &Input.TokenCount);
     if (TRUE == FullHelpRequested) {
+#ifdef OS_BUILD
+      start_cli_output_capture();
+#endif
       showHelp(NULL);
       HelpShown = TRUE;
       break;
@@ -540,6 +554,12 @@ UefiMain(
 
     /* run the command */
     Rc = Parse(&Input, &Command);
+#ifdef OS_BUILD
+    //help and the text output of commands not using the printer are converted afterwards
+    if (EFI_ERROR(Rc) || !Command.PrinterCtrlSupported || Command.ShowHelp) {
+      start_cli_output_capture();
+    }
+#endif
 
     if (!HelpRequested) {
       if (PBR_NORMAL_MODE != Mode && !Command.ExcludeDriverBinding) {
@@ -567,23 +587,19 @@ UefiMain(
         showHelp(&Command);
         HelpShown = TRUE;
       } else {
-#ifdef OS_BUILD //WA, remove after all CMDs convert to "unified printing" mechanism
-        if (Command.PrinterCtrlSupported) {
-          gOsShellParametersProtocol.StdOut = stdout;
-        }
-#endif
-
 #ifdef OS_BUILD
-        if (!Command.ExcludeDriverBinding) {
+        if (!Command.ExcludeDriverBinding && !mDriverBindingStarted) {
           Rc = NvmDimmDriverDriverBindingStart(&gNvmDimmDriverDriverBinding, FakeBindHandle, NULL);
+          mDriverBindingStarted = TRUE;
         }
 #endif
 
         Rc = ExecuteCmd(&Command);
 
 #ifdef OS_BUILD
-        if (!Command.ExcludeDriverBinding) {
-          NvmDimmDriverDriverBindingStop(&gNvmDimmDriverDriverBinding, FakeBindHandle, 0, NULL);
+        if (!Command.ExcludeDriverBinding &&
+            (!mDriverBindingWarm || !IsReadOnlyCommand(&Command))) {
+          InvalidateDriverBinding();
         }
 #endif
       }
@@ -628,6 +644,63 @@ Finish:
   return Rc;
 }
 
+#ifdef OS_BUILD
+/**
+  Check whether a command only reads the platform and DIMM state,
+  so the driver state may be kept for the following commands.
+
+  @param[in] pCmd Parsed command
+
+  @retval TRUE for show, version and help commands
+**/
+static
+BOOLEAN
+IsReadOnlyCommand(
+  IN     struct Command *pCmd
+  )
+{
+  if (pCmd == NULL) {
+    return FALSE;
+  }
+
+  return (StrCmp(pCmd->verb, SHOW_VERB) == 0 ||
+          StrCmp(pCmd->verb, VERSION_VERB) == 0 ||
+          StrCmp(pCmd->verb, HELP_VERB) == 0);
+}
+
+/**
+  Keep the driver binding started between commands run by this process.
+
+  @param[in] Warm TRUE to keep the binding started between commands
+**/
+VOID
+SetDriverBindingWarm(
+  IN     BOOLEAN Warm
+  )
+{
+  mDriverBindingWarm = Warm;
+  if (!Warm) {
+    InvalidateDriverBinding();
+  }
+}
+
+/**
+  Stop the driver binding if it is started, so the next command re-reads
+  the platform and DIMM state.
+**/
+VOID
+InvalidateDriverBinding(
+  )
+{
+  EFI_HANDLE FakeBindHandle = (EFI_HANDLE)0x1;
+
+  if (mDriverBindingStarted) {
+    NvmDimmDriverDriverBindingStop(&gNvmDimmDriverDriverBinding, FakeBindHandle, 0, NULL);
+    mDriverBindingStarted = FALSE;
+  }
+}
+#endif // OS_BUILD
+
 /**
 Register basic commands on the commands list for non-root users
 
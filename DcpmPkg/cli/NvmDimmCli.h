@@ -46,3 +46,28 @@ RegisterNonAdminUserCommands(
   Print the CLI application help
 **/
 EFI_STATUS showHelp(struct Command *pCmd);
+
+#ifdef OS_BUILD
+/**
+  Keep the driver binding started between commands run by this process.
+
+  By default every command starts the driver binding before it runs and stops it
+  afterwards. A resident process (daemon or batch mode) keeps the initialized
+  driver state instead, and only drops it after commands that may change the
+  configuration or when InvalidateDriverBinding() is called.
+
+  @param[in] Warm TRUE to keep the binding started between commands
+**/
+VOID
+SetDriverBindingWarm(
+  IN     BOOLEAN Warm
+  );
+
+/**
+  Stop the driver binding if it is started, so the next command re-reads
+  the platform and DIMM state.
+**/
+VOID
+InvalidateDriverBinding(
+  );
+#endif // OS_BUILD
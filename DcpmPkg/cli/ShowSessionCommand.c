@@ -19,9 +19,33 @@
 #define DS_TAG_PATH                         L"/Session/Tag"
 #define DS_TAG_INDEX_PATH                   L"/Session/Tag[%d]"
 
+#define DS_PASS_THRU_PATH                   L"/Session/PassThru"
+#define DS_PASS_THRU_INDEX_PATH             L"/Session/PassThru[%d]"
+
 #define TAG_ID_FORMAT                       L"0x%x"
 #define TAG_ID_SELECTED_FORMAT              L"0x%x*"
 
+#define PASS_THRU_STR                       L"PassThru"
+#define OPCODE_STR                          L"Opcode"
+#define SUBOPCODE_STR                       L"SubOpcode"
+#define COUNT_STR                           L"Count"
+#define TOTAL_TIME_STR                      L"TotalTime(us)"
+#define MAX_TIME_STR                        L"MaxTime(us)"
+#define OPCODE_FORMAT                       L"0x%02x"
+
+#define PASS_THRU_OPCODES_GROW_BY           64
+
+/** recorded time of one opcode/subopcode pair **/
+typedef struct _PASS_THRU_LATENCY {
+  UINT8 Opcode;
+  UINT8 SubOpcode;
+  UINT32 Count;
+  UINT64 TotalMicroseconds;
+  UINT64 MaxMicroseconds;
+} PASS_THRU_LATENCY;
+
+STATIC EFI_STATUS ShowSessionLatency(PRINT_CONTEXT *pPrinterCtx, EFI_DCPMM_PBR_PROTOCOL *pNvmDimmPbrProtocol);
+
 EFI_STATUS
 MapTagtoCurrentSessionState(
   IN  EFI_DCPMM_PBR_PROTOCOL *pNvmDimmPbrProtocol,
@@ -74,6 +98,67 @@ PRINTER_DATA_SET_ATTRIBS ShowSessionDataSetAttribs =
   &ShowSessionTableAttributes
 };
 
+ /*
+  *  PRINT LIST ATTRIBUTES
+  *  ---Opcode=0x06---
+  *     SubOpcode=0x00
+  */
+PRINTER_LIST_ATTRIB ShowSessionLatencyListAttributes =
+{
+ {
+    {
+      PASS_THRU_STR,                                      //GROUP LEVEL TYPE
+      L"---" OPCODE_STR L"=$(" OPCODE_STR L")---",        //NULL or GROUP LEVEL HEADER
+      SHOW_LIST_IDENT L"%ls=%ls",                         //NULL or KEY VAL FORMAT STR
+      OPCODE_STR                                          //NULL or IGNORE KEY LIST (K1;K2)
+    }
+  }
+};
+
+ /*
+ *  PRINTER TABLE ATTRIBUTES (5 columns)
+ *   Opcode | SubOpcode | Count | TotalTime(us) | MaxTime(us)
+ *   ========================================================
+ *   0x06   | 0x00      | X     | X             | X
+ *   ...
+ */
+PRINTER_TABLE_ATTRIB ShowSessionLatencyTableAttributes =
+{
+  {
+    {
+      OPCODE_STR,                                       //COLUMN HEADER
+      DEFAULT_MAX_STR_WIDTH,                            //COLUMN MAX STR WIDTH
+      DS_PASS_THRU_PATH PATH_KEY_DELIM OPCODE_STR       //COLUMN DATA PATH
+    },
+    {
+      SUBOPCODE_STR,                                    //COLUMN HEADER
+      DEFAULT_MAX_STR_WIDTH,                            //COLUMN MAX STR WIDTH
+      DS_PASS_THRU_PATH PATH_KEY_DELIM SUBOPCODE_STR    //COLUMN DATA PATH
+    },
+    {
+      COUNT_STR,                                        //COLUMN HEADER
+      DEFAULT_MAX_STR_WIDTH,                            //COLUMN MAX STR WIDTH
+      DS_PASS_THRU_PATH PATH_KEY_DELIM COUNT_STR        //COLUMN DATA PATH
+    },
+    {
+      TOTAL_TIME_STR,                                   //COLUMN HEADER
+      DEFAULT_MAX_STR_WIDTH,                            //COLUMN MAX STR WIDTH
+      DS_PASS_THRU_PATH PATH_KEY_DELIM TOTAL_TIME_STR   //COLUMN DATA PATH
+    },
+    {
+      MAX_TIME_STR,                                     //COLUMN HEADER
+      DEFAULT_MAX_STR_WIDTH,                            //COLUMN MAX STR WIDTH
+      DS_PASS_THRU_PATH PATH_KEY_DELIM MAX_TIME_STR     //COLUMN DATA PATH
+    }
+  }
+};
+
+PRINTER_DATA_SET_ATTRIBS ShowSessionLatencyDataSetAttribs =
+{
+  &ShowSessionLatencyListAttributes,
+  &ShowSessionLatencyTableAttributes
+};
+
 /**
   Command syntax definition
 **/
@@ -85,6 +170,7 @@ struct Command ShowSessionCommand = {
 #endif
     {L"", PROTOCOL_OPTION_DDRT, L"", L"",HELP_DDRT_DETAILS_TEXT, FALSE, ValueEmpty},
     {L"", PROTOCOL_OPTION_SMBUS, L"", L"",HELP_SMBUS_DETAILS_TEXT, FALSE, ValueEmpty},
+    {L"", PBR_LATENCY_OPTION, L"", L"",HELP_PBR_LATENCY_DETAILS_TEXT, FALSE, ValueEmpty},
     {L"", L"", L"", L"",FALSE, ValueOptional}
   },                                                                                            //!< options
   {{SESSION_TARGET, L"", L"", TRUE, ValueEmpty}},                                               //!< targets
@@ -153,6 +239,11 @@ ShowSession(
     goto Finish;
   }
 
+  if (containsOption(pCmd, PBR_LATENCY_OPTION)) {
+    ReturnCode = ShowSessionLatency(pPrinterCtx, pNvmDimmPbrProtocol);
+    goto Finish;
+  }
+
   //Retrieve the current TagID (CLI's job to track/increment/reset the tag id).
   PbrDcpmmDeserializeTagId(&TagId, 0);
 
@@ -197,6 +288,124 @@ Finish:
   return  ReturnCode;
 }
 
+/**
+  Show the recorded passthrough time of the session, per opcode/subopcode and in total
+
+  @param[in] pPrinterCtx printer context
+  @param[in] pNvmDimmPbrProtocol PBR protocol
+
+  @retval EFI_SUCCESS success
+  @retval EFI_OUT_OF_RESOURCES memory allocation failure
+**/
+STATIC
+EFI_STATUS
+ShowSessionLatency(
+  IN     PRINT_CONTEXT *pPrinterCtx,
+  IN     EFI_DCPMM_PBR_PROTOCOL *pNvmDimmPbrProtocol
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PASS_THRU_LATENCY *pLatencies = NULL;
+  PASS_THRU_LATENCY *pGrownLatencies = NULL;
+  PASS_THRU_LATENCY Total;
+  PbrPassThruReq *pReq = NULL;
+  CHAR16 *pPath = NULL;
+  UINT32 LatencyCount = 0;
+  UINT32 LatencyCapacity = PASS_THRU_OPCODES_GROW_BY;
+  UINT32 RecordCount = 0;
+  UINT32 RecordsSize = 0;
+  UINT32 PlaybackOffset = 0;
+  UINT32 DataSize = 0;
+  UINT32 Index = 0;
+  UINT32 LatencyIndex = 0;
+
+  ZeroMem(&Total, sizeof(Total));
+
+  pLatencies = AllocateZeroPool(sizeof(*pLatencies) * LatencyCapacity);
+  if (NULL == pLatencies) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_OUT_OF_MEMORY);
+    goto Finish;
+  }
+
+  //a session without passthrough records shows an empty table
+  if (EFI_ERROR(pNvmDimmPbrProtocol->PbrGetDataPlaybackInfo(PBR_PASS_THRU_SIG, &RecordCount, &RecordsSize, &PlaybackOffset))) {
+    RecordCount = 0;
+  }
+
+  for (Index = 0; Index < RecordCount; ++Index) {
+    ReturnCode = pNvmDimmPbrProtocol->PbrGetData(PBR_PASS_THRU_SIG, Index, (VOID **)&pReq, &DataSize, NULL);
+    if (EFI_ERROR(ReturnCode) || DataSize < sizeof(PbrPassThruReq)) {
+      NVDIMM_WARN("Failed to get passthrough record %d", Index);
+      FREE_POOL_SAFE(pReq);
+      ReturnCode = EFI_SUCCESS;
+      continue;
+    }
+
+    for (LatencyIndex = 0; LatencyIndex < LatencyCount; ++LatencyIndex) {
+      if (pLatencies[LatencyIndex].Opcode == pReq->Opcode && pLatencies[LatencyIndex].SubOpcode == pReq->SubOpcode) {
+        break;
+      }
+    }
+    if (LatencyIndex == LatencyCount) {
+      if (LatencyCount == LatencyCapacity) {
+        //ReallocatePool frees the old table only on success
+        pGrownLatencies = ReallocatePool(sizeof(*pLatencies) * LatencyCapacity,
+          sizeof(*pLatencies) * (LatencyCapacity + PASS_THRU_OPCODES_GROW_BY), pLatencies);
+        if (NULL == pGrownLatencies) {
+          FREE_POOL_SAFE(pReq);
+          ReturnCode = EFI_OUT_OF_RESOURCES;
+          PRINTER_SET_MSG(pPrinterCtx, ReturnCode, CLI_ERR_OUT_OF_MEMORY);
+          goto Finish;
+        }
+        pLatencies = pGrownLatencies;
+        LatencyCapacity += PASS_THRU_OPCODES_GROW_BY;
+      }
+      ZeroMem(&pLatencies[LatencyIndex], sizeof(pLatencies[LatencyIndex]));
+      pLatencies[LatencyIndex].Opcode = pReq->Opcode;
+      pLatencies[LatencyIndex].SubOpcode = pReq->SubOpcode;
+      LatencyCount++;
+    }
+
+    //recordings made before latency capture count, but add no time
+    pLatencies[LatencyIndex].Count++;
+    if (PBR_PASS_THRU_LATENCY_UNKNOWN != pReq->TotalMicroseconds) {
+      pLatencies[LatencyIndex].TotalMicroseconds += pReq->TotalMicroseconds;
+      pLatencies[LatencyIndex].MaxMicroseconds = MAX(pLatencies[LatencyIndex].MaxMicroseconds, pReq->TotalMicroseconds);
+    }
+    Total.Count++;
+    if (PBR_PASS_THRU_LATENCY_UNKNOWN != pReq->TotalMicroseconds) {
+      Total.TotalMicroseconds += pReq->TotalMicroseconds;
+      Total.MaxMicroseconds = MAX(Total.MaxMicroseconds, pReq->TotalMicroseconds);
+    }
+    FREE_POOL_SAFE(pReq);
+  }
+
+  for (LatencyIndex = 0; LatencyIndex < LatencyCount; ++LatencyIndex) {
+    PRINTER_BUILD_KEY_PATH(pPath, DS_PASS_THRU_INDEX_PATH, LatencyIndex);
+    PRINTER_SET_KEY_VAL_WIDE_STR_FORMAT(pPrinterCtx, pPath, OPCODE_STR, OPCODE_FORMAT, pLatencies[LatencyIndex].Opcode);
+    PRINTER_SET_KEY_VAL_WIDE_STR_FORMAT(pPrinterCtx, pPath, SUBOPCODE_STR, OPCODE_FORMAT, pLatencies[LatencyIndex].SubOpcode);
+    PRINTER_SET_KEY_VAL_UINT64(pPrinterCtx, pPath, COUNT_STR, pLatencies[LatencyIndex].Count, DECIMAL);
+    PRINTER_SET_KEY_VAL_UINT64(pPrinterCtx, pPath, TOTAL_TIME_STR, pLatencies[LatencyIndex].TotalMicroseconds, DECIMAL);
+    PRINTER_SET_KEY_VAL_UINT64(pPrinterCtx, pPath, MAX_TIME_STR, pLatencies[LatencyIndex].MaxMicroseconds, DECIMAL);
+  }
+
+  PRINTER_BUILD_KEY_PATH(pPath, DS_PASS_THRU_INDEX_PATH, LatencyCount);
+  PRINTER_SET_KEY_VAL_WIDE_STR(pPrinterCtx, pPath, OPCODE_STR, TOTAL_STR);
+  PRINTER_SET_KEY_VAL_WIDE_STR(pPrinterCtx, pPath, SUBOPCODE_STR, L"");
+  PRINTER_SET_KEY_VAL_UINT64(pPrinterCtx, pPath, COUNT_STR, Total.Count, DECIMAL);
+  PRINTER_SET_KEY_VAL_UINT64(pPrinterCtx, pPath, TOTAL_TIME_STR, Total.TotalMicroseconds, DECIMAL);
+  PRINTER_SET_KEY_VAL_UINT64(pPrinterCtx, pPath, MAX_TIME_STR, Total.MaxMicroseconds, DECIMAL);
+
+  PRINTER_CONFIGURE_DATA_ATTRIBUTES(pPrinterCtx, DS_ROOT_PATH, &ShowSessionLatencyDataSetAttribs);
+  PRINTER_ENABLE_TEXT_TABLE_FORMAT(pPrinterCtx);
+
+Finish:
+  FREE_POOL_SAFE(pPath);
+  FREE_POOL_SAFE(pLatencies);
+  return ReturnCode;
+}
+
 /**
   Register the show session command
 
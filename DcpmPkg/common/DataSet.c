@@ -50,10 +50,14 @@ do { \
   } \
   KeyVal->ValueToString = CatSPrint(NULL, FormatString(ValTypeEnum, Base), *((ValType*)Val)); \
   KeyVal->KeyValInfo.Type = ValTypeEnum; \
+  KeyVal->KeyValInfo.Base = Base; \
   *RetVal = EFI_SUCCESS; \
 }while(0)
 
 VOID FreeAllKeyValuePairs(DATA_SET *DataSet);
+KEY_VAL * FindKeyValuePair(DATA_SET *DataSet, const CHAR16 *Key);
+KEY_VAL * SetKeyValue(DATA_SET_CONTEXT *DataSetCtx, const CHAR16 *Key, VOID * Val, UINTN ValSize);
+VOID CopyKeyValue(DATA_SET_CONTEXT *DestDataSetCtx, DATA_SET_CONTEXT *SrcDataSetCtx, const CHAR16 *Key);
 
 /*
 * Set all data sets in the ancestry path to dirty.
@@ -424,7 +428,6 @@ VOID * SquashDataSetCb(DATA_SET_CONTEXT *DataSetCtx, CHAR16 *CurPath, VOID *User
   DATA_SET_CONTEXT *RootDataSet = (DATA_SET_CONTEXT*)UserData;
   DATA_SET_CONTEXT *NewDataSet = NULL;
   KEY_VAL_INFO *KvInfo = NULL;
-  CHAR16 *Val = NULL;
 
   if (NULL == UserData) {
     return NULL;
@@ -433,25 +436,16 @@ VOID * SquashDataSetCb(DATA_SET_CONTEXT *DataSetCtx, CHAR16 *CurPath, VOID *User
   if (IsLeaf(DataSetCtx)) {
     NewDataSet = CreateDataSet(RootDataSet, GetDataSetName(DataSetCtx), NULL);
     while (NULL != (KvInfo = GetNextKey(DataSetCtx, KvInfo))) {
-      GetKeyValueWideStr(DataSetCtx, KvInfo->Key, &Val, NULL);
-      if (Val) {
-        SetKeyValueWideStr(NewDataSet, KvInfo->Key, Val);
-      }
+      CopyKeyValue(NewDataSet, DataSetCtx, KvInfo->Key);
     }
     KvInfo = NULL;
     while (NULL != (KvInfo = GetNextKey(RootDataSet, KvInfo))) {
-      GetKeyValueWideStr(RootDataSet, KvInfo->Key, &Val, NULL);
-      if (Val) {
-        SetKeyValueWideStr(NewDataSet, KvInfo->Key, Val);
-      }
+      CopyKeyValue(NewDataSet, RootDataSet, KvInfo->Key);
     }
   }
   else {
     while (NULL != (KvInfo = GetNextKey(DataSetCtx, KvInfo))) {
-      GetKeyValueWideStr(DataSetCtx, KvInfo->Key, &Val, NULL);
-      if (Val) {
-        SetKeyValueWideStr(RootDataSet, KvInfo->Key, Val);
-      }
+      CopyKeyValue(RootDataSet, DataSetCtx, KvInfo->Key);
     }
   }
   return NULL;
@@ -642,6 +636,7 @@ EFI_STATUS SetKeyValueWideStr(DATA_SET_CONTEXT *DataSetCtx, const CHAR16 *Key, c
   }
   CopyMem(KeyVal->Value, (VOID*)Val, StrSize(Val));
   KeyVal->ValueToString = KeyVal->Value;
+  KeyVal->KeyValInfo.Type = KEY_W_STR;
   SetAncestorsDirty(DataSetCtx);
   return EFI_SUCCESS;
 }
@@ -701,6 +696,34 @@ KEY_VAL * SetKeyValue(DATA_SET_CONTEXT *DataSetCtx, const CHAR16 *Key, VOID * Va
   return KeyVal;
 }
 
+/*
+* Copy a key/value pair from one data set to another, keeping its type and display string
+*/
+VOID CopyKeyValue(DATA_SET_CONTEXT *DestDataSetCtx, DATA_SET_CONTEXT *SrcDataSetCtx, const CHAR16 *Key) {
+  KEY_VAL *SrcKeyVal = NULL;
+  KEY_VAL *KeyVal = NULL;
+
+  if (NULL == DestDataSetCtx || NULL == SrcDataSetCtx || NULL == Key) {
+    return;
+  }
+
+  if (NULL == (SrcKeyVal = FindKeyValuePair((DATA_SET*)SrcDataSetCtx, Key)) || NULL == SrcKeyVal->ValueToString) {
+    return;
+  }
+
+  if (KEY_W_STR == SrcKeyVal->KeyValInfo.Type) {
+    SetKeyValueWideStr(DestDataSetCtx, Key, SrcKeyVal->ValueToString);
+    return;
+  }
+
+  if (NULL == (KeyVal = SetKeyValue(DestDataSetCtx, Key, SrcKeyVal->Value, SrcKeyVal->KeyValInfo.ValueSize))) {
+    return;
+  }
+  KeyVal->ValueToString = CatSPrint(NULL, FORMAT_STR, SrcKeyVal->ValueToString);
+  KeyVal->KeyValInfo.Type = SrcKeyVal->KeyValInfo.Type;
+  KeyVal->KeyValInfo.Base = SrcKeyVal->KeyValInfo.Base;
+}
+
 /*
 * Helper to get all primitive types
 */
@@ -758,6 +781,8 @@ EFI_STATUS SetKeyValueBool(DATA_SET_CONTEXT *DataSetCtx, const CHAR16 *Key, BOOL
   }
   CopyMem(KeyVal->Value, (VOID*)&Val, sizeof(BOOLEAN));
   KeyVal->ValueToString = CatSPrint(NULL, BoolVal);
+  KeyVal->KeyValInfo.Type = KEY_BOOL;
+  KeyVal->KeyValInfo.ValueSize = sizeof(BOOLEAN);
   SetAncestorsDirty(DataSetCtx);
   return EFI_SUCCESS;
 }
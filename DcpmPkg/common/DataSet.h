@@ -64,6 +64,7 @@ typedef struct _KEY_VAL_INFO {
   KEY_TYPE Type;      //type of value associated with a particular key
   CHAR16 *Key;        //the name associated with a particular value
   UINT32 ValueSize;   //the binary size of the value
+  TO_STRING_BASE Base;//base the value is displayed in, numeric types only
   VOID *UserData;     //user data
 }KEY_VAL_INFO;
 
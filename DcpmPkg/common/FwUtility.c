@@ -359,6 +359,62 @@ Finish:
   return ReturnValue;
 }
 
+/**
+  Attach zeroed large payload buffers to a firmware command.
+  A buffer is allocated only if the matching LargeInputPayloadSize or
+  LargeOutputPayloadSize is non-zero and no buffer is attached yet.
+
+  @param[in, out] pFwCmd Firmware command with large payload sizes set
+
+  @retval EFI_SUCCESS Buffers attached
+  @retval EFI_INVALID_PARAMETER pFwCmd is NULL or a size exceeds the mailbox size
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+AllocateFwCmdLargePayloads(
+  IN OUT FW_CMD *pFwCmd
+  )
+{
+  if (pFwCmd == NULL || pFwCmd->LargeInputPayloadSize > IN_MB_SIZE ||
+      pFwCmd->LargeOutputPayloadSize > OUT_MB_SIZE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (pFwCmd->LargeInputPayloadSize > 0 && pFwCmd->LargeInputPayload == NULL) {
+    pFwCmd->LargeInputPayload = AllocateZeroPool(pFwCmd->LargeInputPayloadSize);
+    if (pFwCmd->LargeInputPayload == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  if (pFwCmd->LargeOutputPayloadSize > 0 && pFwCmd->LargeOutputPayload == NULL) {
+    pFwCmd->LargeOutputPayload = AllocateZeroPool(pFwCmd->LargeOutputPayloadSize);
+    if (pFwCmd->LargeOutputPayload == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Free the large payload buffers attached to a firmware command.
+  Buffers owned by the caller must be detached (set to NULL) beforehand.
+
+  @param[in, out] pFwCmd Firmware command
+**/
+VOID
+FreeFwCmdLargePayloads(
+  IN OUT FW_CMD *pFwCmd
+  )
+{
+  if (pFwCmd == NULL) {
+    return;
+  }
+
+  FREE_POOL_SAFE(pFwCmd->LargeInputPayload);
+  FREE_POOL_SAFE(pFwCmd->LargeOutputPayload);
+}
 
 /**
   Calculates the checksum of passed in buffer and keeps a running
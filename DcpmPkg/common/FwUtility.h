@@ -76,20 +76,37 @@ typedef struct {
   // Additional buffer for potential OS special passthrough
   // See use of SubopExtVendorSpecific in PassThru()
   UINT8 InputPayload[IN_PAYLOAD_SIZE + IN_PAYLOAD_SIZE_EXT_PAD];
-  UINT8 LargeInputPayload[IN_MB_SIZE];
+  // Large payloads are attached out of line, only when the matching size is non-zero.
+  // See AllocateFwCmdLargePayloads() and FREE_FW_CMD_SAFE()
+  UINT8 *LargeInputPayload;
   UINT8 OutPayload[OUT_PAYLOAD_SIZE];
-  UINT8 LargeOutputPayload[OUT_MB_SIZE];
+  UINT8 *LargeOutputPayload;
   UINT32 DimmID;
   UINT8 Opcode;
   UINT8 SubOpcode;
   UINT8 Status;
 #ifdef OS_BUILD
   UINT8 DsmStatus;
+  // Filled in by the OS passthrough: number of submissions, busy retries included,
+  // and the total time spent in microseconds
+  UINT32 Attempts;
+  UINT64 ElapsedUs;
 #endif
 } FW_CMD;
 
 #pragma pack(pop)
 
+/**
+  Free a firmware command together with its attached large payload buffers
+**/
+#define FREE_FW_CMD_SAFE(pFwCmd) { \
+  if (pFwCmd != NULL) { \
+    FreeFwCmdLargePayloads(pFwCmd); \
+    FreePool((VOID *)pFwCmd); \
+    pFwCmd = NULL; \
+  } \
+};
+
 /**
   Version struct definition
 **/
@@ -402,6 +419,33 @@ IsFwStaged(
   IN FIRMWARE_VERSION StagedFwVersion
   );
 
+/**
+  Attach zeroed large payload buffers to a firmware command.
+  A buffer is allocated only if the matching LargeInputPayloadSize or
+  LargeOutputPayloadSize is non-zero and no buffer is attached yet.
+
+  @param[in, out] pFwCmd Firmware command with large payload sizes set
+
+  @retval EFI_SUCCESS Buffers attached
+  @retval EFI_INVALID_PARAMETER pFwCmd is NULL or a size exceeds the mailbox size
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+AllocateFwCmdLargePayloads(
+  IN OUT FW_CMD *pFwCmd
+  );
+
+/**
+  Free the large payload buffers attached to a firmware command.
+  Buffers owned by the caller must be detached (set to NULL) beforehand.
+
+  @param[in, out] pFwCmd Firmware command
+**/
+VOID
+FreeFwCmdLargePayloads(
+  IN OUT FW_CMD *pFwCmd
+  );
+
 /**
   Calculates the checksum of passed in buffer and keeps a running
   value. Used by CR FW for computing their checksum, used in our code for get/set
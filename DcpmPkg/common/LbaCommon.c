@@ -141,6 +141,7 @@ VOID FreeLsaSafe(
       FREE_POOL_SAFE(((*ppLabelStorageArea)->Index)->pReserved);
     }
     FREE_POOL_SAFE((*ppLabelStorageArea)->pLabels);
+    FREE_POOL_SAFE((*ppLabelStorageArea)->pDirtySlots);
     FREE_POOL_SAFE(*ppLabelStorageArea);
   }
 }
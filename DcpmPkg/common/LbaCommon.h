@@ -115,6 +115,12 @@ typedef struct {
 typedef struct {
   NAMESPACE_INDEX Index[NAMESPACE_INDEXES];
   NAMESPACE_LABEL *pLabels;
+  /**
+    Write-back tracking of an LSA read from a DIMM: one bit per label slot changed
+    since the read. NULL when the LSA was built in memory and has to be written whole.
+  **/
+  UINT8 *pDirtySlots;
+  UINT8 DirtyIndexes;                 //!< One bit per index block changed since the read
 } LABEL_STORAGE_AREA;
 
 #pragma pack(pop)
@@ -8,6 +8,7 @@
 #include <Debug.h>
 #include <Types.h>
 #include <Convert.h>
+#include <Utility.h>
 #include "Pbr.h"
 #include "PbrDcpmm.h"
 #ifdef OS_BUILD
@@ -15,17 +16,43 @@
 #else
 STATIC EFI_STATUS PbrSerializeCtx(PbrContext *ctx, BOOLEAN Force);
 STATIC EFI_STATUS PbrDeserializeCtx(PbrContext * ctx);
+PbrPartitionIndex *PbrGetPartitionIndex(UINT32 CtxIndex);
 #endif
 //local helper function prototypes
 STATIC EFI_STATUS PbrCheckBufferIntegrity(PbrContext *ctx);
 STATIC EFI_STATUS PbrComposeSession(PbrContext *pContext, VOID **ppBufferAddress, UINT32 *pBufferSize);
 STATIC EFI_STATUS PbrDecomposeSession(PbrContext *pContext, VOID *pPbrImg, UINT32 PbrImgSize);
+STATIC EFI_STATUS PbrLoadSession(PbrContext *pContext, VOID *pBufferAddress, UINT32 BufferSize);
 STATIC EFI_STATUS PbrCreateSessionContext(PbrContext * ctx);
 STATIC UINT32 PbrPartitionCount();
 STATIC EFI_STATUS PbrGetPartition(UINT32 Signature, PbrPartitionContext **ppPartition);
 STATIC EFI_STATUS PbrCopyChunks(VOID *pDest, UINT32 pDestSz, VOID *pSource, UINT32 pSourceSz);
+STATIC INT32 PbrFindPartition(PbrContext *pContext, UINT32 Signature);
+STATIC VOID PbrResetPartitionLookup();
+STATIC EFI_STATUS PbrIndexAppend(PbrPartitionIndex *pIndex, UINT32 Offset);
+STATIC VOID PbrReleaseIndexOffsets(PbrPartitionIndex *pIndex);
+STATIC VOID PbrReleasePartitionData(PbrContext *pContext, UINT32 CtxIndex);
+STATIC EFI_STATUS PbrMakePartitionWritable(PbrContext *pContext, UINT32 CtxIndex);
+STATIC PbrPartitionLogicalDataItem *PbrGetIndexedItem(PbrContext *pContext, UINT32 CtxIndex, UINT32 Index);
+STATIC EFI_STATUS PbrDecomposeLog(PbrContext *pContext, VOID *pLog, UINT32 LogSize);
+STATIC EFI_STATUS PbrApplyLogFrames(PbrContext *pContext, VOID *pLog, UINT32 LogSize);
+STATIC VOID PbrTruncatePartition(PbrContext *pContext, UINT32 CtxIndex, UINT32 ItemCnt);
+STATIC EFI_STATUS PbrCopyReleasedItems(UINT32 CtxIndex, VOID *pDest, UINT32 DestSize);
+#ifdef OS_BUILD
+STATIC EFI_STATUS PbrStreamPartition(PbrContext *pContext, UINT32 CtxIndex);
+#endif
 
 PbrContext gPbrContext;
+PbrPartitionIndex gPbrPartitionIndexes[MAX_PARTITIONS];
+PbrStreamContext gPbrStreamContext;
+
+//streamed partitions keep at most this many recorded bytes in memory, the rest is read back from the record log
+#define PBR_STREAM_RESIDENT_SIZE              (1024 * 1024)
+
+//signature to PartitionContexts slot lookup, entries are the slot + 1 so zero means empty
+#define PBR_PARTITION_LOOKUP_SZ               128 //power of two, larger than MAX_PARTITIONS
+#define PBR_PARTITION_LOOKUP_HASH(Sig)        ((UINT32)((Sig) * 2654435761U) >> 25)
+STATIC UINT8 mPbrPartitionLookup[PBR_PARTITION_LOOKUP_SZ];
 //used for setting volatile/non-volatile uefi variables
 extern EFI_GUID gIntelDimmPbrVariableGuid;
 extern EFI_GUID gIntelDimmPbrTagIdVariableguid;
@@ -58,9 +85,13 @@ PbrSetData(
 )
 {
   UINT32 CtxIndex = 0;
+  INT32 PartitionSlot = 0;
+  UINT32 OldSize = 0;
+  UINT32 NewSize = 0;
   EFI_STATUS ReturnCode = EFI_SUCCESS;
   PbrContext *pContext = PBR_CTX();
   PbrPartitionLogicalDataItem *pDataItem = NULL;
+  PbrPartitionIndex *pIndex = NULL;
 
   if (NULL == pContext) {
     NVDIMM_DBG("No PBR context\n");
@@ -68,93 +99,115 @@ PbrSetData(
     goto Finish;
   }
 
+  //items handed out by the previous call are filled in by now, a failed log write is retried next time
+  PbrFlushSession();
+
   //find the partition associated input param Signature
-  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
-    //partition signature check
-    if (Signature == pContext->PartitionContexts[CtxIndex].PartitionSig) {
-      //caller wants the data object to be a singleton (only one logical data associated with this specific partition)
-      if (Singleton) {
-        //is the size previously allocated for this partition big enough?
-        if (Size > pContext->PartitionContexts[CtxIndex].PartitionSize) {
-          //no it isn't, let's free anything previously allocated
-          if (pContext->PartitionContexts[CtxIndex].PartitionData) {
-            FreePool(pContext->PartitionContexts[CtxIndex].PartitionData);
-          }
-          //allocate just enough to add our new singleton data object
-          pDataItem = AllocateZeroPool(Size+sizeof(PbrPartitionLogicalDataItem));
-          if (NULL == pDataItem) {
-            ReturnCode = EFI_OUT_OF_RESOURCES;
-            NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
-            goto Finish;
-          }
-          pContext->PartitionContexts[CtxIndex].PartitionData = pDataItem;
-          //update our internal context with the new partition size
-          pContext->PartitionContexts[CtxIndex].PartitionSize = Size + sizeof(PbrPartitionLogicalDataItem);
-          //now that we have memory allocated, let's copy caller data into it
-          //note, caller has option to not provide data.
-          if (pData) {
-            PbrCopyChunks(pDataItem->Data,
-              Size,
-              pData,
-              Size);
-          }
-          pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt = 1;
-          pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset = Size + sizeof(PbrPartitionLogicalDataItem);
-          pContext->PartitionContexts[CtxIndex].PartitionEndOffset = 0; //not used yet
-          //individual data objects within a partition are signed generically as PBR_LOGICAL_DATA_SIG
-          //only the partition itself contains the specific signature associated with the data (each data signature has a partition associated with it)
-          pDataItem->Signature = PBR_LOGICAL_DATA_SIG;
-          pDataItem->Size = Size;
+  PartitionSlot = PbrFindPartition(pContext, Signature);
+  if (PartitionSlot >= 0) {
+    CtxIndex = (UINT32)PartitionSlot;
+    //partitions loaded from a playback file may be read-only mappings
+    ReturnCode = PbrMakePartitionWritable(pContext, CtxIndex);
+    if (EFI_ERROR(ReturnCode)) {
+      goto Finish;
+    }
+    //caller wants the data object to be a singleton (only one logical data associated with this specific partition)
+    if (Singleton) {
+      //is the size previously allocated for this partition big enough?
+      if (Size + sizeof(PbrPartitionLogicalDataItem) > pContext->PartitionContexts[CtxIndex].PartitionSize) {
+        //no it isn't, let's free anything previously allocated
+        PbrReleasePartitionData(pContext, CtxIndex);
+        //allocate just enough to add our new singleton data object
+        pDataItem = AllocateZeroPool(Size+sizeof(PbrPartitionLogicalDataItem));
+        if (NULL == pDataItem) {
+          ReturnCode = EFI_OUT_OF_RESOURCES;
+          NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
           goto Finish;
         }
-        else {
-          pDataItem = (PbrPartitionLogicalDataItem*)(pContext->PartitionContexts[CtxIndex].PartitionData);
-          pDataItem->Signature = PBR_LOGICAL_DATA_SIG;
-          pDataItem->Size = Size;
-          if (pData) {
-            PbrCopyChunks(pDataItem->Data,
-              pContext->PartitionContexts[CtxIndex].PartitionSize,
-              pData,
-              Size);
-          }
-          goto Finish;
+        pContext->PartitionContexts[CtxIndex].PartitionData = pDataItem;
+        //update our internal context with the new partition size
+        pContext->PartitionContexts[CtxIndex].PartitionSize = Size + sizeof(PbrPartitionLogicalDataItem);
+        //now that we have memory allocated, let's copy caller data into it
+        //note, caller has option to not provide data.
+        if (pData) {
+          PbrCopyChunks(pDataItem->Data,
+            Size,
+            pData,
+            Size);
         }
+        pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt = 1;
+        pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset = Size + sizeof(PbrPartitionLogicalDataItem);
+        pContext->PartitionContexts[CtxIndex].PartitionEndOffset = 0; //not used yet
+        //individual data objects within a partition are signed generically as PBR_LOGICAL_DATA_SIG
+        //only the partition itself contains the specific signature associated with the data (each data signature has a partition associated with it)
+        pDataItem->Signature = PBR_LOGICAL_DATA_SIG;
+        pDataItem->Size = Size;
       }
       else {
-        //allocate more memory if needed
-        if (pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset + (Size + sizeof(PbrPartitionLogicalDataItem)) > pContext->PartitionContexts[CtxIndex].PartitionSize) {
-          pContext->PartitionContexts[CtxIndex].PartitionData = ReallocatePool(pContext->PartitionContexts[CtxIndex].PartitionSize,
-            pContext->PartitionContexts[CtxIndex].PartitionSize + ((Size + sizeof(PbrPartitionLogicalDataItem)) * PARTITION_GROW_SZ_MULTIPLIER),
-            pContext->PartitionContexts[CtxIndex].PartitionData);
-
-          if (NULL == pContext->PartitionContexts[CtxIndex].PartitionData) {
-            ReturnCode = EFI_OUT_OF_RESOURCES;
-            NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
-            goto Finish;
-          }
-          pContext->PartitionContexts[CtxIndex].PartitionSize += ((Size + sizeof(PbrPartitionLogicalDataItem)) * PARTITION_GROW_SZ_MULTIPLIER);
-        }
-        pDataItem = (PbrPartitionLogicalDataItem*)((UINTN)pContext->PartitionContexts[CtxIndex].PartitionData + (UINTN)pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset);
+        pDataItem = (PbrPartitionLogicalDataItem*)(pContext->PartitionContexts[CtxIndex].PartitionData);
         pDataItem->Signature = PBR_LOGICAL_DATA_SIG;
         pDataItem->Size = Size;
-        //now that we have memory allocated, let's copy caller data into it
-        //note, caller has option to not provide data.
         if (pData) {
           PbrCopyChunks(pDataItem->Data,
-            pContext->PartitionContexts[CtxIndex].PartitionSize - pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset,
+            pContext->PartitionContexts[CtxIndex].PartitionSize,
             pData,
             Size);
         }
-        //keep track of how many data objects copied to each partition
-        pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt++;
-        //next position to copy data to
+      }
+      goto Finish;
+    }
+    //make sure the item index covers the existing items before appending to it
+    pIndex = PbrGetPartitionIndex(CtxIndex);
+    if (NULL == pIndex) {
+      ReturnCode = EFI_OUT_OF_RESOURCES;
+      goto Finish;
+    }
+    //allocate more memory if needed, grow geometrically so long recordings are not reallocated on every item
+    if (pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset + (Size + sizeof(PbrPartitionLogicalDataItem)) > pContext->PartitionContexts[CtxIndex].PartitionSize) {
+      OldSize = pContext->PartitionContexts[CtxIndex].PartitionSize;
+      NewSize = OldSize * 2;
+      if (NewSize < pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset + ((Size + sizeof(PbrPartitionLogicalDataItem)) * PARTITION_GROW_SZ_MULTIPLIER)) {
+        NewSize = pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset + ((Size + sizeof(PbrPartitionLogicalDataItem)) * PARTITION_GROW_SZ_MULTIPLIER);
+      }
+      pContext->PartitionContexts[CtxIndex].PartitionData = ReallocatePool(OldSize,
+        NewSize,
+        pContext->PartitionContexts[CtxIndex].PartitionData);
 
-        pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset += (Size + sizeof(PbrPartitionLogicalDataItem));
+      if (NULL == pContext->PartitionContexts[CtxIndex].PartitionData) {
+        ReturnCode = EFI_OUT_OF_RESOURCES;
+        NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
+        goto Finish;
       }
+      //the unused tail must not look like a logical data item to GET_NEXT_DATA_INDEX playback
+      ZeroMem((VOID*)((UINTN)pContext->PartitionContexts[CtxIndex].PartitionData + OldSize), NewSize - OldSize);
+      pContext->PartitionContexts[CtxIndex].PartitionSize = NewSize;
+      pIndex->PartitionData = pContext->PartitionContexts[CtxIndex].PartitionData;
+    }
+    pDataItem = (PbrPartitionLogicalDataItem*)((UINTN)pContext->PartitionContexts[CtxIndex].PartitionData + (UINTN)pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset);
+    pDataItem->Signature = PBR_LOGICAL_DATA_SIG;
+    pDataItem->Size = Size;
+    //now that we have memory allocated, let's copy caller data into it
+    //note, caller has option to not provide data.
+    if (pData) {
+      PbrCopyChunks(pDataItem->Data,
+        pContext->PartitionContexts[CtxIndex].PartitionSize - pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset,
+        pData,
+        Size);
+    }
+    //keep track of how many data objects copied to each partition
+    pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt++;
+    ReturnCode = PbrIndexAppend(pIndex, pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset);
+    if (EFI_ERROR(ReturnCode)) {
       goto Finish;
     }
-    //if we haven't found a previously allocated partition associated with Signature then create one
-    else if (PBR_INVALID_SIG == pContext->PartitionContexts[CtxIndex].PartitionSig) {
+    //next position to copy data to
+    pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset += (Size + sizeof(PbrPartitionLogicalDataItem));
+    goto Finish;
+  }
+
+  //if we haven't found a previously allocated partition associated with Signature then create one
+  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
+    if (PBR_INVALID_SIG == pContext->PartitionContexts[CtxIndex].PartitionSig) {
       break;
     }
   }
@@ -188,6 +241,15 @@ PbrSetData(
       pData,
       Size);
   }
+  //the first item of a new partition is always at offset 0
+  pIndex = &gPbrPartitionIndexes[CtxIndex];
+  PbrReleaseIndexOffsets(pIndex);
+  pIndex->PartitionData = pContext->PartitionContexts[CtxIndex].PartitionData;
+  pIndex->DataMapSize = 0;
+  ReturnCode = PbrIndexAppend(pIndex, 0);
+  if (EFI_ERROR(ReturnCode)) {
+    goto Finish;
+  }
   //advance next recording offset pointer
   pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset += (Size + sizeof(PbrPartitionLogicalDataItem));
 Finish:
@@ -204,6 +266,11 @@ Finish:
   if (EFI_SUCCESS == ReturnCode && pLogicalIndex) {
     *pLogicalIndex = pDataItem->LogicalIndex;
   }
+  //a singleton is streamed again whenever it is replaced
+  if (EFI_SUCCESS == ReturnCode && Singleton) {
+    gPbrStreamContext.Partitions[CtxIndex].Singleton = TRUE;
+    gPbrStreamContext.Partitions[CtxIndex].Dirty = TRUE;
+  }
   return ReturnCode;
 }
 
@@ -233,56 +300,75 @@ PbrGetData(
 )
 {
   UINT32 CtxIndex = 0;
-  UINT32 PartitionCtxIndex = 0;
+  INT32 PartitionSlot = 0;
+  PbrPartitionContext *pPartition = NULL;
   EFI_STATUS ReturnCode = EFI_NOT_FOUND;
   PbrContext *pContext = PBR_CTX();
   PbrPartitionLogicalDataItem *pDataItem = NULL;
+#ifdef OS_BUILD
+  PbrPartitionStream *pStream = NULL;
+#endif
 
   //find the partition associated input param Signature
-  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
-    //if signature matches
-    if (Signature == pContext->PartitionContexts[CtxIndex].PartitionSig) {
-      //caller wants the next data object within the playback session
-      if(GET_NEXT_DATA_INDEX == Index){
-        //get the next logical data item
-        pDataItem = (PbrPartitionLogicalDataItem *)((UINTN)pContext->PartitionContexts[CtxIndex].PartitionData + (UINTN)pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset);
-        //verify the data item is valid, if not return EFI_NOT_FOUND
-        if (PBR_LOGICAL_DATA_SIG != pDataItem->Signature) {
-          goto Finish;
-        }
-        //found it, now advance the current pbr offset so the next time this is called the next logical data item is returned
-        pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset += (sizeof(PbrPartitionLogicalDataItem) + pDataItem->Size);
-        ReturnCode = EFI_SUCCESS;
-      }
-      else {
-        //caller wants a specific indexed data item
-        pDataItem = (PbrPartitionLogicalDataItem *)(pContext->PartitionContexts[CtxIndex].PartitionData);
-        //iterate through all items
-        while (PBR_LOGICAL_DATA_SIG == pDataItem->Signature) {
-          if ((UINT32)Index == PartitionCtxIndex) {
-            ReturnCode = EFI_SUCCESS;
-            break;
-          }
-          pDataItem = (PbrPartitionLogicalDataItem *)((UINTN)pDataItem + (UINTN)pDataItem->Size + sizeof(PbrPartitionLogicalDataItem));
-          ++PartitionCtxIndex;
-        }
-      }
-      //if indexed item was located, allocate memory and copy the data to the caller
-      if (EFI_SUCCESS == ReturnCode) {
-        *ppData = AllocateZeroPool(pDataItem->Size);
-        if (NULL == *ppData) {
-          ReturnCode = EFI_OUT_OF_RESOURCES;
-          NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
-          goto Finish;
-        }
-        *pSize = pDataItem->Size;
-        PbrCopyChunks(*ppData, *pSize, pDataItem->Data, pDataItem->Size);
-        ReturnCode = EFI_SUCCESS;
+  PartitionSlot = PbrFindPartition(pContext, Signature);
+  if (PartitionSlot < 0) {
+    goto Finish;
+  }
+  CtxIndex = (UINT32)PartitionSlot;
+  pPartition = &pContext->PartitionContexts[CtxIndex];
+  if (NULL == pPartition->PartitionData) {
+    goto Finish;
+  }
+
+  //caller wants the next data object within the playback session
+  if (GET_NEXT_DATA_INDEX == Index) {
+    //verify the data item header and payload are within the partition, if not return EFI_NOT_FOUND
+    if (pPartition->PartitionCurrentOffset > pPartition->PartitionSize ||
+      pPartition->PartitionSize - pPartition->PartitionCurrentOffset < sizeof(PbrPartitionLogicalDataItem)) {
+      goto Finish;
+    }
+    //get the next logical data item
+    pDataItem = (PbrPartitionLogicalDataItem *)((UINTN)pPartition->PartitionData + (UINTN)pPartition->PartitionCurrentOffset);
+    if (PBR_LOGICAL_DATA_SIG != pDataItem->Signature ||
+      pDataItem->Size > pPartition->PartitionSize - pPartition->PartitionCurrentOffset - sizeof(PbrPartitionLogicalDataItem)) {
+      goto Finish;
+    }
+    //found it, now advance the current pbr offset so the next time this is called the next logical data item is returned
+    pPartition->PartitionCurrentOffset += (sizeof(PbrPartitionLogicalDataItem) + pDataItem->Size);
+  }
+  else {
+#ifdef OS_BUILD
+    //items released from memory by a streamed recording are read back from the record log
+    pStream = &gPbrStreamContext.Partitions[CtxIndex];
+    if ((UINT32)Index < pStream->ReleasedCnt) {
+      if (NULL == pStream->pLocations) {
         goto Finish;
       }
+      ReturnCode = PbrLogRead(pStream->pLocations[Index], Signature, (UINT32)Index, ppData, pSize);
+      if (EFI_SUCCESS == ReturnCode && pLogicalIndex) {
+        *pLogicalIndex = (UINT32)Index;
+      }
+      return ReturnCode;
+    }
+#endif
+    //caller wants a specific indexed data item, look it up in the partition item index
+    pDataItem = PbrGetIndexedItem(pContext, CtxIndex, (UINT32)Index);
+    if (NULL == pDataItem) {
+      goto Finish;
     }
   }
 
+  //item was located, allocate memory and copy the data to the caller
+  *ppData = AllocateZeroPool(pDataItem->Size);
+  if (NULL == *ppData) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
+    goto Finish;
+  }
+  *pSize = pDataItem->Size;
+  PbrCopyChunks(*ppData, *pSize, pDataItem->Data, pDataItem->Size);
+  ReturnCode = EFI_SUCCESS;
+
 Finish:
   //if caller has requested the data item index
   if (EFI_SUCCESS == ReturnCode && pLogicalIndex) {
@@ -312,20 +398,18 @@ PbrGetDataPlaybackInfo(
   OUT UINT32 *pCurrentPlaybackDataOffset
 )
 {
-  UINT32 CtxIndex = 0;
+  INT32 PartitionSlot = 0;
   EFI_STATUS ReturnCode = EFI_NOT_FOUND;
   PbrContext *pContext = PBR_CTX();
   PbrPartitionContext *pPartition = NULL;
 
-  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
-    if (Signature == pContext->PartitionContexts[CtxIndex].PartitionSig) {
-      pPartition = &pContext->PartitionContexts[CtxIndex];
-      *pTotalDataItems = pPartition->PartitionLogicalDataCnt;
-      *pTotalDataSize = pPartition->PartitionSize;
-      *pCurrentPlaybackDataOffset = pPartition->PartitionCurrentOffset;
-      ReturnCode = EFI_SUCCESS;
-      break;
-    }
+  PartitionSlot = PbrFindPartition(pContext, Signature);
+  if (PartitionSlot >= 0) {
+    pPartition = &pContext->PartitionContexts[PartitionSlot];
+    *pTotalDataItems = pPartition->PartitionLogicalDataCnt;
+    *pTotalDataSize = pPartition->PartitionSize;
+    *pCurrentPlaybackDataOffset = pPartition->PartitionCurrentOffset;
+    ReturnCode = EFI_SUCCESS;
   }
   return ReturnCode;
 }
@@ -361,6 +445,8 @@ PbrSetMode(
   }
   //if normal, free buffers
   else if (PBR_NORMAL_MODE == PbrMode) {
+    //the record log outlives the session, so it can still be loaded
+    PbrFlushSession();
     PbrFreeSession();
     ZeroMem(pContext, sizeof(PbrContext));
   }
@@ -441,6 +527,102 @@ PbrSetSession(
     NVDIMM_DBG("Failed to free session!");
     goto Finish;
   }
+#ifdef OS_BUILD
+  //a new session gets a new record log, a loaded one may be read from the old log, which stays
+  if (NULL == pBufferAddress) {
+    PbrLogReset();
+  }
+#endif
+
+  ReturnCode = PbrLoadSession(pContext, pBufferAddress, BufferSize);
+
+Finish:
+  return ReturnCode;
+}
+
+#ifdef OS_BUILD
+/**
+  Set the PBR session to the session file at pFilePath. The file is mapped read-only
+  and the partitions of the session point into the mapping, so playback does not
+  copy the file. The mapping is released by PbrFreeSession.
+
+  @param[in] pFilePath: path of the session file
+  @param[out] ppImage: start of the mapped file, valid until the session is freed
+  @param[out] pImageSize: size in bytes of the file
+
+  @retval EFI_SUCCESS if the session is loaded
+  @retval EFI_NOT_READY if the pbr context is not available
+  @retval EFI_INVALID_PARAMETER if one or more parameters equal NULL
+  @retval EFI_UNSUPPORTED if the file cannot be mapped, the caller reads it and uses PbrSetSession
+**/
+EFI_STATUS
+EFIAPI
+PbrSetSessionFile(
+  IN     CHAR16 *pFilePath,
+     OUT VOID **ppImage,
+     OUT UINT32 *pImageSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrContext *pContext = PBR_CTX();
+  CHAR8 *pAsciiPath = NULL;
+  UINTN PathSize = 0;
+
+  if (NULL == pContext) {
+    NVDIMM_DBG("No PBR context\n");
+    return EFI_NOT_READY;
+  }
+  if (NULL == pFilePath || NULL == ppImage || NULL == pImageSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  PathSize = StrLen(pFilePath) + 1;
+  pAsciiPath = AllocateZeroPool(PathSize);
+  if (NULL == pAsciiPath) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    goto Finish;
+  }
+  UnicodeStrToAsciiStrS(pFilePath, pAsciiPath, PathSize);
+
+  //frees any existing session buffers and the image they were loaded from
+  ReturnCode = PbrFreeSession();
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_DBG("Failed to free session!");
+    goto Finish;
+  }
+
+  *ppImage = PbrMapSessionImage(pAsciiPath, pImageSize);
+  if (NULL == *ppImage) {
+    NVDIMM_DBG("Failed to map session file %a\n", pAsciiPath);
+    ReturnCode = EFI_UNSUPPORTED;
+    goto Finish;
+  }
+
+  ReturnCode = PbrLoadSession(pContext, *ppImage, *pImageSize);
+  if (EFI_ERROR(ReturnCode)) {
+    PbrFreeSession();
+    *ppImage = NULL;
+  }
+
+Finish:
+  FREE_POOL_SAFE(pAsciiPath);
+  return ReturnCode;
+}
+#endif
+
+/**
+  Helper that sets up the context for a new session, or for the session in pBufferAddress,
+  and saves it. Session buffers must be freed by the caller.
+**/
+STATIC
+EFI_STATUS
+PbrLoadSession(
+  IN     PbrContext *pContext,
+  IN     VOID *pBufferAddress,
+  IN     UINT32 BufferSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
 
   //caller wants to create a new session
   if (NULL == pBufferAddress) {
@@ -477,6 +659,62 @@ Finish:
   return ReturnCode;
 }
 
+/**
+  Add a further segment of a record log to the session PbrSetSession loaded from
+  its first segment. Segments are added in order, one at a time, so a log of any
+  size is loaded without holding all of it in memory.
+
+  @param[in] pSegment: contents of the segment file
+  @param[in] SegmentSize: size in bytes of pSegment
+  @param[in] LastSegment: no segment follows, save the loaded session
+
+  @retval EFI_SUCCESS the frames of the segment are in the session
+  @retval EFI_NOT_READY if the pbr context is not available
+  @retval EFI_INVALID_PARAMETER pSegment is not a record log segment
+**/
+EFI_STATUS
+EFIAPI
+PbrAppendSessionLog(
+  IN     VOID *pSegment,
+  IN     UINT32 SegmentSize,
+  IN     BOOLEAN LastSegment
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrContext *pContext = PBR_CTX();
+
+  if (NULL == pContext) {
+    NVDIMM_DBG("No PBR context\n");
+    return EFI_NOT_READY;
+  }
+  if (NULL == pSegment || SegmentSize < sizeof(PbrLogSegmentHeader) ||
+    PBR_LOG_SEGMENT_SIG != ((PbrLogSegmentHeader *)pSegment)->Signature) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ReturnCode = PbrApplyLogFrames(pContext, pSegment, SegmentSize);
+  if (EFI_ERROR(ReturnCode)) {
+    goto Finish;
+  }
+  if (!LastSegment) {
+    goto Finish;
+  }
+
+  ReturnCode = PbrCheckBufferIntegrity(pContext);
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_DBG("Invalid PBR Buffer!");
+    goto Finish;
+  }
+  ReturnCode = PbrSerializeCtx(pContext, TRUE);
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_DBG("Failed to set PBR Context variable\n");
+    goto Finish;
+  }
+
+Finish:
+  return ReturnCode;
+}
+
 /**
   Get the PBR Buffer that is current being used
 
@@ -538,12 +776,20 @@ PbrFreeSession(
 
   for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
     if (PBR_INVALID_SIG != pContext->PartitionContexts[CtxIndex].PartitionSig) {
-      if (pContext->PartitionContexts[CtxIndex].PartitionData) {
-        FreePool(pContext->PartitionContexts[CtxIndex].PartitionData);
-      }
+      PbrReleasePartitionData(pContext, CtxIndex);
       pContext->PartitionContexts[CtxIndex].PartitionSig = PBR_INVALID_SIG;
     }
+    PbrReleaseIndexOffsets(&gPbrPartitionIndexes[CtxIndex]);
+    gPbrPartitionIndexes[CtxIndex].PartitionData = NULL;
+    FREE_POOL_SAFE(gPbrStreamContext.Partitions[CtxIndex].pLocations);
   }
+  PbrResetPartitionLookup();
+  PbrFreePassThruIndex();
+#ifdef OS_BUILD
+  PbrLogClose();
+  PbrUnmapSessionImage();
+#endif
+  ZeroMem(&gPbrStreamContext, sizeof(gPbrStreamContext));
 
   FREE_POOL_SAFE(pContext->PbrMainHeader);
   return EFI_SUCCESS;
@@ -607,6 +853,8 @@ PbrResetSession(
       }
     }
   }
+  //keyed passthrough playback restarts at the tag as well
+  PbrResetPassThruIndex();
 Finish:
   FREE_POOL_SAFE(pTag);
   return ReturnCode;
@@ -693,7 +941,9 @@ PbrSetTag(
   for (Index = 0; Index < MAX_PARTITIONS; ++Index) {
     if (PBR_INVALID_SIG != pContext->PartitionContexts[Index].PartitionSig) {
       pTagPartitionInfo->PartitionSignature = pContext->PartitionContexts[Index].PartitionSig;
-      pTagPartitionInfo->PartitionCurrentOffset = pContext->PartitionContexts[Index].PartitionCurrentOffset;
+      //offsets count the items a streamed recording released, so they match the composed partition
+      pTagPartitionInfo->PartitionCurrentOffset = gPbrStreamContext.Partitions[Index].ReleasedSize +
+        pContext->PartitionContexts[Index].PartitionCurrentOffset;
       ++pTagPartitionInfo;
     }
   }
@@ -706,6 +956,7 @@ PbrSetTag(
   if (NULL != pId) {
     *pId = LogicalIndex;
   }
+  PbrFlushSession();
 
 Finish:
   return ReturnCode;
@@ -831,6 +1082,39 @@ Finish:
   return ReturnCode;
 }
 
+/**
+  Append the items recorded since the last call to the record log, if recordings are
+  streamed. Items reserved with a NULL pData are appended once they are filled in, so
+  recorders call this after filling in the item. No-op outside of record mode.
+
+  @retval EFI_SUCCESS if the items are in the log or streaming is disabled
+  @retval EFI_DEVICE_ERROR if the log could not be written, the items stay in memory
+**/
+EFI_STATUS
+PbrFlushSession(
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+#ifdef OS_BUILD
+  PbrContext *pContext = PBR_CTX();
+  UINT32 CtxIndex = 0;
+
+  if (NULL == pContext || PBR_RECORD_MODE != pContext->PbrMode || !PbrLogEnabled()) {
+    return ReturnCode;
+  }
+
+  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
+    if (PBR_INVALID_SIG != pContext->PartitionContexts[CtxIndex].PartitionSig) {
+      ReturnCode = PbrStreamPartition(pContext, CtxIndex);
+      if (EFI_ERROR(ReturnCode)) {
+        NVDIMM_ERR("Failed to stream partition 0x%x to the record log\n", pContext->PartitionContexts[CtxIndex].PartitionSig);
+        break;
+      }
+    }
+  }
+#endif
+  return ReturnCode;
+}
 
 /**
   Initialize data structures associated with PBR
@@ -849,6 +1133,9 @@ PbrInit(
     return EFI_OUT_OF_RESOURCES;
   }
 
+  //a new context gets loaded, cached partition slots are no longer valid
+  PbrResetPartitionLookup();
+
   //initialize the context's mode property
   ReturnCode = PbrDeserializeCtx(pContext);
   if (EFI_ERROR(ReturnCode)) {
@@ -875,6 +1162,7 @@ PbrUninit(
   EFI_STATUS ReturnCode = EFI_SUCCESS;
   PbrContext *pContext = PBR_CTX();
 
+  PbrFlushSession();
   ReturnCode = PbrSerializeCtx(pContext, FALSE);
   //todo for OS free buffers in context
 #ifdef OS_BUILD
@@ -954,6 +1242,10 @@ Finish:
 #endif
 /**
   Helper that decomposes/unstitches a PBR session
+
+  Version 1 images describe the partitions in the PbrHeader partition table. Version 2
+  images have a PbrImageHeader right after the PbrHeader and a partition directory,
+  which also carries the item offset table of every partition.
 **/
 STATIC
 EFI_STATUS
@@ -966,10 +1258,31 @@ PbrDecomposeSession(
   EFI_STATUS ReturnCode = EFI_SUCCESS;
   PbrPartitionTable *pPartitionTable = NULL;
   PbrHeader *pPbrHeader = NULL;
+  PbrImageHeader *pImageHeader = NULL;
+  PbrImagePartitionEntry *pEntry = NULL;
+  PbrPartitionIndex *pIndex = NULL;
   UINT32 PartitionIndex = 0;
+  BOOLEAN InPlace = FALSE;
 
 
   ZeroMem(pContext->PartitionContexts, sizeof(pContext->PartitionContexts));
+#ifdef OS_BUILD
+  //a mapped session file stays for the whole session, partitions point into it
+  InPlace = PbrInSessionImage(pPbrImg);
+#endif
+
+  //a record log loaded directly, i.e. from a recording that was never dumped
+  if (NULL != pPbrImg && PbrImgSize >= sizeof(PbrLogSegmentHeader) &&
+    PBR_LOG_SEGMENT_SIG == ((PbrLogSegmentHeader *)pPbrImg)->Signature) {
+    ReturnCode = PbrDecomposeLog(pContext, pPbrImg, PbrImgSize);
+    goto Finish;
+  }
+
+  if (NULL == pPbrImg || PbrImgSize < sizeof(PbrHeader)) {
+    ReturnCode = EFI_INVALID_PARAMETER;
+    NVDIMM_DBG("Invalid buffer, too small for a PBR master header!\n");
+    goto Finish;
+  }
 
   //update context's file header
   pContext->PbrMainHeader = (PbrHeader*)AllocateZeroPool(sizeof(PbrHeader));
@@ -987,13 +1300,99 @@ PbrDecomposeSession(
   pPbrHeader = (PbrHeader*)pContext->PbrMainHeader;
   pPartitionTable = (PbrPartitionTable *)&(pPbrHeader->PartitionTable);
 
+  if (PbrImgSize >= sizeof(PbrHeader) + sizeof(PbrImageHeader) &&
+    PBR_IMAGE_SIG == ((PbrImageHeader *)((UINTN)pPbrImg + sizeof(PbrHeader)))->Signature) {
+    pImageHeader = (PbrImageHeader *)((UINTN)pPbrImg + sizeof(PbrHeader));
+    if (PBR_IMAGE_VERSION != pImageHeader->Version ||
+      pImageHeader->HeaderSize < sizeof(PbrImageHeader) ||
+      pImageHeader->ImageSize > PbrImgSize ||
+      pImageHeader->PartitionCnt > MAX_PARTITIONS ||
+      (UINT64)pImageHeader->DirectoryOffset + (UINT64)pImageHeader->PartitionCnt * sizeof(PbrImagePartitionEntry) > pImageHeader->ImageSize) {
+      ReturnCode = EFI_INVALID_PARAMETER;
+      NVDIMM_DBG("Invalid PBR image header!\n");
+      goto Finish;
+    }
+
+    pEntry = (PbrImagePartitionEntry *)((UINTN)pPbrImg + pImageHeader->DirectoryOffset);
+    for (PartitionIndex = 0; PartitionIndex < pImageHeader->PartitionCnt; ++PartitionIndex, ++pEntry) {
+      if (PBR_INVALID_SIG == pEntry->Signature ||
+        (UINT64)pEntry->DataOffset + pEntry->DataSize > pImageHeader->ImageSize ||
+        (0 != pEntry->IndexOffset &&
+          (UINT64)pEntry->IndexOffset + (UINT64)pEntry->LogicalDataCnt * sizeof(UINT32) > pImageHeader->ImageSize)) {
+        ReturnCode = EFI_INVALID_PARAMETER;
+        NVDIMM_DBG("Invalid PBR partition directory entry %d!\n", PartitionIndex);
+        goto Finish;
+      }
+      pContext->PartitionContexts[PartitionIndex].PartitionSig = pEntry->Signature;
+      pContext->PartitionContexts[PartitionIndex].PartitionLogicalDataCnt = pEntry->LogicalDataCnt;
+      pContext->PartitionContexts[PartitionIndex].PartitionCurrentOffset = 0;
+      pContext->PartitionContexts[PartitionIndex].PartitionEndOffset = 0;
+      pIndex = &gPbrPartitionIndexes[PartitionIndex];
+
+      //playback is bounded by the partition size, the mapped data needs no trailing item header
+      if (InPlace && 0 != pEntry->DataSize) {
+        pContext->PartitionContexts[PartitionIndex].PartitionSize = pEntry->DataSize;
+        pContext->PartitionContexts[PartitionIndex].PartitionData = (VOID*)((UINTN)pPbrImg + pEntry->DataOffset);
+        pIndex->PartitionData = pContext->PartitionContexts[PartitionIndex].PartitionData;
+        pIndex->DataMapSize = pEntry->DataSize;
+        if (0 != pEntry->IndexOffset && 0 != pEntry->LogicalDataCnt && 0 == pEntry->IndexOffset % sizeof(UINT32)) {
+          pIndex->pItemOffsets = (UINT32 *)((UINTN)pPbrImg + pEntry->IndexOffset);
+          pIndex->ItemCnt = pIndex->ItemCapacity = pEntry->LogicalDataCnt;
+          pIndex->ItemOffsetsMapSize = pEntry->LogicalDataCnt * sizeof(UINT32);
+        }
+        continue;
+      }
+
+      //room for a zeroed item header after the last item, which ends GET_NEXT_DATA_INDEX playback
+      pContext->PartitionContexts[PartitionIndex].PartitionSize = pEntry->DataSize + sizeof(PbrPartitionLogicalDataItem);
+      pContext->PartitionContexts[PartitionIndex].PartitionData = AllocateZeroPool(pContext->PartitionContexts[PartitionIndex].PartitionSize);
+      if (NULL == pContext->PartitionContexts[PartitionIndex].PartitionData) {
+        ReturnCode = EFI_OUT_OF_RESOURCES;
+        NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
+        goto Finish;
+      }
+      PbrCopyChunks(pContext->PartitionContexts[PartitionIndex].PartitionData,
+        pEntry->DataSize,
+        (VOID*)((UINTN)pPbrImg + pEntry->DataOffset),
+        pEntry->DataSize);
+
+      //offsets are only checked when an item is looked up, a bad table gets rebuilt then
+      pIndex->PartitionData = pContext->PartitionContexts[PartitionIndex].PartitionData;
+      pIndex->DataMapSize = 0;
+      if (0 != pEntry->IndexOffset && 0 != pEntry->LogicalDataCnt) {
+        pIndex->pItemOffsets = AllocateZeroPool(pEntry->LogicalDataCnt * sizeof(UINT32));
+        if (NULL == pIndex->pItemOffsets) {
+          ReturnCode = EFI_OUT_OF_RESOURCES;
+          goto Finish;
+        }
+        PbrCopyChunks(pIndex->pItemOffsets,
+          pEntry->LogicalDataCnt * sizeof(UINT32),
+          (VOID*)((UINTN)pPbrImg + pEntry->IndexOffset),
+          pEntry->LogicalDataCnt * sizeof(UINT32));
+        pIndex->ItemCnt = pIndex->ItemCapacity = pEntry->LogicalDataCnt;
+      }
+    }
+    goto Finish;
+  }
+
   for (PartitionIndex = 0; PartitionIndex < MAX_PARTITIONS; ++PartitionIndex) {
     if (PBR_INVALID_SIG != pPartitionTable->Partitions[PartitionIndex].Signature) {
+      if ((UINT64)pPartitionTable->Partitions[PartitionIndex].Offset + pPartitionTable->Partitions[PartitionIndex].Size > PbrImgSize) {
+        ReturnCode = EFI_INVALID_PARAMETER;
+        NVDIMM_DBG("Invalid PBR partition table entry %d!\n", PartitionIndex);
+        goto Finish;
+      }
       pContext->PartitionContexts[PartitionIndex].PartitionSig = pPartitionTable->Partitions[PartitionIndex].Signature;
       pContext->PartitionContexts[PartitionIndex].PartitionSize = pPartitionTable->Partitions[PartitionIndex].Size;
       pContext->PartitionContexts[PartitionIndex].PartitionLogicalDataCnt = pPartitionTable->Partitions[PartitionIndex].LogicalDataCnt;
       pContext->PartitionContexts[PartitionIndex].PartitionCurrentOffset = 0;
       pContext->PartitionContexts[PartitionIndex].PartitionEndOffset = 0;
+      if (InPlace && 0 != pPartitionTable->Partitions[PartitionIndex].Size) {
+        pContext->PartitionContexts[PartitionIndex].PartitionData = (VOID*)((UINTN)pPbrImg + pPartitionTable->Partitions[PartitionIndex].Offset);
+        gPbrPartitionIndexes[PartitionIndex].PartitionData = pContext->PartitionContexts[PartitionIndex].PartitionData;
+        gPbrPartitionIndexes[PartitionIndex].DataMapSize = pPartitionTable->Partitions[PartitionIndex].Size;
+        continue;
+      }
       pContext->PartitionContexts[PartitionIndex].PartitionData = AllocateZeroPool(pPartitionTable->Partitions[PartitionIndex].Size);
       if (NULL == pContext->PartitionContexts[PartitionIndex].PartitionData) {
         ReturnCode = EFI_OUT_OF_RESOURCES;
@@ -1012,20 +1411,149 @@ Finish:
 }
 
 /**
-  Helper that stitches together all buffers to make a full PBR image
+  Helper that rebuilds a session from the first segments of a record log, the rest
+  are added with PbrAppendSessionLog
 **/
 STATIC
 EFI_STATUS
-PbrComposeSession(
+PbrDecomposeLog(
   IN     PbrContext *pContext,
-  OUT    VOID **ppBufferAddress,
-  OUT    UINT32 *pBufferSize
+  IN     VOID *pLog,
+  IN     UINT32 LogSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+
+  ReturnCode = PbrCreateSessionContext(pContext);
+  if (EFI_ERROR(ReturnCode)) {
+    return ReturnCode;
+  }
+  return PbrApplyLogFrames(pContext, pLog, LogSize);
+}
+
+/**
+  Helper that applies the frames of record log segments to the session
+
+  The log is the concatenation of its segment files, each padded to PBR_LOG_ALIGNMENT.
+  Frames are applied in order. A frame for an item index that already exists comes from
+  a recording resumed after its process died, it replaces the items from that index on.
+  A torn or corrupted frame skips the rest of its segment.
+**/
+STATIC
+EFI_STATUS
+PbrApplyLogFrames(
+  IN     PbrContext *pContext,
+  IN     VOID *pLog,
+  IN     UINT32 LogSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrLogSegmentHeader *pSegment = NULL;
+  PbrLogFrame *pFrame = NULL;
+  UINT64 FrameSize = 0;
+  UINT32 Offset = 0;
+  UINT32 ItemCnt = 0;
+  UINT32 FrameCnt = 0;
+  UINT32 SkippedCnt = 0;
+  UINT32 CtxIndex = 0;
+  INT32 PartitionSlot = 0;
+  UINT32 PbrMode = pContext->PbrMode;
+  BOOLEAN InSegment = FALSE;
+
+  //the partitions are rebuilt with PbrSetData, which must not stream them to the new record log
+  pContext->PbrMode = PBR_NORMAL_MODE;
+
+  while (LogSize - Offset >= sizeof(PbrLogSegmentHeader)) {
+    pSegment = (PbrLogSegmentHeader *)((UINTN)pLog + Offset);
+    if (PBR_LOG_SEGMENT_SIG == pSegment->Signature &&
+      PBR_LOG_VERSION == pSegment->Version &&
+      sizeof(PbrLogSegmentHeader) == pSegment->HeaderSize &&
+      ChecksumOperations(pSegment, sizeof(PbrLogSegmentHeader), &pSegment->Checksum, FALSE)) {
+      InSegment = TRUE;
+      Offset += sizeof(PbrLogSegmentHeader);
+      continue;
+    }
+
+    pFrame = (PbrLogFrame *)pSegment;
+    FrameSize = sizeof(PbrLogFrame) + ALIGN_VALUE((UINT64)pFrame->Size, PBR_LOG_ALIGNMENT);
+    if (!InSegment || LogSize - Offset < sizeof(PbrLogFrame) ||
+      PBR_LOG_FRAME_SIG != pFrame->Signature ||
+      PBR_INVALID_SIG == pFrame->PartitionSig ||
+      FrameSize > LogSize - Offset ||
+      !ChecksumOperations(pFrame, FrameSize, &pFrame->Checksum, FALSE)) {
+      //look for the next segment
+      if (InSegment) {
+        NVDIMM_WARN("Record log damaged at offset %d, skipping to the next segment\n", Offset);
+        InSegment = FALSE;
+      }
+      Offset += PBR_LOG_ALIGNMENT;
+      continue;
+    }
+    Offset += (UINT32)FrameSize;
+    ++FrameCnt;
+
+    if (pFrame->Flags & PBR_LOG_FRAME_SINGLETON) {
+      ReturnCode = PbrSetData(pFrame->PartitionSig, (VOID *)(pFrame + 1), pFrame->Size, TRUE, NULL, NULL);
+    }
+    else {
+      PartitionSlot = PbrFindPartition(pContext, pFrame->PartitionSig);
+      ItemCnt = (PartitionSlot >= 0) ? pContext->PartitionContexts[PartitionSlot].PartitionLogicalDataCnt : 0;
+      if (pFrame->LogicalIndex > ItemCnt) {
+        //an earlier item of the partition is missing, later ones would get the wrong index
+        ++SkippedCnt;
+        continue;
+      }
+      if (pFrame->LogicalIndex < ItemCnt) {
+        PbrTruncatePartition(pContext, (UINT32)PartitionSlot, pFrame->LogicalIndex);
+      }
+      ReturnCode = PbrSetData(pFrame->PartitionSig, (VOID *)(pFrame + 1), pFrame->Size, FALSE, NULL, NULL);
+    }
+    if (EFI_ERROR(ReturnCode)) {
+      goto Finish;
+    }
+  }
+
+  //playback starts at the first item of every partition
+  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
+    pContext->PartitionContexts[CtxIndex].PartitionCurrentOffset = 0;
+  }
+  NVDIMM_DBG("Rebuilt session from %d record log frames, %d skipped\n", FrameCnt, SkippedCnt);
+
+Finish:
+  pContext->PbrMode = PbrMode;
+  return ReturnCode;
+}
+
+/**
+  Helper that stitches together all buffers to make a full PBR image
+
+  The image is a PbrHeader with the recording info, a PbrImageHeader, the partition
+  directory and then, PBR_IMAGE_ALIGNMENT aligned, the used data of every partition
+  followed by its item offset table. Items a streamed recording released from memory
+  are read back from the record log, those partitions get no offset table.
+**/
+STATIC
+EFI_STATUS
+PbrComposeSession(
+  IN     PbrContext *pContext,
+  OUT    VOID **ppBufferAddress,
+  OUT    UINT32 *pBufferSize
 )
 {
   PbrHeader *pPbrMainHeader = NULL;
+  PbrImageHeader *pImageHeader = NULL;
+  PbrImagePartitionEntry *pDirectory = NULL;
+  PbrPartitionIndex *pIndex = NULL;
+  PbrPartitionLogicalDataItem *pLastItem = NULL;
+  PbrPartitionStream *pStream = NULL;
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  UINT32 DataSizes[MAX_PARTITIONS];
+  UINT32 ResidentSize = 0;
+  UINT32 PartitionCnt = 0;
   UINT32 BufferSize = 0;
-  UINT8 *pTemp = NULL;
+  UINT32 EntryIndex = 0;
   UINT32 CtxIndex = 0;
+  BOOLEAN Indexed[MAX_PARTITIONS];
 
   if (NULL == pContext) {
     NVDIMM_DBG("No PBR context\n");
@@ -1038,39 +1566,97 @@ PbrComposeSession(
 
   pPbrMainHeader = (PbrHeader *)pContext->PbrMainHeader;
   ZeroMem(&pPbrMainHeader->PartitionTable, sizeof(PbrPartitionTable));
-  BufferSize = sizeof(PbrHeader);
+  ZeroMem(DataSizes, sizeof(DataSizes));
+  ZeroMem(Indexed, sizeof(Indexed));
 
+  //only the recorded bytes of each partition are stored, not the unused grown tail
+  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
+    if (PBR_INVALID_SIG == pContext->PartitionContexts[CtxIndex].PartitionSig) {
+      continue;
+    }
+    ++PartitionCnt;
+    pStream = &gPbrStreamContext.Partitions[CtxIndex];
+    ResidentSize = pContext->PartitionContexts[CtxIndex].PartitionSize;
+    pIndex = PbrGetPartitionIndex(CtxIndex);
+    if (NULL != pIndex && NULL != pContext->PartitionContexts[CtxIndex].PartitionData &&
+      pIndex->ItemCnt == pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt - pStream->ReleasedCnt) {
+      Indexed[CtxIndex] = (0 == pStream->ReleasedCnt);
+      if (pIndex->ItemCnt > 0) {
+        pLastItem = (PbrPartitionLogicalDataItem *)((UINTN)pContext->PartitionContexts[CtxIndex].PartitionData + pIndex->pItemOffsets[pIndex->ItemCnt - 1]);
+        ResidentSize = pIndex->pItemOffsets[pIndex->ItemCnt - 1] + sizeof(PbrPartitionLogicalDataItem) + pLastItem->Size;
+      }
+      else if (pStream->ReleasedCnt > 0) {
+        ResidentSize = 0;
+      }
+    }
+    DataSizes[CtxIndex] = pStream->ReleasedSize + ResidentSize;
+  }
+
+  BufferSize = ALIGN_VALUE(sizeof(PbrHeader) + sizeof(PbrImageHeader), PBR_IMAGE_ALIGNMENT);
+  BufferSize += ALIGN_VALUE(PartitionCnt * sizeof(PbrImagePartitionEntry), PBR_IMAGE_ALIGNMENT);
   for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
     if (PBR_INVALID_SIG != pContext->PartitionContexts[CtxIndex].PartitionSig) {
-      pPbrMainHeader->PartitionTable.Partitions[CtxIndex].Signature = pContext->PartitionContexts[CtxIndex].PartitionSig;
-      pPbrMainHeader->PartitionTable.Partitions[CtxIndex].Size = pContext->PartitionContexts[CtxIndex].PartitionSize;
-      pPbrMainHeader->PartitionTable.Partitions[CtxIndex].LogicalDataCnt = pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt;
-      pPbrMainHeader->PartitionTable.Partitions[CtxIndex].Offset = BufferSize;
-      BufferSize += pContext->PartitionContexts[CtxIndex].PartitionSize;
+      BufferSize += ALIGN_VALUE(DataSizes[CtxIndex], PBR_IMAGE_ALIGNMENT);
+      if (Indexed[CtxIndex]) {
+        BufferSize += ALIGN_VALUE(pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt * sizeof(UINT32), PBR_IMAGE_ALIGNMENT);
+      }
     }
   }
 
   *ppBufferAddress = AllocateZeroPool(BufferSize);
   NVDIMM_DBG("StitchImg: buffersize = %d bytes\n", BufferSize);
-  if (NULL != *ppBufferAddress) {
-    pPbrMainHeader = (PbrHeader*)*ppBufferAddress;
-    //copy the main pbr header to the buffer
-    PbrCopyChunks(*ppBufferAddress, BufferSize, pContext->PbrMainHeader, sizeof(PbrHeader));
-    //advance past the main header, this will be copied at the end
-    pTemp = (VOID*)((UINTN)(*ppBufferAddress) + (UINTN)sizeof(PbrHeader));
-    NVDIMM_DBG("Copying main header: %d bytes\n", sizeof(PbrHeader));
-
-    for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
-      if (PBR_INVALID_SIG != pContext->PartitionContexts[CtxIndex].PartitionSig) {
-        PbrCopyChunks(pTemp, BufferSize, pContext->PartitionContexts[CtxIndex].PartitionData, pContext->PartitionContexts[CtxIndex].PartitionSize);
-        pTemp += pContext->PartitionContexts[CtxIndex].PartitionSize;
+  if (NULL == *ppBufferAddress) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //copy the main pbr header to the buffer, it keeps the recording info for older tools
+  PbrCopyChunks(*ppBufferAddress, BufferSize, pContext->PbrMainHeader, sizeof(PbrHeader));
+  NVDIMM_DBG("Copying main header: %d bytes\n", sizeof(PbrHeader));
+
+  pImageHeader = (PbrImageHeader *)((UINTN)(*ppBufferAddress) + sizeof(PbrHeader));
+  pImageHeader->Signature = PBR_IMAGE_SIG;
+  pImageHeader->Version = PBR_IMAGE_VERSION;
+  pImageHeader->HeaderSize = sizeof(PbrImageHeader);
+  pImageHeader->PartitionCnt = PartitionCnt;
+  pImageHeader->DirectoryOffset = ALIGN_VALUE(sizeof(PbrHeader) + sizeof(PbrImageHeader), PBR_IMAGE_ALIGNMENT);
+  pImageHeader->ImageSize = BufferSize;
+
+  pDirectory = (PbrImagePartitionEntry *)((UINTN)(*ppBufferAddress) + pImageHeader->DirectoryOffset);
+  BufferSize = pImageHeader->DirectoryOffset + ALIGN_VALUE(PartitionCnt * sizeof(PbrImagePartitionEntry), PBR_IMAGE_ALIGNMENT);
+
+  for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
+    if (PBR_INVALID_SIG == pContext->PartitionContexts[CtxIndex].PartitionSig) {
+      continue;
+    }
+    pDirectory[EntryIndex].Signature = pContext->PartitionContexts[CtxIndex].PartitionSig;
+    pDirectory[EntryIndex].LogicalDataCnt = pContext->PartitionContexts[CtxIndex].PartitionLogicalDataCnt;
+    pDirectory[EntryIndex].DataOffset = BufferSize;
+    pDirectory[EntryIndex].DataSize = DataSizes[CtxIndex];
+    pStream = &gPbrStreamContext.Partitions[CtxIndex];
+    if (pStream->ReleasedCnt > 0) {
+      ReturnCode = PbrCopyReleasedItems(CtxIndex, (VOID*)((UINTN)(*ppBufferAddress) + BufferSize), pStream->ReleasedSize);
+      if (EFI_ERROR(ReturnCode)) {
+        NVDIMM_ERR("Failed to read partition 0x%x back from the record log\n", pDirectory[EntryIndex].Signature);
+        FREE_POOL_SAFE(*ppBufferAddress);
+        return ReturnCode;
       }
     }
-    *pBufferSize = BufferSize;
-  }
-  else {
-    return EFI_OUT_OF_RESOURCES;
+    if (NULL != pContext->PartitionContexts[CtxIndex].PartitionData) {
+      PbrCopyChunks((VOID*)((UINTN)(*ppBufferAddress) + BufferSize + pStream->ReleasedSize), DataSizes[CtxIndex] - pStream->ReleasedSize,
+        pContext->PartitionContexts[CtxIndex].PartitionData, DataSizes[CtxIndex] - pStream->ReleasedSize);
+    }
+    BufferSize += ALIGN_VALUE(DataSizes[CtxIndex], PBR_IMAGE_ALIGNMENT);
+    if (Indexed[CtxIndex]) {
+      pIndex = &gPbrPartitionIndexes[CtxIndex];
+      pDirectory[EntryIndex].IndexOffset = BufferSize;
+      PbrCopyChunks((VOID*)((UINTN)(*ppBufferAddress) + BufferSize), pIndex->ItemCnt * sizeof(UINT32),
+        pIndex->pItemOffsets, pIndex->ItemCnt * sizeof(UINT32));
+      BufferSize += ALIGN_VALUE(pIndex->ItemCnt * sizeof(UINT32), PBR_IMAGE_ALIGNMENT);
+    }
+    ++EntryIndex;
   }
+
+  *pBufferSize = BufferSize;
   return EFI_SUCCESS;
 }
 
@@ -1160,18 +1746,464 @@ PbrGetPartition(
   OUT PbrPartitionContext **ppPartition
 )
 {
-  UINT32 CtxIndex = 0;
+  INT32 PartitionSlot = 0;
   EFI_STATUS ReturnCode = EFI_NOT_FOUND;
   PbrContext *pContext = PBR_CTX();
 
+  PartitionSlot = PbrFindPartition(pContext, Signature);
+  if (PartitionSlot >= 0) {
+    *ppPartition = &pContext->PartitionContexts[PartitionSlot];
+    ReturnCode = EFI_SUCCESS;
+  }
+  return ReturnCode;
+}
+
+/**
+  Helper that finds the PartitionContexts slot of a partition signature
+
+  Slots are cached in a small open addressing table. A cached slot is only trusted if
+  the context still holds the signature there, otherwise the context is scanned.
+
+  @retval slot index, -1 if there is no partition with Signature
+**/
+STATIC
+INT32
+PbrFindPartition(
+  IN     PbrContext *pContext,
+  IN     UINT32 Signature
+)
+{
+  UINT32 Hash = PBR_PARTITION_LOOKUP_HASH(Signature);
+  UINT32 Probe = 0;
+  UINT32 Slot = 0;
+  UINT32 CtxIndex = 0;
+
+  if (NULL == pContext || PBR_INVALID_SIG == Signature) {
+    return -1;
+  }
+
+  for (Probe = 0; Probe < PBR_PARTITION_LOOKUP_SZ; ++Probe) {
+    Slot = (Hash + Probe) & (PBR_PARTITION_LOOKUP_SZ - 1);
+    if (0 == mPbrPartitionLookup[Slot]) {
+      break;
+    }
+    if (Signature == pContext->PartitionContexts[mPbrPartitionLookup[Slot] - 1].PartitionSig) {
+      return mPbrPartitionLookup[Slot] - 1;
+    }
+  }
+
+  //not cached yet, scan and remember the slot in the free lookup entry found above
   for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
     if (Signature == pContext->PartitionContexts[CtxIndex].PartitionSig) {
-      *ppPartition = &pContext->PartitionContexts[CtxIndex];
-      ReturnCode = EFI_SUCCESS;
+      if (Probe < PBR_PARTITION_LOOKUP_SZ) {
+        mPbrPartitionLookup[Slot] = (UINT8)(CtxIndex + 1);
+      }
+      return (INT32)CtxIndex;
+    }
+  }
+  return -1;
+}
+
+/**
+  Helper that drops all cached partition slots, used when the context is replaced
+**/
+STATIC
+VOID
+PbrResetPartitionLookup(
+)
+{
+  ZeroMem(mPbrPartitionLookup, sizeof(mPbrPartitionLookup));
+}
+
+/**
+  Helper that provides the item index of a partition, building it if it is missing
+  or stale. An index is stale when the partition buffer or item count changed behind it.
+
+  @param[in] CtxIndex: PartitionContexts slot of the partition
+
+  @retval the index, NULL on allocation failure
+**/
+PbrPartitionIndex *
+PbrGetPartitionIndex(
+  IN     UINT32 CtxIndex
+)
+{
+  PbrContext *pContext = PBR_CTX();
+  PbrPartitionContext *pPartition = NULL;
+  PbrPartitionIndex *pIndex = NULL;
+  PbrPartitionLogicalDataItem *pDataItem = NULL;
+  UINT32 Offset = 0;
+  UINT32 ResidentCnt = 0;
+
+  if (CtxIndex >= MAX_PARTITIONS) {
+    return NULL;
+  }
+  pPartition = &pContext->PartitionContexts[CtxIndex];
+  pIndex = &gPbrPartitionIndexes[CtxIndex];
+  //items released by a streamed recording are not in the partition data
+  ResidentCnt = pPartition->PartitionLogicalDataCnt - gPbrStreamContext.Partitions[CtxIndex].ReleasedCnt;
+
+  if (pIndex->PartitionData == pPartition->PartitionData &&
+    pIndex->ItemCnt == ResidentCnt) {
+    return pIndex;
+  }
+
+  //walk the partition once, bounded by its size in case the count and the data disagree
+  PbrReleaseIndexOffsets(pIndex);
+  if (pIndex->PartitionData != pPartition->PartitionData) {
+    pIndex->DataMapSize = 0;
+  }
+  pIndex->PartitionData = pPartition->PartitionData;
+  if (NULL == pPartition->PartitionData) {
+    return pIndex;
+  }
+  while (pIndex->ItemCnt < ResidentCnt &&
+    pPartition->PartitionSize - Offset >= sizeof(PbrPartitionLogicalDataItem)) {
+    pDataItem = (PbrPartitionLogicalDataItem *)((UINTN)pPartition->PartitionData + Offset);
+    if (PBR_LOGICAL_DATA_SIG != pDataItem->Signature ||
+      pDataItem->Size > pPartition->PartitionSize - Offset - sizeof(PbrPartitionLogicalDataItem)) {
+      NVDIMM_DBG("Partition 0x%x has %d of %d items\n", pPartition->PartitionSig, pIndex->ItemCnt, ResidentCnt);
+      break;
+    }
+    if (EFI_ERROR(PbrIndexAppend(pIndex, Offset))) {
+      return NULL;
+    }
+    Offset += sizeof(PbrPartitionLogicalDataItem) + pDataItem->Size;
+  }
+  return pIndex;
+}
+
+/**
+  Helper that returns the logical data item at position Index of a partition
+
+  Offsets coming from a loaded image or index file are checked here, a bad one makes
+  the index get rebuilt from the partition data.
+
+  @retval the item, NULL if it does not exist
+**/
+STATIC
+PbrPartitionLogicalDataItem *
+PbrGetIndexedItem(
+  IN     PbrContext *pContext,
+  IN     UINT32 CtxIndex,
+  IN     UINT32 Index
+)
+{
+  PbrPartitionContext *pPartition = &pContext->PartitionContexts[CtxIndex];
+  PbrPartitionIndex *pIndex = NULL;
+  PbrPartitionLogicalDataItem *pDataItem = NULL;
+  UINT32 Offset = 0;
+  UINT32 Attempt = 0;
+
+  //items released by a streamed recording are only in the record log
+  if (Index < gPbrStreamContext.Partitions[CtxIndex].ReleasedCnt) {
+    return NULL;
+  }
+  Index -= gPbrStreamContext.Partitions[CtxIndex].ReleasedCnt;
+
+  for (Attempt = 0; Attempt < 2; ++Attempt) {
+    pIndex = PbrGetPartitionIndex(CtxIndex);
+    if (NULL == pIndex || Index >= pIndex->ItemCnt) {
+      return NULL;
+    }
+    Offset = pIndex->pItemOffsets[Index];
+    if (Offset <= pPartition->PartitionSize &&
+      pPartition->PartitionSize - Offset >= sizeof(PbrPartitionLogicalDataItem)) {
+      pDataItem = (PbrPartitionLogicalDataItem *)((UINTN)pPartition->PartitionData + Offset);
+      if (PBR_LOGICAL_DATA_SIG == pDataItem->Signature &&
+        pDataItem->Size <= pPartition->PartitionSize - Offset - sizeof(PbrPartitionLogicalDataItem)) {
+        return pDataItem;
+      }
     }
+    NVDIMM_DBG("Bad item offset in partition 0x%x index, rebuilding it\n", pPartition->PartitionSig);
+    PbrReleaseIndexOffsets(pIndex);
+  }
+  return NULL;
+}
+
+/**
+  Helper that appends an item offset to a partition index
+**/
+STATIC
+EFI_STATUS
+PbrIndexAppend(
+  IN     PbrPartitionIndex *pIndex,
+  IN     UINT32 Offset
+)
+{
+  UINT32 *pItemOffsets = NULL;
+  UINT32 NewCapacity = 0;
+  UINT32 ItemCnt = pIndex->ItemCnt;
+
+  //mapped tables are read-only, the first append moves them to the heap
+  if (ItemCnt == pIndex->ItemCapacity || 0 != pIndex->ItemOffsetsMapSize) {
+    NewCapacity = (ItemCnt < PARTITION_GROW_SZ_MULTIPLIER) ? PARTITION_GROW_SZ_MULTIPLIER : ItemCnt * 2;
+    pItemOffsets = AllocateZeroPool(NewCapacity * sizeof(UINT32));
+    if (NULL == pItemOffsets) {
+      NVDIMM_DBG("Failed to allocate memory for partition index\n");
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (ItemCnt > 0) {
+      PbrCopyChunks(pItemOffsets, NewCapacity * sizeof(UINT32), pIndex->pItemOffsets, ItemCnt * sizeof(UINT32));
+    }
+    PbrReleaseIndexOffsets(pIndex);
+    pIndex->pItemOffsets = pItemOffsets;
+    pIndex->ItemCnt = ItemCnt;
+    pIndex->ItemCapacity = NewCapacity;
+  }
+  pIndex->pItemOffsets[pIndex->ItemCnt++] = Offset;
+  return EFI_SUCCESS;
+}
+
+/**
+  Helper that frees or unmaps the item offset table of a partition index
+**/
+STATIC
+VOID
+PbrReleaseIndexOffsets(
+  IN     PbrPartitionIndex *pIndex
+)
+{
+  if (NULL != pIndex->pItemOffsets) {
+#ifdef OS_BUILD
+    if (0 != pIndex->ItemOffsetsMapSize) {
+      PbrUnmapFile(pIndex->pItemOffsets, pIndex->ItemOffsetsMapSize);
+    }
+    else
+#endif
+    {
+      FreePool(pIndex->pItemOffsets);
+    }
+  }
+  pIndex->pItemOffsets = NULL;
+  pIndex->ItemCnt = 0;
+  pIndex->ItemCapacity = 0;
+  pIndex->ItemOffsetsMapSize = 0;
+}
+
+/**
+  Helper that frees or unmaps the data of a partition along with its index
+**/
+STATIC
+VOID
+PbrReleasePartitionData(
+  IN     PbrContext *pContext,
+  IN     UINT32 CtxIndex
+)
+{
+  PbrPartitionIndex *pIndex = &gPbrPartitionIndexes[CtxIndex];
+  VOID *pData = pContext->PartitionContexts[CtxIndex].PartitionData;
+
+  if (NULL != pData) {
+#ifdef OS_BUILD
+    if (0 != pIndex->DataMapSize && pIndex->PartitionData == pData) {
+      PbrUnmapFile(pData, pIndex->DataMapSize);
+    }
+    else
+#endif
+    {
+      FreePool(pData);
+    }
+  }
+  PbrReleaseIndexOffsets(pIndex);
+  pIndex->PartitionData = NULL;
+  pIndex->DataMapSize = 0;
+  pContext->PartitionContexts[CtxIndex].PartitionData = NULL;
+}
+
+/**
+  Helper that moves a partition mapped from a playback file to the heap, so it can
+  be modified or grown. No-op for partitions that are not mapped.
+**/
+STATIC
+EFI_STATUS
+PbrMakePartitionWritable(
+  IN     PbrContext *pContext,
+  IN     UINT32 CtxIndex
+)
+{
+  PbrPartitionIndex *pIndex = &gPbrPartitionIndexes[CtxIndex];
+  PbrPartitionContext *pPartition = &pContext->PartitionContexts[CtxIndex];
+  VOID *pData = NULL;
+
+  if (0 == pIndex->DataMapSize || pIndex->PartitionData != pPartition->PartitionData) {
+    return EFI_SUCCESS;
+  }
+
+  pData = AllocateZeroPool(pPartition->PartitionSize);
+  if (NULL == pData) {
+    NVDIMM_DBG("Failed to allocate memory for partition buffer\n");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  PbrCopyChunks(pData, pPartition->PartitionSize, pPartition->PartitionData, pPartition->PartitionSize);
+#ifdef OS_BUILD
+  PbrUnmapFile(pPartition->PartitionData, pIndex->DataMapSize);
+#endif
+  //item offsets do not change, the index follows the data
+  pPartition->PartitionData = pData;
+  pIndex->PartitionData = pData;
+  pIndex->DataMapSize = 0;
+  return EFI_SUCCESS;
+}
+
+/**
+  Helper that drops the items of a partition from position ItemCnt on
+**/
+STATIC
+VOID
+PbrTruncatePartition(
+  IN     PbrContext *pContext,
+  IN     UINT32 CtxIndex,
+  IN     UINT32 ItemCnt
+)
+{
+  PbrPartitionContext *pPartition = &pContext->PartitionContexts[CtxIndex];
+  PbrPartitionIndex *pIndex = PbrGetPartitionIndex(CtxIndex);
+  UINT32 Offset = 0;
+
+  if (NULL == pIndex || ItemCnt >= pIndex->ItemCnt || pIndex->ItemCnt != pPartition->PartitionLogicalDataCnt) {
+    return;
+  }
+  Offset = pIndex->pItemOffsets[ItemCnt];
+  //partitions mapped from a session file are read-only
+  if (EFI_ERROR(PbrMakePartitionWritable(pContext, CtxIndex))) {
+    return;
+  }
+  //the dropped items must not look like logical data items to GET_NEXT_DATA_INDEX playback
+  ZeroMem((VOID*)((UINTN)pPartition->PartitionData + Offset), pPartition->PartitionCurrentOffset - Offset);
+  pPartition->PartitionCurrentOffset = Offset;
+  pPartition->PartitionLogicalDataCnt = ItemCnt;
+  pIndex->ItemCnt = ItemCnt;
+}
+
+/**
+  Helper that reads the items a streamed recording released from memory back from the
+  record log, laid out as in the partition data
+
+  @param[in] CtxIndex: PartitionContexts slot of the partition
+  @param[out] pDest: buffer for the items
+  @param[in] DestSize: size of pDest, the released size of the partition
+**/
+STATIC
+EFI_STATUS
+PbrCopyReleasedItems(
+  IN     UINT32 CtxIndex,
+     OUT VOID *pDest,
+  IN     UINT32 DestSize
+)
+{
+#ifdef OS_BUILD
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPartitionStream *pStream = &gPbrStreamContext.Partitions[CtxIndex];
+  PbrPartitionLogicalDataItem *pDataItem = NULL;
+  VOID *pData = NULL;
+  UINT32 Size = 0;
+  UINT32 Offset = 0;
+  UINT32 Index = 0;
+
+  if (NULL == pStream->pLocations) {
+    return EFI_NOT_FOUND;
+  }
+
+  for (Index = 0; Index < pStream->ReleasedCnt; ++Index) {
+    ReturnCode = PbrLogRead(pStream->pLocations[Index], gPbrContext.PartitionContexts[CtxIndex].PartitionSig, Index, &pData, &Size);
+    if (EFI_ERROR(ReturnCode)) {
+      goto Finish;
+    }
+    if (DestSize - Offset < sizeof(PbrPartitionLogicalDataItem) ||
+      Size > DestSize - Offset - sizeof(PbrPartitionLogicalDataItem)) {
+      ReturnCode = EFI_COMPROMISED_DATA;
+      goto Finish;
+    }
+    pDataItem = (PbrPartitionLogicalDataItem *)((UINTN)pDest + Offset);
+    pDataItem->Signature = PBR_LOGICAL_DATA_SIG;
+    pDataItem->Size = Size;
+    pDataItem->LogicalIndex = Index;
+    PbrCopyChunks(pDataItem->Data, Size, pData, Size);
+    Offset += sizeof(PbrPartitionLogicalDataItem) + Size;
+    FREE_POOL_SAFE(pData);
+  }
+
+Finish:
+  FREE_POOL_SAFE(pData);
+  return ReturnCode;
+#else
+  return EFI_UNSUPPORTED;
+#endif
+}
+
+#ifdef OS_BUILD
+/**
+  Helper that appends the items of a partition that are not in the record log yet, then
+  releases the recorded items from memory once they take more than PBR_STREAM_RESIDENT_SIZE.
+  Released items keep their logical index, the partition data starts with the first
+  item that was not released.
+**/
+STATIC
+EFI_STATUS
+PbrStreamPartition(
+  IN     PbrContext *pContext,
+  IN     UINT32 CtxIndex
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPartitionContext *pPartition = &pContext->PartitionContexts[CtxIndex];
+  PbrPartitionStream *pStream = &gPbrStreamContext.Partitions[CtxIndex];
+  PbrPartitionLogicalDataItem *pDataItem = NULL;
+  UINT32 NewCapacity = 0;
+
+  if (NULL == pPartition->PartitionData) {
+    return ReturnCode;
+  }
+
+  if (pStream->Singleton) {
+    if (pStream->Dirty) {
+      pDataItem = (PbrPartitionLogicalDataItem *)pPartition->PartitionData;
+      ReturnCode = PbrLogAppend(pPartition->PartitionSig, 0, PBR_LOG_FRAME_SINGLETON, pDataItem->Data, pDataItem->Size, NULL);
+      if (!EFI_ERROR(ReturnCode)) {
+        pStream->Dirty = FALSE;
+      }
+    }
+    return ReturnCode;
+  }
+
+  while (pStream->StreamedCnt < pPartition->PartitionLogicalDataCnt) {
+    pDataItem = PbrGetIndexedItem(pContext, CtxIndex, pStream->StreamedCnt);
+    if (NULL == pDataItem) {
+      return EFI_NOT_FOUND;
+    }
+    if (pStream->StreamedCnt >= pStream->LocationCapacity) {
+      NewCapacity = (pStream->StreamedCnt < PARTITION_GROW_SZ_MULTIPLIER) ? PARTITION_GROW_SZ_MULTIPLIER : pStream->StreamedCnt * 2;
+      pStream->pLocations = ReallocatePool(pStream->LocationCapacity * sizeof(UINT64), NewCapacity * sizeof(UINT64), pStream->pLocations);
+      if (NULL == pStream->pLocations) {
+        pStream->LocationCapacity = 0;
+        return EFI_OUT_OF_RESOURCES;
+      }
+      pStream->LocationCapacity = NewCapacity;
+    }
+    ReturnCode = PbrLogAppend(pPartition->PartitionSig, pStream->StreamedCnt, 0,
+      pDataItem->Data, pDataItem->Size, &pStream->pLocations[pStream->StreamedCnt]);
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+    ++pStream->StreamedCnt;
+  }
+
+  if (pPartition->PartitionCurrentOffset > PBR_STREAM_RESIDENT_SIZE) {
+    //tag offsets and composed images address the released items by their partition offset
+    if (pStream->ReleasedSize > MAX_UINT32 - pPartition->PartitionCurrentOffset) {
+      NVDIMM_ERR("Partition 0x%x is too large for a PBR image\n", pPartition->PartitionSig);
+      return EFI_BUFFER_TOO_SMALL;
+    }
+    pStream->ReleasedSize += pPartition->PartitionCurrentOffset;
+    pStream->ReleasedCnt = pPartition->PartitionLogicalDataCnt;
+    ZeroMem(pPartition->PartitionData, pPartition->PartitionCurrentOffset);
+    pPartition->PartitionCurrentOffset = 0;
+    PbrReleaseIndexOffsets(&gPbrPartitionIndexes[CtxIndex]);
   }
   return ReturnCode;
 }
+#endif
 
 #define COPY_CHUNK_SZ_BYTES   1024
 
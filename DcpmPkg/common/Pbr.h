@@ -125,6 +125,47 @@ PbrSetSession(
   IN     UINT32 BufferSize
 );
 
+#ifdef OS_BUILD
+/**
+  Set the PBR session to a session file, which is mapped read-only and played back
+  in place. The mapping is released when the session is freed.
+
+  @param[in] pFilePath: path of the session file
+  @param[out] ppImage: start of the mapped file, valid until the session is freed
+  @param[out] pImageSize: size in bytes of the file
+
+  @retval EFI_SUCCESS if the session is loaded
+  @retval EFI_INVALID_PARAMETER if one or more parameters equal NULL
+  @retval EFI_UNSUPPORTED if the file cannot be mapped, read it and use PbrSetSession
+**/
+EFI_STATUS
+EFIAPI
+PbrSetSessionFile(
+  IN     CHAR16 *pFilePath,
+     OUT VOID **ppImage,
+     OUT UINT32 *pImageSize
+);
+#endif
+
+/**
+  Add a further segment of a record log to the session PbrSetSession loaded from
+  its first segment
+
+  @param[in] pSegment: contents of the segment file
+  @param[in] SegmentSize: size in bytes of pSegment
+  @param[in] LastSegment: no segment follows, save the loaded session
+
+  @retval EFI_SUCCESS the frames of the segment are in the session
+  @retval EFI_INVALID_PARAMETER pSegment is not a record log segment
+**/
+EFI_STATUS
+EFIAPI
+PbrAppendSessionLog(
+  IN     VOID *pSegment,
+  IN     UINT32 SegmentSize,
+  IN     BOOLEAN LastSegment
+);
+
 /**
   Get the PBR Buffer that is current being used
 
@@ -223,6 +264,18 @@ PbrGetTag(
 );
 
 
+/**
+  Append the items recorded since the last call to the record log, if recordings are
+  streamed. Items reserved with a NULL pData are appended once they are filled in, so
+  recorders call this after filling in the item. No-op outside of record mode.
+
+  @retval EFI_SUCCESS if the items are in the log or streaming is disabled
+  @retval EFI_DEVICE_ERROR if the log could not be written, the items stay in memory
+**/
+EFI_STATUS
+PbrFlushSession(
+);
+
 /**
   Initialize data structures associated with PBR
 
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  Block compression of PBR payloads.
+
+  Uses the LZMA SDK bundled in BaseTools/Source/C/LzmaCompress/Sdk, built
+  single threaded (_7ZIP_ST). Every payload is compressed on its own, so a
+  payload is decompressed without touching any other.
+**/
+
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Debug.h>
+#include "PbrCompress.h"
+#include "LzmaEnc.h"
+#include "LzmaDec.h"
+
+#define PBR_LZMA_LEVEL                    1
+#define PBR_LZMA_MIN_DICT_SIZE            (1 << 12)
+
+STATIC VOID *PbrLzmaAlloc(VOID *p, size_t Size);
+STATIC VOID PbrLzmaFree(VOID *p, VOID *pAddress);
+
+STATIC ISzAlloc mPbrLzmaAlloc = { PbrLzmaAlloc, PbrLzmaFree };
+
+/**
+  Compress a payload with the LZMA codec of the bundled LZMA SDK.
+
+  @param[in] pSource Payload to compress
+  @param[in] SourceSize Size of pSource
+  @param[out] pDest Buffer for the compressed payload
+  @param[in,out] pDestSize In: size of pDest. Out: size of the compressed payload
+
+  @retval EFI_SUCCESS Payload compressed
+  @retval EFI_BUFFER_TOO_SMALL The payload does not compress to less than *pDestSize
+  @retval EFI_INVALID_PARAMETER NULL parameter
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+PbrCompressPayload(
+  IN     UINT8 *pSource,
+  IN     UINT32 SourceSize,
+     OUT UINT8 *pDest,
+  IN OUT UINT32 *pDestSize
+  )
+{
+  CLzmaEncProps Props;
+  SizeT PropsSize = LZMA_PROPS_SIZE;
+  SizeT StreamSize = 0;
+  SRes Result = SZ_OK;
+
+  if (NULL == pSource || NULL == pDest || NULL == pDestSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (*pDestSize <= LZMA_PROPS_SIZE) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  LzmaEncProps_Init(&Props);
+  Props.level = PBR_LZMA_LEVEL;
+  Props.numThreads = 1;
+  //a payload never refers back further than its own start
+  Props.dictSize = PBR_LZMA_MIN_DICT_SIZE;
+  while (Props.dictSize < SourceSize && Props.dictSize < (1 << 24)) {
+    Props.dictSize <<= 1;
+  }
+
+  StreamSize = *pDestSize - LZMA_PROPS_SIZE;
+  Result = LzmaEncode(pDest + LZMA_PROPS_SIZE, &StreamSize, pSource, SourceSize,
+    &Props, pDest, &PropsSize, 0, NULL, &mPbrLzmaAlloc, &mPbrLzmaAlloc);
+  if (SZ_ERROR_OUTPUT_EOF == Result) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  if (SZ_OK != Result || LZMA_PROPS_SIZE != PropsSize) {
+    NVDIMM_DBG("LZMA compression failed, error %d\n", Result);
+    return (SZ_ERROR_MEM == Result) ? EFI_OUT_OF_RESOURCES : EFI_ABORTED;
+  }
+
+  *pDestSize = (UINT32)(LZMA_PROPS_SIZE + StreamSize);
+  return EFI_SUCCESS;
+}
+
+/**
+  Decompress a payload compressed by PbrCompressPayload.
+
+  @param[in] pSource Compressed payload
+  @param[in] SourceSize Size of pSource
+  @param[out] pDest Buffer for the payload
+  @param[in] DestSize Size of the payload, pDest must hold exactly that many bytes
+
+  @retval EFI_SUCCESS Payload decompressed
+  @retval EFI_INVALID_PARAMETER NULL parameter
+  @retval EFI_VOLUME_CORRUPTED The compressed payload is damaged or of a different size
+**/
+EFI_STATUS
+PbrDecompressPayload(
+  IN     UINT8 *pSource,
+  IN     UINT32 SourceSize,
+     OUT UINT8 *pDest,
+  IN     UINT32 DestSize
+  )
+{
+  SizeT StreamSize = 0;
+  SizeT OutputSize = DestSize;
+  ELzmaStatus Status = LZMA_STATUS_NOT_SPECIFIED;
+  SRes Result = SZ_OK;
+
+  if (NULL == pSource || NULL == pDest) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (SourceSize < LZMA_PROPS_SIZE) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  StreamSize = SourceSize - LZMA_PROPS_SIZE;
+  Result = LzmaDecode(pDest, &OutputSize, pSource + LZMA_PROPS_SIZE, &StreamSize,
+    pSource, LZMA_PROPS_SIZE, LZMA_FINISH_END, &Status, &mPbrLzmaAlloc);
+  if (SZ_OK != Result || OutputSize != DestSize ||
+    (LZMA_STATUS_FINISHED_WITH_MARK != Status && LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK != Status)) {
+    NVDIMM_ERR("Failed to decompress a recorded payload, error %d, status %d\n", Result, Status);
+    return EFI_VOLUME_CORRUPTED;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  LZMA SDK allocator callbacks
+**/
+STATIC
+VOID *
+PbrLzmaAlloc(
+  IN     VOID *p,
+  IN     size_t Size
+  )
+{
+  return AllocatePool(Size);
+}
+
+STATIC
+VOID
+PbrLzmaFree(
+  IN     VOID *p,
+  IN     VOID *pAddress
+  )
+{
+  if (NULL != pAddress) {
+    FreePool(pAddress);
+  }
+}
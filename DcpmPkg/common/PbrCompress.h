@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PBR_COMPRESS_H_
+#define _PBR_COMPRESS_H_
+
+#include <Types.h>
+
+#define PBR_PAYLOAD_ENCODING_RAW          0   //!< Payload stored as is
+#define PBR_PAYLOAD_ENCODING_LZMA         1   //!< Payload stored as LZMA properties followed by the LZMA stream
+
+/**
+  Compress a payload with the LZMA codec of the bundled LZMA SDK.
+
+  @param[in] pSource Payload to compress
+  @param[in] SourceSize Size of pSource
+  @param[out] pDest Buffer for the compressed payload
+  @param[in,out] pDestSize In: size of pDest. Out: size of the compressed payload
+
+  @retval EFI_SUCCESS Payload compressed
+  @retval EFI_BUFFER_TOO_SMALL The payload does not compress to less than *pDestSize
+  @retval EFI_INVALID_PARAMETER NULL parameter
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+PbrCompressPayload(
+  IN     UINT8 *pSource,
+  IN     UINT32 SourceSize,
+     OUT UINT8 *pDest,
+  IN OUT UINT32 *pDestSize
+  );
+
+/**
+  Decompress a payload compressed by PbrCompressPayload.
+
+  @param[in] pSource Compressed payload
+  @param[in] SourceSize Size of pSource
+  @param[out] pDest Buffer for the payload
+  @param[in] DestSize Size of the payload, pDest must hold exactly that many bytes
+
+  @retval EFI_SUCCESS Payload decompressed
+  @retval EFI_INVALID_PARAMETER NULL parameter
+  @retval EFI_VOLUME_CORRUPTED The compressed payload is damaged or of a different size
+**/
+EFI_STATUS
+PbrDecompressPayload(
+  IN     UINT8 *pSource,
+  IN     UINT32 SourceSize,
+     OUT UINT8 *pDest,
+  IN     UINT32 DestSize
+  );
+
+#endif //_PBR_COMPRESS_H_
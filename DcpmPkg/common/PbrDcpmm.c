@@ -5,19 +5,756 @@
 #include <Library/UefiLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
 #include <Debug.h>
 #include <Types.h>
 #include <Convert.h>
+#include <Utility.h>
 #include "Pbr.h"
 #include "PbrDcpmm.h"
+#include "PbrCompress.h"
 
+extern EFI_GUID gIntelDimmPbrVariableGuid;
 
+#define PBR_PASS_THRU_NO_RECORD           0xFFFFFFFF
+#define PBR_PASS_THRU_MIN_SLOTS           16
+#define PBR_FNV64_OFFSET_BASIS            0xCBF29CE484222325ULL
+#define PBR_FNV64_PRIME                   0x100000001B3ULL
+
+/**one recorded passthrough in the keyed playback index**/
+typedef struct _PbrPassThruIndexRecord {
+  UINT32 Offset;                  //!< Offset of the record within the passthrough partition
+  UINT32 NextSameInput;           //!< Next record with the same DIMM, opcode, subopcode and input
+  UINT32 NextAnyInput;            //!< Next record with the same DIMM, opcode and subopcode
+}PbrPassThruIndexRecord;
+
+/**keyed playback hash table slot, one per distinct key**/
+typedef struct _PbrPassThruIndexSlot {
+  UINT64  InputHash;              //!< Hash of the input payloads, 0 for any input slots
+  UINT32  DimmId;                 //!< Target DIMM ID
+  UINT8   Opcode;                 //!< FIS Opcode
+  UINT8   SubOpcode;              //!< FIS SubOpcode
+  BOOLEAN AnyInput;               //!< Slot chains the records of all inputs
+  BOOLEAN Used;                   //!< Slot holds a key
+  UINT32  First;                  //!< First record of the key
+  UINT32  Last;                   //!< Last record of the key
+  UINT32  Start;                  //!< First record at or after the playback offset
+  UINT32  Next;                   //!< Next record to return
+}PbrPassThruIndexSlot;
+
+/**keyed playback index of the passthrough partition, built on first use**/
+typedef struct _PbrPassThruIndex {
+  BOOLEAN Configured;             //!< Playback preferences below were read
+  BOOLEAN Built;                  //!< Records and slots describe the current partition
+  BOOLEAN Rewind;                 //!< Slots must be moved to the current playback offset
+  UINT32  Order;                  //!< PBR_PLAYBACK_ORDER_*
+  UINT32  Repeat;                 //!< PBR_PLAYBACK_REPEAT_*
+  UINT32  Missing;                //!< PBR_PLAYBACK_MISSING_*
+  UINT32  RecordCnt;              //!< Number of records in the partition when built
+  UINT32  PartitionSize;          //!< Size of the partition when built
+  UINT32  SlotCnt;                //!< Number of slots, a power of 2
+  PbrPassThruIndexRecord *pRecords;
+  PbrPassThruIndexSlot *pSlots;
+}PbrPassThruIndex;
+
+STATIC PbrPassThruIndex mPassThruIndex;
+
+/**payload store lookup slot, finds the stored copy of a payload by its hash**/
+typedef struct _PbrPayloadLookupSlot {
+  UINT64  Hash;                   //!< FNV-1a hash of the payload
+  UINT32  Size;                   //!< Size of the payload
+  UINT32  BlobIndex;              //!< Item index in the payload partition, PBR_PASS_THRU_NO_RECORD if free
+}PbrPayloadLookupSlot;
+
+/**payload store lookup of the recording session, built on first use**/
+typedef struct _PbrPayloadLookup {
+  BOOLEAN Configured;             //!< Compression below was read
+  UINT32  Compression;            //!< Non zero to compress stored payloads
+  UINT32  BlobCnt;                //!< Number of payload partition items in the table
+  UINT32  SlotCnt;                //!< Number of slots, a power of 2
+  PbrPayloadLookupSlot *pSlots;
+}PbrPayloadLookup;
+
+STATIC PbrPayloadLookup mPayloadLookup;
+
+/**
+  Helper that reads a PBR playback preference from the ini configuration.
+  All playback preferences default to 0.
+**/
+STATIC
+UINT32
+PbrGetPlaybackPreference(
+  IN    CHAR16 *pName
+)
+{
+  UINT32 Value = 0;
+  UINTN Size = sizeof(Value);
+
+  if (EFI_ERROR(GET_VARIABLE(pName, gIntelDimmPbrVariableGuid, &Size, &Value))) {
+    Value = 0;
+  }
+  return Value;
+}
+
+/**
+  Helper that extends a FNV-1a hash with a buffer, so a payload split over two buffers
+  hashes the same as the recorded, contiguous one
+**/
+STATIC
+UINT64
+PbrHashBytes(
+  IN    UINT64 Hash,
+  IN    UINT8 *pData,
+  IN    UINT32 Size
+)
+{
+  UINT32 Index = 0;
+
+  for (Index = 0; Index < Size; ++Index) {
+    Hash = (Hash ^ pData[Index]) * PBR_FNV64_PRIME;
+  }
+  return Hash;
+}
+
+/**
+  Helper that tells whether the passthrough records of the session reference
+  their large input and output payloads in the payload partition
+**/
+STATIC
+BOOLEAN
+PbrHasPayloadStore(
+)
+{
+  UINT32 BlobCnt = 0;
+  UINT32 PartitionSize = 0;
+  UINT32 PlaybackOffset = 0;
+
+  return !EFI_ERROR(PbrGetDataPlaybackInfo(PBR_PAYLOAD_SIG, &BlobCnt, &PartitionSize, &PlaybackOffset));
+}
+
+/**
+  Helper that hashes the input of a passthrough, the large input payload
+  contributing by its own hash so a stored payload needs no loading
+
+  @param[in] pInput: small input payload
+  @param[in] InputSize: size of pInput
+  @param[in] LargeInputHash: FNV-1a hash of the large input payload
+  @param[in] LargeInputSize: size of the large input payload, 0 for none
+**/
+STATIC
+UINT64
+PbrHashPassThruInput(
+  IN    UINT8 *pInput,
+  IN    UINT32 InputSize,
+  IN    UINT64 LargeInputHash,
+  IN    UINT32 LargeInputSize
+)
+{
+  UINT64 Hash = PbrHashBytes(PBR_FNV64_OFFSET_BASIS, pInput, InputSize);
+
+  if (0 != LargeInputSize) {
+    Hash = PbrHashBytes(Hash, (UINT8 *)&LargeInputHash, sizeof(LargeInputHash));
+  }
+  return Hash;
+}
+
+/**
+  Helper that returns the hash of a payload in the payload partition
+
+  @retval EFI_SUCCESS pHash holds the hash
+  @retval EFI_LOAD_ERROR the payload is missing, damaged or of a different size
+**/
+STATIC
+EFI_STATUS
+PbrGetPayloadHash(
+  IN    UINT32 BlobIndex,
+  IN    UINT32 Size,
+  OUT   UINT64 *pHash
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPayloadBlob *pBlob = NULL;
+  UINT32 BlobSize = 0;
+
+  ReturnCode = PbrGetData(PBR_PAYLOAD_SIG, BlobIndex, (VOID **)&pBlob, &BlobSize, NULL);
+  if (EFI_ERROR(ReturnCode) || BlobSize < sizeof(PbrPayloadBlob) || pBlob->Size != Size) {
+    NVDIMM_ERR("Recorded payload %d is missing or does not match the request\n", BlobIndex);
+    FREE_POOL_SAFE(pBlob);
+    return EFI_LOAD_ERROR;
+  }
+  *pHash = pBlob->Hash;
+  FREE_POOL_SAFE(pBlob);
+  return EFI_SUCCESS;
+}
+
+/**
+  Helper that returns the slot of a key, linear probing from the key hash
+
+  @param[in] Insert: claim a free slot if the key is not in the table
+
+  @retval the slot, NULL if the key is not in the table
+**/
+STATIC
+PbrPassThruIndexSlot *
+PbrFindPassThruSlot(
+  IN    UINT32 DimmId,
+  IN    UINT8 Opcode,
+  IN    UINT8 SubOpcode,
+  IN    BOOLEAN AnyInput,
+  IN    UINT64 InputHash,
+  IN    BOOLEAN Insert
+)
+{
+  PbrPassThruIndexSlot *pSlot = NULL;
+  UINT64 KeyHash = 0;
+  UINT32 SlotIndex = 0;
+  UINT32 Probe = 0;
+
+  KeyHash = (InputHash ^ ((UINT64)DimmId << 17) ^ ((UINT64)Opcode << 8) ^ SubOpcode ^ ((UINT64)AnyInput << 63)) * PBR_FNV64_PRIME;
+  SlotIndex = (UINT32)(KeyHash >> 32) & (mPassThruIndex.SlotCnt - 1);
+
+  for (Probe = 0; Probe < mPassThruIndex.SlotCnt; ++Probe) {
+    pSlot = &mPassThruIndex.pSlots[(SlotIndex + Probe) & (mPassThruIndex.SlotCnt - 1)];
+    if (!pSlot->Used) {
+      if (!Insert) {
+        return NULL;
+      }
+      pSlot->Used = TRUE;
+      pSlot->DimmId = DimmId;
+      pSlot->Opcode = Opcode;
+      pSlot->SubOpcode = SubOpcode;
+      pSlot->AnyInput = AnyInput;
+      pSlot->InputHash = InputHash;
+      pSlot->First = pSlot->Last = pSlot->Start = pSlot->Next = PBR_PASS_THRU_NO_RECORD;
+      return pSlot;
+    }
+    if (pSlot->DimmId == DimmId && pSlot->Opcode == Opcode && pSlot->SubOpcode == SubOpcode &&
+      pSlot->AnyInput == AnyInput && pSlot->InputHash == InputHash) {
+      return pSlot;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Helper that returns the record following Record in the chain of a slot
+**/
+STATIC
+UINT32
+PbrNextPassThruRecord(
+  IN    PbrPassThruIndexSlot *pSlot,
+  IN    UINT32 Record
+)
+{
+  if (PBR_PASS_THRU_NO_RECORD == Record) {
+    return PBR_PASS_THRU_NO_RECORD;
+  }
+  return pSlot->AnyInput ? mPassThruIndex.pRecords[Record].NextAnyInput : mPassThruIndex.pRecords[Record].NextSameInput;
+}
+
+/**
+  Helper that appends a record to the chain of a slot
+**/
+STATIC
+VOID
+PbrChainPassThruRecord(
+  IN    PbrPassThruIndexSlot *pSlot,
+  IN    UINT32 Record
+)
+{
+  if (PBR_PASS_THRU_NO_RECORD == pSlot->Last) {
+    pSlot->First = Record;
+  }
+  else if (pSlot->AnyInput) {
+    mPassThruIndex.pRecords[pSlot->Last].NextAnyInput = Record;
+  }
+  else {
+    mPassThruIndex.pRecords[pSlot->Last].NextSameInput = Record;
+  }
+  pSlot->Last = Record;
+}
+
+/**
+  Helper that indexes every record of the passthrough partition by
+  (DIMM, opcode, subopcode, input hash) and by (DIMM, opcode, subopcode)
+
+  @retval EFI_SUCCESS the index describes the current partition
+  @retval EFI_NOT_FOUND the session has no passthrough partition
+  @retval EFI_OUT_OF_RESOURCES memory allocation failure
+**/
+STATIC
+EFI_STATUS
+PbrBuildPassThruIndex(
+  IN    UINT32 RecordCnt,
+  IN    UINT32 PartitionSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPassThruReq *ptReq = NULL;
+  PbrPassThruIndexSlot *pSlot = NULL;
+  UINT32 DataSize = 0;
+  UINT32 Offset = 0;
+  UINT32 Record = 0;
+  UINT32 LargeInputSize = 0;
+  UINT32 BlobIndex = 0;
+  UINT64 LargeInputHash = 0;
+  UINT64 InputHash = 0;
+  BOOLEAN PayloadStore = PbrHasPayloadStore();
+
+  FREE_POOL_SAFE(mPassThruIndex.pRecords);
+  FREE_POOL_SAFE(mPassThruIndex.pSlots);
+  mPassThruIndex.Built = FALSE;
+
+  //every record is in two slots, keep the table at most half full
+  mPassThruIndex.SlotCnt = PBR_PASS_THRU_MIN_SLOTS;
+  while (mPassThruIndex.SlotCnt < RecordCnt * 4 && mPassThruIndex.SlotCnt < (MAX_UINT32 >> 1) + 1) {
+    mPassThruIndex.SlotCnt <<= 1;
+  }
+  mPassThruIndex.pRecords = AllocateZeroPool(sizeof(PbrPassThruIndexRecord) * (RecordCnt ? RecordCnt : 1));
+  mPassThruIndex.pSlots = AllocateZeroPool(sizeof(PbrPassThruIndexSlot) * mPassThruIndex.SlotCnt);
+  if (NULL == mPassThruIndex.pRecords || NULL == mPassThruIndex.pSlots) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    goto Finish;
+  }
+
+  for (Record = 0; Record < RecordCnt; ++Record) {
+    mPassThruIndex.pRecords[Record].Offset = Offset;
+    mPassThruIndex.pRecords[Record].NextSameInput = PBR_PASS_THRU_NO_RECORD;
+    mPassThruIndex.pRecords[Record].NextAnyInput = PBR_PASS_THRU_NO_RECORD;
+
+    ReturnCode = PbrGetData(PBR_PASS_THRU_SIG, Record, (VOID **)&ptReq, &DataSize, NULL);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_ERR("Failed to index passthrough record %d\n", Record);
+      goto Finish;
+    }
+    Offset += sizeof(PbrPartitionLogicalDataItem) + DataSize;
+
+    //a record too short for its input is never served
+    LargeInputSize = ptReq->InputLargePayloadSize;
+    if (PayloadStore && 0 != LargeInputSize) {
+      LargeInputSize = sizeof(BlobIndex);
+    }
+    if (DataSize < sizeof(PbrPassThruReq) ||
+      ptReq->InputPayloadSize > DataSize - sizeof(PbrPassThruReq) ||
+      LargeInputSize > DataSize - sizeof(PbrPassThruReq) - ptReq->InputPayloadSize) {
+      NVDIMM_WARN("Skipping malformed passthrough record %d\n", Record);
+      FREE_POOL_SAFE(ptReq);
+      continue;
+    }
+
+    if (PayloadStore && 0 != LargeInputSize) {
+      CopyMem_S(&BlobIndex, sizeof(BlobIndex), ptReq->Input + ptReq->InputPayloadSize, sizeof(BlobIndex));
+      if (EFI_ERROR(PbrGetPayloadHash(BlobIndex, ptReq->InputLargePayloadSize, &LargeInputHash))) {
+        NVDIMM_WARN("Skipping malformed passthrough record %d\n", Record);
+        FREE_POOL_SAFE(ptReq);
+        continue;
+      }
+    }
+    else {
+      LargeInputHash = PbrHashBytes(PBR_FNV64_OFFSET_BASIS, ptReq->Input + ptReq->InputPayloadSize, LargeInputSize);
+    }
+    InputHash = PbrHashPassThruInput(ptReq->Input, ptReq->InputPayloadSize, LargeInputHash, ptReq->InputLargePayloadSize);
+    pSlot = PbrFindPassThruSlot(ptReq->DimmId, ptReq->Opcode, ptReq->SubOpcode, FALSE, InputHash, TRUE);
+    if (NULL != pSlot) {
+      PbrChainPassThruRecord(pSlot, Record);
+    }
+    pSlot = PbrFindPassThruSlot(ptReq->DimmId, ptReq->Opcode, ptReq->SubOpcode, TRUE, 0, TRUE);
+    if (NULL != pSlot) {
+      PbrChainPassThruRecord(pSlot, Record);
+    }
+    FREE_POOL_SAFE(ptReq);
+  }
+
+  mPassThruIndex.RecordCnt = RecordCnt;
+  mPassThruIndex.PartitionSize = PartitionSize;
+  mPassThruIndex.Built = TRUE;
+  mPassThruIndex.Rewind = TRUE;
+
+Finish:
+  if (EFI_ERROR(ReturnCode)) {
+    FREE_POOL_SAFE(mPassThruIndex.pRecords);
+    FREE_POOL_SAFE(mPassThruIndex.pSlots);
+  }
+  return ReturnCode;
+}
+
+/**
+  Helper that moves every slot to its first record at or after the playback offset,
+  which PbrResetSession sets to the tag being played back
+**/
+STATIC
+VOID
+PbrRewindPassThruIndex(
+  IN    UINT32 PlaybackOffset
+)
+{
+  PbrPassThruIndexSlot *pSlot = NULL;
+  UINT32 SlotIndex = 0;
+  UINT32 Record = 0;
+
+  for (SlotIndex = 0; SlotIndex < mPassThruIndex.SlotCnt; ++SlotIndex) {
+    pSlot = &mPassThruIndex.pSlots[SlotIndex];
+    if (!pSlot->Used) {
+      continue;
+    }
+    Record = pSlot->First;
+    while (PBR_PASS_THRU_NO_RECORD != Record && mPassThruIndex.pRecords[Record].Offset < PlaybackOffset) {
+      Record = PbrNextPassThruRecord(pSlot, Record);
+    }
+    pSlot->Start = pSlot->Next = Record;
+  }
+  mPassThruIndex.Rewind = FALSE;
+}
+
+/**
+  Helper that returns the recorded passthrough matching the DIMM, opcode, subopcode
+  and input of pCmd, regardless of the order it was recorded in
+
+  @retval EFI_SUCCESS ppData holds the record, the caller frees it
+  @retval EFI_NOT_FOUND nothing matches or the matching records are consumed
+**/
+STATIC
+EFI_STATUS
+PbrGetKeyedPassThruData(
+  IN    FW_CMD *pCmd,
+  OUT   VOID **ppData,
+  OUT   UINT32 *pDataSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPassThruIndexSlot *pSlot = NULL;
+  UINT32 RecordCnt = 0;
+  UINT32 PartitionSize = 0;
+  UINT32 PlaybackOffset = 0;
+  UINT32 Record = PBR_PASS_THRU_NO_RECORD;
+  UINT32 LargeInputSize = 0;
+  UINT64 LargeInputHash = 0;
+  UINT64 InputHash = 0;
+
+  ReturnCode = PbrGetDataPlaybackInfo(PBR_PASS_THRU_SIG, &RecordCnt, &PartitionSize, &PlaybackOffset);
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_ERR("No passthrough records in the session\n");
+    return ReturnCode;
+  }
+
+  if (!mPassThruIndex.Built || RecordCnt != mPassThruIndex.RecordCnt || PartitionSize != mPassThruIndex.PartitionSize) {
+    ReturnCode = PbrBuildPassThruIndex(RecordCnt, PartitionSize);
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+  }
+  if (mPassThruIndex.Rewind) {
+    PbrRewindPassThruIndex(PlaybackOffset);
+  }
+
+  LargeInputSize = (NULL != pCmd->LargeInputPayload) ? pCmd->LargeInputPayloadSize : 0;
+  LargeInputHash = PbrHashBytes(PBR_FNV64_OFFSET_BASIS, pCmd->LargeInputPayload, LargeInputSize);
+  InputHash = PbrHashPassThruInput(pCmd->InputPayload, pCmd->InputPayloadSize, LargeInputHash, LargeInputSize);
+  pSlot = PbrFindPassThruSlot(pCmd->DimmID, pCmd->Opcode, pCmd->SubOpcode, FALSE, InputHash, FALSE);
+  if (NULL == pSlot && PBR_PLAYBACK_MISSING_ANY_INPUT == mPassThruIndex.Missing) {
+    pSlot = PbrFindPassThruSlot(pCmd->DimmID, pCmd->Opcode, pCmd->SubOpcode, TRUE, 0, FALSE);
+  }
+  if (NULL == pSlot) {
+    NVDIMM_ERR("No recorded passthrough for DIMM 0x%x, opcode 0x%x, subopcode 0x%x\n", pCmd->DimmID, pCmd->Opcode, pCmd->SubOpcode);
+    return EFI_NOT_FOUND;
+  }
+
+  Record = pSlot->Next;
+  if (PBR_PASS_THRU_NO_RECORD == Record) {
+    if (PBR_PLAYBACK_REPEAT_CYCLE == mPassThruIndex.Repeat) {
+      Record = (PBR_PASS_THRU_NO_RECORD != pSlot->Start) ? pSlot->Start : pSlot->First;
+    }
+    else if (PBR_PLAYBACK_REPEAT_FAIL != mPassThruIndex.Repeat) {
+      Record = pSlot->Last;
+    }
+  }
+  if (PBR_PASS_THRU_NO_RECORD == Record) {
+    NVDIMM_ERR("Recorded passthroughs for DIMM 0x%x, opcode 0x%x, subopcode 0x%x are consumed\n", pCmd->DimmID, pCmd->Opcode, pCmd->SubOpcode);
+    return EFI_NOT_FOUND;
+  }
+  pSlot->Next = PbrNextPassThruRecord(pSlot, Record);
+
+  return PbrGetData(PBR_PASS_THRU_SIG, Record, ppData, pDataSize, NULL);
+}
+
+/**
+  Helper that adds a stored payload to the payload store lookup, doubling the table
+  once it is half full
+
+  @retval EFI_SUCCESS payload added
+  @retval EFI_OUT_OF_RESOURCES memory allocation failure
+**/
+STATIC
+EFI_STATUS
+PbrPayloadLookupInsert(
+  IN    UINT64 Hash,
+  IN    UINT32 Size,
+  IN    UINT32 BlobIndex
+)
+{
+  PbrPayloadLookupSlot *pOldSlots = NULL;
+  UINT32 OldSlotCnt = 0;
+  UINT32 SlotIndex = 0;
+  UINT32 Mask = 0;
+
+  if ((mPayloadLookup.BlobCnt + 1) * 2 > mPayloadLookup.SlotCnt) {
+    pOldSlots = mPayloadLookup.pSlots;
+    OldSlotCnt = mPayloadLookup.SlotCnt;
+    mPayloadLookup.SlotCnt = (0 == OldSlotCnt) ? PBR_PASS_THRU_MIN_SLOTS : OldSlotCnt * 2;
+    mPayloadLookup.pSlots = AllocatePool(sizeof(PbrPayloadLookupSlot) * mPayloadLookup.SlotCnt);
+    if (NULL == mPayloadLookup.pSlots) {
+      mPayloadLookup.pSlots = pOldSlots;
+      mPayloadLookup.SlotCnt = OldSlotCnt;
+      return EFI_OUT_OF_RESOURCES;
+    }
+    SetMem(mPayloadLookup.pSlots, sizeof(PbrPayloadLookupSlot) * mPayloadLookup.SlotCnt, 0xFF);
+    mPayloadLookup.BlobCnt = 0;
+    for (SlotIndex = 0; SlotIndex < OldSlotCnt; ++SlotIndex) {
+      if (PBR_PASS_THRU_NO_RECORD != pOldSlots[SlotIndex].BlobIndex) {
+        PbrPayloadLookupInsert(pOldSlots[SlotIndex].Hash, pOldSlots[SlotIndex].Size, pOldSlots[SlotIndex].BlobIndex);
+      }
+    }
+    FREE_POOL_SAFE(pOldSlots);
+  }
+
+  Mask = mPayloadLookup.SlotCnt - 1;
+  SlotIndex = (UINT32)(Hash >> 32) & Mask;
+  while (PBR_PASS_THRU_NO_RECORD != mPayloadLookup.pSlots[SlotIndex].BlobIndex) {
+    SlotIndex = (SlotIndex + 1) & Mask;
+  }
+  mPayloadLookup.pSlots[SlotIndex].Hash = Hash;
+  mPayloadLookup.pSlots[SlotIndex].Size = Size;
+  mPayloadLookup.pSlots[SlotIndex].BlobIndex = BlobIndex;
+  mPayloadLookup.BlobCnt++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Helper that adds the payloads stored since the lookup was last used, e.g. by an
+  earlier invocation recording into the same session
+
+  @retval EFI_SUCCESS the lookup covers the payload partition
+  @retval EFI_OUT_OF_RESOURCES memory allocation failure
+**/
+STATIC
+EFI_STATUS
+PbrSyncPayloadLookup(
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPayloadBlob *pBlob = NULL;
+  UINT32 BlobCnt = 0;
+  UINT32 PartitionSize = 0;
+  UINT32 PlaybackOffset = 0;
+  UINT32 BlobSize = 0;
+  UINT32 BlobIndex = 0;
+
+  if (EFI_ERROR(PbrGetDataPlaybackInfo(PBR_PAYLOAD_SIG, &BlobCnt, &PartitionSize, &PlaybackOffset))) {
+    BlobCnt = 0;
+  }
+  if (BlobCnt < mPayloadLookup.BlobCnt) {
+    FREE_POOL_SAFE(mPayloadLookup.pSlots);
+    mPayloadLookup.SlotCnt = 0;
+    mPayloadLookup.BlobCnt = 0;
+  }
+
+  for (BlobIndex = mPayloadLookup.BlobCnt; BlobIndex < BlobCnt; ++BlobIndex) {
+    ReturnCode = PbrGetData(PBR_PAYLOAD_SIG, BlobIndex, (VOID **)&pBlob, &BlobSize, NULL);
+    if (EFI_ERROR(ReturnCode) || BlobSize < sizeof(PbrPayloadBlob)) {
+      NVDIMM_ERR("Failed to get recorded payload %d\n", BlobIndex);
+      FREE_POOL_SAFE(pBlob);
+      return EFI_LOAD_ERROR;
+    }
+    ReturnCode = PbrPayloadLookupInsert(pBlob->Hash, pBlob->Size, BlobIndex);
+    FREE_POOL_SAFE(pBlob);
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Helper that copies a payload out of the payload partition
+
+  @param[in] BlobIndex: item index of the payload in the payload partition
+  @param[out] pDest: buffer for the payload
+  @param[in] DestSize: size of the payload as recorded in the passthrough response
+
+  @retval EFI_SUCCESS payload copied
+  @retval EFI_LOAD_ERROR the payload is missing, damaged or of a different size
+**/
+STATIC
+EFI_STATUS
+PbrLoadPayload(
+  IN    UINT32 BlobIndex,
+  OUT   UINT8 *pDest,
+  IN    UINT32 DestSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPayloadBlob *pBlob = NULL;
+  UINT32 BlobSize = 0;
+
+  ReturnCode = PbrGetData(PBR_PAYLOAD_SIG, BlobIndex, (VOID **)&pBlob, &BlobSize, NULL);
+  if (EFI_ERROR(ReturnCode) || BlobSize < sizeof(PbrPayloadBlob) ||
+    pBlob->StoredSize > BlobSize - sizeof(PbrPayloadBlob) || pBlob->Size != DestSize) {
+    NVDIMM_ERR("Recorded payload %d is missing or does not match the response\n", BlobIndex);
+    ReturnCode = EFI_LOAD_ERROR;
+    goto Finish;
+  }
+
+  if (PBR_PAYLOAD_ENCODING_LZMA == pBlob->Encoding) {
+    ReturnCode = PbrDecompressPayload(pBlob->Data, pBlob->StoredSize, pDest, DestSize);
+    if (EFI_ERROR(ReturnCode)) {
+      ReturnCode = EFI_LOAD_ERROR;
+    }
+  }
+  else if (PBR_PAYLOAD_ENCODING_RAW == pBlob->Encoding && pBlob->StoredSize == DestSize) {
+    CopyMem_S(pDest, DestSize, pBlob->Data, DestSize);
+  }
+  else {
+    NVDIMM_ERR("Recorded payload %d has an unknown encoding %d\n", BlobIndex, pBlob->Encoding);
+    ReturnCode = EFI_LOAD_ERROR;
+  }
+
+Finish:
+  FREE_POOL_SAFE(pBlob);
+  return ReturnCode;
+}
+
+/**
+  Helper that stores a payload in the payload partition, unless an identical
+  payload is stored already
+
+  @param[in] pPayload: payload to store
+  @param[in] Size: size of pPayload
+  @param[out] pBlobIndex: item index of the stored copy in the payload partition
+
+  @retval EFI_SUCCESS payload stored or found
+  @retval EFI_OUT_OF_RESOURCES memory allocation failure
+**/
+STATIC
+EFI_STATUS
+PbrStorePayload(
+  IN    UINT8 *pPayload,
+  IN    UINT32 Size,
+  OUT   UINT32 *pBlobIndex
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrPayloadBlob *pBlob = NULL;
+  UINT8 *pStored = NULL;
+  UINT8 *pCompressed = NULL;
+  UINT32 CompressedSize = 0;
+  UINT32 BlobIndex = 0;
+  UINT32 SlotIndex = 0;
+  UINT64 Hash = 0;
+
+  if (!mPayloadLookup.Configured) {
+    mPayloadLookup.Compression = PbrGetPlaybackPreference(INI_PREFERENCES_PBR_RECORD_COMPRESSION);
+    mPayloadLookup.Configured = TRUE;
+  }
+
+  ReturnCode = PbrSyncPayloadLookup();
+  if (EFI_ERROR(ReturnCode)) {
+    return ReturnCode;
+  }
+
+  Hash = PbrHashBytes(PBR_FNV64_OFFSET_BASIS, pPayload, Size);
+
+  //a hash match is confirmed byte by byte, replay must return exactly what was recorded
+  if (0 != mPayloadLookup.SlotCnt) {
+    pStored = AllocatePool(Size);
+    if (NULL == pStored) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    SlotIndex = (UINT32)(Hash >> 32) & (mPayloadLookup.SlotCnt - 1);
+    while (PBR_PASS_THRU_NO_RECORD != mPayloadLookup.pSlots[SlotIndex].BlobIndex) {
+      if (mPayloadLookup.pSlots[SlotIndex].Hash == Hash && mPayloadLookup.pSlots[SlotIndex].Size == Size &&
+        !EFI_ERROR(PbrLoadPayload(mPayloadLookup.pSlots[SlotIndex].BlobIndex, pStored, Size)) &&
+        0 == CompareMem(pStored, pPayload, Size)) {
+        *pBlobIndex = mPayloadLookup.pSlots[SlotIndex].BlobIndex;
+        goto Finish;
+      }
+      SlotIndex = (SlotIndex + 1) & (mPayloadLookup.SlotCnt - 1);
+    }
+  }
+
+  //keep the compressed copy only if it is smaller
+  if (0 != mPayloadLookup.Compression && Size > 1) {
+    CompressedSize = Size - 1;
+    pCompressed = AllocatePool(CompressedSize);
+    if (NULL != pCompressed && EFI_ERROR(PbrCompressPayload(pPayload, Size, pCompressed, &CompressedSize))) {
+      FREE_POOL_SAFE(pCompressed);
+    }
+  }
+
+  ReturnCode = PbrSetData(
+    PBR_PAYLOAD_SIG,
+    NULL,
+    (UINT32)sizeof(PbrPayloadBlob) + ((NULL != pCompressed) ? CompressedSize : Size),
+    FALSE,
+    (VOID **)&pBlob,
+    &BlobIndex);
+  if (EFI_ERROR(ReturnCode)) {
+    goto Finish;
+  }
+  pBlob->Hash = Hash;
+  pBlob->Size = Size;
+  if (NULL != pCompressed) {
+    pBlob->Encoding = PBR_PAYLOAD_ENCODING_LZMA;
+    pBlob->StoredSize = CompressedSize;
+    CopyMem_S(pBlob->Data, CompressedSize, pCompressed, CompressedSize);
+  }
+  else {
+    pBlob->Encoding = PBR_PAYLOAD_ENCODING_RAW;
+    pBlob->StoredSize = Size;
+    CopyMem_S(pBlob->Data, Size, pPayload, Size);
+  }
+
+  ReturnCode = PbrPayloadLookupInsert(Hash, Size, BlobIndex);
+  *pBlobIndex = BlobIndex;
+
+Finish:
+  FREE_POOL_SAFE(pStored);
+  FREE_POOL_SAFE(pCompressed);
+  return ReturnCode;
+}
+
+/**
+  Restart keyed passthrough playback at the current playback offset.
+  Called whenever the session is reset to a tag.
+**/
+VOID
+PbrResetPassThruIndex(
+)
+{
+  mPassThruIndex.Rewind = TRUE;
+}
+
+/**
+  Free the keyed passthrough playback index and the payload store lookup.
+  Called whenever the session data is freed or replaced.
+**/
+VOID
+PbrFreePassThruIndex(
+)
+{
+  FREE_POOL_SAFE(mPassThruIndex.pRecords);
+  FREE_POOL_SAFE(mPassThruIndex.pSlots);
+  ZeroMem(&mPassThruIndex, sizeof(mPassThruIndex));
+  FREE_POOL_SAFE(mPayloadLookup.pSlots);
+  ZeroMem(&mPayloadLookup, sizeof(mPayloadLookup));
+}
 
 /**
   Return the current FW_CMD from the playback buffer
 
   @param[in] pContext: Pbr context
   @param[in] pCmd: current FW_CMD from the playback buffer
+  @param[out] pReplayMicroseconds: optional, receives the latency to replay
+              instead of stalling for it here
 
   @retval EFI_SUCCESS if the table was found and is properly returned.
 **/
@@ -25,7 +762,8 @@ EFI_STATUS
 PbrGetPassThruRecord(
   IN    PbrContext *pContext,
   OUT   FW_CMD *pCmd,
-  OUT   EFI_STATUS *pPassThruRc
+  OUT   EFI_STATUS *pPassThruRc,
+  OUT   UINT64 *pReplayMicroseconds OPTIONAL
 )
 {
   EFI_STATUS ReturnCode = EFI_SUCCESS;
@@ -34,17 +772,36 @@ PbrGetPassThruRecord(
   VOID *pData = NULL;
   UINT32 DataSize = 0;
   UINT32 CurDataPos = 0;
+  UINT32 LargeOutputBufferSize = pCmd->LargeOutputPayloadSize;
+  UINT32 DelayScale = 0;
+  UINT32 BlobIndex = 0;
+  BOOLEAN PayloadStore = FALSE;
 
+  if (NULL != pReplayMicroseconds) {
+    *pReplayMicroseconds = 0;
+  }
   if (PBR_PLAYBACK_MODE != pContext->PbrMode) {
     return EFI_SUCCESS;
   }
 
-  ReturnCode = PbrGetData(
-                PBR_PASS_THRU_SIG,
-                GET_NEXT_DATA_INDEX,
-                &pData,
-                &DataSize,
-                NULL);
+  if (!mPassThruIndex.Configured) {
+    mPassThruIndex.Order = PbrGetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_ORDER);
+    mPassThruIndex.Repeat = PbrGetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_REPEAT);
+    mPassThruIndex.Missing = PbrGetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_MISSING);
+    mPassThruIndex.Configured = TRUE;
+  }
+
+  if (PBR_PLAYBACK_ORDER_KEYED == mPassThruIndex.Order) {
+    ReturnCode = PbrGetKeyedPassThruData(pCmd, &pData, &DataSize);
+  }
+  else {
+    ReturnCode = PbrGetData(
+                  PBR_PASS_THRU_SIG,
+                  GET_NEXT_DATA_INDEX,
+                  &pData,
+                  &DataSize,
+                  NULL);
+  }
 
   if (EFI_SUCCESS != ReturnCode) {
     Print(L"Failed to get data!!!!\n");
@@ -81,7 +838,10 @@ PbrGetPassThruRecord(
     goto Finish;
   }
 
-  CurDataPos += ptReq->InputLargePayloadSize;
+  //sessions with a payload store keep the payload partition index of each large payload instead
+  PayloadStore = PbrHasPayloadStore();
+
+  CurDataPos += PayloadStore ? (ptReq->InputLargePayloadSize ? sizeof(BlobIndex) : 0) : ptReq->InputLargePayloadSize;
   //verify we didn't run out of data
   if (CurDataPos > DataSize) {
     NVDIMM_ERR("Failed to skip past the InputLargePayload\n");
@@ -108,13 +868,27 @@ PbrGetPassThruRecord(
 
   //there is an output payload
   if (ptResp->OutputPayloadSize) {
-    CopyMem_S(pCmd->OutPayload,
-      OUT_PAYLOAD_SIZE,
-      (UINT8*)((UINTN)pData + (UINTN)CurDataPos),
-      ptResp->OutputPayloadSize);
+    if (PayloadStore) {
+      if (sizeof(BlobIndex) > DataSize - CurDataPos || ptResp->OutputPayloadSize > OUT_PAYLOAD_SIZE) {
+        NVDIMM_ERR("Failed to get the OutputPayload index\n");
+        ReturnCode = EFI_LOAD_ERROR;
+        goto Finish;
+      }
+      CopyMem_S(&BlobIndex, sizeof(BlobIndex), (UINT8*)pData + CurDataPos, sizeof(BlobIndex));
+      ReturnCode = PbrLoadPayload(BlobIndex, pCmd->OutPayload, ptResp->OutputPayloadSize);
+      if (EFI_ERROR(ReturnCode)) {
+        goto Finish;
+      }
+    }
+    else {
+      CopyMem_S(pCmd->OutPayload,
+        OUT_PAYLOAD_SIZE,
+        (UINT8*)((UINTN)pData + (UINTN)CurDataPos),
+        ptResp->OutputPayloadSize);
+    }
   }
   //skip past the response output payload
-  CurDataPos += ptResp->OutputPayloadSize;
+  CurDataPos += PayloadStore ? (ptResp->OutputPayloadSize ? sizeof(BlobIndex) : 0) : ptResp->OutputPayloadSize;
   //verify we didn't run out of data
   if (CurDataPos > DataSize) {
     NVDIMM_ERR("Failed to skip past the OutputPayload\n");
@@ -124,10 +898,46 @@ PbrGetPassThruRecord(
 
   //there is a large output payload
   if (ptResp->OutputLargePayloadSize) {
-    CopyMem_S(pCmd->LargeOutputPayload,
-      OUT_MB_SIZE,
-      (UINT8*)pData + CurDataPos,
-      ptResp->OutputLargePayloadSize);
+    //the caller attaches a buffer sized for the large output payload it requested
+    if (NULL == pCmd->LargeOutputPayload || ptResp->OutputLargePayloadSize > LargeOutputBufferSize) {
+      NVDIMM_ERR("Recorded large output payload (%d bytes) does not fit the attached buffer (%d bytes)\n",
+        ptResp->OutputLargePayloadSize, LargeOutputBufferSize);
+      ReturnCode = EFI_LOAD_ERROR;
+      goto Finish;
+    }
+    if (PayloadStore) {
+      if (sizeof(BlobIndex) > DataSize - CurDataPos) {
+        NVDIMM_ERR("Failed to get the OutputLargePayload index\n");
+        ReturnCode = EFI_LOAD_ERROR;
+        goto Finish;
+      }
+      CopyMem_S(&BlobIndex, sizeof(BlobIndex), (UINT8*)pData + CurDataPos, sizeof(BlobIndex));
+      ReturnCode = PbrLoadPayload(BlobIndex, pCmd->LargeOutputPayload, ptResp->OutputLargePayloadSize);
+      if (EFI_ERROR(ReturnCode)) {
+        goto Finish;
+      }
+    }
+    else {
+      if (ptResp->OutputLargePayloadSize > DataSize - CurDataPos) {
+        NVDIMM_ERR("Failed to get the OutputLargePayload\n");
+        ReturnCode = EFI_LOAD_ERROR;
+        goto Finish;
+      }
+      CopyMem_S(pCmd->LargeOutputPayload,
+        LargeOutputBufferSize,
+        (UINT8*)pData + CurDataPos,
+        ptResp->OutputLargePayloadSize);
+    }
+  }
+
+  //take as long as the recorded passthrough did, scaled, so timing issues reproduce offline
+  DelayScale = PbrGetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_DELAY_SCALE);
+  if (0 != DelayScale && PBR_PASS_THRU_LATENCY_UNKNOWN != ptReq->TotalMicroseconds) {
+    if (NULL != pReplayMicroseconds) {
+      *pReplayMicroseconds = (ptReq->TotalMicroseconds * DelayScale) / 100;
+    } else {
+      gBS->Stall((UINTN)((ptReq->TotalMicroseconds * DelayScale) / 100));
+    }
   }
 
 Finish:
@@ -140,6 +950,8 @@ Finish:
 
   @param[in] pContext: Pbr context
   @param[in] pCmd: current FW_CMD from the playback buffer
+  @param[in] PassthruReturnCode: return code of the passthrough
+  @param[in] LatencyMicroseconds: time the passthrough took, replayed by playback
 
   @retval EFI_SUCCESS if the table was found and is properly returned.
 **/
@@ -147,7 +959,8 @@ EFI_STATUS
 PbrSetPassThruRecord(
   IN    PbrContext *pContext,
   OUT   FW_CMD *pCmd,
-  EFI_STATUS PassthruReturnCode
+  EFI_STATUS PassthruReturnCode,
+  IN    UINT64 LatencyMicroseconds
 )
 {
   EFI_STATUS ReturnCode = EFI_SUCCESS;
@@ -155,6 +968,10 @@ PbrSetPassThruRecord(
   PbrPassThruResp *ptResp = NULL;
   VOID *pData = NULL;
   UINT32 DataSize = 0;
+  UINT32 CurDataPos = 0;
+  UINT32 LargeInputBlobIndex = 0;
+  UINT32 OutputBlobIndex = 0;
+  UINT32 LargeOutputBlobIndex = 0;
 
   if (NULL == pContext || NULL == pCmd) {
     return EFI_INVALID_PARAMETER;
@@ -164,26 +981,54 @@ PbrSetPassThruRecord(
     return EFI_SUCCESS;
   }
 
+  //large inputs (FW images, PCD writes) and output payloads repeat a lot (SMART, identify, PCD),
+  //store each distinct one once
+  if (pCmd->LargeInputPayloadSize) {
+    ReturnCode = PbrStorePayload(pCmd->LargeInputPayload, pCmd->LargeInputPayloadSize, &LargeInputBlobIndex);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_ERR("Failed to record the passthrough large input payload\n");
+      return ReturnCode;
+    }
+  }
+  if (pCmd->OutputPayloadSize) {
+    ReturnCode = PbrStorePayload(pCmd->OutPayload, pCmd->OutputPayloadSize, &OutputBlobIndex);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_ERR("Failed to record the passthrough output payload\n");
+      return ReturnCode;
+    }
+  }
+  if (pCmd->LargeOutputPayloadSize) {
+    ReturnCode = PbrStorePayload(pCmd->LargeOutputPayload, pCmd->LargeOutputPayloadSize, &LargeOutputBlobIndex);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_ERR("Failed to record the passthrough large output payload\n");
+      return ReturnCode;
+    }
+  }
+
   DataSize += sizeof(PbrPassThruReq);
   DataSize += pCmd->InputPayloadSize;
-  DataSize += pCmd->LargeInputPayloadSize;
+  DataSize += pCmd->LargeInputPayloadSize ? sizeof(LargeInputBlobIndex) : 0;
   DataSize += sizeof(PbrPassThruResp);
-  DataSize += pCmd->OutputPayloadSize;
-  DataSize += pCmd->LargeOutputPayloadSize;
+  DataSize += pCmd->OutputPayloadSize ? sizeof(OutputBlobIndex) : 0;
+  DataSize += pCmd->LargeOutputPayloadSize ? sizeof(LargeOutputBlobIndex) : 0;
 
-  PbrSetData(
+  ReturnCode = PbrSetData(
     PBR_PASS_THRU_SIG,
     NULL,
     DataSize,
     FALSE,
     &pData,
     NULL);
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_ERR("Failed to record the passthrough\n");
+    return ReturnCode;
+  }
 
   ptReq = (PbrPassThruReq*)pData;
   ptReq->DimmId = pCmd->DimmID;
   ptReq->Opcode = pCmd->Opcode;
   ptReq->SubOpcode = pCmd->SubOpcode;
-  ptReq->TotalMilliseconds = 0xDEADBEEF;// GetCurrentMilliseconds();
+  ptReq->TotalMicroseconds = LatencyMicroseconds;
   ptReq->InputPayloadSize = pCmd->InputPayloadSize;
   ptReq->InputLargePayloadSize = pCmd->LargeInputPayloadSize;
 
@@ -195,37 +1040,45 @@ PbrSetPassThruRecord(
       pCmd->InputPayloadSize);
   }
 
+  //the small input is followed by the payload partition index of the large input
+  CurDataPos = sizeof(PbrPassThruReq) + pCmd->InputPayloadSize;
   if (pCmd->LargeInputPayloadSize)
   {
-    CopyMem_S((VOID*)((UINTN)pData + (UINTN)sizeof(PbrPassThruReq) + (UINTN)pCmd->InputPayloadSize),
-      DataSize - sizeof(PbrPassThruReq) - pCmd->InputPayloadSize,
-      pCmd->LargeInputPayload,
-      pCmd->LargeInputPayloadSize);
+    CopyMem_S((VOID*)((UINTN)pData + CurDataPos),
+      DataSize - CurDataPos,
+      &LargeInputBlobIndex,
+      sizeof(LargeInputBlobIndex));
+    CurDataPos += sizeof(LargeInputBlobIndex);
   }
 
-  ptResp = (PbrPassThruResp*)((UINTN)pData + (UINTN)sizeof(PbrPassThruReq) + (UINTN)pCmd->InputPayloadSize + (UINTN)pCmd->LargeInputPayloadSize);
+  ptResp = (PbrPassThruResp*)((UINTN)pData + CurDataPos);
   ptResp->DimmId = pCmd->DimmID;
   ptResp->PassthruReturnCode = PassthruReturnCode;
   ptResp->Status = pCmd->Status;
-  ptResp->TotalMilliseconds = 0x55AA55AA;
+  ptResp->TotalMilliseconds = LatencyMicroseconds / 1000;
   ptResp->OutputPayloadSize = pCmd->OutputPayloadSize;
   ptResp->OutputLargePayloadSize = pCmd->LargeOutputPayloadSize;
 
+  //the response is followed by the payload partition index of each output payload
+  CurDataPos += sizeof(PbrPassThruResp);
   if (pCmd->OutputPayloadSize)
   {
-    CopyMem_S((VOID*)((UINTN)pData + sizeof(PbrPassThruReq) + pCmd->InputPayloadSize + pCmd->LargeInputPayloadSize + sizeof(PbrPassThruResp)),
-      DataSize - sizeof(PbrPassThruReq) - pCmd->InputPayloadSize - pCmd->LargeInputPayloadSize - sizeof(PbrPassThruResp),
-      pCmd->OutPayload,
-      pCmd->OutputPayloadSize);
+    CopyMem_S((VOID*)((UINTN)pData + CurDataPos),
+      DataSize - CurDataPos,
+      &OutputBlobIndex,
+      sizeof(OutputBlobIndex));
+    CurDataPos += sizeof(OutputBlobIndex);
   }
 
   if (pCmd->LargeOutputPayloadSize)
   {
-    CopyMem_S((VOID*)((UINTN)pData + sizeof(PbrPassThruReq) + pCmd->InputPayloadSize + pCmd->LargeInputPayloadSize + sizeof(PbrPassThruResp) + pCmd->OutputPayloadSize),
-      DataSize - sizeof(PbrPassThruReq) - pCmd->InputPayloadSize - pCmd->LargeInputPayloadSize - sizeof(PbrPassThruResp) - pCmd->OutputPayloadSize,
-      pCmd->LargeOutputPayload,
-      pCmd->LargeOutputPayloadSize);
+    CopyMem_S((VOID*)((UINTN)pData + CurDataPos),
+      DataSize - CurDataPos,
+      &LargeOutputBlobIndex,
+      sizeof(LargeOutputBlobIndex));
   }
+  //the record is complete, stream it right away so it survives the process
+  PbrFlushSession();
   return ReturnCode;
 }
 
@@ -355,6 +1208,7 @@ PbrSetTableRecord(
     NVDIMM_ERR("Failed to set partition data (signature: %d)\n", Signature);
     goto Finish;
   }
+  PbrFlushSession();
 Finish:
   return ReturnCode;
 }
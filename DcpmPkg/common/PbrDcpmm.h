@@ -23,13 +23,33 @@
 #define PBR_NFIT_SIG                      SIGNATURE_32('P', 'B', 'N', 'F')
 #define PBR_PCAT_SIG                      SIGNATURE_32('P', 'B', 'P', 'C')
 #define PBR_PMTT_SIG                      SIGNATURE_32('P', 'B', 'P', 'M')
+#define PBR_PAYLOAD_SIG                   SIGNATURE_32('P', 'B', 'P', 'L')
 
 #define PBR_FILE_DESCRIPTION              "Intel(R) Optane(TM) DC Persistent Memory Recording File."
+//recordings made before latency capture carry this placeholder instead of the latency
+#define PBR_PASS_THRU_LATENCY_UNKNOWN     0xDEADBEEF
+
+#define INI_PREFERENCES_PBR_PLAYBACK_DELAY_SCALE  L"PBR_PLAYBACK_DELAY_SCALE"
+#define INI_PREFERENCES_PBR_PLAYBACK_ORDER        L"PBR_PLAYBACK_ORDER"
+#define INI_PREFERENCES_PBR_PLAYBACK_REPEAT       L"PBR_PLAYBACK_REPEAT"
+#define INI_PREFERENCES_PBR_PLAYBACK_MISSING      L"PBR_PLAYBACK_MISSING"
+#define INI_PREFERENCES_PBR_RECORD_COMPRESSION    L"PBR_RECORD_COMPRESSION"
+
+//PBR_PLAYBACK_ORDER values
+#define PBR_PLAYBACK_ORDER_RECORDED       0   //!< Replay passthroughs strictly in recorded order
+#define PBR_PLAYBACK_ORDER_KEYED          1   //!< Match passthroughs on DIMM, opcode, subopcode and input payload
+//PBR_PLAYBACK_REPEAT values, used once the recorded responses of a key are consumed
+#define PBR_PLAYBACK_REPEAT_LAST          0   //!< Keep returning the last recorded response
+#define PBR_PLAYBACK_REPEAT_CYCLE         1   //!< Start over with the first recorded response
+#define PBR_PLAYBACK_REPEAT_FAIL          2   //!< Fail the passthrough
+//PBR_PLAYBACK_MISSING values, used when nothing was recorded for a key
+#define PBR_PLAYBACK_MISSING_FAIL         0   //!< Fail the passthrough
+#define PBR_PLAYBACK_MISSING_ANY_INPUT    1   //!< Use a response recorded for the same DIMM, opcode and subopcode
 #define PBR_DRIVER_INIT_TAG_DESCRIPTION   L"driver: initialization"
 
 /**passthru data struct that is used within the passthru partition**/
 typedef struct _PbrPassThruReq {
-  UINT64  TotalMilliseconds;                                  //!< Duration of the PT request
+  UINT64  TotalMicroseconds;                                  //!< Latency of the PT request, from issue to completion
   UINT32  DimmId;                                             //!< Target DIMM ID
   UINT8   Opcode;                                             //!< FIS Opcode
   UINT8   SubOpcode;                                          //!< FIS SubOpcode
@@ -40,7 +60,7 @@ typedef struct _PbrPassThruReq {
 
 /**passthru data struct that is used within the passthru partition**/
 typedef struct _PbrPassThruResp {
-  UINT64      TotalMilliseconds;                              //!< Duration of the PT response
+  UINT64      TotalMilliseconds;                              //!< Latency of the PT request in milliseconds
   EFI_STATUS  PassthruReturnCode;                             //!< Return value from the PT adapter layer
   UINT32      DimmId;                                         //!< Target DIMM ID
   UINT32      OutputPayloadSize;                              //!< FIS Output payload size (small payload)
@@ -49,6 +69,21 @@ typedef struct _PbrPassThruResp {
   UINT8       Output[];                                       //!< Payload
 }PbrPassThruResp;
 
+/**
+  payload data struct that is used within the payload partition. Every distinct large input
+  and output payload is stored once. When a session has a payload partition, the small input
+  of each passthrough record is followed by the UINT32 item index of its large input payload,
+  and the response by the index of its output payload and then of its large output payload,
+  instead of the payloads themselves. Sizes of 0 have no index.
+**/
+typedef struct _PbrPayloadBlob {
+  UINT64  Hash;                                               //!< FNV-1a hash of the payload
+  UINT32  Size;                                               //!< Size of the payload
+  UINT32  StoredSize;                                         //!< Size of Data
+  UINT8   Encoding;                                           //!< PBR_PAYLOAD_ENCODING_RAW or PBR_PAYLOAD_ENCODING_LZMA
+  UINT8   Data[];                                             //!< Payload, encoded
+}PbrPayloadBlob;
+
 /**smbios data struct that is used within the smbios partition**/
 typedef struct _PbrSmbiosTableRecord
 {
@@ -63,6 +98,9 @@ typedef struct _PbrSmbiosTableRecord
 
   @param[in] pContext: Pbr context
   @param[in] pCmd: current FW_CMD from the playback buffer
+  @param[out] pReplayMicroseconds: optional, receives the recorded latency to
+              replay instead of stalling for it here, so the caller can stall
+              outside of any lock it holds
 
   @retval EFI_SUCCESS if the table was found and is properly returned.
   @retval EFI_INVALID_PARAMETER if one or more parameters equal NULL.
@@ -71,7 +109,8 @@ EFI_STATUS
 PbrGetPassThruRecord(
   IN    PbrContext *pContext,
   OUT   FW_CMD *pCmd,
-  OUT   EFI_STATUS *pPassThruRc
+  OUT   EFI_STATUS *pPassThruRc,
+  OUT   UINT64 *pReplayMicroseconds OPTIONAL
 );
 
 /**
@@ -79,6 +118,8 @@ PbrGetPassThruRecord(
 
   @param[in] pContext: Pbr context
   @param[in] pCmd: current FW_CMD from the playback buffer
+  @param[in] PassthruReturnCode: return code of the passthrough
+  @param[in] LatencyMicroseconds: time the passthrough took, replayed by playback
 
   @retval EFI_SUCCESS if the table was found and is properly returned.
   @retval EFI_INVALID_PARAMETER if one or more parameters equal NULL.
@@ -87,7 +128,8 @@ EFI_STATUS
 PbrSetPassThruRecord(
   IN    PbrContext *pContext,
   OUT   FW_CMD *pCmd,
-  EFI_STATUS PassthruReturnCode
+  EFI_STATUS PassthruReturnCode,
+  IN    UINT64 LatencyMicroseconds
 );
 
 
@@ -130,6 +172,9 @@ PbrSetTableRecord(
 
   @param[in] pContext: Pbr context
   @param[in] pCmd: current FW_CMD from the playback buffer
+  @param[out] pReplayMicroseconds: optional, receives the recorded latency to
+              replay instead of stalling for it here, so the caller can stall
+              outside of any lock it holds
 
   @retval EFI_SUCCESS if the table was found and is properly returned.
   @retval EFI_INVALID_PARAMETER if one or more parameters equal NULL.
@@ -138,7 +183,8 @@ EFI_STATUS
 PbrGetPassThruRecord(
   IN    PbrContext *pContext,
   OUT   FW_CMD *pCmd,
-  OUT   EFI_STATUS *pPassThruRc
+  OUT   EFI_STATUS *pPassThruRc,
+  OUT   UINT64 *pReplayMicroseconds OPTIONAL
 );
 
 /**
@@ -146,6 +192,8 @@ PbrGetPassThruRecord(
 
   @param[in] pContext: Pbr context
   @param[in] pCmd: current FW_CMD from the playback buffer
+  @param[in] PassthruReturnCode: return code of the passthrough
+  @param[in] LatencyMicroseconds: time the passthrough took, replayed by playback
 
   @retval EFI_SUCCESS if the table was found and is properly returned.
   @retval EFI_INVALID_PARAMETER if one or more parameters equal NULL.
@@ -154,7 +202,8 @@ EFI_STATUS
 PbrSetPassThruRecord(
   IN    PbrContext *pContext,
   OUT   FW_CMD *pCmd,
-  EFI_STATUS PassthruReturnCode
+  EFI_STATUS PassthruReturnCode,
+  IN    UINT64 LatencyMicroseconds
 );
 
 
@@ -192,4 +241,20 @@ PbrSetTableRecord(
   IN    UINT32 TableSize
 );
 
+/**
+  Restart keyed passthrough playback at the current playback offset.
+  Called whenever the session is reset to a tag.
+**/
+VOID
+PbrResetPassThruIndex(
+);
+
+/**
+  Free the keyed passthrough playback index and the payload store lookup.
+  Called whenever the session data is freed or replaced.
+**/
+VOID
+PbrFreePassThruIndex(
+);
+
 #endif //_PBR_DCPMM_H_
@@ -8,6 +8,7 @@
 #include <Debug.h>
 #include <Types.h>
 #include <Convert.h>
+#include <Utility.h>
 #include "PbrOs.h"
 #include "PbrDcpmm.h"
 #include <os.h>
@@ -29,17 +30,41 @@ extern int registry_read(const char *key, unsigned int *dword_val, unsigned int
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #define _read read
 #define _getch getchar
 #endif
 
 #define PBR_CTX_FILE_NAME         "pbr_ctx.tmp"
 #define PBR_MAIN_FILE_NAME        "pbr_main.tmp"
+#define PBR_STREAM_FILE_NAME      "pbr_stream.tmp"
 #define FILE_READ_OPTS            "rb"
 #define FILE_WRITE_OPTS           "wb"
+#define FILE_APPEND_OPTS          "ab"
 
 VOID SerializePbrMode(UINT32 mode);
 VOID DeserializePbrMode(UINT32 *pMode, UINT32 defaultMode);
+STATIC VOID PbrLogConfigure();
+STATIC VOID PbrLogSegmentName(UINT32 SegmentNumber, CHAR8 *pName, UINT32 NameSize);
+STATIC EFI_STATUS PbrLogCreateSegment(UINT32 SegmentNumber);
+STATIC EFI_STATUS PbrLogOpen();
+STATIC BOOLEAN PbrLogSegmentExists(UINT32 SegmentNumber);
+STATIC VOID PbrLogCloseSegment();
+
+extern EFI_GUID gIntelDimmPbrVariableGuid;
+
+//record log segment being appended to, see gPbrStreamContext for its number and size
+STATIC FILE *mLogFile = NULL;
+STATIC UINT8 *mLogFrameBuffer = NULL;
+STATIC UINT32 mLogFrameBufferSize = 0;
+STATIC BOOLEAN mLogConfigured = FALSE;
+STATIC BOOLEAN mLogEnabled = FALSE;
+STATIC UINT32 mLogSegmentSize = 0;
+
+//session file loaded by PbrSetSessionFile, partitions of the loaded session point into it
+STATIC VOID *mSessionImage = NULL;
+STATIC UINT32 mSessionImageSize = 0;
 
 /**Memory buffer serialization**/
 #define SerializeBuffer(file, buffer, size) \
@@ -125,6 +150,8 @@ EFI_STATUS PbrSerializeCtx(
   char pbr_dir[100];
   char pbr_filename[100];
   UINT32 CtxIndex = 0;
+  PbrPartitionIndex *pIndex = NULL;
+  PbrPartitionStream *pStream = NULL;
 
   if (NULL == ctx) {
     NVDIMM_DBG("ctx is null\n");
@@ -144,9 +171,36 @@ EFI_STATUS PbrSerializeCtx(
 
   for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
     if (PBR_INVALID_SIG != ctx->PartitionContexts[CtxIndex].PartitionSig) {
-      AsciiSPrint(pbr_filename, sizeof(pbr_filename), "%x.pbr", ctx->PartitionContexts[CtxIndex].PartitionSig);
-      AsciiSPrint(pbr_dir, sizeof(pbr_dir), "%s%s", PBR_TMP_DIR, pbr_filename);
-      SerializeBuffer(pbr_dir, ctx->PartitionContexts[CtxIndex].PartitionData, ctx->PartitionContexts[CtxIndex].PartitionSize);
+      pIndex = &gPbrPartitionIndexes[CtxIndex];
+      //a mapped partition is unchanged since it was loaded, rewriting the file would pull it from under the mapping
+      //partitions in the session image are written, later processes map their files
+      if (0 == pIndex->DataMapSize || pIndex->PartitionData != ctx->PartitionContexts[CtxIndex].PartitionData ||
+        PbrInSessionImage(pIndex->PartitionData)) {
+        AsciiSPrint(pbr_filename, sizeof(pbr_filename), "%x.pbr", ctx->PartitionContexts[CtxIndex].PartitionSig);
+        AsciiSPrint(pbr_dir, sizeof(pbr_dir), "%s%s", PBR_TMP_DIR, pbr_filename);
+        SerializeBuffer(pbr_dir, ctx->PartitionContexts[CtxIndex].PartitionData, ctx->PartitionContexts[CtxIndex].PartitionSize);
+      }
+      //item offsets, so the next process can do indexed gets without walking the partition
+      if (0 == pIndex->ItemOffsetsMapSize || PbrInSessionImage(pIndex->pItemOffsets)) {
+        AsciiSPrint(pbr_filename, sizeof(pbr_filename), "%x.idx", ctx->PartitionContexts[CtxIndex].PartitionSig);
+        AsciiSPrint(pbr_dir, sizeof(pbr_dir), "%s%s", PBR_TMP_DIR, pbr_filename);
+        pIndex = PbrGetPartitionIndex(CtxIndex);
+        pStream = &gPbrStreamContext.Partitions[CtxIndex];
+        if (NULL != pIndex && pIndex->ItemCnt > 0 &&
+          pIndex->ItemCnt == ctx->PartitionContexts[CtxIndex].PartitionLogicalDataCnt - pStream->ReleasedCnt) {
+          SerializeBuffer(pbr_dir, pIndex->pItemOffsets, pIndex->ItemCnt * sizeof(UINT32));
+        }
+        else {
+          remove(pbr_dir);
+        }
+      }
+      //record log locations of the streamed items, released items are only found through them
+      pStream = &gPbrStreamContext.Partitions[CtxIndex];
+      if (NULL != pStream->pLocations && pStream->StreamedCnt > 0) {
+        AsciiSPrint(pbr_filename, sizeof(pbr_filename), "%x.loc", ctx->PartitionContexts[CtxIndex].PartitionSig);
+        AsciiSPrint(pbr_dir, sizeof(pbr_dir), "%s%s", PBR_TMP_DIR, pbr_filename);
+        SerializeBuffer(pbr_dir, pStream->pLocations, pStream->StreamedCnt * sizeof(UINT64));
+      }
     }
   }
 
@@ -154,6 +208,8 @@ EFI_STATUS PbrSerializeCtx(
   SerializeBuffer(PBR_TMP_DIR PBR_CTX_FILE_NAME, ctx, sizeof(PbrContext));
   /**Serialize the PBR main header**/
   SerializeBuffer(PBR_TMP_DIR PBR_MAIN_FILE_NAME, ctx->PbrMainHeader, sizeof(PbrHeader));
+  /**Serialize the record log state**/
+  SerializeBuffer(PBR_TMP_DIR PBR_STREAM_FILE_NAME, &gPbrStreamContext, sizeof(PbrStreamContext));
 
 Finish:
   if (pFile) {
@@ -177,6 +233,9 @@ EFI_STATUS PbrDeserializeCtx(
   char pbr_dir[100];
   char pbr_filename[100];
   UINT32 CtxIndex = 0;
+  UINT32 IndexSize = 0;
+  PbrPartitionIndex *pIndex = NULL;
+  PbrPartitionStream *pStream = NULL;
 
   if (NULL == ctx) {
     NVDIMM_DBG("ctx is null\n");
@@ -218,11 +277,67 @@ EFI_STATUS PbrDeserializeCtx(
 
   DeserializeBuffer(PBR_TMP_DIR PBR_MAIN_FILE_NAME, ctx->PbrMainHeader, sizeof(PbrHeader));
 
+  /**Deserialize the record log state, nothing is streamed if it is missing**/
+  ZeroMem(&gPbrStreamContext, sizeof(gPbrStreamContext));
+  if (0 == os_fopen(&pFile, PBR_TMP_DIR PBR_STREAM_FILE_NAME, FILE_READ_OPTS) && NULL != pFile) {
+    if (1 != fread(&gPbrStreamContext, sizeof(PbrStreamContext), 1, pFile)) {
+      NVDIMM_DBG("Failed to read the PBR record log state\n");
+      ZeroMem(&gPbrStreamContext, sizeof(gPbrStreamContext));
+    }
+    fclose(pFile);
+  }
+  pFile = NULL;
+
   for (CtxIndex = 0; CtxIndex < MAX_PARTITIONS; ++CtxIndex) {
+    pIndex = &gPbrPartitionIndexes[CtxIndex];
+    ZeroMem(pIndex, sizeof(*pIndex));
+    pStream = &gPbrStreamContext.Partitions[CtxIndex];
+    pStream->pLocations = NULL;
+    pStream->LocationCapacity = 0;
+    if (PBR_INVALID_SIG == ctx->PartitionContexts[CtxIndex].PartitionSig) {
+      ZeroMem(pStream, sizeof(*pStream));
+    }
+    else if (pStream->StreamedCnt > 0) {
+      AsciiSPrint(pbr_filename, sizeof(pbr_filename), "%x.loc", ctx->PartitionContexts[CtxIndex].PartitionSig);
+      AsciiSPrint(pbr_dir, sizeof(pbr_dir), "%s%s", PBR_TMP_DIR, pbr_filename);
+      DeserializeBufferEx(pbr_dir, pStream->pLocations, pStream->StreamedCnt * sizeof(UINT64));
+      if (NULL != pStream->pLocations) {
+        pStream->LocationCapacity = pStream->StreamedCnt;
+      }
+      else {
+        //items still in memory are streamed again, the loader keeps the last copy
+        //released items can no longer be read back, location 0 is never a frame
+        NVDIMM_ERR("PBR record log locations of partition 0x%x are missing\n", ctx->PartitionContexts[CtxIndex].PartitionSig);
+        pStream->StreamedCnt = pStream->ReleasedCnt;
+        if (pStream->ReleasedCnt > 0) {
+          pStream->pLocations = AllocateZeroPool(pStream->ReleasedCnt * sizeof(UINT64));
+          pStream->LocationCapacity = (NULL != pStream->pLocations) ? pStream->ReleasedCnt : 0;
+        }
+      }
+    }
     if (PBR_INVALID_SIG != ctx->PartitionContexts[CtxIndex].PartitionSig) {
       AsciiSPrint(pbr_filename, sizeof(pbr_filename), "%x.pbr", ctx->PartitionContexts[CtxIndex].PartitionSig);
       AsciiSPrint(pbr_dir, sizeof(pbr_dir), "%s%s", PBR_TMP_DIR, pbr_filename);
-      DeserializeBufferEx(pbr_dir, ctx->PartitionContexts[CtxIndex].PartitionData, ctx->PartitionContexts[CtxIndex].PartitionSize);
+      ctx->PartitionContexts[CtxIndex].PartitionData = NULL;
+      //playback only reads the partitions, use the files in place instead of copying them
+      if (PBR_PLAYBACK_MODE == PbrMode) {
+        ctx->PartitionContexts[CtxIndex].PartitionData = PbrMapFile(pbr_dir, ctx->PartitionContexts[CtxIndex].PartitionSize);
+      }
+      if (NULL != ctx->PartitionContexts[CtxIndex].PartitionData) {
+        pIndex->PartitionData = ctx->PartitionContexts[CtxIndex].PartitionData;
+        pIndex->DataMapSize = ctx->PartitionContexts[CtxIndex].PartitionSize;
+        AsciiSPrint(pbr_filename, sizeof(pbr_filename), "%x.idx", ctx->PartitionContexts[CtxIndex].PartitionSig);
+        AsciiSPrint(pbr_dir, sizeof(pbr_dir), "%s%s", PBR_TMP_DIR, pbr_filename);
+        IndexSize = ctx->PartitionContexts[CtxIndex].PartitionLogicalDataCnt * sizeof(UINT32);
+        pIndex->pItemOffsets = (UINT32 *)PbrMapFile(pbr_dir, IndexSize);
+        if (NULL != pIndex->pItemOffsets) {
+          pIndex->ItemCnt = pIndex->ItemCapacity = ctx->PartitionContexts[CtxIndex].PartitionLogicalDataCnt;
+          pIndex->ItemOffsetsMapSize = IndexSize;
+        }
+      }
+      else {
+        DeserializeBufferEx(pbr_dir, ctx->PartitionContexts[CtxIndex].PartitionData, ctx->PartitionContexts[CtxIndex].PartitionSize);
+      }
     }
   }
 
@@ -315,4 +430,463 @@ VOID DeserializePbrMode(
 #endif
 }
 
+/**
+  Helper that maps a serialized pbr file read-only.  Partitions are moved to the heap
+  before they are modified.
+**/
+VOID *PbrMapFile(
+  CONST CHAR8 *pFileName,
+  UINT32 Size
+)
+{
+#if _MSC_VER
+  //partitions are read into memory on Windows
+  return NULL;
+#else
+  int Fd = -1;
+  struct stat FileStat;
+  VOID *pAddress = NULL;
+
+  if (NULL == pFileName || 0 == Size) {
+    return NULL;
+  }
+
+  Fd = open(pFileName, O_RDONLY);
+  if (Fd < 0) {
+    return NULL;
+  }
+  if (0 == fstat(Fd, &FileStat) && FileStat.st_size >= (off_t)Size) {
+    pAddress = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, Fd, 0);
+    if (MAP_FAILED == pAddress) {
+      NVDIMM_DBG("Failed to map the PBR file: %s\n", pFileName);
+      pAddress = NULL;
+    }
+  }
+  close(Fd);
+  return pAddress;
+#endif
+}
+
+/**
+  Helper that maps a whole session image file read-only, so a loaded session is
+  played back from the file instead of a copy of it
+**/
+VOID *PbrMapSessionImage(
+  CONST CHAR8 *pFileName,
+  UINT32 *pSize
+)
+{
+#if _MSC_VER
+  //session images are read into memory on Windows
+  return NULL;
+#else
+  int Fd = -1;
+  struct stat FileStat;
+  VOID *pAddress = NULL;
+
+  if (NULL == pFileName || NULL == pSize) {
+    return NULL;
+  }
+
+  PbrUnmapSessionImage();
+  Fd = open(pFileName, O_RDONLY);
+  if (Fd < 0) {
+    return NULL;
+  }
+  if (0 == fstat(Fd, &FileStat) && FileStat.st_size > 0 && (UINT64)FileStat.st_size <= MAX_UINT32) {
+    pAddress = mmap(NULL, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, Fd, 0);
+    if (MAP_FAILED == pAddress) {
+      NVDIMM_DBG("Failed to map the PBR session image: %s\n", pFileName);
+      pAddress = NULL;
+    }
+    else {
+      mSessionImage = pAddress;
+      mSessionImageSize = (UINT32)FileStat.st_size;
+      *pSize = mSessionImageSize;
+    }
+  }
+  close(Fd);
+  return pAddress;
+#endif
+}
+
+/**
+  Helper that unmaps the session image mapped by PbrMapSessionImage
+**/
+VOID PbrUnmapSessionImage(
+)
+{
+#if !_MSC_VER
+  if (NULL != mSessionImage) {
+    munmap(mSessionImage, mSessionImageSize);
+  }
+#endif
+  mSessionImage = NULL;
+  mSessionImageSize = 0;
+}
+
+/**
+  Helper that checks whether an address is within the mapped session image
+**/
+BOOLEAN PbrInSessionImage(
+  CONST VOID *pAddress
+)
+{
+  return (NULL != mSessionImage && (UINTN)pAddress >= (UINTN)mSessionImage &&
+    (UINTN)pAddress < (UINTN)mSessionImage + mSessionImageSize);
+}
+
+/**
+  Helper that unmaps a file mapped by PbrMapFile. Partitions and index tables that
+  point into the session image go away with the image.
+**/
+VOID PbrUnmapFile(
+  VOID *pAddress,
+  UINT32 Size
+)
+{
+#if !_MSC_VER
+  if (NULL != pAddress && !PbrInSessionImage(pAddress)) {
+    munmap(pAddress, Size);
+  }
+#endif
+}
+
+/**
+  Helper that reads the record log configuration from the ini preferences, once
+**/
+STATIC
+VOID
+PbrLogConfigure(
+)
+{
+  UINT32 Value = 0;
+  UINTN Size = sizeof(Value);
+
+  if (mLogConfigured) {
+    return;
+  }
+  mLogConfigured = TRUE;
+
+  if (!EFI_ERROR(GET_VARIABLE(INI_PREFERENCES_PBR_RECORD_STREAM, gIntelDimmPbrVariableGuid, &Size, &Value)) && 1 == Value) {
+    mLogEnabled = TRUE;
+  }
+
+  Value = 0;
+  Size = sizeof(Value);
+  if (EFI_ERROR(GET_VARIABLE(INI_PREFERENCES_PBR_RECORD_SEGMENT_SIZE, gIntelDimmPbrVariableGuid, &Size, &Value)) ||
+    0 == Value || Value > PBR_LOG_SEGMENT_SIZE_MAX) {
+    Value = PBR_LOG_SEGMENT_SIZE_DEFAULT;
+  }
+  mLogSegmentSize = Value * 1024 * 1024;
+}
+
+/**
+  Check the ini configuration whether recordings are streamed to the record log.
+  The configuration is read only on the first call.
+**/
+BOOLEAN
+PbrLogEnabled(
+)
+{
+  PbrLogConfigure();
+  return mLogEnabled;
+}
 
+/**
+  Helper that provides the file name of a record log segment
+**/
+STATIC
+VOID
+PbrLogSegmentName(
+  UINT32 SegmentNumber,
+  CHAR8 *pName,
+  UINT32 NameSize
+)
+{
+  AsciiSPrint(pName, NameSize, PBR_TMP_DIR PBR_LOG_SEGMENT_FILE_PREFIX "%04u" PBR_LOG_SEGMENT_FILE_SUFFIX, SegmentNumber);
+}
+
+/**
+  Helper that starts a new record log segment and makes it the one appended to
+**/
+STATIC
+EFI_STATUS
+PbrLogCreateSegment(
+  UINT32 SegmentNumber
+)
+{
+  PbrLogSegmentHeader Header;
+  char SegmentName[100];
+
+  PbrLogCloseSegment();
+  ZeroMem(&Header, sizeof(Header));
+  Header.Signature = PBR_LOG_SEGMENT_SIG;
+  Header.Version = PBR_LOG_VERSION;
+  Header.HeaderSize = sizeof(Header);
+  Header.SegmentNumber = SegmentNumber;
+  ChecksumOperations(&Header, sizeof(Header), &Header.Checksum, TRUE);
+
+  PbrLogSegmentName(SegmentNumber, SegmentName, sizeof(SegmentName));
+  if (0 != os_fopen(&mLogFile, SegmentName, FILE_WRITE_OPTS) || NULL == mLogFile) {
+    NVDIMM_ERR("Failed to open the PBR file: %s\n", SegmentName);
+    mLogFile = NULL;
+    return EFI_DEVICE_ERROR;
+  }
+  if (1 != fwrite(&Header, sizeof(Header), 1, mLogFile) || 0 != fflush(mLogFile)) {
+    NVDIMM_ERR("Failed to write the PBR file: %s\n", SegmentName);
+    PbrLogCloseSegment();
+    return EFI_DEVICE_ERROR;
+  }
+  gPbrStreamContext.SegmentNumber = SegmentNumber;
+  gPbrStreamContext.SegmentOffset = sizeof(Header);
+  return EFI_SUCCESS;
+}
+
+/**
+  Helper that checks whether a record log segment file exists
+**/
+STATIC
+BOOLEAN
+PbrLogSegmentExists(
+  UINT32 SegmentNumber
+)
+{
+  FILE *pFile = NULL;
+  char SegmentName[100];
+
+  PbrLogSegmentName(SegmentNumber, SegmentName, sizeof(SegmentName));
+  if (0 != os_fopen(&pFile, SegmentName, FILE_READ_OPTS) || NULL == pFile) {
+    return FALSE;
+  }
+  fclose(pFile);
+  return TRUE;
+}
+
+/**
+  Helper that opens the record log segment a previous process of the session appended to.
+  If the log grew since that process saved the session, it died after writing more
+  frames. Those stay in place for the loader and recording continues in a new segment
+  after them.
+**/
+STATIC
+EFI_STATUS
+PbrLogOpen(
+)
+{
+  char SegmentName[100];
+  long SegmentSize = 0;
+  UINT32 SegmentNumber = gPbrStreamContext.SegmentNumber;
+
+  if (0 == gPbrStreamContext.SegmentOffset) {
+    return PbrLogCreateSegment(SegmentNumber);
+  }
+
+  PbrLogSegmentName(SegmentNumber, SegmentName, sizeof(SegmentName));
+  if (0 == os_fopen(&mLogFile, SegmentName, FILE_APPEND_OPTS) && NULL != mLogFile) {
+    fseek(mLogFile, 0L, SEEK_END);
+    SegmentSize = ftell(mLogFile);
+    if (SegmentSize == (long)gPbrStreamContext.SegmentOffset && !PbrLogSegmentExists(SegmentNumber + 1)) {
+      return EFI_SUCCESS;
+    }
+  }
+  NVDIMM_WARN("PBR record log segment %d was not closed cleanly\n", SegmentNumber);
+  do {
+    ++SegmentNumber;
+  } while (PbrLogSegmentExists(SegmentNumber));
+  return PbrLogCreateSegment(SegmentNumber);
+}
+
+/**
+  Append a logical data item to the record log. Every frame is flushed to the file
+  before returning, so a recording survives the process dying.
+**/
+EFI_STATUS
+PbrLogAppend(
+  UINT32 PartitionSig,
+  UINT32 LogicalIndex,
+  UINT32 Flags,
+  VOID *pData,
+  UINT32 Size,
+  UINT64 *pLocation
+)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  PbrLogFrame *pFrame = NULL;
+  UINT64 FrameSize = sizeof(PbrLogFrame) + ALIGN_VALUE((UINT64)Size, PBR_LOG_ALIGNMENT);
+
+  PbrLogConfigure();
+  //segment offsets are UINT32
+  if (FrameSize > MAX_UINT32 - sizeof(PbrLogSegmentHeader)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  if (FrameSize > mLogFrameBufferSize) {
+    FREE_POOL_SAFE(mLogFrameBuffer);
+    mLogFrameBufferSize = 0;
+    mLogFrameBuffer = AllocatePool((UINTN)FrameSize);
+    if (NULL == mLogFrameBuffer) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    mLogFrameBufferSize = (UINT32)FrameSize;
+  }
+  pFrame = (PbrLogFrame *)mLogFrameBuffer;
+  ZeroMem(pFrame, (UINTN)FrameSize);
+  pFrame->Signature = PBR_LOG_FRAME_SIG;
+  pFrame->PartitionSig = PartitionSig;
+  pFrame->LogicalIndex = LogicalIndex;
+  pFrame->Size = Size;
+  pFrame->Flags = Flags;
+  if (0 != Size) {
+    CopyMem_S(pFrame + 1, Size, pData, Size);
+  }
+  ChecksumOperations(pFrame, FrameSize, &pFrame->Checksum, TRUE);
+
+  if (NULL == mLogFile) {
+    ReturnCode = PbrLogOpen();
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+  }
+  //a frame larger than a segment gets a segment of its own
+  if (gPbrStreamContext.SegmentOffset > sizeof(PbrLogSegmentHeader) &&
+    gPbrStreamContext.SegmentOffset + FrameSize > mLogSegmentSize) {
+    ReturnCode = PbrLogCreateSegment(gPbrStreamContext.SegmentNumber + 1);
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+  }
+  if ((UINT64)gPbrStreamContext.SegmentOffset + FrameSize > MAX_UINT32) {
+    ReturnCode = PbrLogCreateSegment(gPbrStreamContext.SegmentNumber + 1);
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+  }
+
+  //a failed write leaves the segment longer than recorded, the next append starts a new one
+  if (1 != fwrite(pFrame, (size_t)FrameSize, 1, mLogFile) || 0 != fflush(mLogFile)) {
+    NVDIMM_ERR("Failed to append to PBR record log segment %d\n", gPbrStreamContext.SegmentNumber);
+    PbrLogCloseSegment();
+    return EFI_DEVICE_ERROR;
+  }
+  if (NULL != pLocation) {
+    *pLocation = PBR_LOG_LOCATION(gPbrStreamContext.SegmentNumber, gPbrStreamContext.SegmentOffset);
+  }
+  gPbrStreamContext.SegmentOffset += (UINT32)FrameSize;
+  return ReturnCode;
+}
+
+/**
+  Read a logical data item back from the record log, verifying its frame.
+**/
+EFI_STATUS
+PbrLogRead(
+  UINT64 Location,
+  UINT32 PartitionSig,
+  UINT32 LogicalIndex,
+  VOID **ppData,
+  UINT32 *pSize
+)
+{
+  EFI_STATUS ReturnCode = EFI_COMPROMISED_DATA;
+  FILE *pFile = NULL;
+  PbrLogFrame Frame;
+  PbrLogFrame *pFrame = NULL;
+  UINT64 FrameSize = 0;
+  char SegmentName[100];
+
+  if (NULL == ppData || NULL == pSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  PbrLogSegmentName(PBR_LOG_LOCATION_SEGMENT(Location), SegmentName, sizeof(SegmentName));
+  if (0 != os_fopen(&pFile, SegmentName, FILE_READ_OPTS) || NULL == pFile) {
+    NVDIMM_ERR("Failed to open the PBR file: %s\n", SegmentName);
+    return EFI_NOT_FOUND;
+  }
+  if (0 != fseek(pFile, (long)PBR_LOG_LOCATION_OFFSET(Location), SEEK_SET) ||
+    1 != fread(&Frame, sizeof(Frame), 1, pFile) ||
+    PBR_LOG_FRAME_SIG != Frame.Signature ||
+    PartitionSig != Frame.PartitionSig ||
+    LogicalIndex != Frame.LogicalIndex) {
+    goto Finish;
+  }
+
+  FrameSize = sizeof(PbrLogFrame) + ALIGN_VALUE((UINT64)Frame.Size, PBR_LOG_ALIGNMENT);
+  pFrame = AllocatePool((UINTN)FrameSize);
+  if (NULL == pFrame) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    goto Finish;
+  }
+  CopyMem_S(pFrame, sizeof(PbrLogFrame), &Frame, sizeof(PbrLogFrame));
+  if ((FrameSize > sizeof(PbrLogFrame) && 1 != fread(pFrame + 1, (size_t)(FrameSize - sizeof(PbrLogFrame)), 1, pFile)) ||
+    !ChecksumOperations(pFrame, FrameSize, &pFrame->Checksum, FALSE)) {
+    goto Finish;
+  }
+
+  *ppData = AllocatePool(Frame.Size);
+  if (NULL == *ppData) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    goto Finish;
+  }
+  CopyMem_S(*ppData, Frame.Size, pFrame + 1, Frame.Size);
+  *pSize = Frame.Size;
+  ReturnCode = EFI_SUCCESS;
+
+Finish:
+  if (EFI_COMPROMISED_DATA == ReturnCode) {
+    NVDIMM_ERR("Bad PBR record log frame in %s at offset %d\n", SegmentName, PBR_LOG_LOCATION_OFFSET(Location));
+  }
+  FREE_POOL_SAFE(pFrame);
+  fclose(pFile);
+  return ReturnCode;
+}
+
+/**
+  Helper that closes the segment file being appended to
+**/
+STATIC
+VOID
+PbrLogCloseSegment(
+)
+{
+  if (NULL != mLogFile) {
+    fclose(mLogFile);
+    mLogFile = NULL;
+  }
+}
+
+/**
+  Close the segment file being appended to
+**/
+VOID
+PbrLogClose(
+)
+{
+  PbrLogCloseSegment();
+  FREE_POOL_SAFE(mLogFrameBuffer);
+  mLogFrameBufferSize = 0;
+}
+
+/**
+  Delete the record log and its saved state, a new session starts a new log
+**/
+VOID
+PbrLogReset(
+)
+{
+  char SegmentName[100];
+  UINT32 SegmentNumber = 0;
+
+  PbrLogClose();
+  //segments are numbered without gaps
+  for (SegmentNumber = 0; ; ++SegmentNumber) {
+    PbrLogSegmentName(SegmentNumber, SegmentName, sizeof(SegmentName));
+    if (0 != remove(SegmentName)) {
+      break;
+    }
+  }
+  remove(PBR_TMP_DIR PBR_STREAM_FILE_NAME);
+  gPbrStreamContext.SegmentNumber = 0;
+  gPbrStreamContext.SegmentOffset = 0;
+}
@@ -11,5 +11,78 @@
 
 EFI_STATUS PbrSerializeCtx(PbrContext *ctx, BOOLEAN Force);
 EFI_STATUS PbrDeserializeCtx(PbrContext * ctx);
+PbrPartitionIndex *PbrGetPartitionIndex(UINT32 CtxIndex);
+
+/**
+  Map a serialized partition or index file read-only, so playback can use it in place.
+  Returns NULL if the file is smaller than Size or mapping is not supported.
+**/
+VOID *PbrMapFile(CONST CHAR8 *pFileName, UINT32 Size);
+VOID PbrUnmapFile(VOID *pAddress, UINT32 Size);
+
+/**
+  Map a whole session image file read-only, replacing the image mapped before. The
+  mapping stays until PbrUnmapSessionImage, PbrUnmapFile skips addresses within it.
+  Returns NULL if the file is empty, larger than MAX_UINT32 or mapping is not supported.
+**/
+VOID *PbrMapSessionImage(CONST CHAR8 *pFileName, UINT32 *pSize);
+VOID PbrUnmapSessionImage();
+BOOLEAN PbrInSessionImage(CONST VOID *pAddress);
+
+#define INI_PREFERENCES_PBR_RECORD_STREAM         L"PBR_RECORD_STREAM"
+#define INI_PREFERENCES_PBR_RECORD_SEGMENT_SIZE   L"PBR_RECORD_SEGMENT_SIZE"
+
+#define PBR_LOG_SEGMENT_FILE_PREFIX   "pbr_log_"
+#define PBR_LOG_SEGMENT_FILE_SUFFIX   ".seg"
+#define PBR_LOG_SEGMENT_SIZE_DEFAULT  64    //!< MiB
+#define PBR_LOG_SEGMENT_SIZE_MAX      1024  //!< MiB, keeps segment offsets within a UINT32
+
+/**
+  Check the ini configuration whether recordings are streamed to the record log.
+  The configuration is read only on the first call.
+**/
+BOOLEAN PbrLogEnabled();
+
+/**
+  Append a logical data item to the record log. Every frame is flushed to the file
+  before returning, so a recording survives the process dying.
+
+  @param[in] PartitionSig: partition the item belongs to
+  @param[in] LogicalIndex: index of the item within the partition
+  @param[in] Flags: PBR_LOG_FRAME_SINGLETON or 0
+  @param[in] pData: item data
+  @param[in] Size: size of pData
+  @param[out] pLocation: record log location of the frame, may be NULL
+
+  @retval EFI_SUCCESS on success
+  @retval EFI_OUT_OF_RESOURCES memory allocation failure
+  @retval EFI_DEVICE_ERROR the segment file could not be written
+**/
+EFI_STATUS PbrLogAppend(UINT32 PartitionSig, UINT32 LogicalIndex, UINT32 Flags, VOID *pData, UINT32 Size, UINT64 *pLocation);
+
+/**
+  Read a logical data item back from the record log, verifying its frame.
+
+  @param[in] Location: record log location returned by PbrLogAppend
+  @param[in] PartitionSig: partition the item must belong to
+  @param[in] LogicalIndex: index the item must have
+  @param[out] ppData: newly allocated copy of the item data, caller frees it
+  @param[out] pSize: size of the item data
+
+  @retval EFI_SUCCESS on success
+  @retval EFI_NOT_FOUND the segment file is missing
+  @retval EFI_COMPROMISED_DATA the frame does not match or is corrupted
+**/
+EFI_STATUS PbrLogRead(UINT64 Location, UINT32 PartitionSig, UINT32 LogicalIndex, VOID **ppData, UINT32 *pSize);
+
+/**
+  Close the segment file being appended to
+**/
+VOID PbrLogClose();
+
+/**
+  Delete the record log and its saved state, a new session starts a new log
+**/
+VOID PbrLogReset();
 
 #endif //_PBR_OS_H_
@@ -27,6 +27,16 @@
 #define PBR_HEADER_SIG                        SIGNATURE_32('P', 'B', 'R', 'H')
 #define PBR_TAG_HEADER_SIG                    SIGNATURE_32('P', 'B', 'T', 'H')
 #define PBR_TAG_SIG                           SIGNATURE_32('P', 'B', 'T', 'I')
+#define PBR_IMAGE_SIG                         SIGNATURE_32('P', 'B', 'R', 'I')
+#define PBR_LOG_SEGMENT_SIG                   SIGNATURE_32('P', 'B', 'L', 'S')
+#define PBR_LOG_FRAME_SIG                     SIGNATURE_32('P', 'B', 'L', 'F')
+
+#define PBR_IMAGE_VERSION                     2
+#define PBR_IMAGE_ALIGNMENT                   8
+
+#define PBR_LOG_VERSION                       1
+#define PBR_LOG_ALIGNMENT                     8
+#define PBR_LOG_FRAME_SINGLETON               0x1     //!< Frame replaces the only item of its partition
 
 
 /**set playback/record/normal mode**/
@@ -104,6 +114,102 @@ typedef struct _TagPartitionInfo {
   UINT32 PartitionCurrentOffset;                              //!< Playback or Recording offset of the partition
 }TagPartitionInfo;
 
+/**
+  Version 2 pbr image descriptor. It immediately follows the PbrHeader, which keeps the
+  recording info but has an empty partition table. Version 1 images have the first
+  partition there, which starts with PBR_LOGICAL_DATA_SIG.
+**/
+typedef struct _PbrImageHeader {
+  UINT32 Signature;                                           //!< PBR_IMAGE_SIG
+  UINT32 Version;                                             //!< PBR_IMAGE_VERSION
+  UINT32 HeaderSize;                                          //!< sizeof(PbrImageHeader)
+  UINT32 PartitionCnt;                                        //!< Number of entries in the partition directory
+  UINT32 DirectoryOffset;                                     //!< Offset of the partition directory within the image
+  UINT32 ImageSize;                                           //!< Size in bytes of the whole image
+}PbrImageHeader;
+
+/**
+  Partition directory entry of a version 2 pbr image. The partition data and its item
+  offset table are PBR_IMAGE_ALIGNMENT aligned, so both can be used in place.
+**/
+typedef struct _PbrImagePartitionEntry {
+  UINT32 Signature;                                           //!< Defines the type of partition
+  UINT32 LogicalDataCnt;                                      //!< Number of logical data items within the partition
+  UINT32 DataOffset;                                          //!< Offset of the partition data within the image
+  UINT32 DataSize;                                            //!< Size of the recorded partition data
+  UINT32 IndexOffset;                                         //!< Offset of the UINT32 item offset table within the image
+  UINT32 Reserved;
+}PbrImagePartitionEntry;
+
+/**
+  Item offset index of a partition, one per PartitionContexts slot. It is built when a
+  partition is loaded or first accessed and extended by PbrSetData, so indexed gets
+  do not walk the partition. Not part of the serialized context.
+**/
+typedef struct _PbrPartitionIndex {
+  VOID   *PartitionData;                                      //!< Partition buffer the index describes
+  UINT32 *pItemOffsets;                                       //!< Offset of every logical data item within the partition
+  UINT32 ItemCnt;                                             //!< Number of valid entries in pItemOffsets
+  UINT32 ItemCapacity;                                        //!< Number of entries allocated in pItemOffsets
+  UINT32 DataMapSize;                                         //!< Non zero if PartitionData is a read-only file mapping
+  UINT32 ItemOffsetsMapSize;                                  //!< Non zero if pItemOffsets is a read-only file mapping
+}PbrPartitionIndex;
+
+/**
+  Header at the start of every record log segment. A record log is a series of segment
+  files, each holding PBR_LOG_ALIGNMENT aligned frames that follow this header.
+**/
+typedef struct _PbrLogSegmentHeader {
+  UINT32 Signature;                                           //!< PBR_LOG_SEGMENT_SIG
+  UINT32 Version;                                             //!< PBR_LOG_VERSION
+  UINT32 HeaderSize;                                          //!< sizeof(PbrLogSegmentHeader)
+  UINT32 SegmentNumber;                                       //!< Position of the segment within the log, starts at 0
+  UINT64 Checksum;                                            //!< Fletcher64 over the header
+}PbrLogSegmentHeader;
+
+/**
+  Record log frame, one per recorded logical data item. The item data follows the frame
+  and is zero padded to PBR_LOG_ALIGNMENT.
+**/
+typedef struct _PbrLogFrame {
+  UINT32 Signature;                                           //!< PBR_LOG_FRAME_SIG
+  UINT32 PartitionSig;                                        //!< Partition the item belongs to
+  UINT32 LogicalIndex;                                        //!< Index of the item within the partition
+  UINT32 Size;                                                //!< Size of the item data in bytes
+  UINT32 Flags;                                               //!< PBR_LOG_FRAME_SINGLETON
+  UINT32 Reserved;
+  UINT64 Checksum;                                            //!< Fletcher64 over the frame and the padded data
+}PbrLogFrame;
+
+/**
+  Streaming state of a partition, one per PartitionContexts slot. The first StreamedCnt
+  items are in the record log, the first ReleasedCnt of those are no longer held in memory
+  and the partition data starts with item ReleasedCnt.
+**/
+typedef struct _PbrPartitionStream {
+  UINT32 StreamedCnt;                                         //!< Number of items appended to the record log
+  UINT32 ReleasedCnt;                                         //!< Number of leading items only kept in the record log
+  UINT32 ReleasedSize;                                        //!< Partition bytes the released items took
+  UINT32 LocationCapacity;                                    //!< Number of entries allocated in pLocations
+  BOOLEAN Singleton;                                          //!< Partition holds a singleton item
+  BOOLEAN Dirty;                                              //!< Singleton item changed since it was streamed
+  UINT64 *pLocations;                                         //!< Record log location of every streamed item
+}PbrPartitionStream;
+
+/**record log state of the global context**/
+typedef struct _PbrStreamContext {
+  UINT32 SegmentNumber;                                       //!< Record log segment being appended to
+  UINT32 SegmentOffset;                                       //!< End of the last frame in that segment, 0 if not created yet
+  PbrPartitionStream Partitions[MAX_PARTITIONS];
+}PbrStreamContext;
+
+/**record log locations keep the segment number in the upper and the offset in the lower dword**/
+#define PBR_LOG_LOCATION(Segment, Offset)     (((UINT64)(Segment) << 32) | (UINT32)(Offset))
+#define PBR_LOG_LOCATION_SEGMENT(Location)    ((UINT32)((Location) >> 32))
+#define PBR_LOG_LOCATION_OFFSET(Location)     ((UINT32)(Location))
+
 extern PbrContext gPbrContext;                                //!< extern global context
+extern PbrPartitionIndex gPbrPartitionIndexes[MAX_PARTITIONS];//!< item indexes of the global context partitions
+extern PbrStreamContext gPbrStreamContext;                    //!< record log state of the global context
 #pragma pack(pop)
 #endif //_PBR_TYPES_H_
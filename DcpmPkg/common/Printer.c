@@ -26,6 +26,15 @@
 #define NVM_XML_RESULT_BEGIN              L"<Results>\n<Result>\n"
 #define MVM_XML_RESULT_END                L"</Result>\n</Results>\n"
 
+#define JSON_RESULTS_BEGIN                L"{\"Results\":[\n"
+#define JSON_RESULTS_END                  L"\n]}\n"
+#define JSON_ERROR_BEGIN                  L"{\"Error\":{\"Type\":%d,\"Results\":[\n"
+#define JSON_ERROR_END                    L"\n]}}\n"
+#define JSON_ITEM_DELIM                   L",\n"
+#define JSON_WHITESPACE_IDENT             L" "
+#define JSON_STR_CHUNK_LEN                128
+#define JSON_ESCAPE_MAX_LEN               6   //\uXXXX
+
 #define TEXT_TABLE_DEFAULT_DELIM          L'|'
 #define TEXT_NEW_LINE                     L"\n"
 #define TEXT_TABLE_HEADER_SEP             L"="
@@ -47,9 +56,15 @@ CHAR16* gNullValueToDisplay = L"NULL";
 typedef enum {
   PRINT_TEXT,
   PRINT_BASIC_XML,
-  PRINT_XML
+  PRINT_XML,
+  PRINT_BASIC_JSON,
+  PRINT_JSON
 }PRINT_MODE;
 
+typedef struct _JSON_NODE_INFO {
+  UINT32 ChildCnt;                  //children printed so far, all but the first are preceded by a delimiter
+}JSON_NODE_INFO;
+
 typedef struct _PRV_TABLE_INFO {
   PRINTER_TABLE_ATTRIB *AllTableAttribs;
   PRINTER_TABLE_ATTRIB *ModifiedTableAttribs;
@@ -942,6 +957,232 @@ static VOID PrintAsXml(DATA_SET_CONTEXT *DataSetCtx, PRINT_CONTEXT *PrintCtx) {
   }
 }
 
+/*
+* Helper for JSON whitespace characters dropped from keys and trimmed from values
+*/
+static BOOLEAN JsonIsWhiteSpace(CHAR16 Char) {
+  return (CHAR_WHITE_SPACE == Char || L'\t' == Char || L'\r' == Char || L'\n' == Char);
+}
+
+/*
+* Print a string as a quoted JSON string.
+* Values are trimmed and keys have all whitespace removed, as in the NVM XML output.
+* Quotes, backslashes, control and non-ASCII characters are escaped, so the output is
+* plain ASCII (and so UTF-8) whatever the console code page. The string is streamed
+* through a small chunk, it is never copied as a whole.
+*/
+static VOID JsonPrintStr(CONST CHAR16 *Str, BOOLEAN RemoveWhiteSpace) {
+  CONST CHAR16 *HexDigits = L"0123456789abcdef";
+  CHAR16 Chunk[JSON_STR_CHUNK_LEN + 1];
+  UINTN ChunkLen = 0;
+  UINTN Begin = 0;
+  UINTN End = 0;
+  UINTN Index = 0;
+  CHAR16 Char = 0;
+
+  Print(L"\"");
+  if (NULL != Str) {
+    End = StrLen(Str);
+    while (End > 0 && JsonIsWhiteSpace(Str[End - 1])) {
+      --End;
+    }
+    while (Begin < End && JsonIsWhiteSpace(Str[Begin])) {
+      ++Begin;
+    }
+    for (Index = Begin; Index < End; ++Index) {
+      Char = Str[Index];
+      if (RemoveWhiteSpace && JsonIsWhiteSpace(Char)) {
+        continue;
+      }
+      if (ChunkLen + JSON_ESCAPE_MAX_LEN > JSON_STR_CHUNK_LEN) {
+        Chunk[ChunkLen] = CHAR_NULL_TERM;
+        Print(FORMAT_STR, Chunk);
+        ChunkLen = 0;
+      }
+      if (L'"' == Char || L'\\' == Char) {
+        Chunk[ChunkLen++] = L'\\';
+        Chunk[ChunkLen++] = Char;
+      }
+      else if (L'\n' == Char) {
+        Chunk[ChunkLen++] = L'\\';
+        Chunk[ChunkLen++] = L'n';
+      }
+      else if (L'\t' == Char) {
+        Chunk[ChunkLen++] = L'\\';
+        Chunk[ChunkLen++] = L't';
+      }
+      else if (Char < 0x20 || Char > 0x7E) {
+        //CHAR16 is UTF-16, characters outside of the BMP are already surrogate pairs
+        Chunk[ChunkLen++] = L'\\';
+        Chunk[ChunkLen++] = L'u';
+        Chunk[ChunkLen++] = HexDigits[(Char >> 12) & 0xF];
+        Chunk[ChunkLen++] = HexDigits[(Char >> 8) & 0xF];
+        Chunk[ChunkLen++] = HexDigits[(Char >> 4) & 0xF];
+        Chunk[ChunkLen++] = HexDigits[Char & 0xF];
+      }
+      else {
+        Chunk[ChunkLen++] = Char;
+      }
+    }
+  }
+  if (ChunkLen > 0) {
+    Chunk[ChunkLen] = CHAR_NULL_TERM;
+    Print(FORMAT_STR, Chunk);
+  }
+  Print(L"\"");
+}
+
+/*
+* Print a key's value as JSON.
+* Booleans and numbers set in decimal are printed as JSON literals. Numbers set in hex,
+* such as handles and IDs, keep their display string, as do all other values.
+*/
+static VOID JsonPrintVal(DATA_SET_CONTEXT *DataSetCtx, KEY_VAL_INFO *KvInfo) {
+  CHAR16 *Val = NULL;
+  BOOLEAN BoolVal = FALSE;
+  UINT64 Uint64Val = 0;
+  INT64 Int64Val = 0;
+  UINT32 Uint32Val = 0;
+  INT32 Int32Val = 0;
+  UINT16 Uint16Val = 0;
+  INT16 Int16Val = 0;
+  UINT8 Uint8Val = 0;
+  INT8 Int8Val = 0;
+
+  if (KEY_BOOL == KvInfo->Type) {
+    GetKeyValueBool(DataSetCtx, KvInfo->Key, &BoolVal, &BoolVal);
+    Print(BoolVal ? L"true" : L"false");
+    return;
+  }
+
+  if (DECIMAL == KvInfo->Base) {
+    switch (KvInfo->Type) {
+    case KEY_UINT64:
+      GetKeyValueUint64(DataSetCtx, KvInfo->Key, &Uint64Val, &Uint64Val);
+      Print(FORMAT_UINT64, Uint64Val);
+      return;
+    case KEY_INT64:
+      GetKeyValueInt64(DataSetCtx, KvInfo->Key, &Int64Val, &Int64Val);
+      Print(FORMAT_INT64, Int64Val);
+      return;
+    case KEY_UINT32:
+      GetKeyValueUint32(DataSetCtx, KvInfo->Key, &Uint32Val, &Uint32Val);
+      Print(FORMAT_UINT64, (UINT64)Uint32Val);
+      return;
+    case KEY_INT32:
+      GetKeyValueInt32(DataSetCtx, KvInfo->Key, &Int32Val, &Int32Val);
+      Print(FORMAT_INT64, (INT64)Int32Val);
+      return;
+    case KEY_UINT16:
+      GetKeyValueUint16(DataSetCtx, KvInfo->Key, &Uint16Val, &Uint16Val);
+      Print(FORMAT_UINT64, (UINT64)Uint16Val);
+      return;
+    case KEY_INT16:
+      GetKeyValueInt16(DataSetCtx, KvInfo->Key, &Int16Val, &Int16Val);
+      Print(FORMAT_INT64, (INT64)Int16Val);
+      return;
+    case KEY_UINT8:
+      GetKeyValueUint8(DataSetCtx, KvInfo->Key, &Uint8Val, &Uint8Val);
+      Print(FORMAT_UINT64, (UINT64)Uint8Val);
+      return;
+    case KEY_INT8:
+      GetKeyValueInt8(DataSetCtx, KvInfo->Key, &Int8Val, &Int8Val);
+      Print(FORMAT_INT64, (INT64)Int8Val);
+      return;
+    default:
+      break;
+    }
+  }
+
+  GetKeyValueWideStr(DataSetCtx, KvInfo->Key, &Val, NULL);
+  JsonPrintStr(Val, FALSE);
+}
+
+/*
+* Callback routine for printing out JSON.
+* -Print the delimiter if this is not the first child of the parent node.
+* -Start by printing indentation whitespace based on depth of node in tree.
+* -Leaf node: {"DataSetName":{"KeyName":KeyVal,...}
+* -Other nodes: {"DataSetName":[ followed by the children.
+* Note, data sets are squashed before printing like for NVM XML, so only leaf nodes have keys.
+* Closing brackets are printed in the JsonChildrenDoneCb callback routine.
+*/
+static VOID * JsonCb(DATA_SET_CONTEXT *DataSetCtx, CHAR16 *CurPath, VOID *UserData, VOID *ParentUserData) {
+  JSON_NODE_INFO *ParentInfo = (JSON_NODE_INFO *)ParentUserData;
+  KEY_VAL_INFO *KvInfo = NULL;
+  UINT32 Index = 0;
+  UINT32 Ident = 0;
+  BOOLEAN FirstKey = TRUE;
+
+  if (NULL != ParentInfo && 0 < ParentInfo->ChildCnt++) {
+    Print(JSON_ITEM_DELIM);
+  }
+
+  Ident = NvmXmlGetNvmXmlIdent(CurPath);
+  for (Index = 0; Index < Ident; ++Index) {
+    Print(JSON_WHITESPACE_IDENT);
+  }
+  Print(L"{");
+  JsonPrintStr(GetDataSetName(DataSetCtx), TRUE);
+
+  if (IsLeaf(DataSetCtx)) {
+    Print(L":{");
+    while (NULL != (KvInfo = GetNextKey(DataSetCtx, KvInfo))) {
+      if (!FirstKey) {
+        Print(L",");
+      }
+      FirstKey = FALSE;
+      JsonPrintStr(KvInfo->Key, TRUE);
+      Print(L":");
+      JsonPrintVal(DataSetCtx, KvInfo);
+    }
+    Print(L"}");
+  }
+  else {
+    Print(L":[\n");
+  }
+  //freed by RecurseDataSet once all children are printed
+  return AllocateZeroPool(sizeof(JSON_NODE_INFO));
+}
+
+/*
+* Children done callback routine for printing out JSON.
+* -Close the node, for nodes with children on a new line with the node's indentation.
+*/
+static VOID * JsonChildrenDoneCb(DATA_SET_CONTEXT *DataSetCtx, CHAR16 *CurPath, VOID *UserData) {
+  UINT32 Index = 0;
+  UINT32 Ident = 0;
+
+  if (IsLeaf(DataSetCtx)) {
+    Print(L"}");
+    return NULL;
+  }
+
+  Print(L"\n");
+  Ident = NvmXmlGetNvmXmlIdent(CurPath);
+  for (Index = 0; Index < Ident; ++Index) {
+    Print(JSON_WHITESPACE_IDENT);
+  }
+  Print(L"]}");
+  return NULL;
+}
+
+/*
+* Main entry point for displaying a hierarchical data set as JSON.
+* The document is printed while the data set is walked, it is never buffered.
+*/
+static VOID PrintAsJson(DATA_SET_CONTEXT *DataSetCtx) {
+  DATA_SET_CONTEXT *SquashedDataSet;
+  SquashedDataSet = SquashDataSet(DataSetCtx);
+
+  RecurseDataSet(SquashedDataSet, JsonCb, JsonChildrenDoneCb, NULL, TRUE);
+  //SquashDataSet will return original Data set if it has no children
+  //If it doesn't squash, don't free it.
+  if (SquashedDataSet != DataSetCtx) {
+    FreeDataSet(SquashedDataSet);
+  }
+}
+
 /*
 * Print to stdout with each line starting with ERROR
 */
@@ -1347,6 +1588,12 @@ static PRINT_MODE PrintMode(
   else if (XML == pPrintCtx->FormatType) {
     return PRINT_BASIC_XML;
   }
+  else if (JSON == pPrintCtx->FormatType && 1 == pPrintCtx->BufferedDataSetCnt && EFI_SUCCESS == pPrintCtx->BufferedObjectLastError) {
+    return PRINT_JSON;
+  }
+  else if (JSON == pPrintCtx->FormatType) {
+    return PRINT_BASIC_JSON;
+  }
   else return PRINT_TEXT;
 }
 
@@ -1365,6 +1612,8 @@ EFI_STATUS PrinterProcessSetBuffer(
   PRINT_MODE PrinterMode = PRINT_TEXT;
   BOOLEAN startXmlSuccessPrinted = FALSE;
   BOOLEAN startXmlErrorPrinted = FALSE;
+  UINTN JsonItemCnt = 0;
+  EFI_STATUS CmdExitCode = EFI_SUCCESS;
 
   if (NULL == pPrintCtx) {
     return EFI_INVALID_PARAMETER;
@@ -1391,6 +1640,20 @@ EFI_STATUS PrinterProcessSetBuffer(
     }
   }
 
+  //if JSON mode, messages and data sets are the items of a result or error object
+  if (PRINT_BASIC_JSON == PrinterMode) {
+    if (EFI_SUCCESS == pPrintCtx->BufferedObjectLastError) {
+      Print(JSON_RESULTS_BEGIN);
+    }
+    else {
+      CmdExitCode = pPrintCtx->BufferedObjectLastError;
+#ifdef OS_BUILD
+      CmdExitCode = UefiToOsReturnCode(CmdExitCode);
+#endif
+      Print(JSON_ERROR_BEGIN, CmdExitCode);
+    }
+  }
+
   //iterate through all items in the "set buffer".
   //all items found should be transformed to text and printed directly to stdout
   BUFFERED_OBJECT_LIST_FOR_EACH_SAFE(Entry, NextEntry, &pPrintCtx->BufferedObjectList) {
@@ -1406,9 +1669,15 @@ EFI_STATUS PrinterProcessSetBuffer(
       {
         PrintTextAsEsxError(pTempBs->pStr);
       }
+      else if (PRINT_BASIC_JSON == PrinterMode) {
+        if (0 < JsonItemCnt++) {
+          Print(JSON_ITEM_DELIM);
+        }
+        JsonPrintStr(pTempBs->pStr, FALSE);
+      }
       else
       {
-        if (PRINT_XML != PrinterMode) {
+        if (PRINT_XML != PrinterMode && PRINT_JSON != PrinterMode) {
           PrintTextWithNewLine(pTempBs->pStr);
         }
       }
@@ -1420,6 +1689,16 @@ EFI_STATUS PrinterProcessSetBuffer(
       if (PRINT_XML == PrinterMode) {
         PrintAsXml(pTempDs->pDataSet, pPrintCtx);
       }
+      else if (PRINT_JSON == PrinterMode) {
+        PrintAsJson(pTempDs->pDataSet);
+        Print(L"\n");
+      }
+      else if (PRINT_BASIC_JSON == PrinterMode) {
+        if (0 < JsonItemCnt++) {
+          Print(JSON_ITEM_DELIM);
+        }
+        PrintAsJson(pTempDs->pDataSet);
+      }
       else {
         PrintAsText(pTempDs->pDataSet, pPrintCtx);
       }
@@ -1428,7 +1707,13 @@ EFI_STATUS PrinterProcessSetBuffer(
     else if (BUFF_COMMAND_STATUS_TYPE == BufferedObject->Type) {
       BUFFERED_COMMAND_STATUS *pTempCs = (BUFFERED_COMMAND_STATUS *)BufferedObject->Obj;
       CreateCmdStatusMsg(&FullMsg, pTempCs->pStatusMessage, pTempCs->pStatusPreposition, pTempCs->pCommandStatus);
-      if (PRINT_XML != PrinterMode) {
+      if (PRINT_BASIC_JSON == PrinterMode) {
+        if (0 < JsonItemCnt++) {
+          Print(JSON_ITEM_DELIM);
+        }
+        JsonPrintStr(FullMsg, FALSE);
+      }
+      else if (PRINT_XML != PrinterMode && PRINT_JSON != PrinterMode) {
         PrintTextWithNewLine(FullMsg);
       }
       FreeCommandStatus(&pTempCs->pCommandStatus);
@@ -1447,6 +1732,9 @@ EFI_STATUS PrinterProcessSetBuffer(
   else if (TRUE == startXmlSuccessPrinted) {
     PrintXmlEndSuccessTag(pPrintCtx, pPrintCtx->BufferedObjectLastError);
   }
+  else if (PRINT_BASIC_JSON == PrinterMode) {
+    Print((EFI_SUCCESS == pPrintCtx->BufferedObjectLastError) ? JSON_RESULTS_END : JSON_ERROR_END);
+  }
 
   CleanDataSetLookupItems(pPrintCtx);
   pPrintCtx->BufferedObjectLastError = EFI_SUCCESS;
@@ -59,7 +59,8 @@ extern CHAR16* gNullValueToDisplay;
 
 typedef enum {
   TEXT,
-  XML
+  XML,
+  JSON
 }PRINT_FORMAT_TYPE;
 
 typedef enum {
@@ -19,8 +19,11 @@
 #include <Convert.h>
 #include <NvmDimmDriver.h>
 #ifdef OS_BUILD
+#include <os.h>
 #include <os_types.h>
 #include <Common.h>
+#include <Pbr.h>
+#include "PcdDiskCache.h"
 #endif
 
 #ifndef OS_BUILD
@@ -29,6 +32,7 @@
 
 #define SMBIOS_TYPE_MEM_DEV             17
 #define SMBIOS_TYPE_MEM_DEV_MAPPED_ADDR 20
+// Build default only, per-DIMM work may run concurrently so each call decides on a local copy
 #ifdef PCD_CACHE_ENABLED
 int gPCDCacheEnabled = 1;
 #else
@@ -171,6 +175,174 @@ InitializeCpuCommands(
 
 STATIC EFI_STATUS PollOnArsDeviceBusy(IN DIMM *pDimm, IN UINT32 TimeoutSecs);
 
+/**
+  Lookup index of the DIMM inventory: two open addressing tables of DIMM pointers,
+  hashed on Dimm ID and on NFIT device handle. The index is built once the
+  inventory is initialized and is only used while the inventory generation it
+  was built for is current, any other lookup scans the list.
+**/
+typedef struct {
+  LIST_ENTRY *pDimms;           ///< List the index was built for
+  UINT32 Generation;            ///< Inventory generation the index was built for
+  UINT32 Mask;                  ///< Slots per table minus one, the slot count is a power of two
+  DIMM **ppById;
+  DIMM **ppByHandle;
+} DIMM_INDEX;
+
+#define DIMM_INDEX_MIN_SLOTS  16
+#define DIMM_INDEX_HASH(Key, Mask)  ((((UINT32)(Key) * 0x9E3779B1) >> 7) & (Mask))
+
+STATIC DIMM_INDEX gDimmIndex;
+STATIC UINT32 gDimmInventoryGeneration = 1;
+
+VOID
+InvalidateDimmIndex(
+  )
+{
+  FREE_POOL_SAFE(gDimmIndex.ppById);
+  FREE_POOL_SAFE(gDimmIndex.ppByHandle);
+  ZeroMem(&gDimmIndex, sizeof(gDimmIndex));
+  gDimmInventoryGeneration++;
+}
+
+UINT32
+GetDimmInventoryGeneration(
+  )
+{
+  return gDimmInventoryGeneration;
+}
+
+VOID
+LockDimmMailbox(
+  IN     DIMM *pDimm
+  )
+{
+#ifdef OS_BUILD
+  if (pDimm != NULL && pDimm->pMailboxLock != NULL) {
+    os_mutex_lock(pDimm->pMailboxLock);
+  }
+#endif
+}
+
+VOID
+UnlockDimmMailbox(
+  IN     DIMM *pDimm
+  )
+{
+#ifdef OS_BUILD
+  if (pDimm != NULL && pDimm->pMailboxLock != NULL) {
+    os_mutex_unlock(pDimm->pMailboxLock);
+  }
+#endif
+}
+
+/**
+  Insert a DIMM into an index table unless a DIMM with the same key is there,
+  so lookups return the first DIMM in list order like a scan does.
+**/
+STATIC
+VOID
+DimmIndexInsert(
+  IN OUT DIMM **ppTable,
+  IN     UINT32 Key,
+  IN     BOOLEAN ByHandle,
+  IN     DIMM *pDimm
+  )
+{
+  UINT32 Slot = DIMM_INDEX_HASH(Key, gDimmIndex.Mask);
+
+  while (ppTable[Slot] != NULL) {
+    if (Key == (ByHandle ? ppTable[Slot]->DeviceHandle.AsUint32 : ppTable[Slot]->DimmID)) {
+      return;
+    }
+    Slot = (Slot + 1) & gDimmIndex.Mask;
+  }
+  ppTable[Slot] = pDimm;
+}
+
+/**
+  Build the DIMM index for the current inventory generation.
+  A failed allocation leaves the index empty and the lookups scan the list.
+
+  @param[in] pDev: The pmem super structure
+**/
+STATIC
+VOID
+BuildDimmIndex(
+  IN     PMEM_DEV *pDev
+  )
+{
+  DIMM *pCurDimm = NULL;
+  LIST_ENTRY *pCurDimmNode = NULL;
+  UINT32 DimmCount = 0;
+  UINT32 Slots = DIMM_INDEX_MIN_SLOTS;
+
+  FREE_POOL_SAFE(gDimmIndex.ppById);
+  FREE_POOL_SAFE(gDimmIndex.ppByHandle);
+  ZeroMem(&gDimmIndex, sizeof(gDimmIndex));
+
+  LIST_FOR_EACH(pCurDimmNode, &pDev->Dimms) {
+    DimmCount++;
+  }
+  // Keep the tables at most half full so probe sequences stay short
+  while (Slots < DimmCount * 2) {
+    Slots <<= 1;
+  }
+  gDimmIndex.ppById = AllocateZeroPool(Slots * sizeof(DIMM *));
+  gDimmIndex.ppByHandle = AllocateZeroPool(Slots * sizeof(DIMM *));
+  if (gDimmIndex.ppById == NULL || gDimmIndex.ppByHandle == NULL) {
+    NVDIMM_WARN("Unable to allocate the DIMM index, lookups scan the DIMM list");
+    FREE_POOL_SAFE(gDimmIndex.ppById);
+    FREE_POOL_SAFE(gDimmIndex.ppByHandle);
+    return;
+  }
+  gDimmIndex.Mask = Slots - 1;
+
+  LIST_FOR_EACH(pCurDimmNode, &pDev->Dimms) {
+    pCurDimm = DIMM_FROM_NODE(pCurDimmNode);
+    DimmIndexInsert(gDimmIndex.ppById, pCurDimm->DimmID, FALSE, pCurDimm);
+    DimmIndexInsert(gDimmIndex.ppByHandle, pCurDimm->DeviceHandle.AsUint32, TRUE, pCurDimm);
+  }
+  gDimmIndex.pDimms = &pDev->Dimms;
+  gDimmIndex.Generation = gDimmInventoryGeneration;
+}
+
+/**
+  Look a DIMM up in the DIMM index.
+
+  @param[in] pDimms: The head of the dimm list searched
+  @param[in] Key: Dimm ID or device handle
+  @param[in] ByHandle: TRUE when Key is a device handle
+  @param[out] ppDimm: The DIMM found, NULL when there is none
+
+  @retval TRUE if the index covers pDimms and answered the lookup
+  @retval FALSE if the list has to be scanned
+**/
+STATIC
+BOOLEAN
+DimmIndexLookup(
+  IN     LIST_ENTRY *pDimms,
+  IN     UINT32 Key,
+  IN     BOOLEAN ByHandle,
+     OUT DIMM **ppDimm
+  )
+{
+  DIMM **ppTable = ByHandle ? gDimmIndex.ppByHandle : gDimmIndex.ppById;
+  UINT32 Slot;
+
+  if (ppTable == NULL || pDimms != gDimmIndex.pDimms || gDimmIndex.Generation != gDimmInventoryGeneration) {
+    return FALSE;
+  }
+  *ppDimm = NULL;
+  for (Slot = DIMM_INDEX_HASH(Key, gDimmIndex.Mask); ppTable[Slot] != NULL; Slot = (Slot + 1) & gDimmIndex.Mask) {
+    if (Key == (ByHandle ? ppTable[Slot]->DeviceHandle.AsUint32 : ppTable[Slot]->DimmID)) {
+      *ppDimm = ppTable[Slot];
+      break;
+    }
+  }
+  return TRUE;
+}
+
 /**
   Get dimm by Dimm ID
   Scan the dimm list for a dimm identified by Dimm ID
@@ -192,6 +364,9 @@ GetDimmByPid(
   LIST_ENTRY *pCurDimmNode = NULL;
 
   NVDIMM_ENTRY();
+  if (DimmIndexLookup(pDimms, DimmID, FALSE, &pTargetDimm)) {
+    goto Finish;
+  }
   for (pCurDimmNode = GetFirstNode(pDimms);
       !IsNull(pDimms, pCurDimmNode);
       pCurDimmNode = GetNextNode(pDimms, pCurDimmNode)) {
@@ -204,6 +379,7 @@ GetDimmByPid(
     }
   }
 
+Finish:
   NVDIMM_EXIT();
   return pTargetDimm;
 }
@@ -228,6 +404,9 @@ GetDimmByHandle(
   DIMM *pTargetDimm = NULL;
   LIST_ENTRY *pCurDimmNode = NULL;
   NVDIMM_ENTRY();
+  if (DimmIndexLookup(pDimms, DeviceHandle, TRUE, &pTargetDimm)) {
+    goto Finish;
+  }
   for (pCurDimmNode = GetFirstNode(pDimms);
       !IsNull(pDimms, pCurDimmNode);
       pCurDimmNode = GetNextNode(pDimms, pCurDimmNode)) {
@@ -239,6 +418,7 @@ GetDimmByHandle(
       break;
     }
   }
+Finish:
   NVDIMM_EXIT();
   return pTargetDimm;
 }
@@ -1080,6 +1260,7 @@ RemoveDimmInventory(
   EFI_STATUS TmpReturnCode = EFI_SUCCESS;
 
   NVDIMM_ENTRY();
+  InvalidateDimmIndex();
   for (pCurDimmNode = GetFirstNode(&pDev->Dimms);
       !IsNull(&pDev->Dimms, pCurDimmNode) && pCurDimmNode != NULL;
       pCurDimmNode = pTempDimmNode) {
@@ -1225,6 +1406,7 @@ InitializeDimmInventory(
 #ifndef OS_BUILD
   InitializeCpuCommands();
 #endif
+  InvalidateDimmIndex();
   pFitHead = pDev->pFitHead;
   pPmttHead = pDev->pPmttHead;
   ppNvDimmRegionMappingStructures = pFitHead->ppNvDimmRegionMappingStructures;
@@ -1246,6 +1428,10 @@ InitializeDimmInventory(
 
     // Assume dimm is functional
     pNewDimm->NonFunctional = FALSE;
+#ifdef OS_BUILD
+    // Unnamed, the lock only orders the threads of this process
+    pNewDimm->pMailboxLock = os_mutex_init(NULL);
+#endif
 
     // Fill in smbus address details
     CHECK_RESULT_CONTINUE(PopulateSmbusFields(pNewDimm));
@@ -1266,6 +1452,7 @@ ErrorUnresponsiveDimm:
 
   ReturnCode = EFI_SUCCESS;
 Finish:
+  BuildDimmIndex(pDev);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1321,7 +1508,7 @@ FwCmdGetViralPolicy(
   CopyMem_S(pViralPolicyPayload, sizeof(*pViralPolicyPayload), pFwCmd->OutPayload, sizeof(*pViralPolicyPayload));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1369,7 +1556,7 @@ FwCmdGetOptionalConfigurationDataPolicy(
   pOptionalDataPolicyPayload->FisMinor = pDimm->FwVer.FwApiMinor;
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1416,7 +1603,7 @@ FwCmdSetOptionalConfigurationDataPolicy(
   }
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1465,7 +1652,7 @@ FwCmdGetSecurityInfo(
   CopyMem_S(pSecurityPayload, sizeof(*pSecurityPayload), pFwCmd->OutPayload, sizeof(*pSecurityPayload));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1528,7 +1715,7 @@ FwCmdGetSecurityOptIn(
   CopyMem_S(pSecurityOptIn, sizeof(*pSecurityOptIn), pFwCmd->OutPayload, sizeof(*pSecurityOptIn));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1586,7 +1773,7 @@ FwCmdDisableARS(
   NVDIMM_DBG("Finished polling long op, return val = %x", ReturnCode);
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1646,7 +1833,7 @@ FwCmdGetARS(
   }
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1745,7 +1932,7 @@ FwCmdIdDimm (
   CopyMem_S(pPayload, sizeof(*pPayload), pFwCmd->OutPayload, sizeof(*pPayload));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
 
   return ReturnCode;
@@ -1812,7 +1999,7 @@ FinishError:
     FREE_POOL_SAFE(*ppPayload);
   }
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1864,7 +2051,7 @@ FwCmdGetDimmPartitionInfo(
   CopyMem_S(pPayload, sizeof(*pPayload), pFwCmd->OutPayload, sizeof(*pPayload));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -1982,7 +2169,7 @@ FwGetPCDFromOffsetSmallPayload(
   }
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   return ReturnCode;
 }
 /**
@@ -2040,8 +2227,9 @@ FwCmdGetPcdLargePayload(
   InputPayload.CmdOptions.RetrieveOption = PCD_CMD_OPT_PARTITION_DATA;
   pFwCmd->InputPayloadSize = sizeof(InputPayload);
 
-  /** Get PCD by large payload in single call **/
+  /** Get PCD by large payload in single call, straight into the caller's buffer **/
   pFwCmd->LargeOutputPayloadSize = PCD_PARTITION_SIZE;
+  pFwCmd->LargeOutputPayload = *ppRawData;
   InputPayload.Offset = 0;
   InputPayload.CmdOptions.PayloadType = PCD_CMD_OPT_LARGE_PAYLOAD;
 
@@ -2056,10 +2244,13 @@ FwCmdGetPcdLargePayload(
     FW_CMD_ERROR_TO_EFI_STATUS(pFwCmd, ReturnCode);
     goto Finish;
   }
-  CopyMem_S(*ppRawData, PCD_PARTITION_SIZE, pFwCmd->LargeOutputPayload, PCD_PARTITION_SIZE);
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  if (pFwCmd != NULL) {
+    // Output buffer is owned by the caller
+    pFwCmd->LargeOutputPayload = NULL;
+  }
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -2092,8 +2283,10 @@ FwCmdGetPlatformConfigData(
   UINT32 PcdSize = 0;
   EFI_DCPMM_CONFIG2_PROTOCOL *pNvmDimmConfigProtocol = NULL;
   EFI_DCPMM_CONFIG_TRANSPORT_ATTRIBS pAttribs;
+  BOOLEAN PcdCacheEnabled = (gPCDCacheEnabled != 0);
 
   NVDIMM_ENTRY();
+  LockDimmMailbox(pDimm);
 
   // Don't support using this function to retrieve PCD OEM Config data.
   // Use FwCmdGetPcdSmallPayload
@@ -2126,7 +2319,7 @@ FwCmdGetPlatformConfigData(
   * It could also be possbile that FW was busy during driver load time, so disable the cache.
   */
   if (PcdSize == 0) {
-    gPCDCacheEnabled = 0;
+    PcdCacheEnabled = FALSE;
     ReturnCode = FwCmdGetPlatformConfigDataSize(pDimm, PartitionId, &PcdSize);
     if (EFI_ERROR(ReturnCode) || PcdSize == 0) {
       NVDIMM_DBG("FW CMD Error: %d", ReturnCode);
@@ -2145,7 +2338,7 @@ FwCmdGetPlatformConfigData(
     goto Finish;
   }
 
-  if (gPCDCacheEnabled) {
+  if (PcdCacheEnabled) {
     if (pDimm->pPcdLsa && PartitionId == PCD_LSA_PARTITION_ID) {
       CopyMem_S(*ppRawData, PcdSize, pDimm->pPcdLsa, PcdSize);
       goto Finish;
@@ -2208,11 +2401,12 @@ FwCmdGetPlatformConfigData(
       CopyMem_S(pBuffer + Offset, PcdSize - Offset, pFwCmd->OutPayload, PCD_GET_SMALL_PAYLOAD_DATA_SIZE);
     }
 #ifdef OS_BUILD
-    gPCDCacheEnabled = 1;
+    PcdCacheEnabled = TRUE;
 #endif
   } else {
     /** Get PCD by large payload in single call **/
     pFwCmd->LargeOutputPayloadSize = PcdSize;
+    CHECK_RESULT(AllocateFwCmdLargePayloads(pFwCmd), Finish);
     InputPayload.Offset = 0;
     InputPayload.CmdOptions.PayloadType = PCD_CMD_OPT_LARGE_PAYLOAD;
     if (pFwCmd->InputPayloadSize > IN_PAYLOAD_SIZE) {
@@ -2230,11 +2424,11 @@ FwCmdGetPlatformConfigData(
       goto Finish;
     }
 #ifdef OS_BUILD
-    gPCDCacheEnabled = 1;
+    PcdCacheEnabled = TRUE;
 #endif
   }
 
-  if (gPCDCacheEnabled) {
+  if (PcdCacheEnabled) {
     VOID *pTempCache = NULL;
     UINTN pTempCacheSz = 0;
 
@@ -2270,9 +2464,10 @@ FwCmdGetPlatformConfigData(
     CopyMem_S(*ppRawData, PcdSize, pFwCmd->LargeOutputPayload, PcdSize);
   }
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   FREE_POOL_SAFE(pBuffer);
   NVDIMM_EXIT_I64(ReturnCode);
+  UnlockDimmMailbox(pDimm);
   return ReturnCode;
 }
 
@@ -2340,7 +2535,7 @@ FwCmdGetPlatformConfigDataSize (
   *pPcdSize = OutputPcdSize.Size;
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -2489,17 +2684,6 @@ FwCmdGetPcdSmallPayload(
     goto Finish;
   }
 
-
-  /*
-  * PcdSize is 0 if Media is disabled or FW is busy.
-  * PcdSize was retrieved at driver load time so it is possible that since load time there
-  * was a fatal media error that this would not catch. We would then be returning cached data
-  * from a media disabled DIMM instead of erroring out.
-  * It could also be possbile that FW was busy during driver load time, so disable the cache.
-  */
-  if (gPCDCacheEnabled && pDimm->PcdOemPartitionSize == 0) {
-    gPCDCacheEnabled = 0;
-  }
   pFwCmd = AllocateZeroPool(sizeof(*pFwCmd));
   if (pFwCmd == NULL) {
     ReturnCode = EFI_OUT_OF_RESOURCES;
@@ -2533,7 +2717,7 @@ FwCmdGetPcdSmallPayload(
   CopyMem_S(pData, DataSize, pFwCmd->OutPayload, DataSize);
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -2566,20 +2750,29 @@ GetPcdOemConfigDataUsingSmallPayload(
   UINT8 *pBuffer = NULL;
   UINT32 Offset = 0;
   UINT8 TmpBuf[PCD_GET_SMALL_PAYLOAD_DATA_SIZE];
+  BOOLEAN ReadFromDiskCache = FALSE;
+  BOOLEAN PcdCacheEnabled = (gPCDCacheEnabled != 0);
   NVDIMM_ENTRY();
+  LockDimmMailbox(pDimm);
 
   if (pDimm == NULL || ppRawData == NULL || pRawDataSize == NULL) {
     ReturnCode = EFI_INVALID_PARAMETER;
     goto Finish;
   }
 
-// Disable the cache when media is disabled or when the fw is busy
-  if (gPCDCacheEnabled && pDimm->PcdOemPartitionSize == 0) {
-    gPCDCacheEnabled = 0;
+  /*
+  * PcdSize is 0 if Media is disabled or FW is busy.
+  * PcdSize was retrieved at driver load time so it is possible that since load time there
+  * was a fatal media error that this would not catch. We would then be returning cached data
+  * from a media disabled DIMM instead of erroring out.
+  * It could also be possbile that FW was busy during driver load time, so disable the cache.
+  */
+  if (pDimm->PcdOemPartitionSize == 0) {
+    PcdCacheEnabled = FALSE;
   }
 
   // Return the cached data
-  if (gPCDCacheEnabled && pDimm->pPcdOem) {
+  if (PcdCacheEnabled && pDimm->pPcdOem) {
     *ppRawData = AllocateZeroPool(pDimm->PcdOemSize);
     if (*ppRawData == NULL) {
       NVDIMM_WARN("Can't allocate memory for Platform Config Data (%d bytes)", pDimm->PcdOemSize);
@@ -2633,8 +2826,15 @@ GetPcdOemConfigDataUsingSmallPayload(
   // Save the first 128 bytes already read
   CopyMem_S(pBuffer, BufferSize, TmpBuf, PCD_GET_SMALL_PAYLOAD_DATA_SIZE);
 
+#ifdef OS_BUILD
+  // The header block just read validates the entry a previous invocation left on disk
+  if (!EFI_ERROR(PcdDiskCacheLoad(pDimm, TmpBuf, OemDataSize, pBuffer, BufferSize))) {
+    ReadFromDiskCache = TRUE;
+  }
+#endif
+
   /** Get PCD by small payload in loop in 128 byte chunks **/
-  for (Offset = PCD_GET_SMALL_PAYLOAD_DATA_SIZE; Offset < OemDataSize; Offset += PCD_GET_SMALL_PAYLOAD_DATA_SIZE) {
+  for (Offset = PCD_GET_SMALL_PAYLOAD_DATA_SIZE; !ReadFromDiskCache && Offset < OemDataSize; Offset += PCD_GET_SMALL_PAYLOAD_DATA_SIZE) {
 
     ReturnCode = FwCmdGetPcdSmallPayload(pDimm, PCD_OEM_PARTITION_ID, Offset, pBuffer + Offset, (UINT8)PCD_GET_SMALL_PAYLOAD_DATA_SIZE);
     if (EFI_ERROR(ReturnCode)) {
@@ -2642,8 +2842,14 @@ GetPcdOemConfigDataUsingSmallPayload(
     }
   }
 
+#ifdef OS_BUILD
+  if (!ReadFromDiskCache) {
+    PcdDiskCacheStore(pDimm, pBuffer, OemDataSize);
+  }
+#endif
 
-  if ( gPCDCacheEnabled && OemDataSize > 0) {
+
+  if (PcdCacheEnabled && OemDataSize > 0) {
     VOID *pTempCache = NULL;
 
     // Save data cache info
@@ -2668,6 +2874,7 @@ Finish:
 
   NVDIMM_EXIT_I64(ReturnCode);
 
+  UnlockDimmMailbox(pDimm);
   return ReturnCode;
 }
 
@@ -2701,7 +2908,10 @@ FwSetPCDFromOffsetSmallPayload(
   PT_INPUT_PAYLOAD_SET_DATA_PLATFORM_CONFIG_DATA InPayloadSetData;
   UINT32 StartingPageOffset = ((ReqOffset / PCD_SET_SMALL_PAYLOAD_DATA_SIZE)*PCD_SET_SMALL_PAYLOAD_DATA_SIZE);
   UINT32 WriteOffset = 0;
+  VOID *pTempCache = NULL;
+  UINT32 TempCacheSize = 0;
 
+  LockDimmMailbox(pDimm);
   SetMem(&InPayloadSetData, sizeof(InPayloadSetData), 0x0);
 
   if ((pDimm == NULL) || (pRawData == NULL) ||
@@ -2734,6 +2944,17 @@ FwSetPCDFromOffsetSmallPayload(
     }
   }
 
+  if (PartitionId == PCD_LSA_PARTITION_ID && gPCDCacheEnabled) {
+    pTempCache = pDimm->pPcdLsa;
+    TempCacheSize = pDimm->PcdLsaPartitionSize;
+  } else if (PartitionId == PCD_OEM_PARTITION_ID) {
+    // Partial OEM writes would leave the cached size behind, just drop the copy
+    FREE_POOL_SAFE(pDimm->pPcdOem);
+  }
+#ifdef OS_BUILD
+  PcdDiskCacheInvalidate(pDimm);
+#endif
+
   pFwCmd = AllocateZeroPool(sizeof(*pFwCmd));
   if (pFwCmd == NULL) {
     ReturnCode = EFI_OUT_OF_RESOURCES;
@@ -2762,10 +2983,15 @@ FwSetPCDFromOffsetSmallPayload(
       FW_CMD_ERROR_TO_EFI_STATUS(pFwCmd, ReturnCode);
       goto Finish;
     }
+    // Keep the cached partition in sync, large payload reads are served from it
+    if (pTempCache != NULL && (WriteOffset + PCD_SET_SMALL_PAYLOAD_DATA_SIZE) <= TempCacheSize) {
+      CopyMem_S((UINT8 *)pTempCache + WriteOffset, TempCacheSize - WriteOffset, InPayloadSetData.Data, PCD_SET_SMALL_PAYLOAD_DATA_SIZE);
+    }
   }
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
+  UnlockDimmMailbox(pDimm);
   return ReturnCode;
 }
 
@@ -2802,6 +3028,7 @@ FwCmdSetPlatformConfigData (
   EFI_DCPMM_CONFIG_TRANSPORT_ATTRIBS pAttribs;
 
   NVDIMM_ENTRY();
+  LockDimmMailbox(pDimm);
 
   SetMem(&InPayloadSetData, sizeof(InPayloadSetData), 0x0);
 
@@ -2854,6 +3081,11 @@ FwCmdSetPlatformConfigData (
     goto Finish;
   }
 
+#ifdef OS_BUILD
+  // Drop the persistent copy first, so that a failed or partial write never leaves it stale
+  PcdDiskCacheInvalidate(pDimm);
+#endif
+
   pFwCmd = AllocateZeroPool(sizeof(*pFwCmd));
   if (pFwCmd == NULL) {
     ReturnCode = EFI_OUT_OF_RESOURCES;
@@ -2919,14 +3151,16 @@ FwCmdSetPlatformConfigData (
     // back entire partition
     if (PartitionId == PCD_OEM_PARTITION_ID) {
       CHECK_RESULT(FwCmdGetPcdLargePayload(pDimm, PCD_OEM_PARTITION_ID, &pOEMPartitionData), Finish);
+      pFwCmd->LargeInputPayloadSize = PCD_PARTITION_SIZE;
+      CHECK_RESULT(AllocateFwCmdLargePayloads(pFwCmd), Finish);
       CopyMem_S(pFwCmd->LargeInputPayload + PCD_OEM_PARTITION_INTEL_CFG_REGION_SIZE,
-                 sizeof(pFwCmd->LargeInputPayload)- PCD_OEM_PARTITION_INTEL_CFG_REGION_SIZE,
+                 pFwCmd->LargeInputPayloadSize - PCD_OEM_PARTITION_INTEL_CFG_REGION_SIZE,
                  pOEMPartitionData + PCD_OEM_PARTITION_INTEL_CFG_REGION_SIZE,
                  PCD_OEM_PARTITION_INTEL_CFG_REGION_SIZE);
-      pFwCmd->LargeInputPayloadSize = PCD_PARTITION_SIZE;
     }
     else {
       pFwCmd->LargeInputPayloadSize = PcdSize;
+      CHECK_RESULT(AllocateFwCmdLargePayloads(pFwCmd), Finish);
     }
     /** Set PCD by large payload in single call **/
     InPayloadSetData.Offset = 0;
@@ -2934,7 +3168,7 @@ FwCmdSetPlatformConfigData (
     CopyMem_S(pFwCmd->InputPayload, sizeof(pFwCmd->InputPayload), &InPayloadSetData, pFwCmd->InputPayloadSize);
 
     /** Save 128KB partition to Large Payload **/
-    CopyMem_S(pFwCmd->LargeInputPayload, sizeof(pFwCmd->LargeInputPayload), pPartition, PcdSize);
+    CopyMem_S(pFwCmd->LargeInputPayload, pFwCmd->LargeInputPayloadSize, pPartition, PcdSize);
 #ifdef OS_BUILD
     ReturnCode = PassThru(pDimm, pFwCmd, PT_LONG_TIMEOUT_INTERVAL);
 #else
@@ -2952,9 +3186,10 @@ FwCmdSetPlatformConfigData (
 
 Finish:
   FREE_POOL_SAFE(pPartition);
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   FREE_POOL_SAFE(pOEMPartitionData);
   NVDIMM_EXIT_I64(ReturnCode);
+  UnlockDimmMailbox(pDimm);
   return ReturnCode;
 }
 
@@ -3015,7 +3250,7 @@ FinishAfterPayloadAlloc:
     FREE_POOL_SAFE(*ppPayloadAlarmThresholds);
   }
 FinishAfterFwCmdAlloc:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
 Finish:
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
@@ -3126,7 +3361,7 @@ FwCmdGetFwDebugLogSize(
   *pLogSizeInMb = pDbgSmallOutPayload->LogSize;
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3249,10 +3484,11 @@ FwCmdGetFwDebugLog (
     pFwCmd->LargeOutputPayloadSize = 0;
   } else {
     ChunkSize = MIB_TO_BYTES(1);
-    OutputPayload = pFwCmd->LargeOutputPayload;
     pInputPayload->PayloadType = DEBUG_LOG_PAYLOAD_TYPE_LARGE;
     pFwCmd->OutputPayloadSize = 0;
     pFwCmd->LargeOutputPayloadSize = OUT_MB_SIZE;
+    CHECK_RESULT(AllocateFwCmdLargePayloads(pFwCmd), Finish);
+    OutputPayload = pFwCmd->LargeOutputPayload;
   }
 
   /** Fetch whole buffer, iterate by chunk size **/
@@ -3278,7 +3514,7 @@ FwCmdGetFwDebugLog (
 
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3331,6 +3567,8 @@ FwCmdGetErrorLog (
   pFwCmd->InputPayloadSize = sizeof(*pInputPayload);
   pFwCmd->OutputPayloadSize = OutputPayloadSize;
   pFwCmd->LargeOutputPayloadSize = LargeOutputPayloadSize;
+  // Large payload is read straight into the caller's buffer
+  pFwCmd->LargeOutputPayload = (pLargeOutputPayload != NULL) ? (UINT8 *)pLargeOutputPayload : NULL;
   CopyMem_S(&pFwCmd->InputPayload, sizeof(pFwCmd->InputPayload), pInputPayload, pFwCmd->InputPayloadSize);
 
   ReturnCode = PassThru(pDimm, pFwCmd, PT_LONG_TIMEOUT_INTERVAL);
@@ -3344,12 +3582,11 @@ FwCmdGetErrorLog (
     CopyMem_S(pOutputPayload, OutputPayloadSize, &pFwCmd->OutPayload, OutputPayloadSize);
   }
 
-  if (pLargeOutputPayload != NULL && LargeOutputPayloadSize > 0) {
-    CopyMem_S(pLargeOutputPayload, LargeOutputPayloadSize, &pFwCmd->LargeOutputPayload, LargeOutputPayloadSize);
-  }
-
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  if (pFwCmd != NULL) {
+    pFwCmd->LargeOutputPayload = NULL;
+  }
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3402,6 +3639,8 @@ FwCmdGetCommandEffectLog(
   pFwCmd->InputPayloadSize = sizeof(*pInputPayload);
   pFwCmd->OutputPayloadSize = OutputPayloadSize;
   pFwCmd->LargeOutputPayloadSize = LargeOutputPayloadSize;
+  // Large payload is read straight into the caller's buffer
+  pFwCmd->LargeOutputPayload = (pLargeOutputPayload != NULL) ? (UINT8 *)pLargeOutputPayload : NULL;
   CopyMem_S(&pFwCmd->InputPayload, sizeof(pFwCmd->InputPayload), pInputPayload, pFwCmd->InputPayloadSize);
 
   ReturnCode = PassThru(pDimm, pFwCmd, PT_TIMEOUT_INTERVAL);
@@ -3415,15 +3654,14 @@ FwCmdGetCommandEffectLog(
     CopyMem_S(pOutputPayload, OutputPayloadSize, &pFwCmd->OutPayload, OutputPayloadSize);
   }
 
-  if (pLargeOutputPayload != NULL && LargeOutputPayloadSize > 0) {
-    CopyMem_S(pLargeOutputPayload, LargeOutputPayloadSize, &pFwCmd->LargeOutputPayload, LargeOutputPayloadSize);
-  }
-
   ReturnCode = EFI_SUCCESS;
   goto Finish;
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  if (pFwCmd != NULL) {
+    pFwCmd->LargeOutputPayload = NULL;
+  }
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3481,7 +3719,7 @@ FwCmdGetSmartAndHealth (
   CopyMem_S(*ppPayloadSmartAndHealth, sizeof(**ppPayloadSmartAndHealth), pFwCmd->OutPayload, sizeof(**ppPayloadSmartAndHealth));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3555,7 +3793,7 @@ FwCmdGetMemoryInfoPage (
   CopyMem_S(*ppPayloadMemoryInfoPage, PageSize, pFwCmd->OutPayload, pFwCmd->OutputPayloadSize);
 
 FinishAfterFwCmdAlloc:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
 Finish:
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
@@ -3614,7 +3852,7 @@ FwCmdGetFirmwareImageInfo (
   CopyMem_S(*ppPayloadFwImage, sizeof(**ppPayloadFwImage), pFwCmd->OutPayload, sizeof(**ppPayloadFwImage));
 
 FinishError:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
 Finish:
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
@@ -3682,7 +3920,7 @@ FinishError:
     FREE_POOL_SAFE(*ppPayloadPowerManagementPolicy);
   }
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3740,7 +3978,7 @@ FwCmdGetPMONRegisters(
   CopyMem_S(pPayloadPMONRegisters, sizeof(*pPayloadPMONRegisters), pFwCmd->OutPayload, sizeof(*pPayloadPMONRegisters));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3795,7 +4033,7 @@ FwCmdSetPMONRegisters(
   }
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -3915,7 +4153,7 @@ FwCmdGetLongOperationStatus(
   ReturnCode = EFI_SUCCESS;
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -5270,6 +5508,9 @@ FreeDimm(
     return;
   }
   FreeBlockWindow(pDimm->pBw);
+#ifdef OS_BUILD
+  os_mutex_delete(pDimm->pMailboxLock, NULL);
+#endif
   FREE_POOL_SAFE(pDimm);
   NVDIMM_EXIT();
 }
@@ -5809,6 +6050,88 @@ Finish:
   return ReturnCode;
 }
 
+/**
+  DIMM_WORKER reading the PCD OEM partition once so that it lands in pPcdOem
+
+  @param[in] pDimm The Intel NVM Dimm to read the PCD from
+  @param[in] pContext Unused
+
+  @retval Status returned by GetPcdOemConfigDataUsingSmallPayload
+**/
+STATIC
+EFI_STATUS
+PrefetchPcdOemWorker(
+  IN     DIMM *pDimm,
+  IN OUT VOID *pContext
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  UINT8 *pRawData = NULL;
+  UINT32 RawDataSize = 0;
+
+  ReturnCode = GetPcdOemConfigDataUsingSmallPayload(pDimm, &pRawData, &RawDataSize);
+  FREE_POOL_SAFE(pRawData);
+  return ReturnCode;
+}
+
+/**
+  Warm the PCD OEM partition cache (pPcdOem) of all manageable DIMMs on the list,
+  reading the DIMMs in parallel. Does nothing when the PCD cache is disabled.
+  Failures are not reported, the regular readers retry and report them.
+
+  @param[in] pDimmList Head of the list of DIMMs
+
+  @retval EFI_SUCCESS Prefetch done or not needed
+  @retval EFI_INVALID_PARAMETER pDimmList is NULL
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+PrefetchPcdOemPartitions(
+  IN     LIST_ENTRY *pDimmList
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  DIMM_WORK_ITEM *pWorkItems = NULL;
+  LIST_ENTRY *pNode = NULL;
+  DIMM *pDimm = NULL;
+  UINT32 DimmCount = 0;
+  UINT32 ItemCount = 0;
+
+  NVDIMM_ENTRY();
+
+  if (pDimmList == NULL) {
+    ReturnCode = EFI_INVALID_PARAMETER;
+    goto Finish;
+  }
+
+  // Without the cache the data read here would simply be thrown away
+  if (!gPCDCacheEnabled) {
+    goto Finish;
+  }
+
+  LIST_COUNT(pNode, pDimmList, DimmCount);
+  if (DimmCount == 0) {
+    goto Finish;
+  }
+
+  CHECK_RESULT_MALLOC(pWorkItems, AllocateZeroPool(sizeof(*pWorkItems) * DimmCount), Finish);
+
+  LIST_FOR_EACH(pNode, pDimmList) {
+    pDimm = DIMM_FROM_NODE(pNode);
+    if (!IsDimmManageable(pDimm) || pDimm->pPcdOem != NULL || pDimm->PcdOemPartitionSize == 0) {
+      continue;
+    }
+    pWorkItems[ItemCount++].pDimm = pDimm;
+  }
+
+  ReturnCode = DispatchDimmWork(pWorkItems, ItemCount, PrefetchPcdOemWorker);
+
+Finish:
+  FREE_POOL_SAFE(pWorkItems);
+  NVDIMM_EXIT_I64(ReturnCode);
+  return ReturnCode;
+}
+
 /**
   Set Platform Config Data OEM Partition Intel config region.
   We only write to the first 64KiB of Intel FW/SW config metadata. The latter
@@ -6382,7 +6705,7 @@ FwCmdFormatDimm(
   }
 
   Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -6434,7 +6757,7 @@ FwCmdGetDdrtIoInitInfo(
   CopyMem_S(pDdrtIoInitInfo, sizeof(*pDdrtIoInitInfo), pFwCmd->OutPayload, sizeof(*pDdrtIoInitInfo));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -6503,7 +6826,7 @@ FwCmdGetCommandAccessPolicy(
   *pRestriction = pOutputCAP->Restriction;
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -6564,7 +6887,7 @@ FwCmdInjectError(
   }
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -6618,7 +6941,7 @@ FwCmdGetSystemTime(
   CopyMem_S(pSystemTimePayload, sizeof(*pSystemTimePayload), pFwCmd->OutPayload, sizeof(*pSystemTimePayload));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -6677,7 +7000,7 @@ FwCmdGetExtendedAdrInfo(
   CopyMem_S(pExtendedAdrInfo, sizeof(*pExtendedAdrInfo), pFwCmd->OutPayload, sizeof(*pExtendedAdrInfo));
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -6809,7 +7132,9 @@ EFI_STATUS ClearPcdCacheOnDimmList(VOID)
         pDimm = DIMM_FROM_NODE(pDimmNode);
         if (NULL != pDimm) {
           // Free memory and set to NULL so won't be used by Get PCD calls
+          LockDimmMailbox(pDimm);
           FREE_POOL_SAFE(pDimm->pPcdOem);
+          UnlockDimmMailbox(pDimm);
         }
       }
     }
@@ -6924,6 +7249,12 @@ PassThru(
   INPUT_PAYLOAD_SMBUS_OS_PASSTHRU *pInputPayloadSOP = NULL;
 #endif
 
+  if ((pCmd->LargeInputPayloadSize > 0 && pCmd->LargeInputPayload == NULL) ||
+      (pCmd->LargeOutputPayloadSize > 0 && pCmd->LargeOutputPayload == NULL)) {
+    NVDIMM_ERR("Large payload size set without an attached buffer");
+    goto Finish;
+  }
+
   IsLargePayloadCommand = pCmd->LargeInputPayloadSize > 0;
   Method = DeterminePassThruMethod(pDimm, IsLargePayloadCommand);
 
@@ -6952,8 +7283,10 @@ PassThru(
   }
 
   // Use the OS passthru dsm mechanism to talk with the DCPMM
-  // for both DDRT and SMBUS
-  ReturnCode = DefaultPassThru(pDimm, pCmd, PT_TIMEOUT_INTERVAL);
+  // for both DDRT and SMBUS. A DIMM runs one mailbox command at a time.
+  LockDimmMailbox(pDimm);
+  ReturnCode = DefaultPassThru(pDimm, pCmd, (Timeout > 0) ? Timeout : PT_TIMEOUT_INTERVAL);
+  UnlockDimmMailbox(pDimm);
 
   // If we're using the special bios emulated command (smbus only
   // for now), do some cleanup and restore previous pCmd values
@@ -6983,6 +7316,271 @@ Finish:
   return ReturnCode;
 }
 
+/**
+  Shared state of a single DispatchDimmWork call
+**/
+typedef struct _DIMM_WORK_DISPATCH {
+  DIMM_WORK_ITEM *pItems;
+  UINT32 ItemCount;
+  DIMM_WORKER Worker;
+  DIMM **ppLanes;           //!< One entry per distinct DIMM, in order of first appearance
+  UINT32 LaneCount;
+  UINT32 NextLane;          //!< Next lane to be picked up, guarded by pLock
+#ifdef OS_BUILD
+  OS_MUTEX *pLock;
+#endif // OS_BUILD
+} DIMM_WORK_DISPATCH;
+
+/**
+  Execute, in array order, all items that belong to the given lane
+
+  @param[in,out] pDispatch Dispatch state
+  @param[in] Lane Index of the lane to execute
+**/
+STATIC
+VOID
+RunDimmWorkLane(
+  IN OUT DIMM_WORK_DISPATCH *pDispatch,
+  IN     UINT32 Lane
+  )
+{
+  UINT32 Index = 0;
+
+  for (Index = 0; Index < pDispatch->ItemCount; Index++) {
+    if (pDispatch->pItems[Index].pDimm == pDispatch->ppLanes[Lane]) {
+      pDispatch->pItems[Index].ReturnCode =
+        pDispatch->Worker(pDispatch->pItems[Index].pDimm, pDispatch->pItems[Index].pContext);
+    }
+  }
+}
+
+#ifdef OS_BUILD
+/**
+  Thread body: keep picking up lanes until none are left
+
+  @param[in] pArg Pointer to the DIMM_WORK_DISPATCH state
+
+  @retval NULL always
+**/
+STATIC
+VOID *
+DimmWorkThread(
+  IN     VOID *pArg
+  )
+{
+  DIMM_WORK_DISPATCH *pDispatch = (DIMM_WORK_DISPATCH *)pArg;
+  UINT32 Lane = 0;
+
+  for (;;) {
+    os_mutex_lock(pDispatch->pLock);
+    Lane = pDispatch->NextLane++;
+    os_mutex_unlock(pDispatch->pLock);
+    if (Lane >= pDispatch->LaneCount) {
+      break;
+    }
+    RunDimmWorkLane(pDispatch, Lane);
+  }
+  return NULL;
+}
+
+/**
+  Check if a playback or record session is active. Both rely on the
+  passthrough calls being issued in a fixed order, so work must stay serial.
+
+  @retval TRUE if a PBR session is active
+**/
+STATIC
+BOOLEAN
+IsPbrSessionActive(
+  VOID
+  )
+{
+  UINT32 PbrMode = PBR_NORMAL_MODE;
+
+  if (EFI_ERROR(PbrGetMode(&PbrMode))) {
+    return FALSE;
+  }
+  return (PBR_NORMAL_MODE != PbrMode);
+}
+#endif // OS_BUILD
+
+/**
+  Run a worker over a set of DIMM work items, one in-flight item per DIMM.
+
+  Items are grouped into lanes by DIMM. Items in one lane run in array order,
+  different lanes run concurrently in the OS build. Every item gets its own
+  ReturnCode slot so results are independent of completion order. Falls back
+  to running the items serially in array order when threads are not available
+  or when a playback/record session is active.
+
+  @param[in,out] pItems Array of work items
+  @param[in] ItemCount Number of items in pItems
+  @param[in] Worker Function executed for every item
+
+  @retval EFI_SUCCESS All items were executed (see per-item ReturnCode)
+  @retval EFI_INVALID_PARAMETER pItems or Worker is NULL, or an item has no DIMM
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+DispatchDimmWork(
+  IN OUT DIMM_WORK_ITEM *pItems,
+  IN     UINT32 ItemCount,
+  IN     DIMM_WORKER Worker
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  DIMM_WORK_DISPATCH Dispatch;
+  UINT32 Index = 0;
+  UINT32 Lane = 0;
+#ifdef OS_BUILD
+  UINT64 Threads[DIMM_WORK_MAX_LANES];
+  UINT32 ThreadCount = 0;
+  UINT32 ThreadsWanted = 0;
+#endif // OS_BUILD
+
+  NVDIMM_ENTRY();
+
+  ZeroMem(&Dispatch, sizeof(Dispatch));
+
+  if ((pItems == NULL && ItemCount > 0) || Worker == NULL) {
+    ReturnCode = EFI_INVALID_PARAMETER;
+    goto Finish;
+  }
+
+  if (ItemCount == 0) {
+    goto Finish;
+  }
+
+  for (Index = 0; Index < ItemCount; Index++) {
+    if (pItems[Index].pDimm == NULL) {
+      ReturnCode = EFI_INVALID_PARAMETER;
+      goto Finish;
+    }
+    pItems[Index].ReturnCode = EFI_NOT_STARTED;
+  }
+
+  Dispatch.pItems = pItems;
+  Dispatch.ItemCount = ItemCount;
+  Dispatch.Worker = Worker;
+  CHECK_RESULT_MALLOC(Dispatch.ppLanes, AllocateZeroPool(sizeof(*Dispatch.ppLanes) * ItemCount), Finish);
+
+  for (Index = 0; Index < ItemCount; Index++) {
+    for (Lane = 0; Lane < Dispatch.LaneCount; Lane++) {
+      if (Dispatch.ppLanes[Lane] == pItems[Index].pDimm) {
+        break;
+      }
+    }
+    if (Lane == Dispatch.LaneCount) {
+      Dispatch.ppLanes[Dispatch.LaneCount++] = pItems[Index].pDimm;
+    }
+  }
+
+#ifdef OS_BUILD
+  if (Dispatch.LaneCount > 1 && !IsPbrSessionActive()) {
+    Dispatch.pLock = os_mutex_init(NULL);
+  }
+
+  if (Dispatch.pLock != NULL) {
+    ThreadsWanted = MIN(Dispatch.LaneCount, DIMM_WORK_MAX_LANES);
+    // The calling thread services lanes as well, so one less helper is needed
+    for (ThreadCount = 0; ThreadCount < ThreadsWanted - 1; ThreadCount++) {
+      if (!os_create_thread(&Threads[ThreadCount], DimmWorkThread, &Dispatch)) {
+        NVDIMM_DBG("Could not create worker thread, continuing with %d", ThreadCount + 1);
+        break;
+      }
+    }
+    DimmWorkThread(&Dispatch);
+    for (Index = 0; Index < ThreadCount; Index++) {
+      os_join_thread(Threads[Index]);
+    }
+    os_mutex_delete(Dispatch.pLock, NULL);
+    goto Finish;
+  }
+#endif // OS_BUILD
+
+  for (Lane = 0; Lane < Dispatch.LaneCount; Lane++) {
+    RunDimmWorkLane(&Dispatch, Lane);
+  }
+
+Finish:
+  FREE_POOL_SAFE(Dispatch.ppLanes);
+  NVDIMM_EXIT_I64(ReturnCode);
+  return ReturnCode;
+}
+
+/**
+  DIMM_WORKER adapter sending a single PASS_THRU_BATCH_ENTRY
+
+  @param[in] pDimm The DCPMM the command targets
+  @param[in,out] pContext The PASS_THRU_BATCH_ENTRY to send
+
+  @retval Status returned by PassThru
+**/
+STATIC
+EFI_STATUS
+PassThruBatchWorker(
+  IN     DIMM *pDimm,
+  IN OUT VOID *pContext
+  )
+{
+  PASS_THRU_BATCH_ENTRY *pEntry = (PASS_THRU_BATCH_ENTRY *)pContext;
+
+  pEntry->ReturnCode = PassThru(pDimm, pEntry->pCmd, pEntry->Timeout);
+  return pEntry->ReturnCode;
+}
+
+/**
+  Send a batch of FW commands, running commands for different DIMMs in parallel.
+  Commands targeting the same DIMM are sent one at a time in array order.
+
+  @param[in,out] pEntries Array of commands to send
+  @param[in] EntryCount Number of entries in pEntries
+
+  @retval EFI_SUCCESS All commands were sent (see per-entry ReturnCode)
+  @retval EFI_INVALID_PARAMETER pEntries is NULL or an entry is incomplete
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+PassThruBatch(
+  IN OUT PASS_THRU_BATCH_ENTRY *pEntries,
+  IN     UINT32 EntryCount
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  DIMM_WORK_ITEM *pItems = NULL;
+  UINT32 Index = 0;
+
+  NVDIMM_ENTRY();
+
+  if (pEntries == NULL && EntryCount > 0) {
+    ReturnCode = EFI_INVALID_PARAMETER;
+    goto Finish;
+  }
+
+  if (EntryCount == 0) {
+    goto Finish;
+  }
+
+  CHECK_RESULT_MALLOC(pItems, AllocateZeroPool(sizeof(*pItems) * EntryCount), Finish);
+
+  for (Index = 0; Index < EntryCount; Index++) {
+    if (pEntries[Index].pDimm == NULL || pEntries[Index].pCmd == NULL) {
+      ReturnCode = EFI_INVALID_PARAMETER;
+      goto Finish;
+    }
+    pEntries[Index].ReturnCode = EFI_NOT_STARTED;
+    pItems[Index].pDimm = pEntries[Index].pDimm;
+    pItems[Index].pContext = &pEntries[Index];
+  }
+
+  ReturnCode = DispatchDimmWork(pItems, EntryCount, PassThruBatchWorker);
+
+Finish:
+  FREE_POOL_SAFE(pItems);
+  NVDIMM_EXIT_I64(ReturnCode);
+  return ReturnCode;
+}
+
 /**
   Makes Bios emulated pass through call and acquires the DCPMM Boot
   Status Register
@@ -7028,7 +7626,7 @@ FwCmdGetBsr(
   NVDIMM_ERR("Bsr received is 0x%x", *pBsrValue);
 
 Finish:
-  FREE_POOL_SAFE(pFwCmd);
+  FREE_FW_CMD_SAFE(pFwCmd);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
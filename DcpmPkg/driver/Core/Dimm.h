@@ -260,6 +260,13 @@ typedef struct _DIMM {
   reloaded. It should not be considered current outside of initialization.
   */
   LABEL_STORAGE_AREA *pLsa;
+
+  /*
+  Lock of the firmware mailbox of this DIMM and of the PCD caches above.
+  Only created by the OS build, where commands to different DIMMs may be
+  sent from different threads at the same time.
+  */
+  VOID *pMailboxLock;
 } DIMM;
 
 #define DIMM_SIGNATURE     SIGNATURE_64('\0', '\0', '\0', '\0', 'D', 'I', 'M', 'M')
@@ -338,9 +345,50 @@ RemoveDimmInventory(
   IN OUT struct _PMEM_DEV *pDev
   );
 
+/**
+  Invalidate the lookup index of the DIMM inventory and bump the inventory
+  generation. Called whenever the DIMM list is rebuilt or torn down.
+**/
+VOID
+InvalidateDimmIndex(
+  );
+
+/**
+  Get the DIMM inventory generation. It changes every time the DIMM list is
+  rebuilt or torn down, so lookup caches built on the list can tell they are stale.
+
+  @retval The current DIMM inventory generation
+**/
+UINT32
+GetDimmInventoryGeneration(
+  );
+
+/**
+  Take the mailbox lock of a DIMM. Commands and PCD cache accesses of one DIMM
+  are serialized, the lock is recursive so they may nest. Does nothing when the
+  DIMM has no lock, as in the UEFI build.
+
+  @param[in] pDimm DIMM to lock, may be NULL
+**/
+VOID
+LockDimmMailbox(
+  IN     DIMM *pDimm
+  );
+
+/**
+  Release the mailbox lock of a DIMM taken by LockDimmMailbox.
+
+  @param[in] pDimm DIMM to unlock, may be NULL
+**/
+VOID
+UnlockDimmMailbox(
+  IN     DIMM *pDimm
+  );
+
 /**
   Get dimm by Dimm ID
-  Scan the dimm list for a dimm identified by Dimm ID
+  Look the dimm up in the DIMM index when pDimms is the inventory list,
+  otherwise scan the dimm list for a dimm identified by Dimm ID
 
   @param[in] DimmID: The SMBIOS Type 17 handle of the dimm
   @param[in] pDimms: The head of the dimm list
@@ -356,7 +404,8 @@ GetDimmByPid(
 
 /**
   Get dimm by Dimm Device Handle as UINT32
-  Scan the dimm list for a dimm identified by Dimm device handle
+  Look the dimm up in the DIMM index when pDimms is the inventory list,
+  otherwise scan the dimm list for a dimm identified by Dimm device handle
 
   @param[in] DimmID: UINT32 device handle of the dimm
   @param[in] pDimms: The head of the dimm list
@@ -923,6 +972,30 @@ FwCmdGetPlatformConfigDataSize (
      OUT UINT32 *pPcdSize
   );
 
+/**
+  Retrieve Pcd data using small payload method only. Data is retrieved in 128
+  byte chunks.
+
+  @param[in]  pDimm       The DIMM to retrieve PCD data from
+  @param[in]  PartitionId The partition ID of the PCD
+  @param[in]  Offset      Offset of data to be read from PCD region
+  @param[in,out] pData    Pointer to a buffer used to retrieve PCD data. Must be at least 128 bytes.
+  @param[in]  DataSize    Size of the pData buffer in bytes.
+
+  @retval EFI_INVALID_PARAMETER NULL pointer for DIMM structure provided
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failure
+  @retval EFI_...               Other errors from subroutines
+  @retval EFI_SUCCESS           Success
+**/
+EFI_STATUS
+FwCmdGetPcdSmallPayload(
+  IN     DIMM   *pDimm,
+  IN     UINT8  PartitionId,
+  IN     UINT32 Offset,
+  IN OUT UINT8  *pData,
+  IN     UINT8  DataSize
+  );
+
 /**
   Firmware command access/write Platform Config Data using small payload only.
 
@@ -1376,6 +1449,22 @@ ClearInterleavedBuffer(
   IN     UINT32 NumOfBytes
   );
 
+/**
+  Warm the PCD OEM partition cache (pPcdOem) of all manageable DIMMs on the list,
+  reading the DIMMs in parallel. Does nothing when the PCD cache is disabled.
+  Failures are not reported, the regular readers retry and report them.
+
+  @param[in] pDimmList Head of the list of DIMMs
+
+  @retval EFI_SUCCESS Prefetch done or not needed
+  @retval EFI_INVALID_PARAMETER pDimmList is NULL
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+PrefetchPcdOemPartitions(
+  IN     LIST_ENTRY *pDimmList
+  );
+
 /**
   Get Platform Config Data OEM partition Intel config region and check a correctness of header.
   We only return the actua PCD config data, from the first 64KiB of Intel FW/SW config metadata.
@@ -1884,6 +1973,80 @@ PassThru(
   IN     UINT64 Timeout
 );
 
+/**
+  Upper bound on the number of DIMM lanes serviced concurrently by DispatchDimmWork
+**/
+#define DIMM_WORK_MAX_LANES 32
+
+/**
+  Per-DIMM unit of work executed by DispatchDimmWork
+
+  @param[in] pDimm The DCPMM the work targets
+  @param[in,out] pContext Caller supplied context for this work item
+
+  @retval Status of the work item, stored in DIMM_WORK_ITEM.ReturnCode
+**/
+typedef
+EFI_STATUS
+(*DIMM_WORKER) (
+  IN     struct _DIMM *pDimm,
+  IN OUT VOID *pContext
+  );
+
+typedef struct _DIMM_WORK_ITEM {
+  struct _DIMM *pDimm;      //!< DCPMM the work targets
+  VOID *pContext;           //!< Passed through to the worker untouched
+  EFI_STATUS ReturnCode;    //!< Status returned by the worker for this item
+} DIMM_WORK_ITEM;
+
+/**
+  Run a worker over a set of DIMM work items, one in-flight item per DIMM.
+
+  Items are grouped into lanes by DIMM. Items in one lane run in array order,
+  different lanes run concurrently in the OS build. Every item gets its own
+  ReturnCode slot so results are independent of completion order. Falls back
+  to running the items serially in array order when threads are not available
+  or when a playback/record session is active.
+
+  @param[in,out] pItems Array of work items
+  @param[in] ItemCount Number of items in pItems
+  @param[in] Worker Function executed for every item
+
+  @retval EFI_SUCCESS All items were executed (see per-item ReturnCode)
+  @retval EFI_INVALID_PARAMETER pItems or Worker is NULL, or an item has no DIMM
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+DispatchDimmWork(
+  IN OUT DIMM_WORK_ITEM *pItems,
+  IN     UINT32 ItemCount,
+  IN     DIMM_WORKER Worker
+  );
+
+typedef struct _PASS_THRU_BATCH_ENTRY {
+  struct _DIMM *pDimm;      //!< DCPMM the command is sent to
+  FW_CMD *pCmd;             //!< Command to send, updated with the FW response
+  UINT64 Timeout;           //!< Passthrough timeout for this command
+  EFI_STATUS ReturnCode;    //!< Status returned by PassThru for this command
+} PASS_THRU_BATCH_ENTRY;
+
+/**
+  Send a batch of FW commands, running commands for different DIMMs in parallel.
+  Commands targeting the same DIMM are sent one at a time in array order.
+
+  @param[in,out] pEntries Array of commands to send
+  @param[in] EntryCount Number of entries in pEntries
+
+  @retval EFI_SUCCESS All commands were sent (see per-entry ReturnCode)
+  @retval EFI_INVALID_PARAMETER pEntries is NULL or an entry is incomplete
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+**/
+EFI_STATUS
+PassThruBatch(
+  IN OUT PASS_THRU_BATCH_ENTRY *pEntries,
+  IN     UINT32 EntryCount
+  );
+
 /**
   Makes Bios emulated pass through call and acquires the DCPMM Boot
   Status Register
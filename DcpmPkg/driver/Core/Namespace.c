@@ -1306,6 +1306,13 @@ ReadLabelStorageArea(
     goto FinishError;
   }
 
+  // Nothing is dirty yet, the LSA matches the DIMM content
+  (*ppLsa)->pDirtySlots = AllocateZeroPool(LABELS_TO_FREE_BYTES(ROUNDUP((*ppLsa)->Index[CurrentIndex].NumberOfLabels, NSINDEX_FREE_ALIGN)));
+  if ((*ppLsa)->pDirtySlots == NULL) {
+    ReturnCode = EFI_OUT_OF_RESOURCES;
+    goto FinishError;
+  }
+
   // Copy the Label area
   if (!IsLargePayloadAvailable(pDimm)) {
     // Copy the Label area
@@ -1366,6 +1373,100 @@ Finish:
 }
 
 
+/**
+  Mark a label slot as changed, so that the next write of the LSA sends it to the DIMM.
+  Does nothing for an LSA without write-back tracking, it is always written whole.
+
+  @param[in,out] pLsa Label Storage Area the slot belongs to
+  @param[in] SlotNumber Number of the changed slot
+**/
+STATIC
+VOID
+MarkLsaSlotDirty(
+  IN OUT LABEL_STORAGE_AREA *pLsa,
+  IN     UINT16 SlotNumber
+  )
+{
+  if (pLsa->pDirtySlots == NULL || SlotNumber >= pLsa->Index[FIRST_INDEX_BLOCK].NumberOfLabels) {
+    return;
+  }
+  pLsa->pDirtySlots[LABELS_TO_FREE_BYTES(SlotNumber)] |= (UINT8)(1 << (SlotNumber % NSINDEX_FREE_ALIGN));
+}
+
+/**
+  Write back only the changed parts of a Label Storage Area read from the DIMM.
+
+  The order keeps the two index block update protocol crash-consistent: first the
+  changed labels that are in use by the new current index, which are free slots for
+  the previous index, then the changed index blocks. Until the new index block lands
+  the previous one stays valid and still describes unmodified labels. Labels freed
+  by the update are not written, their content is irrelevant once the index lands.
+
+  @param[in] pDimm Target DIMM
+  @param[in] pLsa Label Storage Area with write-back tracking
+  @param[in] CurrentIndex Index block describing the LSA after the update
+  @param[in] UseNamespace_1_1 TRUE if the labels are stored in the 1.1 format
+
+  @retval EFI_SUCCESS All changes written, tracking cleared
+  @retval Other errors from the DIMM, tracking left untouched
+**/
+STATIC
+EFI_STATUS
+WriteDirtyLabelStorageArea(
+  IN     DIMM *pDimm,
+  IN OUT LABEL_STORAGE_AREA *pLsa,
+  IN     UINT16 CurrentIndex,
+  IN     BOOLEAN UseNamespace_1_1
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  UINT8 *pIndexArea = NULL;
+  UINT64 IndexSize = 0;
+  UINT32 PageSize = 0;
+  UINT32 Slot = 0;
+  UINT32 Index = 0;
+  UINT16 SlotStatus = SLOT_UNKNOWN;
+
+  NVDIMM_ENTRY();
+
+  IndexSize = pLsa->Index[CurrentIndex].MySize;
+  PageSize = (UseNamespace_1_1) ? sizeof(NAMESPACE_LABEL_1_1) : sizeof(NAMESPACE_LABEL);
+
+  for (Slot = 0; Slot < pLsa->Index[CurrentIndex].NumberOfLabels; Slot++) {
+    if (pLsa->pDirtySlots[LABELS_TO_FREE_BYTES(Slot)] == 0) {
+      Slot += NSINDEX_FREE_ALIGN - 1 - (Slot % NSINDEX_FREE_ALIGN);
+      continue;
+    }
+    if (!(pLsa->pDirtySlots[LABELS_TO_FREE_BYTES(Slot)] & (1 << (Slot % NSINDEX_FREE_ALIGN)))) {
+      continue;
+    }
+    CheckSlotStatus(&pLsa->Index[CurrentIndex], (UINT16)Slot, &SlotStatus);
+    if (SlotStatus != SLOT_USED) {
+      continue;
+    }
+    CHECK_RESULT(FwSetPCDFromOffsetSmallPayload(pDimm, PCD_LSA_PARTITION_ID, (UINT8 *)&pLsa->pLabels[Slot],
+      (UINT32)((NAMESPACE_INDEXES * IndexSize) + (PageSize * Slot)), PageSize), Finish);
+  }
+
+  for (Index = 0; Index < NAMESPACE_INDEXES; Index++) {
+    if (!(pLsa->DirtyIndexes & (1 << Index))) {
+      continue;
+    }
+    CHECK_RESULT(LabelIndexAreaToRawData(pLsa, Index, &pIndexArea), Finish);
+    CHECK_RESULT(FwSetPCDFromOffsetSmallPayload(pDimm, PCD_LSA_PARTITION_ID, pIndexArea,
+      (UINT32)(Index * IndexSize), (UINT32)IndexSize), Finish);
+    FREE_POOL_SAFE(pIndexArea);
+  }
+
+  ZeroMem(pLsa->pDirtySlots, LABELS_TO_FREE_BYTES(ROUNDUP(pLsa->Index[CurrentIndex].NumberOfLabels, NSINDEX_FREE_ALIGN)));
+  pLsa->DirtyIndexes = 0;
+
+Finish:
+  FREE_POOL_SAFE(pIndexArea);
+  NVDIMM_EXIT_I64(ReturnCode);
+  return ReturnCode;
+}
+
 /**
   Writes Label Storage Area to a specified DIMM.
 
@@ -1430,6 +1531,12 @@ WriteLabelStorageArea(
      UseNamespace_1_1 = TRUE;
   }
 
+  // An LSA read from the DIMM only needs its changed parts written back
+  if (pLsa->pDirtySlots != NULL) {
+    ReturnCode = WriteDirtyLabelStorageArea(pDimm, pLsa, CurrentIndex, UseNamespace_1_1);
+    goto Finish;
+  }
+
   ReturnCode = OpenNvmDimmProtocol(gNvmDimmConfigProtocolGuid, (VOID **)&pNvmDimmConfigProtocol, NULL);
   if (EFI_ERROR(ReturnCode)) {
     goto Finish;
@@ -2386,6 +2493,31 @@ BOOLEAN IsLSANotInitializedOnDimms()
   return returncode;
 }
 
+/**
+  DIMM_WORKER reading the LSA of a single DIMM into pDimm->pLsa
+
+  @param[in] pDimm DIMM to read the LSA from
+  @param[in] pContext Unused
+
+  @retval Status returned by ReadLabelStorageArea
+**/
+STATIC
+EFI_STATUS
+ReadLabelStorageAreaWorker(
+  IN     DIMM *pDimm,
+  IN OUT VOID *pContext
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  LABEL_STORAGE_AREA *pLsa = NULL;
+
+  ReturnCode = ReadLabelStorageArea(pDimm->DimmID, &pLsa);
+  if (!EFI_ERROR(ReturnCode)) {
+    pDimm->pLsa = pLsa;
+  }
+  return ReturnCode;
+}
+
 /**
   Initializes Namespaces inventory
 
@@ -2408,10 +2540,18 @@ InitializeNamespaces(
   EFI_STATUS TempReturnCode = EFI_INVALID_PARAMETER;
   LIST_ENTRY *pNode = NULL;
   DIMM *pDimm = NULL;
-  LABEL_STORAGE_AREA *pLsa = NULL;
+  DIMM_WORK_ITEM *pWorkItems = NULL;
+  UINT32 DimmCount = 0;
+  UINT32 ItemCount = 0;
+  UINT32 Index = 0;
 
   NVDIMM_ENTRY();
 
+  LIST_COUNT(pNode, &gNvmDimmData->PMEMDev.Dimms, DimmCount);
+  if (DimmCount > 0) {
+    CHECK_RESULT_MALLOC(pWorkItems, AllocateZeroPool(sizeof(*pWorkItems) * DimmCount), Finish);
+  }
+
   LIST_FOR_EACH(pNode, &gNvmDimmData->PMEMDev.Dimms) {
     pDimm = DIMM_FROM_NODE(pNode);
     if (pDimm->pLsa != NULL) {
@@ -2423,7 +2563,15 @@ InitializeNamespaces(
       continue;
     }
 
-    TempReturnCode = ReadLabelStorageArea(pDimm->DimmID, &pLsa);
+    pWorkItems[ItemCount++].pDimm = pDimm;
+  }
+
+  // The LSA of every DIMM is read in parallel, results are then handled in DIMM list order
+  CHECK_RESULT(DispatchDimmWork(pWorkItems, ItemCount, ReadLabelStorageAreaWorker), Finish);
+
+  for (Index = 0; Index < ItemCount; Index++) {
+    pDimm = pWorkItems[Index].pDimm;
+    TempReturnCode = pWorkItems[Index].ReturnCode;
     if (TempReturnCode == EFI_NOT_FOUND) {
       NVDIMM_DBG("LSA not found on DIMM 0x%x", pDimm->DeviceHandle.AsUint32);
       pDimm->LsaStatus = LSA_NOT_INIT;
@@ -2440,8 +2588,6 @@ InitializeNamespaces(
       NVDIMM_DBG("LSA corrupted on DIMM 0x%x", pDimm->DeviceHandle.AsUint32);
       continue;
     }
-
-    pDimm->pLsa = pLsa;
   }
 
   LIST_FOR_EACH(pNode, &gNvmDimmData->PMEMDev.Dimms) {
@@ -2465,6 +2611,7 @@ InitializeNamespaces(
     pDimm->LsaStatus = LSA_OK;
   }
 
+Finish:
   //cleanup cache
   LIST_FOR_EACH(pNode, &gNvmDimmData->PMEMDev.Dimms) {
     pDimm = DIMM_FROM_NODE(pNode);
@@ -2473,6 +2620,7 @@ InitializeNamespaces(
       pDimm->pLsa = NULL;
     }
   }
+  FREE_POOL_SAFE(pWorkItems);
 
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
@@ -4071,6 +4219,7 @@ InsertNamespaceLabels(
     ppLabel[Index]->Slot = SlotNumber;
     CopyMem_S(&pLsa->pLabels[SlotNumber], sizeof(pLsa->pLabels[SlotNumber]), ppLabel[Index], sizeof(pLsa->pLabels[SlotNumber]));
     ChangeSlotStatus(&pLsa->Index[NextIndex], SlotNumber, SLOT_USED);
+    MarkLsaSlotDirty(pLsa, SlotNumber);
   }
   ReturnCode = UpdateLsaIndex(pLsa);
   if (EFI_ERROR(ReturnCode)) {
@@ -4188,6 +4337,8 @@ ModifyLabelAtSlot(
   ChangeSlotStatus(&pLsa->Index[NextIndex], NewSlot, SLOT_USED);
   ChangeSlotStatus(&pLsa->Index[NextIndex], SlotNumber, SLOT_FREE);
   ZeroMem(&pLsa->pLabels[SlotNumber], sizeof(pLsa->pLabels[SlotNumber]));
+  MarkLsaSlotDirty(pLsa, NewSlot);
+  MarkLsaSlotDirty(pLsa, SlotNumber);
 
   ReturnCode = UpdateLsaIndex(pLsa);
   if (EFI_ERROR(ReturnCode)) {
@@ -4336,6 +4487,7 @@ RemoveNamespaceLabels(
       goto Finish;
     }
     ZeroMem(pLabel, sizeof(*pLabel));
+    MarkLsaSlotDirty(pLsa, Index);
     NVDIMM_DBG("Removing label from slot %d", Index);
   }
 
@@ -4473,6 +4625,7 @@ UpdateLsaIndex(
   ChecksumInserted = ChecksumOperations(pRawData, pLsa->Index[CurrentIndex].MySize,
                                          (UINT64 *)(pRawData + ChecksumOffset), TRUE);
   pLsa->Index[NextIndex].Checksum = *(UINT64 *)(pRawData + ChecksumOffset);
+  pLsa->DirtyIndexes |= (UINT8)(1 << NextIndex);
   if (!ChecksumInserted) {
     NVDIMM_DBG("Could not insert the checksum after LSA update.");
     ReturnCode = EFI_OUT_OF_RESOURCES;
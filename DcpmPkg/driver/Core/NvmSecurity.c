@@ -71,7 +71,7 @@ GetDimmSecurityState(
   ReturnCode = EFI_SUCCESS;
 
 FinishFreeMem:
-  FREE_POOL_SAFE(pPassThruCommand);
+  FREE_FW_CMD_SAFE(pPassThruCommand);
 Finish:
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
@@ -146,7 +146,7 @@ SetDimmSecurityState(
   ReturnCode = EFI_SUCCESS;
 
 FinishFreeMem:
-  FREE_POOL_SAFE(pPassThruCommand);
+  FREE_FW_CMD_SAFE(pPassThruCommand);
 Finish:
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
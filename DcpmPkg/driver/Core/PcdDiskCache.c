@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+  Persistent PCD OEM cache shared by consecutive ipmctl invocations.
+
+  Every DIMM gets one file under the STATE_FILE_PATH directory holding a
+  PCD_DISK_CACHE_HEADER followed by the PCD OEM config data. An entry is
+  trusted only for the same DIMM UID, FW version and boot, and only while the
+  first block of the partition and the config input/output sequence numbers
+  on the DIMM are unchanged. BIOS rewrites the PCD only during boot and ipmctl
+  drops the entry before its own PCD/LSA writes.
+**/
+
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Debug.h>
+#include <Utility.h>
+#include <PcdCommon.h>
+#include <Pbr.h>
+#include <os.h>
+#include <os_efi_preferences.h>
+#include "PcdDiskCache.h"
+#ifndef _MSC_VER
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define PCD_DISK_CACHE_DATA_ALIGN(Size)   (((Size) + sizeof(UINT64) - 1) & ~(sizeof(UINT64) - 1))
+
+// The data follows the header, it stays 8 byte aligned only with a multiple of 8 header
+C_ASSERT(sizeof(PCD_DISK_CACHE_HEADER) % sizeof(UINT64) == 0);
+
+// Serializes the first IsPcdDiskCacheEnabled call of concurrently dispatched DIMM work
+STATIC OS_RWLOCK *volatile gPcdDiskCacheInitLock = NULL;
+
+/**
+  Check the ini configuration whether the on-disk PCD cache is enabled.
+  The configuration is read only on the first call.
+
+  @retval TRUE if the cache is enabled and usable in this session
+**/
+BOOLEAN
+IsPcdDiskCacheEnabled(
+  )
+{
+  static BOOLEAN PcdDiskCacheInitialized = FALSE;
+  static BOOLEAN PcdDiskCacheEnabled = FALSE;
+  EFI_GUID Guid = { 0 };
+  UINT8 Enabled = 0;
+  UINTN Size = sizeof(Enabled);
+  UINT32 PbrMode = PBR_NORMAL_MODE;
+  CHAR8 BootId[PCD_DISK_CACHE_BOOT_ID_LEN];
+  OS_RWLOCK *pInitLock = NULL;
+  BOOLEAN CacheEnabled = FALSE;
+
+  // Recording and playback sessions must see (or replay) the real passthroughs
+  if (EFI_ERROR(PbrGetMode(&PbrMode)) || PBR_NORMAL_MODE != PbrMode) {
+    return FALSE;
+  }
+
+  pInitLock = os_rwlock_get_static(&gPcdDiskCacheInitLock);
+  if (pInitLock == NULL) {
+    return FALSE;
+  }
+  os_rwlock_w_lock(pInitLock);
+
+  if (PcdDiskCacheInitialized) {
+    goto Finish;
+  }
+  PcdDiskCacheInitialized = TRUE;
+
+  if (EFI_ERROR(GET_VARIABLE(INI_PREFERENCES_PCD_DISK_CACHE_ENABLED, Guid, &Size, &Enabled)) || Enabled != 1) {
+    goto Finish;
+  }
+
+  // Without a boot identifier BIOS changes made during a reboot could not be detected
+  if (0 != os_get_boot_id(BootId, sizeof(BootId))) {
+    NVDIMM_DBG("Boot id not available, PCD disk cache disabled");
+    goto Finish;
+  }
+
+  PcdDiskCacheEnabled = TRUE;
+
+Finish:
+  CacheEnabled = PcdDiskCacheEnabled;
+  os_rwlock_w_unlock(pInitLock);
+  return CacheEnabled;
+}
+
+#ifndef _MSC_VER
+/**
+  Build the cache file path of a DIMM
+
+  @param[in] pDimm DIMM to build the path for
+  @param[out] pPath Buffer for the path
+  @param[out] pDimmUid Optional buffer for the ASCII DIMM UID, MAX_DIMM_UID_LENGTH bytes
+
+  @retval EFI_SUCCESS Path built
+  @retval EFI_NOT_FOUND The DIMM has no UID or the cache directory is not configured
+**/
+STATIC
+EFI_STATUS
+GetPcdDiskCachePath(
+  IN     DIMM *pDimm,
+     OUT CHAR8 *pPath,
+     OUT CHAR8 *pDimmUid OPTIONAL
+  )
+{
+  EFI_GUID Guid = { 0 };
+  CHAR16 DimmUid[MAX_DIMM_UID_LENGTH];
+  CHAR8 AsciiDimmUid[MAX_DIMM_UID_LENGTH];
+  OS_PATH CacheDir;
+
+  ZeroMem(DimmUid, sizeof(DimmUid));
+  ZeroMem(AsciiDimmUid, sizeof(AsciiDimmUid));
+
+  if (EFI_ERROR(GetDimmUid(pDimm, DimmUid, MAX_DIMM_UID_LENGTH)) || DimmUid[0] == L'\0') {
+    return EFI_NOT_FOUND;
+  }
+  UnicodeStrToAsciiStrS(DimmUid, AsciiDimmUid, MAX_DIMM_UID_LENGTH);
+
+  if (EFI_ERROR(preferences_get_string_ascii(INI_PREFERENCES_STATE_FILE_PATH, Guid, sizeof(CacheDir) - 1, CacheDir)) ||
+      CacheDir[0] == '\0') {
+    return EFI_NOT_FOUND;
+  }
+
+  AsciiSPrint(pPath, OS_PATH_LEN, "%s%s%s%s", CacheDir, PCD_DISK_CACHE_FILE_PREFIX, AsciiDimmUid, PCD_DISK_CACHE_FILE_SUFFIX);
+  if (pDimmUid != NULL) {
+    CopyMem_S(pDimmUid, MAX_DIMM_UID_LENGTH, AsciiDimmUid, MAX_DIMM_UID_LENGTH);
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Read a UINT32 of the PCD OEM partition from the DIMM. Values within the part of
+  the partition already read are taken from it, others are read a small payload
+  block at a time.
+
+  @param[in] pDimm DIMM to read from, its mailbox locked
+  @param[in] pData Start of the partition, already read from the DIMM
+  @param[in] DataSize Size of pData
+  @param[in] Offset Offset of the value within the partition
+  @param[out] pValue The value
+
+  @retval EFI_SUCCESS Value read
+  @retval EFI_... Errors of the small payload read
+**/
+STATIC
+EFI_STATUS
+ReadPcdUint32(
+  IN     DIMM *pDimm,
+  IN     UINT8 *pData,
+  IN     UINT32 DataSize,
+  IN     UINT32 Offset,
+     OUT UINT32 *pValue
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  UINT8 Blocks[2 * PCD_GET_SMALL_PAYLOAD_DATA_SIZE];
+  UINT32 BlockOffset = Offset - (Offset % PCD_GET_SMALL_PAYLOAD_DATA_SIZE);
+  UINT32 Index = 0;
+
+  if ((UINT64)Offset + sizeof(*pValue) <= DataSize) {
+    CopyMem_S(pValue, sizeof(*pValue), pData + Offset, sizeof(*pValue));
+    return EFI_SUCCESS;
+  }
+
+  // A value may straddle two blocks
+  for (Index = 0; BlockOffset + Index * PCD_GET_SMALL_PAYLOAD_DATA_SIZE < Offset + sizeof(*pValue); ++Index) {
+    ReturnCode = FwCmdGetPcdSmallPayload(pDimm, PCD_OEM_PARTITION_ID, BlockOffset + Index * PCD_GET_SMALL_PAYLOAD_DATA_SIZE,
+      Blocks + Index * PCD_GET_SMALL_PAYLOAD_DATA_SIZE, (UINT8)PCD_GET_SMALL_PAYLOAD_DATA_SIZE);
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+  }
+  CopyMem_S(pValue, sizeof(*pValue), Blocks + (Offset - BlockOffset), sizeof(*pValue));
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the config input/output sequence numbers of the PCD OEM partition on a DIMM.
+  The sequence numbers change with every configuration request and BIOS response,
+  so they tell whether the partition changed since a cache entry was written.
+  A table that is absent or does not fit in the partition gives 0.
+
+  @param[in] pDimm DIMM to read from, its mailbox locked
+  @param[in] pData Start of the partition already read from the DIMM, at least the config header
+  @param[in] DataSize Size of pData
+  @param[in] OemDataSize Size of the OEM config data as reported by the config header
+  @param[out] pCinSequenceNumber Config input sequence number
+  @param[out] pCoutSequenceNumber Config output sequence number
+
+  @retval EFI_SUCCESS Sequence numbers read
+  @retval EFI_... Errors of the small payload read
+**/
+STATIC
+EFI_STATUS
+GetPcdSequenceNumbers(
+  IN     DIMM *pDimm,
+  IN     UINT8 *pData,
+  IN     UINT32 DataSize,
+  IN     UINT32 OemDataSize,
+     OUT UINT32 *pCinSequenceNumber,
+     OUT UINT32 *pCoutSequenceNumber
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  NVDIMM_CONFIGURATION_HEADER *pConfHeader = (NVDIMM_CONFIGURATION_HEADER *)pData;
+
+  *pCinSequenceNumber = 0;
+  *pCoutSequenceNumber = 0;
+
+  if (pConfHeader->ConfInputDataSize != 0 &&
+      (UINT64)pConfHeader->ConfInputStartOffset + sizeof(NVDIMM_PLATFORM_CONFIG_INPUT) <= OemDataSize) {
+    ReturnCode = ReadPcdUint32(pDimm, pData, DataSize,
+      pConfHeader->ConfInputStartOffset + OFFSET_OF(NVDIMM_PLATFORM_CONFIG_INPUT, SequenceNumber), pCinSequenceNumber);
+    if (EFI_ERROR(ReturnCode)) {
+      return ReturnCode;
+    }
+  }
+  if (pConfHeader->ConfOutputDataSize != 0 &&
+      (UINT64)pConfHeader->ConfOutputStartOffset + sizeof(NVDIMM_PLATFORM_CONFIG_OUTPUT) <= OemDataSize) {
+    ReturnCode = ReadPcdUint32(pDimm, pData, DataSize,
+      pConfHeader->ConfOutputStartOffset + OFFSET_OF(NVDIMM_PLATFORM_CONFIG_OUTPUT, SequenceNumber), pCoutSequenceNumber);
+  }
+  return ReturnCode;
+}
+#endif // _MSC_VER
+
+/**
+  Load the PCD OEM config data of a DIMM from the on-disk cache.
+
+  The cache entry is used only if it was written for the same DIMM UID, FW version and
+  boot, its first block matches the one just read from the DIMM and the config
+  input/output sequence numbers read from the DIMM match those of the entry.
+  Must be called with the DIMM mailbox locked.
+
+  @param[in] pDimm DIMM the data belongs to
+  @param[in] pFirstBlock First small payload block just read from the DIMM
+  @param[in] OemDataSize Size of the OEM config data as reported by the config header
+  @param[out] pBuffer Buffer for the data
+  @param[in] BufferSize Size of pBuffer, at least OemDataSize
+
+  @retval EFI_SUCCESS Data loaded from the cache
+  @retval EFI_NOT_FOUND No cache entry or the entry is stale or corrupted
+  @retval EFI_INVALID_PARAMETER NULL parameter or buffer too small
+**/
+EFI_STATUS
+PcdDiskCacheLoad(
+  IN     DIMM *pDimm,
+  IN     UINT8 *pFirstBlock,
+  IN     UINT32 OemDataSize,
+     OUT UINT8 *pBuffer,
+  IN     UINT32 BufferSize
+  )
+{
+  EFI_STATUS ReturnCode = EFI_NOT_FOUND;
+#ifndef _MSC_VER
+  OS_PATH CachePath;
+  CHAR8 DimmUid[MAX_DIMM_UID_LENGTH];
+  CHAR8 BootId[PCD_DISK_CACHE_BOOT_ID_LEN];
+  PCD_DISK_CACHE_HEADER *pHeader = NULL;
+  UINT8 *pImage = MAP_FAILED;
+  UINT64 ImageSize = 0;
+  UINT32 CinSequenceNumber = 0;
+  UINT32 CoutSequenceNumber = 0;
+  struct stat FileStat;
+  int Fd = -1;
+
+  NVDIMM_ENTRY();
+
+  if (pDimm == NULL || pFirstBlock == NULL || pBuffer == NULL || BufferSize < OemDataSize) {
+    ReturnCode = EFI_INVALID_PARAMETER;
+    goto Finish;
+  }
+
+  if (!IsPcdDiskCacheEnabled() || OemDataSize == 0) {
+    goto Finish;
+  }
+
+  ZeroMem(BootId, sizeof(BootId));
+  if (EFI_ERROR(GetPcdDiskCachePath(pDimm, CachePath, DimmUid)) ||
+      0 != os_get_boot_id(BootId, sizeof(BootId))) {
+    goto Finish;
+  }
+
+  if ((Fd = open(CachePath, O_RDONLY)) < 0) {
+    goto Finish;
+  }
+
+  ImageSize = sizeof(*pHeader) + PCD_DISK_CACHE_DATA_ALIGN(OemDataSize);
+  if (fstat(Fd, &FileStat) != 0 || (UINT64)FileStat.st_size != ImageSize) {
+    NVDIMM_DBG("PCD disk cache entry %s has unexpected size", CachePath);
+    goto Finish;
+  }
+
+  pImage = mmap(NULL, ImageSize, PROT_READ, MAP_PRIVATE, Fd, 0);
+  if (pImage == MAP_FAILED) {
+    goto Finish;
+  }
+  pHeader = (PCD_DISK_CACHE_HEADER *)pImage;
+
+  // Cheap key checks first, the checksum walks the whole file
+  if (pHeader->Signature != PCD_DISK_CACHE_SIGNATURE ||
+      pHeader->Version != PCD_DISK_CACHE_VERSION ||
+      pHeader->DataOffset != sizeof(*pHeader) ||
+      pHeader->DataSize != OemDataSize ||
+      CompareMem(pHeader->DimmUid, DimmUid, sizeof(pHeader->DimmUid)) != 0 ||
+      CompareMem(pHeader->BootId, BootId, sizeof(pHeader->BootId)) != 0 ||
+      CompareMem(&pHeader->FwVer, &pDimm->FwVer, sizeof(pHeader->FwVer)) != 0 ||
+      CompareMem(pHeader->FirstBlock, pFirstBlock, sizeof(pHeader->FirstBlock)) != 0) {
+    NVDIMM_DBG("PCD disk cache entry %s is stale", CachePath);
+    goto Finish;
+  }
+
+  if (!ChecksumOperations(pImage, ImageSize, &pHeader->Checksum, FALSE)) {
+    NVDIMM_WARN("PCD disk cache entry %s is corrupted", CachePath);
+    goto Finish;
+  }
+
+  // Last, these cost up to two small payload reads
+  if (EFI_ERROR(GetPcdSequenceNumbers(pDimm, pFirstBlock, PCD_GET_SMALL_PAYLOAD_DATA_SIZE, OemDataSize, &CinSequenceNumber, &CoutSequenceNumber)) ||
+      CinSequenceNumber != pHeader->CinSequenceNumber || CoutSequenceNumber != pHeader->CoutSequenceNumber) {
+    NVDIMM_DBG("PCD disk cache entry %s is stale, the config sequence numbers changed", CachePath);
+    goto Finish;
+  }
+
+  CopyMem_S(pBuffer, BufferSize, pImage + pHeader->DataOffset, OemDataSize);
+  ReturnCode = EFI_SUCCESS;
+
+Finish:
+  if (pImage != MAP_FAILED) {
+    munmap(pImage, ImageSize);
+  }
+  if (Fd >= 0) {
+    close(Fd);
+  }
+  NVDIMM_EXIT_I64(ReturnCode);
+#endif // _MSC_VER
+  return ReturnCode;
+}
+
+/**
+  Store the PCD OEM config data of a DIMM in the on-disk cache.
+  The file is written under a temporary name and renamed, so readers never see a partial entry.
+
+  @param[in] pDimm DIMM the data belongs to
+  @param[in] pData PCD OEM config data, starting with the config header
+  @param[in] OemDataSize Size of pData
+
+  @retval EFI_SUCCESS Entry stored
+  @retval EFI_INVALID_PARAMETER NULL parameter or size out of range
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+  @retval EFI_DEVICE_ERROR The cache file could not be written
+**/
+EFI_STATUS
+PcdDiskCacheStore(
+  IN     DIMM *pDimm,
+  IN     UINT8 *pData,
+  IN     UINT32 OemDataSize
+  )
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+#ifndef _MSC_VER
+  OS_PATH CachePath;
+  OS_PATH TmpPath;
+  PCD_DISK_CACHE_HEADER *pHeader = NULL;
+  UINT8 *pImage = NULL;
+  UINT32 ImageSize = 0;
+  FILE *pFile = NULL;
+  int Fd = -1;
+
+  NVDIMM_ENTRY();
+
+  if (pDimm == NULL || pData == NULL || OemDataSize < PCD_GET_SMALL_PAYLOAD_DATA_SIZE ||
+      OemDataSize > PCD_OEM_PARTITION_INTEL_CFG_REGION_SIZE) {
+    ReturnCode = EFI_INVALID_PARAMETER;
+    goto Finish;
+  }
+
+  if (!IsPcdDiskCacheEnabled()) {
+    goto Finish;
+  }
+
+  ImageSize = sizeof(*pHeader) + PCD_DISK_CACHE_DATA_ALIGN(OemDataSize);
+  CHECK_RESULT_MALLOC(pImage, AllocateZeroPool(ImageSize), Finish);
+  pHeader = (PCD_DISK_CACHE_HEADER *)pImage;
+
+  if (EFI_ERROR(GetPcdDiskCachePath(pDimm, CachePath, pHeader->DimmUid)) ||
+      0 != os_get_boot_id(pHeader->BootId, sizeof(pHeader->BootId))) {
+    goto Finish;
+  }
+
+  pHeader->Signature = PCD_DISK_CACHE_SIGNATURE;
+  pHeader->Version = PCD_DISK_CACHE_VERSION;
+  pHeader->DataOffset = sizeof(*pHeader);
+  pHeader->DataSize = OemDataSize;
+  CopyMem_S(&pHeader->FwVer, sizeof(pHeader->FwVer), &pDimm->FwVer, sizeof(pDimm->FwVer));
+  CopyMem_S(pHeader->FirstBlock, sizeof(pHeader->FirstBlock), pData, sizeof(pHeader->FirstBlock));
+  CopyMem_S(pImage + pHeader->DataOffset, ImageSize - pHeader->DataOffset, pData, OemDataSize);
+  // pData was just read from the DIMM, nothing is read again
+  if (EFI_ERROR(GetPcdSequenceNumbers(pDimm, pData, OemDataSize, OemDataSize, &pHeader->CinSequenceNumber, &pHeader->CoutSequenceNumber))) {
+    goto Finish;
+  }
+  ChecksumOperations(pImage, ImageSize, &pHeader->Checksum, TRUE);
+
+  os_mkdir(CachePath);
+  AsciiSPrint(TmpPath, sizeof(TmpPath), "%s.XXXXXX", CachePath);
+  if ((Fd = mkstemp(TmpPath)) < 0 || (pFile = fdopen(Fd, "wb")) == NULL) {
+    NVDIMM_DBG("Failed to create the PCD disk cache entry %s", TmpPath);
+    ReturnCode = EFI_DEVICE_ERROR;
+    goto Finish;
+  }
+  Fd = -1;
+
+  if (1 != fwrite(pImage, ImageSize, 1, pFile)) {
+    ReturnCode = EFI_DEVICE_ERROR;
+    goto Finish;
+  }
+  if (0 != fclose(pFile)) {
+    pFile = NULL;
+    unlink(TmpPath);
+    ReturnCode = EFI_DEVICE_ERROR;
+    goto Finish;
+  }
+  pFile = NULL;
+
+  if (0 != rename(TmpPath, CachePath)) {
+    unlink(TmpPath);
+    ReturnCode = EFI_DEVICE_ERROR;
+    goto Finish;
+  }
+
+Finish:
+  if (pFile != NULL) {
+    fclose(pFile);
+    unlink(TmpPath);
+  } else if (Fd >= 0) {
+    close(Fd);
+    unlink(TmpPath);
+  }
+  FREE_POOL_SAFE(pImage);
+  NVDIMM_EXIT_I64(ReturnCode);
+#endif // _MSC_VER
+  return ReturnCode;
+}
+
+/**
+  Remove the on-disk PCD cache entry of a DIMM.
+  Must be called before ipmctl modifies the PCD or LSA of the DIMM.
+
+  @param[in] pDimm DIMM to drop the entry for
+**/
+VOID
+PcdDiskCacheInvalidate(
+  IN     DIMM *pDimm
+  )
+{
+#ifndef _MSC_VER
+  OS_PATH CachePath;
+
+  if (pDimm == NULL) {
+    return;
+  }
+
+  // Done even when the cache is off, an entry left by an earlier run must not outlive this write
+  if (EFI_ERROR(GetPcdDiskCachePath(pDimm, CachePath, NULL))) {
+    return;
+  }
+  unlink(CachePath);
+#endif // _MSC_VER
+}
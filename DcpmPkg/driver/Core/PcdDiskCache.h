@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _PCD_DISK_CACHE_H_
+#define _PCD_DISK_CACHE_H_
+
+#include <Types.h>
+#include "Dimm.h"
+
+#ifdef OS_BUILD
+
+#define INI_PREFERENCES_PCD_DISK_CACHE_ENABLED  L"PCD_DISK_CACHE_ENABLED"
+#define INI_PREFERENCES_STATE_FILE_PATH         "STATE_FILE_PATH"
+
+#define PCD_DISK_CACHE_SIGNATURE      SIGNATURE_64('I', 'P', 'M', 'P', 'C', 'D', 'C', 'A')
+#define PCD_DISK_CACHE_VERSION        2
+#define PCD_DISK_CACHE_FILE_PREFIX    "pcd_cache_"
+#define PCD_DISK_CACHE_FILE_SUFFIX    ".bin"
+#define PCD_DISK_CACHE_BOOT_ID_LEN    40
+
+#pragma pack(push)
+#pragma pack(1)
+/**
+  On-disk PCD OEM cache file header, one file per DIMM.
+  The PCD OEM config data follows the header at DataOffset, so that the file
+  can be mapped and the data used in place. The header is a multiple of 8 bytes
+  and the data is zero padded to 8 bytes, so the data is 8 byte aligned and
+  the checksum covers the whole file.
+**/
+typedef struct _PCD_DISK_CACHE_HEADER {
+  UINT64 Signature;                                   //!< PCD_DISK_CACHE_SIGNATURE
+  UINT32 Version;                                     //!< PCD_DISK_CACHE_VERSION
+  UINT32 DataOffset;                                  //!< Offset of the PCD data from the start of the file
+  UINT64 Checksum;                                    //!< Fletcher64 over the whole file, 0 while computed
+  UINT32 DataSize;                                    //!< Size of the PCD OEM config data
+  UINT32 CinSequenceNumber;                           //!< Config input sequence number on the DIMM when the data was read
+  UINT32 CoutSequenceNumber;                          //!< Config output sequence number on the DIMM when the data was read
+  UINT32 Reserved;
+  CHAR8 DimmUid[MAX_DIMM_UID_LENGTH];                 //!< UID of the DIMM the data was read from
+  CHAR8 BootId[PCD_DISK_CACHE_BOOT_ID_LEN];           //!< Boot the data was read in, BIOS only rewrites PCD at boot
+  FIRMWARE_VERSION FwVer;                             //!< FW version the data was read with
+  UINT8 FirstBlock[PCD_GET_SMALL_PAYLOAD_DATA_SIZE];  //!< First small payload block of the partition (config header)
+  UINT8 Reserved2[2];                                 //!< Keeps the data 8 byte aligned
+} PCD_DISK_CACHE_HEADER;
+#pragma pack(pop)
+
+/**
+  Check the ini configuration whether the on-disk PCD cache is enabled.
+  The configuration is read only on the first call.
+
+  @retval TRUE if the cache is enabled and usable in this session
+**/
+BOOLEAN
+IsPcdDiskCacheEnabled(
+  );
+
+/**
+  Load the PCD OEM config data of a DIMM from the on-disk cache.
+
+  The cache entry is used only if it was written for the same DIMM UID, FW version and
+  boot, its first block matches the one just read from the DIMM and the config
+  input/output sequence numbers read from the DIMM match those of the entry.
+  Must be called with the DIMM mailbox locked.
+
+  @param[in] pDimm DIMM the data belongs to
+  @param[in] pFirstBlock First small payload block just read from the DIMM
+  @param[in] OemDataSize Size of the OEM config data as reported by the config header
+  @param[out] pBuffer Buffer for the data
+  @param[in] BufferSize Size of pBuffer, at least OemDataSize
+
+  @retval EFI_SUCCESS Data loaded from the cache
+  @retval EFI_NOT_FOUND No cache entry or the entry is stale or corrupted
+  @retval EFI_INVALID_PARAMETER NULL parameter or buffer too small
+**/
+EFI_STATUS
+PcdDiskCacheLoad(
+  IN     DIMM *pDimm,
+  IN     UINT8 *pFirstBlock,
+  IN     UINT32 OemDataSize,
+     OUT UINT8 *pBuffer,
+  IN     UINT32 BufferSize
+  );
+
+/**
+  Store the PCD OEM config data of a DIMM in the on-disk cache.
+  The file is written under a temporary name and renamed, so readers never see a partial entry.
+
+  @param[in] pDimm DIMM the data belongs to
+  @param[in] pData PCD OEM config data, starting with the config header
+  @param[in] OemDataSize Size of pData
+
+  @retval EFI_SUCCESS Entry stored
+  @retval EFI_INVALID_PARAMETER NULL parameter or size out of range
+  @retval EFI_OUT_OF_RESOURCES Memory allocation failure
+  @retval EFI_DEVICE_ERROR The cache file could not be written
+**/
+EFI_STATUS
+PcdDiskCacheStore(
+  IN     DIMM *pDimm,
+  IN     UINT8 *pData,
+  IN     UINT32 OemDataSize
+  );
+
+/**
+  Remove the on-disk PCD cache entry of a DIMM.
+  Must be called before ipmctl modifies the PCD or LSA of the DIMM.
+
+  @param[in] pDimm DIMM to drop the entry for
+**/
+VOID
+PcdDiskCacheInvalidate(
+  IN     DIMM *pDimm
+  );
+
+#endif // OS_BUILD
+#endif // _PCD_DISK_CACHE_H_
@@ -197,6 +197,9 @@ InitializeISs(
   }
 
   if (!UseNfit) {
+    // Read every DIMM's PCD in parallel up front, the parser below then works from the cache
+    PrefetchPcdOemPartitions(pDimmList);
+
     ReturnCode = RetrieveISsFromPlatformConfigData(pFitHead, pDimmList, pISList);
     if (EFI_ERROR(ReturnCode)) {
       NVDIMM_DBG("Retrieving Interleave Sets from the Platform Config Data failed.");
@@ -413,6 +413,7 @@ NvmDimmDriverUnload(
   /**
     clean up data struct
   **/
+  InvalidateDimmIndex();
   FREE_POOL_SAFE(gNvmDimmData);
 
   if (EFI_ERROR(ReturnCode) && DriverAlreadyUnloaded) {
@@ -1610,6 +1610,34 @@ Finish:
   return ReturnCode;
 }
 
+/**
+  Per-DIMM context used to fill DIMM_INFO entries through DispatchDimmWork
+**/
+typedef struct _DIMM_INFO_WORK {
+  DIMM_INFO_CATEGORIES Categories;
+  DIMM_INFO *pDimmInfo;
+} DIMM_INFO_WORK;
+
+/**
+  DIMM_WORKER filling a single DIMM_INFO
+
+  @param[in] pDimm DIMM that will be used to create DIMM_INFO
+  @param[in,out] pContext DIMM_INFO_WORK describing the categories and output
+
+  @retval Status returned by GetDimmInfo
+**/
+STATIC
+EFI_STATUS
+GetDimmInfoWorker(
+  IN     DIMM *pDimm,
+  IN OUT VOID *pContext
+  )
+{
+  DIMM_INFO_WORK *pWork = (DIMM_INFO_WORK *)pContext;
+
+  return GetDimmInfo(pDimm, pWork->Categories, pWork->pDimmInfo);
+}
+
 /**
   Retrieve the list of DCPMMs found in NFIT
 
@@ -1637,6 +1665,9 @@ GetDimms(
   UINT32 Index = 0;
   LIST_ENTRY *pNode = NULL;
   DIMM *pCurDimm = NULL;
+  DIMM_WORK_ITEM *pWorkItems = NULL;
+  DIMM_INFO_WORK *pWork = NULL;
+  EFI_STATUS DispatchReturnCode = EFI_SUCCESS;
 
   NVDIMM_ENTRY();
 
@@ -1658,6 +1689,13 @@ GetDimms(
 
   SetMem(pDimms, sizeof(*pDimms) * DimmCount, 0); // this clears error mask as well
 
+  if (DimmCount == 0) {
+    goto Finish;
+  }
+
+  CHECK_RESULT_MALLOC(pWorkItems, AllocateZeroPool(sizeof(*pWorkItems) * DimmCount), Finish);
+  CHECK_RESULT_MALLOC(pWork, AllocateZeroPool(sizeof(*pWork) * DimmCount), Finish);
+
   Index = 0;
   LIST_FOR_EACH(pNode, &gNvmDimmData->PMEMDev.Dimms) {
     pCurDimm = DIMM_FROM_NODE(pNode);
@@ -1668,14 +1706,25 @@ GetDimms(
     if (DimmCount <= Index) {
       NVDIMM_DBG("Array is too small to hold entire DIMM list");
       ReturnCode = EFI_INVALID_PARAMETER;
-      goto Finish;
+      break;
     }
 
-    GetDimmInfo(pCurDimm, dimmInfoCategories, &pDimms[Index]);
+    pWork[Index].Categories = dimmInfoCategories;
+    pWork[Index].pDimmInfo = &pDimms[Index];
+    pWorkItems[Index].pDimm = pCurDimm;
+    pWorkItems[Index].pContext = &pWork[Index];
     Index++;
   }
 
+  // Entries that fit are still filled in when the array is too small
+  DispatchReturnCode = DispatchDimmWork(pWorkItems, Index, GetDimmInfoWorker);
+  if (EFI_ERROR(DispatchReturnCode) && !EFI_ERROR(ReturnCode)) {
+    ReturnCode = DispatchReturnCode;
+  }
+
 Finish:
+  FREE_POOL_SAFE(pWorkItems);
+  FREE_POOL_SAFE(pWork);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
@@ -4175,6 +4224,36 @@ Finish:
   return ReturnCode;
 }
 
+/**
+  Prepare a Get Log Page command reading one memory info page
+
+  @param[in] pDimm DIMM the command is sent to
+  @param[in] PageNum Memory info page to read
+  @param[in] PageSize Size of the page payload
+  @param[out] pFwCmd Command to fill in
+**/
+STATIC
+VOID
+InitMemoryInfoPageCmd(
+  IN     DIMM *pDimm,
+  IN     UINT8 PageNum,
+  IN     UINT32 PageSize,
+     OUT FW_CMD *pFwCmd
+  )
+{
+    PT_INPUT_PAYLOAD_MEMORY_INFO InputPayload;
+
+    ZeroMem(&InputPayload, sizeof(InputPayload));
+    InputPayload.MemoryPage = PageNum;
+
+    pFwCmd->DimmID = pDimm->DimmID;
+    pFwCmd->Opcode = PtGetLog;
+    pFwCmd->SubOpcode = SubopMemInfo;
+    pFwCmd->InputPayloadSize = sizeof(InputPayload);
+    pFwCmd->OutputPayloadSize = PageSize;
+    CopyMem_S(pFwCmd->InputPayload, sizeof(pFwCmd->InputPayload), &InputPayload, pFwCmd->InputPayloadSize);
+}
+
 /**
 Gather info about performance on all dimms
 
@@ -4199,6 +4278,10 @@ GetDimmsPerformanceData(
     DIMM *pDimm = NULL;
     LIST_ENTRY *pDimmNode = NULL;
     UINT32 Index = 0;
+    UINT32 EntryCount = 0;
+    FW_CMD *pFwCmds = NULL;
+    PASS_THRU_BATCH_ENTRY *pEntries = NULL;
+    DIMM_PERFORMANCE_DATA *pPerformanceData = NULL;
     PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE0 *pPayloadMemInfoPage0 = NULL;
     PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1 *pPayloadMemInfoPage1 = NULL;
 
@@ -4217,6 +4300,20 @@ GetDimmsPerformanceData(
         goto Finish;
     }
 
+    if (*pDimmCount == 0) {
+        goto Finish;
+    }
+
+    // Memory info pages 0 and 1 for the DIMM at Index are pFwCmds[2 * Index] and pFwCmds[2 * Index + 1]
+    pFwCmds = AllocateZeroPool(sizeof(*pFwCmds) * 2 * (*pDimmCount));
+    pEntries = AllocateZeroPool(sizeof(*pEntries) * 2 * (*pDimmCount));
+    if (NULL == pFwCmds || NULL == pEntries) {
+        NVDIMM_ERR("Memory allocation failure");
+        ReturnCode = EFI_OUT_OF_RESOURCES;
+        FREE_POOL_SAFE(*pDimmsPerformanceData);
+        goto Finish;
+    }
+
     LIST_FOR_UNTIL_INDEX(pDimmNode, &gNvmDimmData->PMEMDev.Dimms, *pDimmCount, Index) {
         pDimm = DIMM_FROM_NODE(pDimmNode);
 
@@ -4226,41 +4323,55 @@ GetDimmsPerformanceData(
         }
         (*pDimmsPerformanceData)[Index].DimmId = pDimm->DimmID;
 
-        // Get Dimm Performance data
-        ReturnCode = FwCmdGetMemoryInfoPage(pDimm, MEMORY_INFO_PAGE_0,
-            sizeof(PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE0), (VOID **)&pPayloadMemInfoPage0);
-        if (EFI_ERROR(ReturnCode)) {
-            NVDIMM_ERR("Could not read the memory info page 0; Return code 0x%08x", ReturnCode);
-            ReturnCode = EFI_DEVICE_ERROR;
-            FREE_POOL_SAFE(*pDimmsPerformanceData);
-            goto Finish;
-        }
-        ReturnCode = FwCmdGetMemoryInfoPage(pDimm, MEMORY_INFO_PAGE_1,
-            sizeof(PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1), (VOID **)&pPayloadMemInfoPage1);
-        if (EFI_ERROR(ReturnCode)) {
-            NVDIMM_ERR("Could not read the memory info page 1; Return code 0x%08x", ReturnCode);
+        InitMemoryInfoPageCmd(pDimm, MEMORY_INFO_PAGE_0, sizeof(PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE0), &pFwCmds[2 * Index]);
+        InitMemoryInfoPageCmd(pDimm, MEMORY_INFO_PAGE_1, sizeof(PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1), &pFwCmds[2 * Index + 1]);
+
+        pEntries[EntryCount].pDimm = pDimm;
+        pEntries[EntryCount].pCmd = &pFwCmds[2 * Index];
+        pEntries[EntryCount].Timeout = PT_TIMEOUT_INTERVAL;
+        EntryCount++;
+        pEntries[EntryCount].pDimm = pDimm;
+        pEntries[EntryCount].pCmd = &pFwCmds[2 * Index + 1];
+        pEntries[EntryCount].Timeout = PT_TIMEOUT_INTERVAL;
+        EntryCount++;
+    }
+
+    ReturnCode = PassThruBatch(pEntries, EntryCount);
+    if (EFI_ERROR(ReturnCode)) {
+        FREE_POOL_SAFE(*pDimmsPerformanceData);
+        goto Finish;
+    }
+
+    // Report the first failure in DIMM list order
+    for (Index = 0; Index < EntryCount; Index++) {
+        if (EFI_ERROR(pEntries[Index].ReturnCode)) {
+            NVDIMM_ERR("Could not read the memory info page %d of Dimm 0x%x; Return code 0x%08x",
+                Index % 2, pEntries[Index].pDimm->DeviceHandle.AsUint32, pEntries[Index].ReturnCode);
             ReturnCode = EFI_DEVICE_ERROR;
             FREE_POOL_SAFE(*pDimmsPerformanceData);
             goto Finish;
         }
+    }
 
-        // Copy the data
-        (*pDimmsPerformanceData)[Index].MediaReads = pPayloadMemInfoPage0->MediaReads;
-        (*pDimmsPerformanceData)[Index].MediaWrites = pPayloadMemInfoPage0->MediaWrites;
-        (*pDimmsPerformanceData)[Index].ReadRequests = pPayloadMemInfoPage0->ReadRequests;
-        (*pDimmsPerformanceData)[Index].WriteRequests = pPayloadMemInfoPage0->WriteRequests;
-        (*pDimmsPerformanceData)[Index].TotalMediaReads = pPayloadMemInfoPage1->TotalMediaReads;
-        (*pDimmsPerformanceData)[Index].TotalMediaWrites = pPayloadMemInfoPage1->TotalMediaWrites;
-        (*pDimmsPerformanceData)[Index].TotalReadRequests = pPayloadMemInfoPage1->TotalReadRequests;
-        (*pDimmsPerformanceData)[Index].TotalWriteRequests = pPayloadMemInfoPage1->TotalWriteRequests;
+    // Copy the data
+    for (Index = 0; Index < EntryCount; Index += 2) {
+        pPerformanceData = &(*pDimmsPerformanceData)[(pEntries[Index].pCmd - pFwCmds) / 2];
+        pPayloadMemInfoPage0 = (PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE0 *)pEntries[Index].pCmd->OutPayload;
+        pPayloadMemInfoPage1 = (PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1 *)pEntries[Index + 1].pCmd->OutPayload;
 
-        FREE_POOL_SAFE(pPayloadMemInfoPage0);
-        FREE_POOL_SAFE(pPayloadMemInfoPage1);
+        pPerformanceData->MediaReads = pPayloadMemInfoPage0->MediaReads;
+        pPerformanceData->MediaWrites = pPayloadMemInfoPage0->MediaWrites;
+        pPerformanceData->ReadRequests = pPayloadMemInfoPage0->ReadRequests;
+        pPerformanceData->WriteRequests = pPayloadMemInfoPage0->WriteRequests;
+        pPerformanceData->TotalMediaReads = pPayloadMemInfoPage1->TotalMediaReads;
+        pPerformanceData->TotalMediaWrites = pPayloadMemInfoPage1->TotalMediaWrites;
+        pPerformanceData->TotalReadRequests = pPayloadMemInfoPage1->TotalReadRequests;
+        pPerformanceData->TotalWriteRequests = pPayloadMemInfoPage1->TotalWriteRequests;
     }
 
 Finish:
-    FREE_POOL_SAFE(pPayloadMemInfoPage0);
-    FREE_POOL_SAFE(pPayloadMemInfoPage1);
+    FREE_POOL_SAFE(pEntries);
+    FREE_POOL_SAFE(pFwCmds);
     NVDIMM_EXIT_I64(ReturnCode);
     return ReturnCode;
 }
@@ -5229,7 +5340,7 @@ Finish:
   ClearNvmStatus(GetObjectStatus(pCommandStatus, pCurrentDimm->DeviceHandle.AsUint32), NVM_OPERATION_IN_PROGRESS);
 
 FinishClean:
-  FREE_POOL_SAFE(pPassThruCommand);
+  FREE_FW_CMD_SAFE(pPassThruCommand);
   FREE_POOL_SAFE(pErrorMessage);
 
   NVDIMM_EXIT_I64(ReturnCode);
@@ -5333,7 +5444,12 @@ UpdateDimmFw(
   if (IsLargePayloadAvailable(pCurrentDimm)) {
     FwUpdatePacket.PayloadTypeSelector = FW_UPDATE_LARGE_PAYLOAD_SELECTOR;
     pPassThruCommand->LargeInputPayloadSize = (UINT32)ImageBufferSize;
-    CopyMem_S(pPassThruCommand->LargeInputPayload, sizeof(pPassThruCommand->LargeInputPayload), pImageBuffer, ImageBufferSize);
+    ReturnCode = AllocateFwCmdLargePayloads(pPassThruCommand);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_DBG("Failed to attach the large input payload (%lld bytes).\n", ImageBufferSize);
+      goto Finish;
+    }
+    CopyMem_S(pPassThruCommand->LargeInputPayload, pPassThruCommand->LargeInputPayloadSize, pImageBuffer, ImageBufferSize);
     CopyMem_S(pPassThruCommand->InputPayload, sizeof(pPassThruCommand->InputPayload), &FwUpdatePacket, sizeof(FwUpdatePacket));
     do {
       pPassThruCommand->Status = 0;
@@ -5472,7 +5588,7 @@ UpdateDimmFw(
   ReturnCode = EFI_SUCCESS;
 
 Finish:
-  FREE_POOL_SAFE(pPassThruCommand);
+  FREE_FW_CMD_SAFE(pPassThruCommand);
   FREE_POOL_SAFE(pErrorMessage);
 
   NVDIMM_EXIT_I64(ReturnCode);
@@ -8079,6 +8195,44 @@ Finish:
   return ReturnCode;
 }
 
+/**
+  Per-DIMM context used to fetch error logs through DispatchDimmWork
+**/
+typedef struct _ERROR_LOG_WORK {
+  BOOLEAN ThermalError;
+  BOOLEAN HighLevel;
+  UINT16 SequenceNumber;
+  UINT32 MaxErrorsToSave;
+  UINT32 ErrorsFetched;
+  ERROR_LOG_INFO *pErrorLogs;
+} ERROR_LOG_WORK;
+
+/**
+  DIMM_WORKER fetching the error log of a single DIMM
+
+  @param[in] pDimm DIMM to get errors from
+  @param[in,out] pContext ERROR_LOG_WORK describing the request and output
+
+  @retval Status returned by GetAndParseFwErrorLogForDimm
+**/
+STATIC
+EFI_STATUS
+GetErrorLogWorker(
+  IN     DIMM *pDimm,
+  IN OUT VOID *pContext
+  )
+{
+  ERROR_LOG_WORK *pWork = (ERROR_LOG_WORK *)pContext;
+
+  return GetAndParseFwErrorLogForDimm(pDimm,
+    pWork->ThermalError,
+    pWork->HighLevel,
+    pWork->SequenceNumber,
+    pWork->MaxErrorsToSave,
+    &pWork->ErrorsFetched,
+    pWork->pErrorLogs);
+}
+
 /**
   Get Error log for given dimm
 
@@ -8113,8 +8267,15 @@ GetErrorLog(
   DIMM *pDimms[MAX_DIMMS];
   UINT32 DimmsNum = 0;
   UINT32 Index = 0;
-  UINT32 SingleDimmErrorsFetched = 0;
   UINT32 AllErrorsFetched = 0;
+  UINT32 ErrorsToCopy = 0;
+  UINT32 ErrorsMissing = 0;
+  UINT32 WaveStart = 0;
+  UINT32 WaveSize = 0;
+  UINT32 ItemCount = 0;
+  DIMM_WORK_ITEM *pWorkItems = NULL;
+  ERROR_LOG_WORK *pWork = NULL;
+  ERROR_LOG_INFO *pDimmErrorLogs = NULL;
 
   SetMem(pDimms, sizeof(pDimms), 0x0);
 
@@ -8133,26 +8294,60 @@ GetErrorLog(
   }
 
   ResetCmdStatus(pCommandStatus, NVM_SUCCESS);
-  for (Index = 0; Index < DimmsNum && AllErrorsFetched < *pErrorLogCount; ++Index) {
-    ReturnCode = GetAndParseFwErrorLogForDimm(pDimms[Index],
-      ThermalError,
-      HighLevel,
-      SequenceNumber,
-      (*pErrorLogCount - AllErrorsFetched),
-      &SingleDimmErrorsFetched,
-      &pErrorLogs[AllErrorsFetched]);
+  if (DimmsNum == 0 || *pErrorLogCount == 0) {
+    goto Finish;
+  }
 
-    if (EFI_ERROR(ReturnCode)) {
-      goto Finish;
-    }
+  /**
+    DIMMs are fetched in waves of at most DIMM_WORK_MAX_LANES, in parallel,
+    each into its own slice sized for what is still missing. The slices are
+    packed in DIMM order and no further wave is started once the request is
+    filled. This gives the same result as fetching each DIMM with the space
+    left after the previous ones.
+  **/
+  WaveSize = MIN(DimmsNum, DIMM_WORK_MAX_LANES);
+  CHECK_RESULT_MALLOC(pWorkItems, AllocateZeroPool(sizeof(*pWorkItems) * WaveSize), Finish);
+  CHECK_RESULT_MALLOC(pWork, AllocateZeroPool(sizeof(*pWork) * WaveSize), Finish);
+  CHECK_RESULT_MALLOC(pDimmErrorLogs,
+    AllocateZeroPool(sizeof(*pDimmErrorLogs) * (*pErrorLogCount) * WaveSize), Finish);
+
+  for (WaveStart = 0; WaveStart < DimmsNum && AllErrorsFetched < *pErrorLogCount; WaveStart += WaveSize) {
+    ErrorsMissing = *pErrorLogCount - AllErrorsFetched;
+    ItemCount = MIN(DimmsNum - WaveStart, WaveSize);
+
+    for (Index = 0; Index < ItemCount; ++Index) {
+      ZeroMem(&pWork[Index], sizeof(pWork[Index]));
+      pWork[Index].ThermalError = ThermalError;
+      pWork[Index].HighLevel = HighLevel;
+      pWork[Index].SequenceNumber = SequenceNumber;
+      pWork[Index].MaxErrorsToSave = ErrorsMissing;
+      pWork[Index].pErrorLogs = &pDimmErrorLogs[Index * ErrorsMissing];
+      pWorkItems[Index].pDimm = pDimms[WaveStart + Index];
+      pWorkItems[Index].pContext = &pWork[Index];
+    }
+
+    CHECK_RESULT(DispatchDimmWork(pWorkItems, ItemCount, GetErrorLogWorker), Finish);
+
+    for (Index = 0; Index < ItemCount && AllErrorsFetched < *pErrorLogCount; ++Index) {
+      ReturnCode = pWorkItems[Index].ReturnCode;
+      if (EFI_ERROR(ReturnCode)) {
+        goto Finish;
+      }
 
-    AllErrorsFetched += SingleDimmErrorsFetched;
+      ErrorsToCopy = MIN(pWork[Index].ErrorsFetched, *pErrorLogCount - AllErrorsFetched);
+      CopyMem_S(&pErrorLogs[AllErrorsFetched], sizeof(*pErrorLogs) * (*pErrorLogCount - AllErrorsFetched),
+        pWork[Index].pErrorLogs, sizeof(*pErrorLogs) * ErrorsToCopy);
+      AllErrorsFetched += ErrorsToCopy;
+    }
   }
 
 Finish:
   if (pErrorLogCount != NULL) {
     *pErrorLogCount = AllErrorsFetched;
   }
+  FREE_POOL_SAFE(pWorkItems);
+  FREE_POOL_SAFE(pWork);
+  FREE_POOL_SAFE(pDimmErrorLogs);
   NVDIMM_EXIT_I64(ReturnCode);
   return ReturnCode;
 }
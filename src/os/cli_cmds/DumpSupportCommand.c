@@ -10,6 +10,7 @@
 #include "LoadCommand.h"
 #include "Debug.h"
 #include "Convert.h"
+#include <os_efi_output.h>
 #include <stdio.h>
 
 extern EFI_SHELL_PARAMETERS_PROTOCOL gOsShellParametersProtocol;
@@ -236,6 +237,7 @@ DumpSupportCommand(
     FREE_POOL_SAFE(pCmdInputWithDimmId);
   } //end for dimmIndex
 
+  output_sink_flush();
   fclose(gOsShellParametersProtocol.StdOut);
   gOsShellParametersProtocol.StdOut = stdout;
 
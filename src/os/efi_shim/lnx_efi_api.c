@@ -79,7 +79,9 @@ passthru_os(
   EFI_STATUS Rc = EFI_SUCCESS;
   UINT32 ReturnCode;
 
-  ReturnCode = ioctl_passthrough_fw_cmd((struct fw_cmd *)pCmd);
+  // EFI timeouts count 100 ns periods, the ioctl layer works in microseconds
+  ReturnCode = ioctl_passthrough_fw_cmd((struct fw_cmd *)pCmd,
+    (Timeout > 0) ? (unsigned long long)Timeout / 10 : 0);
   if (0 == ReturnCode)
   {
     Rc = EFI_SUCCESS;
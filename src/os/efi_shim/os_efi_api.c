@@ -39,6 +39,7 @@
 #include "os_efi_simple_file_protocol.h"
 #include "os_efi_bs_protocol.h"
 #include "os_efi_shell_parameters_protocol.h"
+#include "os_efi_output.h"
 #include "os.h"
 #include "os_common.h"
 #include <os_efi_api.h>
@@ -99,6 +100,29 @@ enum
 */
 static struct debug_logger_config g_log_config = { 0 };
 
+/*
+* Firmware commands sent through DefaultPassThru, DIMMs may be queried from several threads.
+*/
+static volatile UINT64 g_passthru_count = 0;
+
+/*
+* The PBR session replays and records passthroughs in order and is not thread safe,
+* DIMMs queried from several threads take turns on it.
+*/
+static OS_RWLOCK *volatile g_pbr_passthru_lock = NULL;
+
+/*
+* The SMBIOS table is loaded on first use, which may come from several DIMM threads at once.
+*/
+static OS_RWLOCK *volatile g_smbios_table_lock = NULL;
+
+UINT64
+get_passthru_count(
+)
+{
+  return g_passthru_count;
+}
+
 EFI_STATUS
 EFIAPI
 DefaultPassThru(
@@ -110,27 +134,65 @@ DefaultPassThru(
   EFI_STATUS Rc = EFI_SUCCESS;
   EFI_STATUS PbrRc = EFI_SUCCESS;
   UINT32 DimmID;
+  UINT64 StartUsec = 0;
+  UINT64 LatencyUsec = 0;
+  UINT64 ReplayUsec = 0;
   PbrContext *pContext = PBR_CTX();
+  OS_RWLOCK *pPbrLock = NULL;
 
   if (!pDimm || !pCmd)
     return EFI_INVALID_PARAMETER;
 
+#ifdef _MSC_VER
+  _InterlockedIncrement64((volatile __int64 *)&g_passthru_count);
+#else
+  __sync_fetch_and_add(&g_passthru_count, 1);
+#endif
+
+  if (PBR_NORMAL_MODE != PBR_GET_MODE(pContext))
+  {
+    pPbrLock = os_rwlock_get_static(&g_pbr_passthru_lock);
+  }
+
+  // The OS and the recordings address the DIMM by its NFIT device handle
+  DimmID = pCmd->DimmID;
+  pCmd->DimmID = pDimm->DeviceHandle.AsUint32;
+
   if (PBR_PLAYBACK_MODE == PBR_GET_MODE(pContext))
   {
-    Rc = PbrGetPassThruRecord(pContext, pCmd, &PbrRc);
+    if (pPbrLock)
+      os_rwlock_w_lock(pPbrLock);
+    Rc = PbrGetPassThruRecord(pContext, pCmd, &PbrRc, &ReplayUsec);
+    if (pPbrLock)
+      os_rwlock_w_unlock(pPbrLock);
+    pCmd->DimmID = DimmID;
+    // the recorded latency is replayed outside the lock, other DIMMs keep going meanwhile
+    if (ReplayUsec > 0) {
+      gBS->Stall((UINTN)ReplayUsec);
+    }
+    pCmd->Attempts = 1;
+    pCmd->ElapsedUs = ReplayUsec;
     if (EFI_SUCCESS == Rc) {
       Rc = PbrRc;
     }
     return Rc;
   }
 
-  DimmID = pCmd->DimmID;
-  pCmd->DimmID = pDimm->DeviceHandle.AsUint32;
+  StartUsec = os_get_monotonic_usec();
   Rc = passthru_os(pDimm, pCmd, (long)Timeout);
+  LatencyUsec = os_get_monotonic_usec() - StartUsec;
+  if (pCmd->Attempts > 1) {
+    NVDIMM_DBG("Passthrough 0x%x:0x%x to DIMM 0x%x was busy, %d attempts in %lld us\n",
+      pCmd->Opcode, pCmd->SubOpcode, DimmID, pCmd->Attempts, pCmd->ElapsedUs);
+  }
 
   if (PBR_RECORD_MODE == PBR_GET_MODE(pContext))
   {
-      Rc = PbrSetPassThruRecord(pContext, pCmd, Rc);
+    if (pPbrLock)
+      os_rwlock_w_lock(pPbrLock);
+    Rc = PbrSetPassThruRecord(pContext, pCmd, Rc, LatencyUsec);
+    if (pPbrLock)
+      os_rwlock_w_unlock(pPbrLock);
   }
   pCmd->DimmID = DimmID;
 
@@ -269,11 +331,17 @@ GetFirstAndBoundSmBiosStructPointer(
   smbios_table_recording *recording = NULL;
   UINT32 record_size = 0;
   PbrContext *pContext = PBR_CTX();
+  OS_RWLOCK *pSmbiosLock = NULL;
 
   if (pSmBiosStruct == NULL || pLastSmBiosStruct == NULL || pSmbiosVersion == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
+  if (NULL == (pSmbiosLock = os_rwlock_get_static(&g_smbios_table_lock))) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  os_rwlock_w_lock(pSmbiosLock);
+
   // One time initialization
   if (NULL == gSmbiosTable && PBR_PLAYBACK_MODE != PBR_GET_MODE(pContext))
   {
@@ -354,6 +422,7 @@ Finish:
     NVDIMM_ERR("Failed to retrieve smbios table\n");
     ReturnCode = EFI_END_OF_FILE;
   }
+  os_rwlock_w_unlock(pSmbiosLock);
   return ReturnCode;
 }
 
@@ -442,18 +511,15 @@ void (*rel_assert) (void) = NULL;
 static void write_system_event_to_stdout(const char* source, const char* message)
 {
   NVM_EVENT_MSG ascii_event_message = { 0 };
-  CHAR16 w_event_message[sizeof(ascii_event_message)] = { 0 };
 
   // Prepare string
   os_strcat(ascii_event_message, sizeof(ascii_event_message), source);
   os_strcat(ascii_event_message, sizeof(ascii_event_message), " ");
   os_strcat(ascii_event_message, sizeof(ascii_event_message), message);
   os_strcat(ascii_event_message, sizeof(ascii_event_message), "\n");
-  // Convert to the unicode
-  AsciiStrToUnicodeStr(ascii_event_message, w_event_message);
 
-  // Send it to standard output
-  Print(FORMAT_STR, w_event_message);
+  // Send it to standard output, the message is ASCII already
+  output_sink_write_utf8(gOsShellParametersProtocol.StdOut, ascii_event_message, strlen(ascii_event_message));
 }
 
 /**
@@ -494,6 +560,7 @@ DebugPrint(
     AsciiVSPrint(event_message, size, Format, args);
     VA_END(args);
     write_system_event_to_stdout(NVM_DEBUG_LOGGER_SOURCE, event_message);
+    output_sink_flush();
 #ifdef NDEBUG
     rel_assert ();
 #else // NDEBUG
@@ -591,23 +658,28 @@ Print(
 )
 {
   va_list argptr;
+  int Length;
   va_start(argptr, Format);
-  vfwprintf(gOsShellParametersProtocol.StdOut, Format, argptr);
+  Length = output_sink_vprint(gOsShellParametersProtocol.StdOut, Format, argptr);
   va_end(argptr);
-  fflush(gOsShellParametersProtocol.StdOut);
-  return 0;
+  return (UINTN)Length;
 }
 
+/**
+Prints a formatted Unicode string to stdout right away, bypassing the batching
+of the output sink. Used for progress messages.
+**/
 UINTN
 EFIAPI
 PrintNoBuffer(CHAR16* Format, ...)
 {
   va_list argptr;
+  int Length;
   va_start(argptr, Format);
-  vfwprintf(stdout, Format, argptr);
+  Length = output_sink_vprint(stdout, Format, argptr);
   va_end(argptr);
-  fflush(stdout);
-  return 0;
+  output_sink_flush();
+  return (UINTN)Length;
 }
 /**
 Frees a buffer that was previously allocated with one of the pool allocation functions in the
@@ -906,39 +978,33 @@ CatVSPrint(
 )
 {
   INT32   CharactersRequired;
-  UINTN   SizeRequired;
+  UINTN   StringLength = 0;
   CHAR16  *BufferToReturn;
-  VA_LIST ExtraMarker;
+  CHAR16  EvalBuff[1024];
+  CHAR16  *pFormatted = NULL;
 
-  VA_COPY(ExtraMarker, Marker);
-  static const int nBuffSize = 8192;
-  static wchar_t evalBuff[8192];
-  CharactersRequired = os_vswprintf(evalBuff, nBuffSize, FormatString, ExtraMarker);
-  if (CharactersRequired > nBuffSize)
+  // Format once, into the stack buffer when the text fits
+  CharactersRequired = vformat_wide_str(EvalBuff, ARRAY_SIZE(EvalBuff), &pFormatted, FormatString, Marker);
+  if (CharactersRequired < 0) {
     return NULL;
-
-  VA_END(ExtraMarker);
+  }
 
   if (String != NULL) {
-    SizeRequired = StrSize(String) + (CharactersRequired * sizeof(CHAR16));
-  }
-  else {
-    SizeRequired = sizeof(CHAR16) + (CharactersRequired * sizeof(CHAR16));
+    StringLength = StrLen(String);
   }
 
-  BufferToReturn = AllocateZeroPool(SizeRequired);
+  BufferToReturn = AllocatePool((StringLength + CharactersRequired + 1) * sizeof(CHAR16));
 
-  if (BufferToReturn == NULL) {
-    return NULL;
+  if (BufferToReturn != NULL) {
+    if (String != NULL) {
+      CopyMem(BufferToReturn, String, StringLength * sizeof(CHAR16));
+    }
+    CopyMem(BufferToReturn + StringLength, pFormatted, (CharactersRequired + 1) * sizeof(CHAR16));
   }
 
-  if (String != NULL) {
-    os_wcscpy(BufferToReturn, (SizeRequired / sizeof(CHAR16)), String);
+  if (pFormatted != EvalBuff) {
+    free(pFormatted);
   }
-  os_vswprintf(BufferToReturn + StrLen(BufferToReturn), (CharactersRequired + 1), FormatString, Marker);
-
-  ASSERT(StrSize(BufferToReturn) == SizeRequired);
-
   return (BufferToReturn);
 }
 
@@ -1586,6 +1652,23 @@ HandleParsingLibDestructor(
 #define MAX_PROMT_INPUT_SZ 1024
 #define RETURN_KEY	0xD
 #define LINE_FEED 0xA
+#define PROMPT_INPUT_UNAVAILABLE_MSG L"Interactive input is not available while commands are read from stdin.\n"
+
+// Cleared while stdin carries something other than the user's answers, e.g. a batch of commands
+static BOOLEAN gPromptInputAvailable = TRUE;
+
+/**
+Allow or refuse prompting the user on stdin
+
+@param[in] Available - FALSE to fail every prompt without reading stdin
+**/
+VOID
+SetPromptInputAvailable(
+  IN     BOOLEAN Available
+)
+{
+  gPromptInputAvailable = Available;
+}
 
 /**
 Prompted input request
@@ -1608,7 +1691,7 @@ PromptedInput(
 {
   EFI_STATUS ReturnCode = EFI_SUCCESS;
   int PromptIndex;
-  char ThrowAway;
+  int Input;
   BOOLEAN NoReturn = TRUE;
 
   NVDIMM_ENTRY();
@@ -1618,12 +1701,25 @@ PromptedInput(
     goto Finish;
   }
 
+  if (!gPromptInputAvailable) {
+    Print(PROMPT_INPUT_UNAVAILABLE_MSG);
+    ReturnCode = EFI_ACCESS_DENIED;
+    goto Finish;
+  }
+
   Print(L"%ls", pPrompt);
+  output_sink_flush();
   char buff[MAX_PROMT_INPUT_SZ];
   memset(buff, 0, MAX_PROMT_INPUT_SZ);
 
+  *ppReturnValue = NULL;
   for (PromptIndex = 0; PromptIndex < (MAX_PROMT_INPUT_SZ - 1); ++PromptIndex) {
-    buff[PromptIndex] = _getch();
+    // A closed stdin never delivers Enter, give up instead of spinning
+    if (EOF == (Input = _getch())) {
+      ReturnCode = EFI_END_OF_FILE;
+      goto Finish;
+    }
+    buff[PromptIndex] = (char)Input;
     if (RETURN_KEY == buff[PromptIndex] || LINE_FEED == buff[PromptIndex]) {
       //terminate string, advance index to indicate size
       buff[PromptIndex++] = '\0';
@@ -1632,13 +1728,12 @@ PromptedInput(
     }
   }
 
-  *ppReturnValue = NULL;
   while (NoReturn) {
     //we ran out of buffer before user pressed Enter
     //consume stdin until Enter
-    ThrowAway = _getch();
+    Input = _getch();
 
-    if (RETURN_KEY == ThrowAway || LINE_FEED == ThrowAway) {
+    if (RETURN_KEY == Input || LINE_FEED == Input || EOF == Input) {
       ReturnCode = EFI_BUFFER_TOO_SMALL;
       goto Finish;
     }
@@ -1684,6 +1779,12 @@ PromptYesNo(
     goto Finish;
   }
 
+  if (!gPromptInputAvailable) {
+    PrintNoBuffer(PROMPT_INPUT_UNAVAILABLE_MSG);
+    ReturnCode = EFI_ACCESS_DENIED;
+    goto Finish;
+  }
+
   PrintNoBuffer(L"%ls", PROMPT_CONTINUE_QUESTION);
   if (0 >= (readSize = _read(0, buf, sizeof(buf))))
   {
@@ -148,7 +148,7 @@ recording/playback as specified
 
 @param[in]  pDimm    pointer to current Dimm
 @param[in, out]  pCmd    pointer to command data
-@param[in]  Timeout    the command timeout
+@param[in]  Timeout    the command timeout in 100 ns units (EFI timer periods), bounds retries of busy responses
 **/
 EFI_STATUS
 passthru_os(
@@ -157,6 +157,14 @@ passthru_os(
   IN     long Timeout
 );
 
+/**
+returns the number of firmware commands sent through DefaultPassThru by this
+process, including the ones answered by a PBR playback session
+**/
+UINT64
+get_passthru_count(
+);
+
 /**
 provides playback functionality
 
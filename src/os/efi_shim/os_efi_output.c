@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#define _write write
+#define _fileno fileno
+#define _isatty isatty
+#endif
+#include <os.h>
+#include "os_efi_output.h"
+
+#define OUTPUT_SINK_MIN_SIZE      4096
+#define UTF8_MAX_CHAR_LEN         4
+#define FORMAT_MAX_LEN            (16 * 1024 * 1024)
+#define UNICODE_REPLACEMENT_CHAR  0xFFFD
+
+typedef struct _OUTPUT_SINK
+{
+  FILE *p_target;         // stream the buffered text goes to
+  char *p_buf;
+  size_t len;             // bytes buffered
+  size_t size;            // bytes allocated
+  unsigned int lines;     // complete lines buffered
+  unsigned int max_lines; // lines per batch for the current target
+  int exit_registered;
+} OUTPUT_SINK;
+
+static OUTPUT_SINK g_sink;
+// DIMM workers may Print concurrently, the sink is written under this lock
+static OS_RWLOCK *volatile g_sink_lock = NULL;
+
+static void output_sink_write_out();
+static void output_sink_flush_locked();
+
+static OS_RWLOCK *output_sink_lock()
+{
+  OS_RWLOCK *p_lock = os_rwlock_get_static(&g_sink_lock);
+
+  if (NULL != p_lock) {
+    os_rwlock_w_lock(p_lock);
+  }
+  return p_lock;
+}
+
+static void output_sink_unlock(OS_RWLOCK *p_lock)
+{
+  if (NULL != p_lock) {
+    os_rwlock_w_unlock(p_lock);
+  }
+}
+
+static void output_sink_at_exit()
+{
+  OS_RWLOCK *p_lock = output_sink_lock();
+
+  output_sink_flush_locked();
+  free(g_sink.p_buf);
+  g_sink.p_buf = NULL;
+  g_sink.size = 0;
+  output_sink_unlock(p_lock);
+}
+
+int vformat_wide_str(CHAR16 *p_buf, size_t buf_len, CHAR16 **pp_out,
+  const CHAR16 *p_format, va_list args)
+{
+  CHAR16 *p_out = p_buf;
+  CHAR16 *p_new = NULL;
+  size_t out_len = buf_len;
+  int len = -1;
+  va_list args_copy;
+
+  if (NULL == pp_out || NULL == p_format) {
+    return -1;
+  }
+  *pp_out = NULL;
+
+  // vswprintf does not report the length it needs, only that the buffer was too small
+  while (NULL != p_out && out_len > 0) {
+    va_copy(args_copy, args);
+#ifdef _MSC_VER
+    len = _vsnwprintf(p_out, out_len, p_format, args_copy);
+#else
+    len = vswprintf(p_out, out_len, p_format, args_copy);
+#endif
+    va_end(args_copy);
+    if (len >= 0 && (size_t)len < out_len) {
+      p_out[len] = L'\0';
+      *pp_out = p_out;
+      return len;
+    }
+    if (out_len >= FORMAT_MAX_LEN) {
+      break;
+    }
+    out_len = (out_len < OUTPUT_SINK_MIN_SIZE) ? OUTPUT_SINK_MIN_SIZE : out_len * 2;
+    if (p_out == p_buf) {
+      p_new = malloc(out_len * sizeof(CHAR16));
+    }
+    else {
+      p_new = realloc(p_out, out_len * sizeof(CHAR16));
+      if (NULL == p_new) {
+        free(p_out);
+      }
+    }
+    p_out = p_new;
+  }
+
+  if (p_out != p_buf) {
+    free(p_out);
+  }
+  return -1;
+}
+
+/*
+ * Start a new batch for p_target, writing out the one buffered for another stream.
+ */
+static void output_sink_set_target(FILE *p_target)
+{
+  int fd;
+
+  if (g_sink.p_target != p_target) {
+    output_sink_flush_locked();
+    g_sink.p_target = p_target;
+    // A terminal shows every line as it comes, anything else takes the output in batches
+    fd = _fileno(p_target);
+    g_sink.max_lines = (fd >= 0 && _isatty(fd)) ? 1 : OUTPUT_SINK_FLUSH_LINES;
+  }
+  if (!g_sink.exit_registered) {
+    g_sink.exit_registered = 1;
+    atexit(output_sink_at_exit);
+  }
+}
+
+/*
+ * Make room for at least need more bytes, growing the buffer up to
+ * OUTPUT_SINK_FLUSH_SIZE and flushing once it is full.
+ */
+static int output_sink_reserve(size_t need)
+{
+  size_t new_size;
+  char *p_new;
+
+  if (g_sink.size - g_sink.len >= need) {
+    return 0;
+  }
+  if (g_sink.size < OUTPUT_SINK_FLUSH_SIZE) {
+    new_size = (g_sink.size < OUTPUT_SINK_MIN_SIZE) ? OUTPUT_SINK_MIN_SIZE : g_sink.size * 2;
+    if (NULL != (p_new = realloc(g_sink.p_buf, new_size))) {
+      g_sink.p_buf = p_new;
+      g_sink.size = new_size;
+      return 0;
+    }
+  }
+  output_sink_write_out();
+  return (g_sink.size >= need) ? 0 : -1;
+}
+
+/*
+ * Flush the batch once it holds enough lines or bytes.
+ */
+static void output_sink_line_done()
+{
+  if (++g_sink.lines >= g_sink.max_lines || g_sink.len >= OUTPUT_SINK_FLUSH_SIZE) {
+    output_sink_write_out();
+  }
+}
+
+/*
+ * Convert len CHAR16 characters to UTF-8 into the sink. CHAR16 is wchar_t, UTF-32
+ * on Linux and UTF-16 on Windows, so surrogate pairs are combined when present.
+ */
+static void output_sink_put_wide(const CHAR16 *p_str, size_t len)
+{
+  size_t index;
+  unsigned long cp;
+  char *p;
+
+  for (index = 0; index < len; ++index) {
+    cp = (unsigned long)p_str[index];
+    if (cp >= 0xD800 && cp <= 0xDBFF && index + 1 < len &&
+      (unsigned long)p_str[index + 1] >= 0xDC00 && (unsigned long)p_str[index + 1] <= 0xDFFF) {
+      cp = 0x10000 + ((cp - 0xD800) << 10) + ((unsigned long)p_str[++index] - 0xDC00);
+    }
+    else if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) {
+      cp = UNICODE_REPLACEMENT_CHAR;
+    }
+
+    if (0 != output_sink_reserve(UTF8_MAX_CHAR_LEN)) {
+      return;
+    }
+    p = g_sink.p_buf + g_sink.len;
+    if (cp < 0x80) {
+      *p++ = (char)cp;
+    }
+    else if (cp < 0x800) {
+      *p++ = (char)(0xC0 | (cp >> 6));
+      *p++ = (char)(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000) {
+      *p++ = (char)(0xE0 | (cp >> 12));
+      *p++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+      *p++ = (char)(0x80 | (cp & 0x3F));
+    }
+    else {
+      *p++ = (char)(0xF0 | (cp >> 18));
+      *p++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+      *p++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+      *p++ = (char)(0x80 | (cp & 0x3F));
+    }
+    g_sink.len = p - g_sink.p_buf;
+    if (L'\n' == cp) {
+      output_sink_line_done();
+    }
+  }
+}
+
+int output_sink_vprint(FILE *p_target, const CHAR16 *p_format, va_list args)
+{
+  CHAR16 buf[1024];
+  CHAR16 *p_str = NULL;
+  OS_RWLOCK *p_lock = NULL;
+  int len;
+
+  if (NULL == p_target) {
+    return 0;
+  }
+  if (0 > (len = vformat_wide_str(buf, sizeof(buf) / sizeof(buf[0]), &p_str, p_format, args))) {
+    return 0;
+  }
+  p_lock = output_sink_lock();
+  output_sink_set_target(p_target);
+  output_sink_put_wide(p_str, (size_t)len);
+  output_sink_unlock(p_lock);
+  if (p_str != buf) {
+    free(p_str);
+  }
+  return len;
+}
+
+void output_sink_write_utf8(FILE *p_target, const char *p_str, size_t len)
+{
+  size_t index;
+  OS_RWLOCK *p_lock = NULL;
+
+  if (NULL == p_target || NULL == p_str) {
+    return;
+  }
+  p_lock = output_sink_lock();
+  output_sink_set_target(p_target);
+  for (index = 0; index < len; ++index) {
+    if (0 != output_sink_reserve(1)) {
+      break;
+    }
+    g_sink.p_buf[g_sink.len++] = p_str[index];
+    if ('\n' == p_str[index]) {
+      output_sink_line_done();
+    }
+  }
+  output_sink_unlock(p_lock);
+}
+
+/*
+ * Write the batch out, keeping the target for the text that follows.
+ */
+static void output_sink_write_out()
+{
+  size_t written = 0;
+  int fd;
+  int rc;
+
+  if (NULL == g_sink.p_target) {
+    return;
+  }
+  // Text printed to the stream directly before the buffered text goes out first
+  fflush(g_sink.p_target);
+  if (g_sink.len > 0) {
+    // The stream may be wide oriented (wprintf), so the bytes bypass stdio
+    fd = _fileno(g_sink.p_target);
+    while (fd >= 0 && written < g_sink.len) {
+      rc = (int)_write(fd, g_sink.p_buf + written, (unsigned int)(g_sink.len - written));
+      if (rc <= 0) {
+        break;
+      }
+      written += (size_t)rc;
+    }
+  }
+  g_sink.len = 0;
+  g_sink.lines = 0;
+}
+
+static void output_sink_flush_locked()
+{
+  output_sink_write_out();
+  // The stream may be closed once flushed, the next text names its target again
+  g_sink.p_target = NULL;
+}
+
+void output_sink_flush()
+{
+  OS_RWLOCK *p_lock = output_sink_lock();
+
+  output_sink_flush_locked();
+  output_sink_unlock(p_lock);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _OS_EFI_OUTPUT_H_
+#define _OS_EFI_OUTPUT_H_
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <Uefi.h>
+
+/*
+ * Process wide output sink behind Print() and DebugPrint().
+ *
+ * Text is converted from CHAR16 to UTF-8 once, appended to a growable buffer
+ * and written to the target stream in batches: after OUTPUT_SINK_FLUSH_LINES
+ * lines (every line when the target is a terminal), when OUTPUT_SINK_FLUSH_SIZE
+ * bytes are buffered, when the target stream changes and on output_sink_flush().
+ * output_sink_flush() must be called before a stream the sink may have buffered
+ * text for is closed, read back or handed over, and before waiting for input.
+ * Threads share the sink; each text is appended whole, under a lock.
+ */
+#define OUTPUT_SINK_FLUSH_SIZE    (64 * 1024)
+#define OUTPUT_SINK_FLUSH_LINES   256
+
+/*
+ * Format a CHAR16 string once. The text is formatted into p_buf when it fits,
+ * otherwise into a heap buffer; *pp_out is set to the buffer holding the text,
+ * the caller frees it when it is not p_buf.
+ * Returns the length of the formatted text in characters, -1 on failure.
+ */
+int vformat_wide_str(CHAR16 *p_buf, size_t buf_len, CHAR16 **pp_out,
+  const CHAR16 *p_format, va_list args);
+
+/*
+ * Append formatted text to the sink for p_target.
+ * Returns the number of CHAR16 characters formatted.
+ */
+int output_sink_vprint(FILE *p_target, const CHAR16 *p_format, va_list args);
+
+/*
+ * Append len bytes of UTF-8 (or ASCII) text to the sink for p_target.
+ */
+void output_sink_write_utf8(FILE *p_target, const char *p_str, size_t len);
+
+/*
+ * Write everything buffered to the target stream.
+ */
+void output_sink_flush();
+
+#endif //_OS_EFI_OUTPUT_H_
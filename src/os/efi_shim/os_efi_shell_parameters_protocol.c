@@ -33,6 +33,7 @@
 #include <fcntl.h>
 #include "os_efi_shell_parameters_protocol.h"
 #include "os_efi_api.h"
+#include "os_efi_output.h"
 #include "os_str.h"
 
 #define MAX_INPUT_PARAMS        256
@@ -43,6 +44,7 @@ EFI_SHELL_PARAMETERS_PROTOCOL *gEfiShellParametersProtocol = &gOsShellParameters
 
 int g_fast_path = 0;
 int g_file_io = 0;
+static int g_converted_output = 0;
 
 static BOOLEAN g_verbose_debug_print_enabled = FALSE;
 
@@ -60,6 +62,7 @@ RecordingDirMode g_rec_file_creation_mode = DefaultMode;
 #define STR_NVMXML              "nvmxml"
 #define STR_ESXXML              "esx"
 #define STR_ESXTABLE            "esxtable"
+#define STR_JSON                "json"
 #define STR_TEXT                "text"
 #define STR_DASH_VERBOSE_LONG   "-verbose"
 #define STR_DASH_VERBOSE_SHORT  "-v"
@@ -75,6 +78,12 @@ EFI_STATUS init_protocol_shell_parameters_protocol(int argc, char *argv[])
     return EFI_INVALID_PARAMETER;
   }
 
+  // A warm process (daemon or batch) parses many command lines, start each one clean
+  g_fast_path = 0;
+  g_file_io = 0;
+  g_converted_output = 0;
+  g_verbose_debug_print_enabled = FALSE;
+
   gOsShellParametersProtocol.Argv = AllocateZeroPool(MAX_INPUT_PARAMS * sizeof(CHAR16*));
   if (NULL == gOsShellParametersProtocol.Argv) {
     return EFI_OUT_OF_RESOURCES;
@@ -97,10 +106,10 @@ EFI_STATUS init_protocol_shell_parameters_protocol(int argc, char *argv[])
       {
         if (0 == s_strncmpi(tok, STR_NVMXML, strlen(STR_NVMXML) + 1) ||
           0 == s_strncmpi(tok, STR_ESXXML, strlen(STR_ESXXML) + 1) ||
-          0 == s_strncmpi(tok, STR_ESXTABLE, strlen(STR_ESXTABLE) + 1))
+          0 == s_strncmpi(tok, STR_ESXTABLE, strlen(STR_ESXTABLE) + 1) ||
+          0 == s_strncmpi(tok, STR_JSON, strlen(STR_JSON) + 1))
         {
-          g_file_io = 1;
-          gOsShellParametersProtocol.StdOut = fopen("output.tmp", "w+");
+          g_converted_output = 1;
         }
 
         tok = os_strtok(NULL, ",", &p_tok_context);
@@ -134,11 +143,37 @@ EFI_STATUS init_protocol_shell_parameters_protocol(int argc, char *argv[])
   return 0;
 }
 
+/*
+ * Commands that print through the printer emit XML or JSON straight to stdout. The
+ * text output of the others (and of syntax errors) is captured in an anonymous
+ * temporary file, which nvm_run_cli converts to XML or JSON once the command is done.
+ */
+void start_cli_output_capture()
+{
+  FILE *p_capture = NULL;
+
+  if (!g_converted_output || g_file_io) {
+    return;
+  }
+  if (NULL == (p_capture = tmpfile())) {
+    return;
+  }
+  g_file_io = 1;
+  gOsShellParametersProtocol.StdOut = p_capture;
+}
+
 int uninit_protocol_shell_parameters_protocol()
 {
   int Index = 0;
-  if (g_file_io)
-    fclose(gOsShellParametersProtocol.StdOut);
+  output_sink_flush();
+  if (g_file_io) {
+    if (gOsShellParametersProtocol.StdOut != stdout) {
+      fclose(gOsShellParametersProtocol.StdOut);
+    }
+    gOsShellParametersProtocol.StdOut = stdout;
+    g_file_io = 0;
+  }
+  g_converted_output = 0;
 
   for (Index = 0; Index < gOsShellParametersProtocol.Argc; ++Index)
   {
@@ -151,7 +186,9 @@ int uninit_protocol_shell_parameters_protocol()
   if (NULL != gOsShellParametersProtocol.Argv)
   {
     FreePool(gOsShellParametersProtocol.Argv);
+    gOsShellParametersProtocol.Argv = NULL;
   }
+  gOsShellParametersProtocol.Argc = 0;
   return EFI_SUCCESS;
 }
 
@@ -15,6 +15,7 @@ extern EFI_SHELL_PARAMETERS_PROTOCOL gOsShellParametersProtocol;
 
 EFI_STATUS init_protocol_shell_parameters_protocol(int argc, char *argv[]);
 int uninit_protocol_shell_parameters_protocol();
+void start_cli_output_capture();
 BOOLEAN is_verbose_debug_print_enabled();
 
 
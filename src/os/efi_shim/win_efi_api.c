@@ -10,6 +10,7 @@
 #include <Dimm.h>
 #include <win_scm2_passthrough.h>
 #include <NvmDimmDriver.h>
+#include <os.h>
 
 extern NVMDIMMDRIVER_DATA *gNvmDimmData;
 
@@ -86,8 +87,12 @@ passthru_os(
   EFI_STATUS Rc = EFI_SUCCESS;
   UINT32 ReturnCode;
   unsigned int dsm_status;
+  unsigned long long start_us = os_get_monotonic_usec();
 
   ReturnCode = win_scm2_passthrough((struct fw_cmd *)pCmd, &dsm_status);
+  // The SCM2 driver does not retry busy responses, the command is submitted once
+  pCmd->Attempts = 1;
+  pCmd->ElapsedUs = os_get_monotonic_usec() - start_us;
   if (0 == ReturnCode && 0 == dsm_status)
   {
     Rc = EFI_SUCCESS;
@@ -0,0 +1,1093 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * This file contains the implementation of the system event store.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _MSC_VER
+#include <io.h>
+#include <sys/locking.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include <os.h>
+#include "event.h"
+
+#define	EVENT_STORE_MAGIC           0x54564549 // IEVT
+#define	EVENT_STORE_VERSION         1
+#define	EVENT_STORE_MUTEX           "ipmctl_event_store"
+#define	EVENT_STORE_FLAG_ACKED      0x01
+#define	EVENT_TYPE_INDEX_CNT        (EVENT_TYPE_DIAG_FW_CONSISTENCY + 1)
+#define	EVENT_SEVERITY_INDEX_CNT    (EVENT_SEVERITY_FATAL + 1)
+#define	FNV1A_32_OFFSET             0x811C9DC5
+#define	FNV1A_32_PRIME              0x01000193
+
+#pragma pack(push)
+#pragma pack(1)
+struct event_store_header
+{
+  NVM_UINT32 magic;
+  NVM_UINT32 version;
+  NVM_UINT32 entry_size;
+  NVM_UINT32 max_rows;          // slots in the entry and message tables
+  NVM_UINT32 next_event_id;     // ID of the next event appended, IDs start at 1
+  NVM_UINT32 generation;        // changed by purges, readers rebuild their indexes
+  NVM_UINT32 ack_count;         // changed by acks, readers reload the entries
+  NVM_UINT32 reserved;
+};
+
+/*
+ * Fixed size entry of one event, its message is kept in the message table at the same slot.
+ */
+struct event_store_entry
+{
+  NVM_UINT32 event_id;          // 0 for an empty or purged slot
+  NVM_UINT32 checksum;          // FNV-1a of the entry and message, with checksum and flags 0
+  NVM_INT64 time;
+  NVM_UINT16 code;
+  NVM_UINT8 type;
+  NVM_UINT8 severity;
+  NVM_UINT8 diag_result;
+  NVM_UINT8 flags;              // EVENT_STORE_FLAG_*
+  NVM_UINT8 reserved[2];
+  NVM_UID uid;
+};
+#pragma pack(pop)
+
+/*
+ * Event IDs in ascending order. Events leave the store oldest first, so they
+ * are only ever removed from the front.
+ */
+struct id_list
+{
+  NVM_UINT32 *p_ids;
+  NVM_UINT32 start;
+  NVM_UINT32 end;
+  NVM_UINT32 capacity;
+};
+
+struct time_key
+{
+  NVM_INT64 time;
+  NVM_UINT32 event_id;
+};
+
+/*
+ * (time, event ID) keys in ascending order, for range queries on the timestamp.
+ */
+struct time_index
+{
+  struct time_key *p_keys;
+  NVM_UINT32 start;
+  NVM_UINT32 end;
+  NVM_UINT32 capacity;
+};
+
+struct uid_index
+{
+  NVM_UID uid;
+  struct id_list ids;
+};
+
+struct event_store
+{
+  FILE *p_file;
+  OS_MUTEX *p_mutex;
+  struct event_store_header header;     // as of the last refresh
+  struct event_store_entry *p_entries;  // by slot
+  NVM_UINT32 live_cnt;
+  struct id_list by_type[EVENT_TYPE_INDEX_CNT];
+  struct id_list by_severity[EVENT_SEVERITY_INDEX_CNT];
+  struct uid_index *p_uids;             // sorted by UID
+  NVM_UINT32 uid_cnt;
+  NVM_UINT32 uid_capacity;
+  struct time_index by_time;
+};
+
+/*
+ * The events a query has to look at: a list of IDs, a range of time keys,
+ * or every event in the store.
+ */
+struct event_candidates
+{
+  const NVM_UINT32 *p_ids;
+  const struct time_key *p_keys;
+  NVM_UINT32 single_id;
+  NVM_UINT32 count;
+  NVM_UINT8 all;
+  NVM_UINT8 covered_mask;               // filter bits every candidate matches
+};
+
+static NVM_UINT32 fnv1a(NVM_UINT32 hash, const void *p_data, size_t size)
+{
+  const unsigned char *p = (const unsigned char *)p_data;
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    hash = (hash ^ p[i]) * FNV1A_32_PRIME;
+  }
+  return hash;
+}
+
+static NVM_UINT32 entry_checksum(const struct event_store_entry *p_entry, const char *p_message)
+{
+  struct event_store_entry entry = *p_entry;
+
+  entry.checksum = 0;
+  entry.flags = 0;
+  return fnv1a(fnv1a(FNV1A_32_OFFSET, &entry, sizeof(entry)), p_message, NVM_EVENT_MSG_LEN);
+}
+
+static long entry_offset(const struct event_store *p_store, NVM_UINT32 slot)
+{
+  return (long)(sizeof(struct event_store_header) + (size_t)slot * sizeof(struct event_store_entry));
+}
+
+static long message_offset(const struct event_store *p_store, NVM_UINT32 slot)
+{
+  return entry_offset(p_store, p_store->header.max_rows) + (long)slot * NVM_EVENT_MSG_LEN;
+}
+
+static NVM_UINT32 id_to_slot(const struct event_store *p_store, NVM_UINT32 event_id)
+{
+  return (event_id - 1) % p_store->header.max_rows;
+}
+
+static NVM_UINT32 oldest_event_id(const struct event_store *p_store)
+{
+  NVM_UINT32 next = p_store->header.next_event_id;
+
+  return (next > p_store->header.max_rows) ? next - p_store->header.max_rows : 1;
+}
+
+static int store_read(struct event_store *p_store, long offset, void *p_buf, size_t size)
+{
+  if (0 != fseek(p_store->p_file, offset, SEEK_SET) ||
+    size != fread(p_buf, 1, size, p_store->p_file)) {
+    return NVM_ERR_UNKNOWN;
+  }
+  return NVM_SUCCESS;
+}
+
+static int store_write(struct event_store *p_store, long offset, const void *p_buf, size_t size)
+{
+  if (0 != fseek(p_store->p_file, offset, SEEK_SET) ||
+    size != fwrite(p_buf, 1, size, p_store->p_file)) {
+    return NVM_ERR_UNKNOWN;
+  }
+  return NVM_SUCCESS;
+}
+
+/*
+ * Read the message of a live entry and check the pair against the entry checksum.
+ * An entry torn by a crash while it was written is not an event, it is neither
+ * indexed nor returned.
+ */
+static int entry_is_valid(struct event_store *p_store, const struct event_store_entry *p_entry, char *p_message)
+{
+  return NVM_SUCCESS == store_read(p_store, message_offset(p_store, id_to_slot(p_store, p_entry->event_id)),
+    p_message, NVM_EVENT_MSG_LEN) && entry_checksum(p_entry, p_message) == p_entry->checksum;
+}
+
+/*
+ * Serialize access to the file between processes by locking the header.
+ */
+static int store_lock(struct event_store *p_store, int lock)
+{
+#ifdef _MSC_VER
+  fseek(p_store->p_file, 0, SEEK_SET);
+  if (lock) {
+    // _LK_LOCK gives up after 10 attempts, keep waiting
+    while (0 != _locking(_fileno(p_store->p_file), _LK_LOCK, sizeof(struct event_store_header))) {
+      if (errno != EDEADLOCK) {
+        return NVM_ERR_UNKNOWN;
+      }
+    }
+  }
+  else {
+    _locking(_fileno(p_store->p_file), _LK_UNLCK, sizeof(struct event_store_header));
+  }
+#else
+  struct flock fl;
+
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = lock ? F_WRLCK : F_UNLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = 0;
+  fl.l_len = sizeof(struct event_store_header);
+  while (0 != fcntl(fileno(p_store->p_file), F_SETLKW, &fl)) {
+    if (errno != EINTR) {
+      return NVM_ERR_UNKNOWN;
+    }
+  }
+#endif
+  return NVM_SUCCESS;
+}
+
+static int id_list_push(struct id_list *p_list, NVM_UINT32 event_id)
+{
+  NVM_UINT32 *p_ids;
+  NVM_UINT32 capacity;
+
+  if (p_list->end == p_list->capacity) {
+    if (p_list->start > 0) {
+      memmove(p_list->p_ids, p_list->p_ids + p_list->start, (p_list->end - p_list->start) * sizeof(NVM_UINT32));
+      p_list->end -= p_list->start;
+      p_list->start = 0;
+    }
+    else {
+      capacity = p_list->capacity ? p_list->capacity * 2 : 64;
+      if (NULL == (p_ids = (NVM_UINT32 *)realloc(p_list->p_ids, capacity * sizeof(NVM_UINT32)))) {
+        return NVM_ERR_NO_MEM;
+      }
+      p_list->p_ids = p_ids;
+      p_list->capacity = capacity;
+    }
+  }
+  p_list->p_ids[p_list->end++] = event_id;
+  return NVM_SUCCESS;
+}
+
+static void id_list_pop(struct id_list *p_list, NVM_UINT32 event_id)
+{
+  if (p_list->start < p_list->end && p_list->p_ids[p_list->start] == event_id) {
+    p_list->start++;
+  }
+}
+
+static void id_list_free(struct id_list *p_list)
+{
+  free(p_list->p_ids);
+  memset(p_list, 0, sizeof(*p_list));
+}
+
+static int time_key_cmp(const struct time_key *p_a, NVM_INT64 time, NVM_UINT32 event_id)
+{
+  if (p_a->time != time) {
+    return (p_a->time < time) ? -1 : 1;
+  }
+  if (p_a->event_id != event_id) {
+    return (p_a->event_id < event_id) ? -1 : 1;
+  }
+  return 0;
+}
+
+/*
+ * Position of the first key not less than (time, event_id).
+ */
+static NVM_UINT32 time_index_lower_bound(const struct time_index *p_index, NVM_INT64 time, NVM_UINT32 event_id)
+{
+  NVM_UINT32 low = p_index->start;
+  NVM_UINT32 high = p_index->end;
+  NVM_UINT32 mid;
+
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    if (time_key_cmp(&p_index->p_keys[mid], time, event_id) < 0) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static int time_index_insert(struct time_index *p_index, NVM_INT64 time, NVM_UINT32 event_id)
+{
+  struct time_key *p_keys;
+  NVM_UINT32 capacity;
+  NVM_UINT32 pos;
+
+  if (p_index->end == p_index->capacity) {
+    if (p_index->start > 0) {
+      memmove(p_index->p_keys, p_index->p_keys + p_index->start, (p_index->end - p_index->start) * sizeof(struct time_key));
+      p_index->end -= p_index->start;
+      p_index->start = 0;
+    }
+    else {
+      capacity = p_index->capacity ? p_index->capacity * 2 : 64;
+      if (NULL == (p_keys = (struct time_key *)realloc(p_index->p_keys, capacity * sizeof(struct time_key)))) {
+        return NVM_ERR_NO_MEM;
+      }
+      p_index->p_keys = p_keys;
+      p_index->capacity = capacity;
+    }
+  }
+  // Events are appended in time order unless the clock was set back
+  pos = p_index->end;
+  if (pos > p_index->start && time_key_cmp(&p_index->p_keys[pos - 1], time, event_id) > 0) {
+    pos = time_index_lower_bound(p_index, time, event_id);
+    memmove(p_index->p_keys + pos + 1, p_index->p_keys + pos, (p_index->end - pos) * sizeof(struct time_key));
+  }
+  p_index->p_keys[pos].time = time;
+  p_index->p_keys[pos].event_id = event_id;
+  p_index->end++;
+  return NVM_SUCCESS;
+}
+
+static void time_index_remove(struct time_index *p_index, NVM_INT64 time, NVM_UINT32 event_id)
+{
+  NVM_UINT32 pos = time_index_lower_bound(p_index, time, event_id);
+
+  if (pos == p_index->end || 0 != time_key_cmp(&p_index->p_keys[pos], time, event_id)) {
+    return;
+  }
+  if (pos == p_index->start) {
+    p_index->start++;
+  }
+  else {
+    memmove(p_index->p_keys + pos, p_index->p_keys + pos + 1, (p_index->end - pos - 1) * sizeof(struct time_key));
+    p_index->end--;
+  }
+}
+
+/*
+ * Find the UID index entry, or the position to insert it at.
+ */
+static int find_uid(const struct event_store *p_store, const char *p_uid, NVM_UINT32 *p_pos)
+{
+  NVM_UINT32 low = 0;
+  NVM_UINT32 high = p_store->uid_cnt;
+  NVM_UINT32 mid;
+  int cmp;
+
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    cmp = strncmp(p_store->p_uids[mid].uid, p_uid, NVM_MAX_UID_LEN);
+    if (0 == cmp) {
+      *p_pos = mid;
+      return 1;
+    }
+    if (cmp < 0) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  *p_pos = low;
+  return 0;
+}
+
+static struct id_list *get_uid_list(struct event_store *p_store, const char *p_uid, int create)
+{
+  struct uid_index *p_uids;
+  NVM_UINT32 capacity;
+  NVM_UINT32 pos;
+
+  if (find_uid(p_store, p_uid, &pos)) {
+    return &p_store->p_uids[pos].ids;
+  }
+  if (!create) {
+    return NULL;
+  }
+  if (p_store->uid_cnt == p_store->uid_capacity) {
+    capacity = p_store->uid_capacity ? p_store->uid_capacity * 2 : 16;
+    if (NULL == (p_uids = (struct uid_index *)realloc(p_store->p_uids, capacity * sizeof(struct uid_index)))) {
+      return NULL;
+    }
+    p_store->p_uids = p_uids;
+    p_store->uid_capacity = capacity;
+  }
+  memmove(p_store->p_uids + pos + 1, p_store->p_uids + pos, (p_store->uid_cnt - pos) * sizeof(struct uid_index));
+  memset(&p_store->p_uids[pos], 0, sizeof(struct uid_index));
+  memcpy(p_store->p_uids[pos].uid, p_uid, NVM_MAX_UID_LEN);
+  p_store->p_uids[pos].uid[NVM_MAX_UID_LEN - 1] = '\0';
+  p_store->uid_cnt++;
+  return &p_store->p_uids[pos].ids;
+}
+
+static int index_add(struct event_store *p_store, const struct event_store_entry *p_entry)
+{
+  struct id_list *p_list;
+  int rc;
+
+  if (p_entry->type < EVENT_TYPE_INDEX_CNT &&
+    NVM_SUCCESS != (rc = id_list_push(&p_store->by_type[p_entry->type], p_entry->event_id))) {
+    return rc;
+  }
+  if (p_entry->severity < EVENT_SEVERITY_INDEX_CNT &&
+    NVM_SUCCESS != (rc = id_list_push(&p_store->by_severity[p_entry->severity], p_entry->event_id))) {
+    return rc;
+  }
+  if (NULL == (p_list = get_uid_list(p_store, p_entry->uid, 1)) ||
+    NVM_SUCCESS != (rc = id_list_push(p_list, p_entry->event_id))) {
+    return NVM_ERR_NO_MEM;
+  }
+  if (NVM_SUCCESS != (rc = time_index_insert(&p_store->by_time, p_entry->time, p_entry->event_id))) {
+    return rc;
+  }
+  p_store->live_cnt++;
+  return NVM_SUCCESS;
+}
+
+static void index_evict(struct event_store *p_store, const struct event_store_entry *p_entry)
+{
+  struct id_list *p_list;
+
+  if (p_entry->type < EVENT_TYPE_INDEX_CNT) {
+    id_list_pop(&p_store->by_type[p_entry->type], p_entry->event_id);
+  }
+  if (p_entry->severity < EVENT_SEVERITY_INDEX_CNT) {
+    id_list_pop(&p_store->by_severity[p_entry->severity], p_entry->event_id);
+  }
+  if (NULL != (p_list = get_uid_list(p_store, p_entry->uid, 0))) {
+    id_list_pop(p_list, p_entry->event_id);
+  }
+  time_index_remove(&p_store->by_time, p_entry->time, p_entry->event_id);
+  p_store->live_cnt--;
+}
+
+static void index_clear(struct event_store *p_store)
+{
+  NVM_UINT32 i;
+
+  for (i = 0; i < EVENT_TYPE_INDEX_CNT; i++) {
+    id_list_free(&p_store->by_type[i]);
+  }
+  for (i = 0; i < EVENT_SEVERITY_INDEX_CNT; i++) {
+    id_list_free(&p_store->by_severity[i]);
+  }
+  for (i = 0; i < p_store->uid_cnt; i++) {
+    id_list_free(&p_store->p_uids[i].ids);
+  }
+  free(p_store->p_uids);
+  p_store->p_uids = NULL;
+  p_store->uid_cnt = 0;
+  p_store->uid_capacity = 0;
+  free(p_store->by_time.p_keys);
+  memset(&p_store->by_time, 0, sizeof(p_store->by_time));
+  p_store->live_cnt = 0;
+}
+
+/*
+ * Write an empty store with max_rows slots. Called with the file locked.
+ */
+static int store_init_file(struct event_store *p_store, NVM_UINT32 max_rows)
+{
+  struct event_store_entry empty;
+  char last = 0;
+  NVM_UINT32 slot;
+  int rc;
+
+  memset(&p_store->header, 0, sizeof(p_store->header));
+  p_store->header.magic = EVENT_STORE_MAGIC;
+  p_store->header.version = EVENT_STORE_VERSION;
+  p_store->header.entry_size = sizeof(struct event_store_entry);
+  p_store->header.max_rows = max_rows;
+  p_store->header.next_event_id = 1;
+
+  memset(&empty, 0, sizeof(empty));
+  if (0 != fseek(p_store->p_file, entry_offset(p_store, 0), SEEK_SET)) {
+    return NVM_ERR_UNKNOWN;
+  }
+  for (slot = 0; slot < max_rows; slot++) {
+    if (1 != fwrite(&empty, sizeof(empty), 1, p_store->p_file)) {
+      return NVM_ERR_UNKNOWN;
+    }
+  }
+  // The message table is only ever read for live entries, it may stay sparse
+  if (NVM_SUCCESS != (rc = store_write(p_store, message_offset(p_store, max_rows) - 1, &last, 1))) {
+    return rc;
+  }
+  return store_write(p_store, 0, &p_store->header, sizeof(p_store->header));
+}
+
+/*
+ * Read all entries and rebuild the indexes. Called with the file locked.
+ */
+static int store_reload(struct event_store *p_store)
+{
+  struct event_store_entry *p_entries;
+  NVM_EVENT_MSG message;
+  NVM_UINT32 event_id;
+  NVM_UINT32 slot;
+  int rc;
+
+  index_clear(p_store);
+  p_entries = (struct event_store_entry *)realloc(p_store->p_entries,
+    (size_t)p_store->header.max_rows * sizeof(struct event_store_entry));
+  if (NULL == p_entries) {
+    return NVM_ERR_NO_MEM;
+  }
+  p_store->p_entries = p_entries;
+  if (NVM_SUCCESS != (rc = store_read(p_store, entry_offset(p_store, 0), p_entries,
+    (size_t)p_store->header.max_rows * sizeof(struct event_store_entry)))) {
+    return rc;
+  }
+
+  for (event_id = oldest_event_id(p_store); event_id < p_store->header.next_event_id; event_id++) {
+    slot = id_to_slot(p_store, event_id);
+    if (p_entries[slot].event_id != event_id || !entry_is_valid(p_store, &p_entries[slot], message)) {
+      p_entries[slot].event_id = 0;
+      continue;
+    }
+    if (NVM_SUCCESS != (rc = index_add(p_store, &p_entries[slot]))) {
+      return rc;
+    }
+  }
+  return NVM_SUCCESS;
+}
+
+/*
+ * Copy the flags of the live entries from the file, after another process
+ * acknowledged events. Called with the file locked.
+ */
+static int store_reload_flags(struct event_store *p_store)
+{
+  struct event_store_entry *p_entries;
+  NVM_UINT32 slot;
+  int rc;
+
+  p_entries = (struct event_store_entry *)malloc((size_t)p_store->header.max_rows * sizeof(struct event_store_entry));
+  if (NULL == p_entries) {
+    return NVM_ERR_NO_MEM;
+  }
+  if (NVM_SUCCESS == (rc = store_read(p_store, entry_offset(p_store, 0), p_entries,
+    (size_t)p_store->header.max_rows * sizeof(struct event_store_entry)))) {
+    for (slot = 0; slot < p_store->header.max_rows; slot++) {
+      if (0 != p_store->p_entries[slot].event_id && p_entries[slot].event_id == p_store->p_entries[slot].event_id) {
+        p_store->p_entries[slot].flags = p_entries[slot].flags;
+      }
+    }
+  }
+  free(p_entries);
+  return rc;
+}
+
+/*
+ * Bring the in-memory entries and indexes up to date with the file, reading only
+ * the events appended since the last refresh. Called with the file locked.
+ */
+static int store_refresh(struct event_store *p_store)
+{
+  struct event_store_header header;
+  struct event_store_entry *p_entry;
+  NVM_EVENT_MSG message;
+  NVM_UINT32 event_id;
+  NVM_UINT32 slot;
+  int rc;
+
+  if (NVM_SUCCESS != (rc = store_read(p_store, 0, &header, sizeof(header)))) {
+    return rc;
+  }
+  if (header.magic != EVENT_STORE_MAGIC || header.version != EVENT_STORE_VERSION ||
+    header.entry_size != sizeof(struct event_store_entry) ||
+    header.max_rows == 0 || header.max_rows > EVENT_STORE_MAX_ROWS || header.next_event_id == 0) {
+    return NVM_ERR_UNKNOWN;
+  }
+
+  if (NULL == p_store->p_entries || header.generation != p_store->header.generation ||
+    header.max_rows != p_store->header.max_rows || header.next_event_id < p_store->header.next_event_id ||
+    header.next_event_id - p_store->header.next_event_id >= header.max_rows) {
+    p_store->header = header;
+    return store_reload(p_store);
+  }
+
+  for (event_id = p_store->header.next_event_id; event_id < header.next_event_id; event_id++) {
+    slot = (event_id - 1) % header.max_rows;
+    p_entry = &p_store->p_entries[slot];
+    if (0 != p_entry->event_id) {
+      index_evict(p_store, p_entry);
+    }
+    if (NVM_SUCCESS != (rc = store_read(p_store, entry_offset(p_store, slot), p_entry, sizeof(*p_entry)))) {
+      p_entry->event_id = 0;
+      return rc;
+    }
+    if (p_entry->event_id != event_id || !entry_is_valid(p_store, p_entry, message)) {
+      p_entry->event_id = 0;
+      continue;
+    }
+    if (NVM_SUCCESS != (rc = index_add(p_store, p_entry))) {
+      return rc;
+    }
+  }
+  if (header.ack_count != p_store->header.ack_count &&
+    NVM_SUCCESS != (rc = store_reload_flags(p_store))) {
+    return rc;
+  }
+  p_store->header = header;
+  return NVM_SUCCESS;
+}
+
+static int store_begin(struct event_store *p_store)
+{
+  int rc;
+
+  os_mutex_lock(p_store->p_mutex);
+  if (NVM_SUCCESS != (rc = store_lock(p_store, 1))) {
+    os_mutex_unlock(p_store->p_mutex);
+    return rc;
+  }
+  if (NVM_SUCCESS != (rc = store_refresh(p_store))) {
+    store_lock(p_store, 0);
+    os_mutex_unlock(p_store->p_mutex);
+  }
+  return rc;
+}
+
+static void store_end(struct event_store *p_store)
+{
+  store_lock(p_store, 0);
+  os_mutex_unlock(p_store->p_mutex);
+}
+
+int event_store_open(const char *p_path, NVM_UINT32 max_rows, struct event_store **pp_store)
+{
+  struct event_store *p_store;
+  FILE *p_file;
+  int rc;
+
+  if (NULL == p_path || NULL == pp_store || 0 == max_rows || max_rows > EVENT_STORE_MAX_ROWS) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  *pp_store = NULL;
+
+  // Create the file without truncating one another process just created
+  if (NULL == (p_file = fopen(p_path, "ab"))) {
+    return NVM_ERR_UNKNOWN;
+  }
+  fclose(p_file);
+
+  if (NULL == (p_store = (struct event_store *)calloc(1, sizeof(struct event_store)))) {
+    return NVM_ERR_NO_MEM;
+  }
+  if (NULL == (p_store->p_file = fopen(p_path, "r+b")) ||
+    NULL == (p_store->p_mutex = os_mutex_init(EVENT_STORE_MUTEX))) {
+    rc = NVM_ERR_UNKNOWN;
+    goto Finish;
+  }
+  // Other processes write the file, nothing may be served from a stale stdio buffer
+  setvbuf(p_store->p_file, NULL, _IONBF, 0);
+
+  if (NVM_SUCCESS != (rc = store_lock(p_store, 1))) {
+    goto Finish;
+  }
+  if (NVM_SUCCESS != store_refresh(p_store)) {
+    // A new, truncated or foreign file
+    if (NVM_SUCCESS == (rc = store_init_file(p_store, max_rows))) {
+      rc = store_refresh(p_store);
+    }
+  }
+  store_lock(p_store, 0);
+
+Finish:
+  if (NVM_SUCCESS != rc) {
+    event_store_close(p_store);
+    return rc;
+  }
+  *pp_store = p_store;
+  return NVM_SUCCESS;
+}
+
+void event_store_close(struct event_store *p_store)
+{
+  if (NULL == p_store) {
+    return;
+  }
+  index_clear(p_store);
+  free(p_store->p_entries);
+  if (NULL != p_store->p_file) {
+    fclose(p_store->p_file);
+  }
+  if (NULL != p_store->p_mutex) {
+    os_mutex_delete(p_store->p_mutex, EVENT_STORE_MUTEX);
+  }
+  free(p_store);
+}
+
+int event_store_append(struct event_store *p_store, const struct event *p_event, NVM_UINT32 *p_event_id)
+{
+  struct event_store_entry entry;
+  struct event_store_header header;
+  NVM_EVENT_MSG message;
+  NVM_UINT32 slot;
+  int rc;
+
+  if (NULL == p_store || NULL == p_event) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = store_begin(p_store))) {
+    return rc;
+  }
+
+  memset(&entry, 0, sizeof(entry));
+  memset(message, 0, sizeof(message));
+  entry.event_id = p_store->header.next_event_id;
+  entry.time = (NVM_INT64)p_event->time;
+  entry.code = p_event->code;
+  entry.type = (NVM_UINT8)p_event->type;
+  entry.severity = (NVM_UINT8)p_event->severity;
+  entry.diag_result = (NVM_UINT8)p_event->diag_result;
+  // Both are zeroed above, so the copies stay terminated
+  memcpy(entry.uid, p_event->uid, strnlen(p_event->uid, NVM_MAX_UID_LEN - 1));
+  memcpy(message, p_event->message, strnlen(p_event->message, NVM_EVENT_MSG_LEN - 1));
+  entry.checksum = entry_checksum(&entry, message);
+  slot = id_to_slot(p_store, entry.event_id);
+
+  // The message and entry land before the header makes the event visible
+  header = p_store->header;
+  header.next_event_id++;
+  if (NVM_SUCCESS == (rc = store_write(p_store, message_offset(p_store, slot), message, sizeof(message))) &&
+    NVM_SUCCESS == (rc = store_write(p_store, entry_offset(p_store, slot), &entry, sizeof(entry))) &&
+    NVM_SUCCESS == (rc = store_write(p_store, 0, &header, sizeof(header)))) {
+    rc = store_refresh(p_store);
+    if (NULL != p_event_id) {
+      *p_event_id = entry.event_id;
+    }
+  }
+  store_end(p_store);
+  return rc;
+}
+
+static int type_matches(NVM_UINT8 type, enum event_type filter_type)
+{
+  if (EVENT_TYPE_ALL == filter_type) {
+    return 1;
+  }
+  if (EVENT_TYPE_DIAG == filter_type) {
+    return type >= EVENT_TYPE_DIAG && type <= EVENT_TYPE_DIAG_FW_CONSISTENCY;
+  }
+  return type == (NVM_UINT8)filter_type;
+}
+
+static int entry_matches(const struct event_store_entry *p_entry, const struct event_filter *p_filter, NVM_UINT8 mask)
+{
+  if ((mask & NVM_FILTER_ON_TYPE) && !type_matches(p_entry->type, p_filter->type)) {
+    return 0;
+  }
+  if ((mask & NVM_FILTER_ON_SEVERITY) && p_entry->severity != (NVM_UINT8)p_filter->severity) {
+    return 0;
+  }
+  if ((mask & NVM_FILTER_ON_CODE) && p_entry->code != p_filter->code) {
+    return 0;
+  }
+  if ((mask & NVM_FILTER_ON_UID) && 0 != strncmp(p_entry->uid, p_filter->uid, NVM_MAX_UID_LEN)) {
+    return 0;
+  }
+  if ((mask & NVM_FILTER_ON_AFTER) && p_entry->time < p_filter->after) {
+    return 0;
+  }
+  if ((mask & NVM_FILTER_ON_BEFORE) && p_entry->time > p_filter->before) {
+    return 0;
+  }
+  if ((mask & NVM_FILTER_ON_EVENT) && p_entry->event_id != (NVM_UINT32)p_filter->event_id) {
+    return 0;
+  }
+  return 1;
+}
+
+static void consider_ids(struct event_candidates *p_best, const struct id_list *p_list, NVM_UINT8 covered)
+{
+  NVM_UINT32 count = (NULL == p_list) ? 0 : p_list->end - p_list->start;
+
+  if (count < p_best->count || (count == p_best->count && p_best->all)) {
+    memset(p_best, 0, sizeof(*p_best));
+    p_best->p_ids = (NULL == p_list) ? NULL : p_list->p_ids + p_list->start;
+    p_best->count = count;
+    p_best->covered_mask = covered;
+  }
+}
+
+/*
+ * Pick the index giving the fewest events to look at for the filter.
+ */
+static void select_candidates(struct event_store *p_store, const struct event_filter *p_filter, NVM_UINT8 mask,
+  struct event_candidates *p_best)
+{
+  NVM_UINT32 event_id;
+  NVM_UINT32 low;
+  NVM_UINT32 high;
+
+  memset(p_best, 0, sizeof(*p_best));
+  p_best->all = 1;
+  p_best->count = p_store->live_cnt;
+
+  if (mask & NVM_FILTER_ON_EVENT) {
+    event_id = (NVM_UINT32)p_filter->event_id;
+    memset(p_best, 0, sizeof(*p_best));
+    if (event_id >= oldest_event_id(p_store) && event_id < p_store->header.next_event_id &&
+      p_store->p_entries[id_to_slot(p_store, event_id)].event_id == event_id) {
+      p_best->single_id = event_id;
+      p_best->count = 1;
+    }
+    p_best->covered_mask = NVM_FILTER_ON_EVENT;
+    return;
+  }
+  if (mask & NVM_FILTER_ON_UID) {
+    consider_ids(p_best, get_uid_list(p_store, p_filter->uid, 0), NVM_FILTER_ON_UID);
+  }
+  if ((mask & NVM_FILTER_ON_TYPE) && EVENT_TYPE_DIAG != p_filter->type) {
+    consider_ids(p_best, (p_filter->type < EVENT_TYPE_INDEX_CNT) ? &p_store->by_type[p_filter->type] : NULL,
+      NVM_FILTER_ON_TYPE);
+  }
+  if (mask & NVM_FILTER_ON_SEVERITY) {
+    consider_ids(p_best, (p_filter->severity < EVENT_SEVERITY_INDEX_CNT) ? &p_store->by_severity[p_filter->severity] : NULL,
+      NVM_FILTER_ON_SEVERITY);
+  }
+  if (mask & (NVM_FILTER_ON_AFTER | NVM_FILTER_ON_BEFORE)) {
+    low = (mask & NVM_FILTER_ON_AFTER) ?
+      time_index_lower_bound(&p_store->by_time, p_filter->after, 0) : p_store->by_time.start;
+    high = (mask & NVM_FILTER_ON_BEFORE) ?
+      time_index_lower_bound(&p_store->by_time, p_filter->before + 1, 0) : p_store->by_time.end;
+    if (high < low) {
+      high = low;
+    }
+    if (high - low < p_best->count || p_best->all) {
+      memset(p_best, 0, sizeof(*p_best));
+      p_best->p_keys = p_store->by_time.p_keys + low;
+      p_best->count = high - low;
+      p_best->covered_mask = mask & (NVM_FILTER_ON_AFTER | NVM_FILTER_ON_BEFORE);
+    }
+  }
+}
+
+/*
+ * Call the visitor for every event matching the filter, oldest first for IDs
+ * (time order for a time range). Stops when the visitor returns non zero.
+ */
+typedef int (*event_visitor)(struct event_store *p_store, const struct event_store_entry *p_entry, void *p_context);
+
+static int visit_matching(struct event_store *p_store, const struct event_filter *p_filter,
+  event_visitor visitor, void *p_context, NVM_UINT32 *p_matched)
+{
+  struct event_candidates candidates;
+  const struct event_store_entry *p_entry;
+  NVM_UINT8 mask = (NULL == p_filter) ? 0 : p_filter->filter_mask;
+  NVM_UINT8 remaining;
+  NVM_UINT32 event_id;
+  NVM_UINT32 oldest;
+  NVM_UINT32 i;
+  int rc = 0;
+
+  // Filtering on all types is no filter at all
+  if ((mask & NVM_FILTER_ON_TYPE) && EVENT_TYPE_ALL == p_filter->type) {
+    mask &= ~NVM_FILTER_ON_TYPE;
+  }
+  select_candidates(p_store, p_filter, mask, &candidates);
+  remaining = mask & ~candidates.covered_mask;
+  *p_matched = 0;
+
+  // Counting events of a single index needs no look at the events
+  if (NULL == visitor && 0 == remaining) {
+    *p_matched = candidates.count;
+    return 0;
+  }
+
+  // Without an index the whole ID range is walked, purged slots included
+  oldest = oldest_event_id(p_store);
+  if (candidates.all) {
+    candidates.count = p_store->header.next_event_id - oldest;
+  }
+  for (i = 0; 0 == rc && i < candidates.count; i++) {
+    if (candidates.all) {
+      event_id = oldest + i;
+    }
+    else if (NULL != candidates.p_keys) {
+      event_id = candidates.p_keys[i].event_id;
+    }
+    else if (NULL != candidates.p_ids) {
+      event_id = candidates.p_ids[i];
+    }
+    else {
+      event_id = candidates.single_id;
+    }
+    p_entry = &p_store->p_entries[id_to_slot(p_store, event_id)];
+    if (p_entry->event_id != event_id || !entry_matches(p_entry, p_filter, remaining)) {
+      continue;
+    }
+    (*p_matched)++;
+    if (NULL != visitor) {
+      rc = visitor(p_store, p_entry, p_context);
+    }
+  }
+  return rc;
+}
+
+int event_store_count(struct event_store *p_store, const struct event_filter *p_filter, NVM_UINT32 *p_count)
+{
+  int rc;
+
+  if (NULL == p_store || NULL == p_count) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = store_begin(p_store))) {
+    return rc;
+  }
+  visit_matching(p_store, p_filter, NULL, NULL, p_count);
+  store_end(p_store);
+  return NVM_SUCCESS;
+}
+
+struct get_context
+{
+  struct event *p_events;
+  NVM_UINT32 count;
+  NVM_UINT32 returned;
+  int rc;
+};
+
+static int get_visitor(struct event_store *p_store, const struct event_store_entry *p_entry, void *p_context)
+{
+  struct get_context *p_get = (struct get_context *)p_context;
+  struct event *p_event;
+  NVM_EVENT_MSG message;
+
+  if (p_get->returned == p_get->count) {
+    p_get->rc = NVM_ERR_BAD_SIZE;
+    return 1;
+  }
+  if (!entry_is_valid(p_store, p_entry, message)) {
+    // Passed the same check when it was indexed, only a failing read skips it here
+    return 0;
+  }
+
+  p_event = &p_get->p_events[p_get->returned++];
+  memset(p_event, 0, sizeof(*p_event));
+  p_event->event_id = p_entry->event_id;
+  p_event->type = (enum event_type)p_entry->type;
+  p_event->severity = (enum event_severity)p_entry->severity;
+  p_event->code = p_entry->code;
+  p_event->action_required = !(p_entry->flags & EVENT_STORE_FLAG_ACKED);
+  memcpy(p_event->uid, p_entry->uid, NVM_MAX_UID_LEN);
+  p_event->time = (time_t)p_entry->time;
+  memcpy(p_event->message, message, NVM_EVENT_MSG_LEN);
+  p_event->message[NVM_EVENT_MSG_LEN - 1] = '\0';
+  p_event->diag_result = (enum diagnostic_result)p_entry->diag_result;
+  return 0;
+}
+
+int event_store_get(struct event_store *p_store, const struct event_filter *p_filter,
+  struct event *p_events, NVM_UINT32 count, NVM_UINT32 *p_returned)
+{
+  struct get_context get;
+  NVM_UINT32 matched;
+  int rc;
+
+  if (NULL == p_store || (NULL == p_events && count > 0) || NULL == p_returned) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = store_begin(p_store))) {
+    return rc;
+  }
+  memset(&get, 0, sizeof(get));
+  get.p_events = p_events;
+  get.count = count;
+  get.rc = NVM_SUCCESS;
+  visit_matching(p_store, p_filter, get_visitor, &get, &matched);
+  store_end(p_store);
+  *p_returned = get.returned;
+  return get.rc;
+}
+
+struct purge_context
+{
+  NVM_UINT32 *p_ids;
+  NVM_UINT32 count;
+};
+
+static int purge_visitor(struct event_store *p_store, const struct event_store_entry *p_entry, void *p_context)
+{
+  struct purge_context *p_purge = (struct purge_context *)p_context;
+
+  p_purge->p_ids[p_purge->count++] = p_entry->event_id;
+  return 0;
+}
+
+int event_store_purge(struct event_store *p_store, const struct event_filter *p_filter)
+{
+  struct purge_context purge;
+  struct event_store_header header;
+  NVM_UINT32 empty_id = 0;
+  NVM_UINT32 matched;
+  NVM_UINT32 i;
+  int rc;
+
+  if (NULL == p_store) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = store_begin(p_store))) {
+    return rc;
+  }
+  memset(&purge, 0, sizeof(purge));
+  if (NULL == (purge.p_ids = (NVM_UINT32 *)malloc(((size_t)p_store->live_cnt + 1) * sizeof(NVM_UINT32)))) {
+    store_end(p_store);
+    return NVM_ERR_NO_MEM;
+  }
+  visit_matching(p_store, p_filter, purge_visitor, &purge, &matched);
+
+  for (i = 0; NVM_SUCCESS == rc && i < purge.count; i++) {
+    rc = store_write(p_store, entry_offset(p_store, id_to_slot(p_store, purge.p_ids[i])), &empty_id, sizeof(empty_id));
+  }
+  if (purge.count > 0) {
+    // Every process rebuilds its indexes, this one included
+    header = p_store->header;
+    header.generation++;
+    if (NVM_SUCCESS == rc) {
+      rc = store_write(p_store, 0, &header, sizeof(header));
+    }
+    if (NVM_SUCCESS == rc) {
+      rc = store_refresh(p_store);
+    }
+  }
+  free(purge.p_ids);
+  store_end(p_store);
+  return rc;
+}
+
+int event_store_acknowledge(struct event_store *p_store, NVM_UINT32 event_id)
+{
+  struct event_store_header header;
+  struct event_store_entry entry;
+  NVM_UINT32 slot;
+  int rc;
+
+  if (NULL == p_store || 0 == event_id) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = store_begin(p_store))) {
+    return rc;
+  }
+  slot = id_to_slot(p_store, event_id);
+  if (event_id < oldest_event_id(p_store) || event_id >= p_store->header.next_event_id ||
+    p_store->p_entries[slot].event_id != event_id) {
+    rc = NVM_ERR_INVALID_PARAMETER;
+    goto Finish;
+  }
+  // The flags are not part of the checksum, only they are rewritten in the file
+  if (NVM_SUCCESS != (rc = store_read(p_store, entry_offset(p_store, slot), &entry, sizeof(entry)))) {
+    goto Finish;
+  }
+  if (entry.event_id != event_id) {
+    rc = NVM_ERR_INVALID_PARAMETER;
+    goto Finish;
+  }
+  if (entry.flags & EVENT_STORE_FLAG_ACKED) {
+    goto Finish;
+  }
+  entry.flags |= EVENT_STORE_FLAG_ACKED;
+  if (NVM_SUCCESS != (rc = store_write(p_store, entry_offset(p_store, slot) + (long)offsetof(struct event_store_entry, flags),
+    &entry.flags, sizeof(entry.flags)))) {
+    goto Finish;
+  }
+  // Other processes reload their copies of the entries
+  header = p_store->header;
+  header.ack_count++;
+  if (NVM_SUCCESS == (rc = store_write(p_store, 0, &header, sizeof(header)))) {
+    rc = store_refresh(p_store);
+  }
+
+Finish:
+  store_end(p_store);
+  return rc;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * System event store backing the nvm_*_events API.
+ *
+ * The store is a single file with a fixed layout: a header, a table of max_rows
+ * fixed size entries and a table of max_rows messages. Events are appended with
+ * increasing event IDs to slot (event_id - 1) % max_rows, so once the store is
+ * full every append overwrites the oldest event and the file never grows.
+ *
+ * A process keeps the entries in memory with secondary indexes on device UID,
+ * event type, severity and timestamp, which answer counts in O(log n) and
+ * limit queries to the matching events. The indexes follow the events appended
+ * by other processes incrementally, purges make them rebuild.
+ */
+
+#ifndef EVENT_H_
+#define	EVENT_H_
+
+#include <nvm_management.h>
+
+#define	EVENT_STORE_FILE_NAME       "ipmctl_events.bin"
+#define	EVENT_STORE_DEFAULT_ROWS    10000
+#define	EVENT_STORE_MAX_ROWS        1000000
+
+/*
+ * Codes of the events logged by the library. Diagnostic events carry the
+ * enum diagnostic_test that ran, health events the enum acpi_event_type signalled.
+ */
+#define	EVENT_CODE_DIAG_BASE        600
+#define	EVENT_CODE_HEALTH_BASE      500
+// A DCPMM left out of a health monitor, above every enum acpi_event_type
+#define	EVENT_CODE_HEALTH_UNMONITORED (EVENT_CODE_HEALTH_BASE + 99)
+
+struct event_store;
+
+/*
+ * Open the store at p_path, creating it with max_rows slots when it does not
+ * exist. An existing store keeps the number of slots it was created with.
+ */
+int event_store_open(const char *p_path, NVM_UINT32 max_rows, struct event_store **pp_store);
+
+void event_store_close(struct event_store *p_store);
+
+/*
+ * Append an event. The event_id of p_event is ignored, the ID assigned is
+ * returned in p_event_id when it is not NULL.
+ */
+int event_store_append(struct event_store *p_store, const struct event *p_event, NVM_UINT32 *p_event_id);
+
+/*
+ * Count the events matching p_filter, NULL matches all events.
+ */
+int event_store_count(struct event_store *p_store, const struct event_filter *p_filter, NVM_UINT32 *p_count);
+
+/*
+ * Copy the events matching p_filter, oldest first, into p_events.
+ * Returns NVM_ERR_BAD_SIZE when more than count events match, after copying count events.
+ */
+int event_store_get(struct event_store *p_store, const struct event_filter *p_filter,
+  struct event *p_events, NVM_UINT32 count, NVM_UINT32 *p_returned);
+
+/*
+ * Remove the events matching p_filter, NULL removes all events.
+ */
+int event_store_purge(struct event_store *p_store, const struct event_filter *p_filter);
+
+/*
+ * Mark an event acknowledged in the file, its action_required is cleared for
+ * every process reading the store.
+ */
+int event_store_acknowledge(struct event_store *p_store, NVM_UINT32 event_id);
+
+#endif // EVENT_H_
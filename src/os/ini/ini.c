@@ -40,8 +40,10 @@ char * get_win_appdata_ptr(void)
 */
 #if defined(__LINUX__) || defined(__ESX__)
 #define TEMP_FILE_PATH "/var/log/ipmctl/"
+#define STATE_FILE_PATH "/var/lib/ipmctl/"
 #else
 #define TEMP_FILE_PATH "%APPDATA%\\Intel\\ipmctl\\"
+#define STATE_FILE_PATH "%APPDATA%\\Intel\\ipmctl\\"
 #endif
 const char p_g_ini_file[] = {
 #include "ipmctl_default.h"
@@ -1,6 +1,8 @@
 #if defined(__LINUX__) || defined(__ESX__)
 #define TEMP_FILE_PATH "/var/log/ipmctl/"
+#define STATE_FILE_PATH "/var/lib/ipmctl/"
 #else
 #define TEMP_FILE_PATH "%APPDATA%\\Intel\\ipmctl\\"
+#define STATE_FILE_PATH "%APPDATA%\\Intel\\ipmctl\\"
 #endif
 #include "ipmctl_default.h"
@@ -42,11 +42,66 @@
 "# The other values will be ignored and won't affect the large payload access\n"
 "LARGE_PAYLOAD_DISABLED = 1\n"
 "\n"
+"# Persistent PCD cache configuration\n"
+"# If the value equals 1 the platform config data read from the dimms is kept\n"
+"# in STATE_FILE_PATH and reused by later invocations until the next reboot,\n"
+"# a firmware change or a configuration change made with this app\n"
+"# If the value equals 0 the platform config data is read from the dimms every time\n"
+"PCD_DISK_CACHE_ENABLED = 0\n"
+"\n"
+"# Session playback timing configuration\n"
+"# Percentage of the recorded firmware command latency that playback waits\n"
+"# before returning each response, 100 replays the recorded timing and\n"
+"# 50 replays it twice as fast\n"
+"# If the value equals 0 the responses are returned without delay\n"
+"PBR_PLAYBACK_DELAY_SCALE = 0\n"
+"\n"
+"# Session playback order configuration\n"
+"# If the value equals 0 firmware commands must be issued in the recorded order\n"
+"# If the value equals 1 each firmware command gets the response recorded for\n"
+"# the same DIMM, opcode, subopcode and input payload, in any order\n"
+"PBR_PLAYBACK_ORDER = 0\n"
+"# Used when PBR_PLAYBACK_ORDER = 1 and a command is issued more often than recorded\n"
+"# If the value equals 0 the last recorded response is returned again\n"
+"# If the value equals 1 the recorded responses are returned again from the first\n"
+"# If the value equals 2 the command fails\n"
+"PBR_PLAYBACK_REPEAT = 0\n"
+"# Used when PBR_PLAYBACK_ORDER = 1 and a command was not recorded\n"
+"# If the value equals 0 the command fails\n"
+"# If the value equals 1 a response recorded for the same DIMM, opcode and\n"
+"# subopcode with a different input payload is returned\n"
+"PBR_PLAYBACK_MISSING = 0\n"
+"\n"
+"# Session recording compression configuration\n"
+"# Every distinct firmware command output is recorded once\n"
+"# If the value equals 1 recorded outputs are also LZMA compressed\n"
+"# If the value equals 0 recorded outputs are stored uncompressed\n"
+"PBR_RECORD_COMPRESSION = 0\n"
+"\n"
+"# Session recording stream configuration\n"
+"# If the value equals 1 recorded data is appended to a segmented log in the\n"
+"# session directory as it is recorded, and only recent data is kept in memory\n"
+"# If the value equals 0 the recording is kept in memory\n"
+"PBR_RECORD_STREAM = 0\n"
+"# Size in MiB of each record log segment, from 1 to 1024\n"
+"PBR_RECORD_SEGMENT_SIZE = 64\n"
+"\n"
+"# System event store configuration\n"
+"# Number of events kept in ipmctl_events.bin in TEMP_FILE_PATH, from 1 to 1000000\n"
+"# Once the store is full every new event replaces the oldest one\n"
+"# The value only takes effect when the store is created\n"
+"EVENT_LOG_MAX_ROWS = 10000\n"
+"\n"
 "# Application temporary files path configuration\n"
 "# The app is going to use the path to store various files required\n"
 "# during the execution\n"
 "TEMP_FILE_PATH = "TEMP_FILE_PATH"\n"
 "\n"
+"# Application state files path configuration\n"
+"# The app is going to use the path to store files that are reused by\n"
+"# later invocations and have to survive a cleanup of the temporary files\n"
+"STATE_FILE_PATH = "STATE_FILE_PATH"\n"
+"\n"
 "# 0 - Disabled\n"
 "# 1 - Enabled\n"
 "DBG_LOG_STDOUT_ENABLED = 0\n"
@@ -7,7 +7,436 @@
  * Implementation of Linux device adapter interface for general operations.
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "lnx_adapter.h"
+#include "lnx_adapter_logging.h"
+
+#define	NDCTL_DIMM_INDEX_BUCKETS	64 // power of two
+#define	NDCTL_DIMM_INDEX_HASH(handle) \
+	((((unsigned int)(handle)) * 2654435761u) & (NDCTL_DIMM_INDEX_BUCKETS - 1))
+
+struct ndctl_dimm_index_entry
+{
+	unsigned int handle;
+	struct ndctl_dimm *p_dimm;
+	struct ndctl_dimm_index_entry *p_next;
+};
+
+/*
+ * A libndctl context with its handle->dimm index. libndctl contexts are not thread
+ * safe, so a slot is checked out by exactly one user at a time and returned to the
+ * pool with put_ndctl_ctx. Idle slots keep their context so the next checkout does
+ * not have to enumerate the buses again.
+ */
+struct ndctl_ctx_slot
+{
+	struct ndctl_ctx *p_ctx;
+	unsigned int generation;
+	int in_use;
+	struct ndctl_dimm_index_entry *p_index[NDCTL_DIMM_INDEX_BUCKETS];
+	struct ndctl_dimm_index_entry *p_entries;
+	struct ndctl_ctx_slot *p_next;
+};
+
+/*
+ * Large mailbox geometry reported by the BIOS, kept per dimm handle independent of
+ * any context until the next invalidation.
+ */
+struct ndctl_mb_geometry_entry
+{
+	unsigned int handle;
+	struct ndctl_mb_geometry mb_geometry;
+	struct ndctl_mb_geometry_entry *p_next;
+};
+
+/*
+ * Process-lifetime pool of libndctl contexts. The pool grows to the number of
+ * concurrent users, a context built before the last invalidation is rebuilt on
+ * its next checkout.
+ */
+static struct ndctl_ctx_slot *g_ndctl_ctx_slots = NULL;
+static unsigned int g_ndctl_generation = 0;
+static struct ndctl_mb_geometry_entry *g_ndctl_mb_geometry[NDCTL_DIMM_INDEX_BUCKETS];
+static pthread_mutex_t g_ndctl_ctx_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Release the context and the handle index of a slot owned by the caller.
+ */
+static void release_ndctl_slot(struct ndctl_ctx_slot *p_slot)
+{
+	memset(p_slot->p_index, 0, sizeof(p_slot->p_index));
+	free(p_slot->p_entries);
+	p_slot->p_entries = NULL;
+
+	if (p_slot->p_ctx)
+	{
+		ndctl_unref(p_slot->p_ctx);
+		p_slot->p_ctx = NULL;
+	}
+}
+
+/*
+ * Build the context and the handle->dimm index of a slot owned by the caller.
+ */
+static int build_ndctl_slot(struct ndctl_ctx_slot *p_slot)
+{
+	int rc = NVM_SUCCESS;
+	unsigned int dimm_cnt = 0;
+	unsigned int index = 0;
+	struct ndctl_bus *bus;
+	struct ndctl_dimm *dimm;
+
+	if ((rc = ndctl_new(&p_slot->p_ctx)) < 0)
+	{
+		COMMON_LOG_ERROR("Failed to retrieve ctx");
+		p_slot->p_ctx = NULL;
+		return linux_err_to_nvm_lib_err(rc);
+	}
+
+	ndctl_bus_foreach(p_slot->p_ctx, bus)
+	{
+		ndctl_dimm_foreach(bus, dimm)
+		{
+			dimm_cnt++;
+		}
+	}
+
+	if (dimm_cnt > 0)
+	{
+		p_slot->p_entries = calloc(dimm_cnt, sizeof(struct ndctl_dimm_index_entry));
+		if (p_slot->p_entries == NULL)
+		{
+			COMMON_LOG_ERROR("Failed to allocate memory for dimm index");
+			release_ndctl_slot(p_slot);
+			return NVM_ERR_NO_MEM;
+		}
+	}
+
+	ndctl_bus_foreach(p_slot->p_ctx, bus)
+	{
+		ndctl_dimm_foreach(bus, dimm)
+		{
+			if (index >= dimm_cnt)
+			{
+				break;
+			}
+			struct ndctl_dimm_index_entry *p_entry = &p_slot->p_entries[index++];
+			unsigned int bucket;
+
+			p_entry->handle = ndctl_dimm_get_handle(dimm);
+			p_entry->p_dimm = dimm;
+			bucket = NDCTL_DIMM_INDEX_HASH(p_entry->handle);
+			p_entry->p_next = p_slot->p_index[bucket];
+			p_slot->p_index[bucket] = p_entry;
+		}
+	}
+
+	return NVM_SUCCESS;
+}
+
+/*
+ * Find a dimm in the index of a slot owned by the caller.
+ */
+static struct ndctl_dimm *find_ndctl_slot_dimm(struct ndctl_ctx_slot *p_slot, unsigned int handle)
+{
+	struct ndctl_dimm_index_entry *p_entry;
+
+	for (p_entry = p_slot->p_index[NDCTL_DIMM_INDEX_HASH(handle)];
+			p_entry != NULL; p_entry = p_entry->p_next)
+	{
+		if (p_entry->handle == handle)
+		{
+			return p_entry->p_dimm;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Find the checked out slot owning a context. Caller must hold g_ndctl_ctx_lock.
+ */
+static struct ndctl_ctx_slot *find_ndctl_slot_locked(struct ndctl_ctx *ctx)
+{
+	struct ndctl_ctx_slot *p_slot;
+
+	for (p_slot = g_ndctl_ctx_slots; p_slot != NULL; p_slot = p_slot->p_next)
+	{
+		if (p_slot->in_use && p_slot->p_ctx == ctx)
+		{
+			break;
+		}
+	}
+	return p_slot;
+}
+
+/*
+ * Return a slot to the pool.
+ */
+static void put_ndctl_slot(struct ndctl_ctx_slot *p_slot)
+{
+	pthread_mutex_lock(&g_ndctl_ctx_lock);
+	p_slot->in_use = 0;
+	pthread_mutex_unlock(&g_ndctl_ctx_lock);
+}
+
+/*
+ * Check out an idle slot, or add one to the pool when all are in use. The context
+ * of the slot is (re)built outside the pool lock so concurrent users do not wait
+ * on each other's bus enumeration.
+ */
+static int checkout_ndctl_slot(struct ndctl_ctx_slot **pp_slot)
+{
+	int rc = NVM_SUCCESS;
+	int stale = 0;
+	struct ndctl_ctx_slot *p_slot;
+
+	pthread_mutex_lock(&g_ndctl_ctx_lock);
+	for (p_slot = g_ndctl_ctx_slots; p_slot != NULL; p_slot = p_slot->p_next)
+	{
+		if (!p_slot->in_use)
+		{
+			break;
+		}
+	}
+	if (p_slot == NULL && (p_slot = calloc(1, sizeof(struct ndctl_ctx_slot))) != NULL)
+	{
+		p_slot->p_next = g_ndctl_ctx_slots;
+		g_ndctl_ctx_slots = p_slot;
+	}
+	if (p_slot != NULL)
+	{
+		p_slot->in_use = 1;
+		stale = (p_slot->p_ctx != NULL && p_slot->generation != g_ndctl_generation);
+		p_slot->generation = g_ndctl_generation;
+	}
+	pthread_mutex_unlock(&g_ndctl_ctx_lock);
+
+	if (p_slot == NULL)
+	{
+		COMMON_LOG_ERROR("Failed to allocate memory for ndctl context");
+		return NVM_ERR_NO_MEM;
+	}
+	if (stale)
+	{
+		release_ndctl_slot(p_slot);
+	}
+	if (p_slot->p_ctx == NULL && (rc = build_ndctl_slot(p_slot)) != NVM_SUCCESS)
+	{
+		put_ndctl_slot(p_slot);
+		return rc;
+	}
+
+	*pp_slot = p_slot;
+	return NVM_SUCCESS;
+}
+
+/*
+ * Check out a libndctl context for the exclusive use of the caller, creating it on
+ * first use. The caller must return it with put_ndctl_ctx.
+ */
+int get_ndctl_ctx(struct ndctl_ctx **pp_ctx)
+{
+	int rc;
+	struct ndctl_ctx_slot *p_slot;
+
+	if (pp_ctx == NULL)
+	{
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+
+	*pp_ctx = NULL;
+	if ((rc = checkout_ndctl_slot(&p_slot)) == NVM_SUCCESS)
+	{
+		*pp_ctx = p_slot->p_ctx;
+	}
+
+	return rc;
+}
+
+/*
+ * Look up a dimm by NFIT handle. On success the context owning the dimm is checked
+ * out for the exclusive use of the caller and must be returned with put_ndctl_ctx.
+ * A handle missing from the index triggers one rebuild in case the topology changed.
+ */
+int get_ndctl_dimm(unsigned int handle, struct ndctl_ctx **pp_ctx, struct ndctl_dimm **pp_dimm)
+{
+	int rc;
+	struct ndctl_ctx_slot *p_slot;
+	struct ndctl_dimm *p_dimm;
+
+	if (pp_ctx == NULL || pp_dimm == NULL)
+	{
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+
+	*pp_ctx = NULL;
+	*pp_dimm = NULL;
+	if ((rc = checkout_ndctl_slot(&p_slot)) != NVM_SUCCESS)
+	{
+		return rc;
+	}
+	if ((p_dimm = find_ndctl_slot_dimm(p_slot, handle)) == NULL)
+	{
+		release_ndctl_slot(p_slot);
+		if ((rc = build_ndctl_slot(p_slot)) == NVM_SUCCESS)
+		{
+			p_dimm = find_ndctl_slot_dimm(p_slot, handle);
+		}
+	}
+	if (p_dimm == NULL)
+	{
+		put_ndctl_slot(p_slot);
+		if (rc == NVM_SUCCESS)
+		{
+			COMMON_LOG_ERROR("Failed to get DIMM from driver");
+			rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
+		}
+		return rc;
+	}
+
+	*pp_ctx = p_slot->p_ctx;
+	*pp_dimm = p_dimm;
+	return NVM_SUCCESS;
+}
+
+/*
+ * Look up a dimm by NFIT handle in a context checked out by the caller.
+ */
+int find_ndctl_ctx_dimm(struct ndctl_ctx *ctx, unsigned int handle, struct ndctl_dimm **pp_dimm)
+{
+	struct ndctl_ctx_slot *p_slot;
+
+	if (ctx == NULL || pp_dimm == NULL)
+	{
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+
+	pthread_mutex_lock(&g_ndctl_ctx_lock);
+	p_slot = find_ndctl_slot_locked(ctx);
+	pthread_mutex_unlock(&g_ndctl_ctx_lock);
+
+	*pp_dimm = (p_slot != NULL) ? find_ndctl_slot_dimm(p_slot, handle) : NULL;
+	if (*pp_dimm == NULL)
+	{
+		COMMON_LOG_ERROR("Failed to get DIMM from driver");
+		return NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
+	}
+	return NVM_SUCCESS;
+}
+
+/*
+ * Return a context checked out by get_ndctl_ctx or get_ndctl_dimm to the pool.
+ */
+void put_ndctl_ctx(struct ndctl_ctx *ctx)
+{
+	struct ndctl_ctx_slot *p_slot;
+
+	if (ctx == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&g_ndctl_ctx_lock);
+	if ((p_slot = find_ndctl_slot_locked(ctx)) != NULL)
+	{
+		p_slot->in_use = 0;
+	}
+	pthread_mutex_unlock(&g_ndctl_ctx_lock);
+
+	if (p_slot == NULL)
+	{
+		COMMON_LOG_ERROR("Returned ndctl context is not checked out");
+	}
+}
+
+/*
+ * Retrieve the cached large mailbox geometry of a dimm.
+ * Fails with NVM_ERR_UNKNOWN when nothing has been cached for the dimm yet.
+ */
+int get_ndctl_dimm_mb_geometry(unsigned int handle, struct ndctl_mb_geometry *p_geometry)
+{
+	int rc = NVM_ERR_UNKNOWN;
+	struct ndctl_mb_geometry_entry *p_entry;
+
+	if (p_geometry == NULL)
+	{
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+
+	pthread_mutex_lock(&g_ndctl_ctx_lock);
+	for (p_entry = g_ndctl_mb_geometry[NDCTL_DIMM_INDEX_HASH(handle)];
+			p_entry != NULL; p_entry = p_entry->p_next)
+	{
+		if (p_entry->handle == handle)
+		{
+			*p_geometry = p_entry->mb_geometry;
+			rc = NVM_SUCCESS;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_ndctl_ctx_lock);
+
+	return rc;
+}
+
+/*
+ * Remember the large mailbox geometry of a dimm until the next invalidation.
+ */
+void set_ndctl_dimm_mb_geometry(unsigned int handle, const struct ndctl_mb_geometry *p_geometry)
+{
+	unsigned int bucket = NDCTL_DIMM_INDEX_HASH(handle);
+	struct ndctl_mb_geometry_entry *p_entry;
+
+	if (p_geometry == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&g_ndctl_ctx_lock);
+	for (p_entry = g_ndctl_mb_geometry[bucket]; p_entry != NULL; p_entry = p_entry->p_next)
+	{
+		if (p_entry->handle == handle)
+		{
+			break;
+		}
+	}
+	if (p_entry == NULL && (p_entry = calloc(1, sizeof(struct ndctl_mb_geometry_entry))) != NULL)
+	{
+		p_entry->handle = handle;
+		p_entry->p_next = g_ndctl_mb_geometry[bucket];
+		g_ndctl_mb_geometry[bucket] = p_entry;
+	}
+	if (p_entry != NULL)
+	{
+		p_entry->mb_geometry = *p_geometry;
+	}
+	pthread_mutex_unlock(&g_ndctl_ctx_lock);
+}
+
+/*
+ * Mark every pooled context stale, e.g. after the nfit driver was rebound, and drop
+ * the cached mailbox geometry. Contexts that are checked out stay valid until they
+ * are returned, each is rebuilt on its next checkout.
+ */
+void invalidate_ndctl_ctx()
+{
+	unsigned int bucket;
+	struct ndctl_mb_geometry_entry *p_entry;
+
+	pthread_mutex_lock(&g_ndctl_ctx_lock);
+	g_ndctl_generation++;
+	for (bucket = 0; bucket < NDCTL_DIMM_INDEX_BUCKETS; bucket++)
+	{
+		while ((p_entry = g_ndctl_mb_geometry[bucket]) != NULL)
+		{
+			g_ndctl_mb_geometry[bucket] = p_entry->p_next;
+			free(p_entry);
+		}
+	}
+	pthread_mutex_unlock(&g_ndctl_ctx_lock);
+}
 
 /*
  * Retrieve the vendor specific NVDIMM driver version.
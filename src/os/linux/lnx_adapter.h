@@ -18,10 +18,27 @@
 
 #define	SYSFS_ATTR_SIZE 1024
 
+/*
+ * Emulated BIOS large mailbox geometry, cached per dimm handle
+ */
+struct ndctl_mb_geometry
+{
+	unsigned int large_input_payload_size;
+	unsigned int large_output_payload_size;
+	unsigned int rw_size;
+};
+
 int linux_err_to_nvm_lib_err(int);
 int open_ioctl_target(int *p_target, const char *dev_name);
 int send_ioctl_command(int fd, unsigned long request, void* parg);
 int get_dimm_by_handle(struct ndctl_ctx *ctx, unsigned int handle, struct ndctl_dimm **dimm);
+int get_ndctl_ctx(struct ndctl_ctx **pp_ctx);
+int get_ndctl_dimm(unsigned int handle, struct ndctl_ctx **pp_ctx, struct ndctl_dimm **pp_dimm);
+int find_ndctl_ctx_dimm(struct ndctl_ctx *ctx, unsigned int handle, struct ndctl_dimm **pp_dimm);
+void put_ndctl_ctx(struct ndctl_ctx *ctx);
+void invalidate_ndctl_ctx();
+int get_ndctl_dimm_mb_geometry(unsigned int handle, struct ndctl_mb_geometry *p_geometry);
+void set_ndctl_dimm_mb_geometry(unsigned int handle, const struct ndctl_mb_geometry *p_geometry);
 int get_unconfigured_namespace(struct ndctl_namespace **unconfigured_namespace,
 	struct ndctl_region *region);
 int get_vendor_driver_revision(char * version_str, const int str_len);
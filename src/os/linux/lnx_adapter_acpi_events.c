@@ -3,11 +3,18 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <nvm_types.h>
 #include <export_api.h>
+#include <os.h>
 #include "lnx_adapter_logging.h"
 #include "lnx_adapter.h"
 
+#define	HEALTH_MONITOR_MAX_WAIT_EVENTS	64
+
 
 struct nvm_dimm_acpi_event_ctx
 {
@@ -35,15 +42,18 @@ NVM_API int acpi_event_create_ctx(unsigned int dimm_handle, void ** ctx)
 	new_ctx = *ctx = (struct nvm_dimm_acpi_event_ctx *)malloc(sizeof(struct nvm_dimm_acpi_event_ctx));
 	if (new_ctx)
 	{
-		ndctl_new(&new_ctx->ndctl_lib_ctx);
 		new_ctx->dimm_handle = dimm_handle;
-		if (NVM_SUCCESS == (rc = get_dimm_by_handle(new_ctx->ndctl_lib_ctx, dimm_handle, &new_ctx->ndctl_lib_dimm)))
+		new_ctx->monitored_events = 0;
+		new_ctx->triggered_events = 0;
+		if (NVM_SUCCESS == (rc = get_ndctl_dimm(dimm_handle, &new_ctx->ndctl_lib_ctx, &new_ctx->ndctl_lib_dimm)))
 		{
 			new_ctx->smart_health_fd = ndctl_dimm_get_health_eventfd(new_ctx->ndctl_lib_dimm);
 		}
 		else
 		{
 			COMMON_LOG_ERROR("Failed to get dimm by handle.");
+			free(new_ctx);
+			*ctx = NULL;
 			return rc;
 		}
 	}
@@ -67,7 +77,7 @@ NVM_API int acpi_event_free_ctx(void * ctx)
 	if (NULL != ctx)
 	{
 		struct nvm_dimm_acpi_event_ctx * p_ctx = (struct nvm_dimm_acpi_event_ctx *)ctx;
-		ndctl_unref(p_ctx->ndctl_lib_ctx);
+		put_ndctl_ctx(p_ctx->ndctl_lib_ctx);
 		free(ctx);
 	}
 
@@ -191,35 +201,36 @@ NVM_API int acpi_wait_for_event(void * acpi_event_contexts[], const NVM_UINT32 d
 	struct nvm_dimm_acpi_event_ctx * context;
 	int rc = NVM_ERR_UNKNOWN;
 	char buf[4096]; //4k based on ndctl example
-	fd_set fds;
-	int max_fd = 0;
-	FD_ZERO(&fds);
+	struct pollfd *p_fds;
+
+	// poll rather than select, so descriptors above FD_SETSIZE work too;
+	// os_health_monitor_* keeps the descriptors armed between waits
+	if (NULL == (p_fds = (struct pollfd *)calloc(dimm_cnt ? dimm_cnt : 1, sizeof(struct pollfd))))
+	{
+		COMMON_LOG_ERROR("Failed to allocate memory for the poll set.");
+		return NVM_ERR_NO_MEM;
+	}
 
 	//add all dimm smart health FDs to the set
-	//and re-arm them (lseek/pread)
+	//and re-arm them (pread)
 	for (int i = 0; i < dimm_cnt; ++i)
 	{
 		context = (struct nvm_dimm_acpi_event_ctx *)acpi_event_contexts[i];
 		context->triggered_events = 0;
 		int fd = context->smart_health_fd;
-		if (fd > max_fd)
-			max_fd = fd;
 
-		lseek(fd, 0, SEEK_SET);
 		rc = pread(fd, buf, sizeof(buf), 0);
-		FD_SET(fd, &fds);
+		p_fds[i].fd = fd;
+		p_fds[i].events = POLLPRI;
 	}
 
-	struct timeval tm;
-	tm.tv_sec = timeout_sec;
-	tm.tv_usec = 0;
 	//wait for event(s), can either have timeout or wait indefinitely for an event
-	if (0 < (rc = select(max_fd + 1, NULL, NULL, &fds, ((timeout_sec >= 0) ? &tm : NULL))))
+	if (0 < (rc = poll(p_fds, dimm_cnt, ((timeout_sec >= 0) ? timeout_sec * 1000 : -1))))
 	{
 		for (int i = 0; i < dimm_cnt; ++i)
 		{
 			context = (struct nvm_dimm_acpi_event_ctx *)acpi_event_contexts[i];
-			if (FD_ISSET(context->smart_health_fd, &fds))
+			if (p_fds[i].revents & POLLPRI)
 			{
 				context->triggered_events |= DIMM_ACPI_EVENT_SMART_HEALTH_MASK;
 				*event_result = ACPI_EVENT_SIGNALLED_RESULT;
@@ -230,5 +241,231 @@ NVM_API int acpi_wait_for_event(void * acpi_event_contexts[], const NVM_UINT32 d
 	{
 		*event_result = (rc == 0 ? ACPI_EVENT_TIMED_OUT_RESULT : ACPI_EVENT_UNKNOWN_RESULT);
 	}
+	free(p_fds);
 	return NVM_SUCCESS;
 }
+
+struct health_monitor_entry
+{
+	unsigned int dimm_handle;
+	unsigned int monitored_events;
+	int smart_health_fd;
+};
+
+/*
+ * The descriptors stay registered with epoll for the life of the monitor, the epoll
+ * data of each descriptor is the index of its entry.
+ */
+struct health_monitor
+{
+	int epoll_fd;
+	unsigned int count;
+	unsigned int capacity;
+	struct health_monitor_entry *p_entries;
+	struct ndctl_ctx *ndctl_lib_ctx; // checked out for the monitor, keeps the descriptors open
+};
+
+/*
+* Create a health event monitor with no DIMMs registered.
+*
+* @param[out] pp_monitor - the new monitor, to be freed by os_health_monitor_free
+* @return Returns one of the following
+*		NVM_ERR_INVALID_PARAMETER
+*		NVM_ERR_NO_MEM
+*		NVM_ERR_UNKNOWN
+*		NVM_SUCCESS
+*/
+int os_health_monitor_create(OS_HEALTH_MONITOR **pp_monitor)
+{
+	struct health_monitor *p_monitor;
+
+	if (NULL == pp_monitor)
+	{
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+	*pp_monitor = NULL;
+	if (NULL == (p_monitor = (struct health_monitor *)calloc(1, sizeof(struct health_monitor))))
+	{
+		COMMON_LOG_ERROR("Failed to allocate memory for the health monitor.");
+		return NVM_ERR_NO_MEM;
+	}
+	if (0 > (p_monitor->epoll_fd = epoll_create1(EPOLL_CLOEXEC)))
+	{
+		COMMON_LOG_ERROR("Failed to create the health monitor epoll instance.");
+		free(p_monitor);
+		return NVM_ERR_UNKNOWN;
+	}
+	*pp_monitor = p_monitor;
+	return NVM_SUCCESS;
+}
+
+/*
+* Register a DIMM with the monitor. The health event descriptor of the DIMM is armed
+* by reading it once, after which it reports EPOLLPRI when the DIMM signals.
+*
+* @param[in] p_monitor - monitor created by os_health_monitor_create
+* @param[in] dimm_handle - NFIT dimm handle
+* @param[in] event_mask - DIMM_ACPI_EVENT_*_MASK bits to report for the DIMM
+* @return Returns one of the following
+*		NVM_ERR_INVALID_PARAMETER
+*		NVM_ERR_NO_MEM
+*		NVM_ERR_UNKNOWN
+*		NVM_SUCCESS
+*/
+int os_health_monitor_add(OS_HEALTH_MONITOR *p_monitor, unsigned int dimm_handle,
+	unsigned int event_mask)
+{
+	struct health_monitor *p_mon = (struct health_monitor *)p_monitor;
+	struct health_monitor_entry *p_entry;
+	struct ndctl_dimm *p_dimm = NULL;
+	struct epoll_event ev;
+	char buf[4096]; //4k based on ndctl example
+	int rc;
+
+	if (NULL == p_mon)
+	{
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+	if (p_mon->count == p_mon->capacity)
+	{
+		unsigned int capacity = p_mon->capacity ? p_mon->capacity * 2 : 16;
+		p_entry = (struct health_monitor_entry *)realloc(p_mon->p_entries,
+			capacity * sizeof(struct health_monitor_entry));
+		if (NULL == p_entry)
+		{
+			COMMON_LOG_ERROR("Failed to allocate memory for the health monitor.");
+			return NVM_ERR_NO_MEM;
+		}
+		p_mon->p_entries = p_entry;
+		p_mon->capacity = capacity;
+	}
+
+	if (NULL == p_mon->ndctl_lib_ctx &&
+		NVM_SUCCESS != (rc = get_ndctl_ctx(&p_mon->ndctl_lib_ctx)))
+	{
+		COMMON_LOG_ERROR("Failed to get ndctl context.");
+		return rc;
+	}
+
+	p_entry = &p_mon->p_entries[p_mon->count];
+	p_entry->dimm_handle = dimm_handle;
+	p_entry->monitored_events = event_mask;
+	if (NVM_SUCCESS != (rc = find_ndctl_ctx_dimm(p_mon->ndctl_lib_ctx, dimm_handle, &p_dimm)))
+	{
+		COMMON_LOG_ERROR("Failed to get dimm by handle.");
+		return rc;
+	}
+	if (0 > (p_entry->smart_health_fd = ndctl_dimm_get_health_eventfd(p_dimm)) ||
+		0 > pread(p_entry->smart_health_fd, buf, sizeof(buf), 0))
+	{
+		COMMON_LOG_ERROR("Failed to arm the dimm health event.");
+		return NVM_ERR_UNKNOWN;
+	}
+
+	ev.events = EPOLLPRI;
+	ev.data.u32 = p_mon->count;
+	if (0 != epoll_ctl(p_mon->epoll_fd, EPOLL_CTL_ADD, p_entry->smart_health_fd, &ev))
+	{
+		COMMON_LOG_ERROR("Failed to register the dimm health event.");
+		return NVM_ERR_UNKNOWN;
+	}
+	p_mon->count++;
+	return NVM_SUCCESS;
+}
+
+/*
+* Wait for DIMM health events. Returns when the timeout expires or at least one registered
+* DIMM signals, with one entry per signalling DIMM. The descriptors that fired are re-armed,
+* those not reported because p_events is full are reported by the next wait.
+*
+* @param[in] p_monitor - monitor created by os_health_monitor_create
+* @param[in] timeout_sec - -1 - No timeout, all other non-negative values represent a second granularity timeout value
+* @param[out] p_events - the DIMMs that signalled and their events
+* @param[in] max_events - number of entries p_events can hold
+* @param[out] p_count - number of entries written, 0 when the wait timed out
+* @return Returns one of the following
+*		NVM_ERR_INVALID_PARAMETER
+*		NVM_ERR_UNKNOWN
+*		NVM_SUCCESS
+*/
+int os_health_monitor_wait(OS_HEALTH_MONITOR *p_monitor, int timeout_sec,
+	struct os_health_event *p_events, unsigned int max_events, unsigned int *p_count)
+{
+	struct health_monitor *p_mon = (struct health_monitor *)p_monitor;
+	struct epoll_event ready[HEALTH_MONITOR_MAX_WAIT_EVENTS];
+	struct health_monitor_entry *p_entry;
+	char buf[4096]; //4k based on ndctl example
+	int ready_cnt;
+	int i;
+
+	if (NULL == p_mon || NULL == p_events || 0 == max_events || NULL == p_count)
+	{
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+	*p_count = 0;
+	if (max_events > HEALTH_MONITOR_MAX_WAIT_EVENTS)
+	{
+		max_events = HEALTH_MONITOR_MAX_WAIT_EVENTS;
+	}
+
+	ready_cnt = epoll_wait(p_mon->epoll_fd, ready, (int)max_events,
+		(timeout_sec >= 0) ? timeout_sec * 1000 : -1);
+	if (ready_cnt < 0)
+	{
+		// A signal ends the wait early, same as a timeout
+		return (errno == EINTR) ? NVM_SUCCESS : NVM_ERR_UNKNOWN;
+	}
+
+	for (i = 0; i < ready_cnt; ++i)
+	{
+		if (ready[i].data.u32 >= p_mon->count)
+		{
+			continue;
+		}
+		p_entry = &p_mon->p_entries[ready[i].data.u32];
+		if (0 > pread(p_entry->smart_health_fd, buf, sizeof(buf), 0))
+		{
+			COMMON_LOG_ERROR("Failed to re-arm a dimm health event.");
+		}
+		if (p_entry->monitored_events & DIMM_ACPI_EVENT_SMART_HEALTH_MASK)
+		{
+			p_events[*p_count].dimm_handle = p_entry->dimm_handle;
+			p_events[*p_count].events = DIMM_ACPI_EVENT_SMART_HEALTH_MASK;
+			(*p_count)++;
+		}
+	}
+	return NVM_SUCCESS;
+}
+
+/*
+* Get the epoll descriptor of a monitor. It polls readable while a registered DIMM
+* has signalled and os_health_monitor_wait has not reported it yet.
+*
+* @param[in] p_monitor - monitor created by os_health_monitor_create
+* @return the descriptor, -1 if p_monitor is NULL
+*/
+int os_health_monitor_fd(OS_HEALTH_MONITOR *p_monitor)
+{
+	struct health_monitor *p_mon = (struct health_monitor *)p_monitor;
+
+	return (NULL == p_mon) ? -1 : p_mon->epoll_fd;
+}
+
+/*
+* Free a monitor created by os_health_monitor_create.
+*
+* @param[in] p_monitor - the monitor, may be NULL
+*/
+void os_health_monitor_free(OS_HEALTH_MONITOR *p_monitor)
+{
+	struct health_monitor *p_mon = (struct health_monitor *)p_monitor;
+
+	if (NULL == p_mon)
+	{
+		return;
+	}
+	close(p_mon->epoll_fd);
+	put_ndctl_ctx(p_mon->ndctl_lib_ctx);
+	free(p_mon->p_entries);
+	free(p_mon);
+}
@@ -15,6 +15,8 @@
 //#include <os/os_adapter.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <os.h>
 #include <os_types.h>
 #define DEV_SMALL_PAYLOAD_SIZE	128 /* 128B - Size for a passthrough command small payload */
 
@@ -156,112 +158,160 @@ int bios_get_payload_size(struct ndctl_dimm *p_dimm, struct pt_bios_get_size *p_
 	return rc;
 }
 
+/*
+ * Retrieve the emulated bios large mailbox geometry of a dimm. The BIOS is only
+ * asked the first time, afterwards the answer cached per dimm handle is used.
+ */
+static int get_large_mb_size(struct ndctl_dimm *p_dimm, struct pt_bios_get_size *p_mb_size,
+		struct fw_cmd *p_fw_cmd)
+{
+	int rc = NVM_SUCCESS;
+	struct ndctl_mb_geometry geometry;
+	unsigned int handle = ndctl_dimm_get_handle(p_dimm);
+
+	if (get_ndctl_dimm_mb_geometry(handle, &geometry) == NVM_SUCCESS)
+	{
+		p_mb_size->large_input_payload_size = geometry.large_input_payload_size;
+		p_mb_size->large_output_payload_size = geometry.large_output_payload_size;
+		p_mb_size->rw_size = geometry.rw_size;
+	}
+	else if ((rc = bios_get_payload_size(p_dimm, p_mb_size, p_fw_cmd)) == NVM_SUCCESS)
+	{
+		if (p_mb_size->rw_size == 0)
+		{
+			COMMON_LOG_ERROR("BIOS reported a zero large payload transfer size");
+			rc = NVM_ERR_BAD_SIZE;
+		}
+		else
+		{
+			geometry.large_input_payload_size = p_mb_size->large_input_payload_size;
+			geometry.large_output_payload_size = p_mb_size->large_output_payload_size;
+			geometry.rw_size = p_mb_size->rw_size;
+			set_ndctl_dimm_mb_geometry(handle, &geometry);
+		}
+	}
+	return rc;
+}
+
+/*
+ * Submit a single large mailbox transfer command and translate its status
+ */
+static int submit_large_payload_cmd(struct ndctl_cmd *p_vendor_cmd, struct fw_cmd *p_fw_cmd)
+{
+	int rc = NVM_SUCCESS;
+	int lnx_err_status = 0;
+	unsigned int dsm_vendor_err_status = 0;
+
+	if ((lnx_err_status = ndctl_cmd_submit(p_vendor_cmd)) == 0)
+	{
+		if ((dsm_vendor_err_status = ndctl_cmd_get_firmware_status(p_vendor_cmd))
+				!= DSM_VENDOR_SUCCESS)
+		{
+      DSM_TO_NVM_ERROR(dsm_vendor_err_status, p_fw_cmd, rc);
+			COMMON_LOG_ERROR_F("BIOS large payload transfer failed: "
+					"DSM returned error %d for command with "
+					"Opcode- 0x%x SubOpcode- 0x%x ", dsm_vendor_err_status,
+					p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
+		}
+	}
+	else
+	{
+		rc = linux_err_to_nvm_lib_err(lnx_err_status);
+		COMMON_LOG_ERROR_F("BIOS large payload transfer failed: "
+				"Linux driver returned error %d for command with "
+				"Opcode- 0x%x SubOpcode- 0x%x ", lnx_err_status,
+				p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
+	}
+	return rc;
+}
+
 /*
  * Populate the emulated bios large input mailbox
+ *
+ * One vendor command sized for a full rw_size chunk is reused for every full
+ * chunk, only a short tail chunk needs a command of its own.
  */
 int bios_write_large_payload(struct ndctl_dimm *p_dimm, struct fw_cmd *p_fw_cmd)
 {
 	COMMON_LOG_ENTRY();
 	int rc = NVM_SUCCESS;
 	struct pt_bios_get_size mb_size;
+	BIOS_INPUT(bios_InputPayload, 0);
+	struct bios_InputPayload *p_dsm_input = NULL;
+	struct ndctl_cmd *p_full_cmd = NULL;
 
 	if (!p_dimm)
 	{
 		COMMON_LOG_ERROR("Invalid parameter, Dimm is null");
 		rc = NVM_ERR_INVALID_PARAMETER;
 	}
-	else if ((rc = bios_get_payload_size(p_dimm, &mb_size, p_fw_cmd)) == NVM_SUCCESS)
+	else if ((rc = get_large_mb_size(p_dimm, &mb_size, p_fw_cmd)) == NVM_SUCCESS)
 	{
 		if (mb_size.large_input_payload_size < p_fw_cmd->LargeInputPayloadSize)
 		{
 			rc = NVM_ERR_BAD_SIZE;
 		}
+		// the header and the data have to be contiguous for ndctl_cmd_vendor_set_input,
+		// so a single buffer sized for a full chunk is shared by all chunks
+		else if ((p_dsm_input = malloc(sizeof (*p_dsm_input) + mb_size.rw_size)) == NULL)
+		{
+			COMMON_LOG_ERROR("Failed to allocate memory for BIOS input payload");
+			rc = NVM_ERR_NO_MEM;
+		}
 		else
 		{
-			unsigned int transfer_size = mb_size.rw_size;
 			unsigned int current_offset = 0;
 
 			while (current_offset < p_fw_cmd->LargeInputPayloadSize &&
 					rc == NVM_SUCCESS)
 			{
+				unsigned int transfer_size = mb_size.rw_size;
+				struct ndctl_cmd *p_vendor_cmd = NULL;
+
 				if ((current_offset + mb_size.rw_size) > p_fw_cmd->LargeInputPayloadSize)
 				{
 					transfer_size = p_fw_cmd->LargeInputPayloadSize - current_offset;
 				}
 
-				BIOS_INPUT(bios_InputPayload, transfer_size);
-				struct bios_InputPayload *p_dsm_input = calloc(1,
-					sizeof (struct bios_InputPayload));
-				if (p_dsm_input)
+				if (transfer_size == mb_size.rw_size && p_full_cmd != NULL)
 				{
-					struct ndctl_cmd *p_vendor_cmd = NULL;
-					if ((p_vendor_cmd = ndctl_dimm_cmd_new_vendor_specific(
-							p_dimm, BUILD_DSM_OPCODE(BIOS_EMULATED_COMMAND,
-							SUBOP_WRITE_LARGE_PAYLOAD_INPUT),
-							sizeof (*p_dsm_input), 0)) == NULL)
-					{
-						COMMON_LOG_ERROR("Failed to get vendor command from driver");
-						rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
-					}
-					else
-					{
-						int lnx_err_status = 0;
-						unsigned int dsm_vendor_err_status = 0;
-
-						p_dsm_input->size = transfer_size;
-						p_dsm_input->offset = current_offset;
-
-						memmove(p_dsm_input->buffer,
-							p_fw_cmd->LargeInputPayload + current_offset,
-							sizeof (p_dsm_input->buffer));
-
-						size_t bytes_written = ndctl_cmd_vendor_set_input(
-							p_vendor_cmd, p_dsm_input, sizeof (*p_dsm_input));
-
-						if (bytes_written != sizeof (*p_dsm_input))
-						{
-							COMMON_LOG_ERROR("Failed to write input payload");
-							rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
-						}
-						else
-						{
-							if ((lnx_err_status = ndctl_cmd_submit(p_vendor_cmd)) == 0)
-							{
-								if ((dsm_vendor_err_status =
-										ndctl_cmd_get_firmware_status(p_vendor_cmd))
-												!= DSM_VENDOR_SUCCESS)
-								{
-                  DSM_TO_NVM_ERROR(dsm_vendor_err_status, p_fw_cmd, rc);
-									COMMON_LOG_ERROR_F("BIOS write failed: "
-											"DSM returned error %d for command with "
-											"Opcode- 0x%x SubOpcode- 0x%x ", dsm_vendor_err_status,
-											p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
-								}
-								else
-								{
-										current_offset += transfer_size;
-								}
+					p_vendor_cmd = p_full_cmd;
+				}
+				else if ((p_vendor_cmd = ndctl_dimm_cmd_new_vendor_specific(
+						p_dimm, BUILD_DSM_OPCODE(BIOS_EMULATED_COMMAND,
+						SUBOP_WRITE_LARGE_PAYLOAD_INPUT),
+						sizeof (*p_dsm_input) + transfer_size, 0)) == NULL)
+				{
+					COMMON_LOG_ERROR("Failed to get vendor command from driver");
+					rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
+					break;
+				}
+				else if (transfer_size == mb_size.rw_size)
+				{
+					p_full_cmd = p_vendor_cmd;
+				}
 
-							}
-							else
-							{
-								rc = linux_err_to_nvm_lib_err(lnx_err_status);
-								COMMON_LOG_ERROR_F("BIOS write failed: "
-										"Linux driver returned error %d for command with "
-											"Opcode- 0x%x SubOpcode- 0x%x ", lnx_err_status,
-												p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
+				p_dsm_input->size = transfer_size;
+				p_dsm_input->offset = current_offset;
+				memcpy(p_dsm_input->buffer,
+					p_fw_cmd->LargeInputPayload + current_offset, transfer_size);
 
-							}
-						}
+				size_t bytes_written = ndctl_cmd_vendor_set_input(
+					p_vendor_cmd, p_dsm_input, sizeof (*p_dsm_input) + transfer_size);
 
-						ndctl_cmd_unref(p_vendor_cmd);
-					}
-					free(p_dsm_input);
+				if (bytes_written != sizeof (*p_dsm_input) + transfer_size)
+				{
+					COMMON_LOG_ERROR("Failed to write input payload");
+					rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
 				}
-				else
+				else if ((rc = submit_large_payload_cmd(p_vendor_cmd, p_fw_cmd)) == NVM_SUCCESS)
+				{
+					current_offset += transfer_size;
+				}
+
+				if (p_vendor_cmd != p_full_cmd)
 				{
-					COMMON_LOG_ERROR("Failed to allocate memory for BIOS input payload");
-					rc = NVM_ERR_NO_MEM;
+					ndctl_cmd_unref(p_vendor_cmd);
 				}
 			} // end while
 
@@ -273,25 +323,36 @@ int bios_write_large_payload(struct ndctl_dimm *p_dimm, struct fw_cmd *p_fw_cmd)
 		}
 	}
 
+	if (p_full_cmd)
+	{
+		ndctl_cmd_unref(p_full_cmd);
+	}
+	free(p_dsm_input);
 	COMMON_LOG_EXIT_RETURN_I(rc);
 	return rc;
 }
 
 /*
  * Read the emulated bios large output mailbox
+ *
+ * Chunks are copied by libndctl straight into LargeOutputPayload. As for writes,
+ * one vendor command is reused for every full rw_size chunk.
  */
 int bios_read_large_payload(struct ndctl_dimm *p_dimm, struct fw_cmd *p_fw_cmd)
 {
 	COMMON_LOG_ENTRY();
 	int rc = NVM_SUCCESS;
 	struct pt_bios_get_size mb_size;
+	BIOS_INPUT(bios_InputPayload, 0);
+	struct bios_InputPayload dsm_input;
+	struct ndctl_cmd *p_full_cmd = NULL;
 
 	if (!p_dimm)
 	{
 		COMMON_LOG_ERROR("Invalid parameter, Dimm is null");
 		rc = NVM_ERR_INVALID_PARAMETER;
 	}
-	else if ((rc = bios_get_payload_size(p_dimm, &mb_size, p_fw_cmd)) == NVM_SUCCESS)
+	else if ((rc = get_large_mb_size(p_dimm, &mb_size, p_fw_cmd)) == NVM_SUCCESS)
 	{
 		if (mb_size.large_input_payload_size < p_fw_cmd->LargeOutputPayloadSize)
 		{
@@ -299,91 +360,66 @@ int bios_read_large_payload(struct ndctl_dimm *p_dimm, struct fw_cmd *p_fw_cmd)
 		}
 		else
 		{
-			unsigned int transfer_size = mb_size.rw_size;
 			unsigned int current_offset = 0;
-			int lnx_err_status = 0;
-			unsigned int dsm_vendor_err_status = 0;
 
-			rc = NVM_SUCCESS;
 			while (current_offset < p_fw_cmd->LargeOutputPayloadSize &&
 					rc == NVM_SUCCESS)
 			{
+				unsigned int transfer_size = mb_size.rw_size;
+				struct ndctl_cmd *p_vendor_cmd = NULL;
+
 				if ((current_offset + mb_size.rw_size) > p_fw_cmd->LargeOutputPayloadSize)
 				{
 					transfer_size = p_fw_cmd->LargeOutputPayloadSize - current_offset;
 				}
 
-				BIOS_INPUT(bios_InputPayload, 0);
-				struct bios_InputPayload *p_dsm_input =
-					calloc(1, sizeof (struct bios_InputPayload));
-				if (p_dsm_input)
+				if (transfer_size == mb_size.rw_size && p_full_cmd != NULL)
 				{
-					struct ndctl_cmd *p_vendor_cmd = NULL;
-					if ((p_vendor_cmd = ndctl_dimm_cmd_new_vendor_specific(p_dimm,
+					p_vendor_cmd = p_full_cmd;
+				}
+				else if ((p_vendor_cmd = ndctl_dimm_cmd_new_vendor_specific(p_dimm,
 						BUILD_DSM_OPCODE(BIOS_EMULATED_COMMAND, SUBOP_READ_LARGE_PAYLOAD_OUTPUT),
-						sizeof (*p_dsm_input), transfer_size)) == NULL)
+						sizeof (dsm_input), transfer_size)) == NULL)
+				{
+					rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
+					COMMON_LOG_ERROR("Failed to get vendor command from driver");
+					break;
+				}
+				else if (transfer_size == mb_size.rw_size)
+				{
+					p_full_cmd = p_vendor_cmd;
+				}
+
+				dsm_input.size = transfer_size;
+				dsm_input.offset = current_offset;
+
+				size_t bytes_written = ndctl_cmd_vendor_set_input(
+					p_vendor_cmd, &dsm_input, sizeof (dsm_input));
+				if (bytes_written != sizeof (dsm_input))
+				{
+					COMMON_LOG_ERROR("Failed to write input payload");
+					rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
+				}
+				else if ((rc = submit_large_payload_cmd(p_vendor_cmd, p_fw_cmd)) == NVM_SUCCESS)
+				{
+					size_t return_size = ndctl_cmd_vendor_get_output(p_vendor_cmd,
+							p_fw_cmd->LargeOutputPayload +
+							current_offset, transfer_size);
+					if (return_size != transfer_size)
 					{
 						rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
-						COMMON_LOG_ERROR("Failed to get vendor command from driver");
+						COMMON_LOG_ERROR("Large Payload returned "
+								"less data than requested");
 					}
 					else
 					{
-						p_dsm_input->size = transfer_size;
-						p_dsm_input->offset = current_offset;
-
-						size_t bytes_written = ndctl_cmd_vendor_set_input(
-							p_vendor_cmd, p_dsm_input, sizeof (*p_dsm_input));
-						if (bytes_written != sizeof (*p_dsm_input))
-						{
-							COMMON_LOG_ERROR("Failed to write input payload");
-							rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
-						}
-
-						if ((lnx_err_status = ndctl_cmd_submit(p_vendor_cmd)) == 0)
-						{
-							if ((dsm_vendor_err_status =
-									ndctl_cmd_get_firmware_status(p_vendor_cmd)) !=
-											DSM_VENDOR_SUCCESS)
-							{
-                DSM_TO_NVM_ERROR(dsm_vendor_err_status, p_fw_cmd, rc);
-								COMMON_LOG_ERROR_F("BIOS read failed: "
-										"DSM returned error %d for command with "
-										"Opcode - 0x%x SubOpcode - 0x%x ", dsm_vendor_err_status,
-										p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
-							}
-							else
-							{
-								size_t return_size = ndctl_cmd_vendor_get_output(p_vendor_cmd,
-										p_fw_cmd->LargeOutputPayload +
-										current_offset, transfer_size);
-								if (return_size != transfer_size)
-								{
-									rc = NVM_ERR_GENERAL_OS_DRIVER_FAILURE;
-									COMMON_LOG_ERROR("Large Payload returned "
-											"less data than requested");
-								}
-								else
-								{
-									current_offset += transfer_size;
-								}
-							}
-						}
-						else
-						{
-							rc = linux_err_to_nvm_lib_err(lnx_err_status);
-							COMMON_LOG_ERROR_F("BIOS read failed: "
-									"Linux driver returned error %d for command with "
-									"Opcode - 0x%x SubOpcode - 0x%x ", lnx_err_status,
-									p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
-						}
-						ndctl_cmd_unref(p_vendor_cmd);
+						current_offset += transfer_size;
 					}
-					free(p_dsm_input);
 				}
-				else
+
+				if (p_vendor_cmd != p_full_cmd)
 				{
-					COMMON_LOG_ERROR("Failed to allocate memory for BIOS payload");
-					rc = NVM_ERR_NO_MEM;
+					ndctl_cmd_unref(p_vendor_cmd);
 				}
 			}  // end while
 
@@ -395,6 +431,10 @@ int bios_read_large_payload(struct ndctl_dimm *p_dimm, struct fw_cmd *p_fw_cmd)
 		}
 	}
 
+	if (p_full_cmd)
+	{
+		ndctl_cmd_unref(p_full_cmd);
+	}
 	COMMON_LOG_EXIT_RETURN_I(rc);
 	return rc;
 }
@@ -428,15 +468,80 @@ int get_dimm_by_handle(struct ndctl_ctx *ctx, unsigned int handle, struct ndctl_
 	return rc;
 }
 
+/*
+ * Monotonic time in microseconds, used to bound passthrough retries
+ */
+static unsigned long long passthrough_time_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+}
+
+/*
+ * Pick the delay before the next DSM_VENDOR_RETRY_SUGGESTED retry.
+ * Exponential backoff with +/-50% jitter so DIMMs that went busy together
+ * do not get polled in lockstep, clamped to what is left of the deadline.
+ * Returns 0 when there is no time left for another attempt.
+ */
+static unsigned long passthrough_retry_delay_ms(int retry, unsigned int *p_seed,
+	unsigned long long now_us, unsigned long long deadline_us)
+{
+	unsigned long backoff_ms = DSM_RETRY_BACKOFF_MIN_MS;
+	unsigned long delay_ms = 0;
+	unsigned long long remaining_ms = 0;
+
+	for (int i = 0; i < retry && backoff_ms < DSM_RETRY_BACKOFF_MAX_MS; i++)
+	{
+		backoff_ms <<= 1;
+	}
+	if (backoff_ms > DSM_RETRY_BACKOFF_MAX_MS)
+	{
+		backoff_ms = DSM_RETRY_BACKOFF_MAX_MS;
+	}
+
+	// xorshift, cheap and private to the calling thread
+	*p_seed ^= *p_seed << 13;
+	*p_seed ^= *p_seed >> 17;
+	*p_seed ^= *p_seed << 5;
+	delay_ms = backoff_ms / 2 + (*p_seed % (backoff_ms + 1));
+	if (delay_ms == 0)
+	{
+		delay_ms = 1;
+	}
+
+	if (deadline_us)
+	{
+		if (now_us >= deadline_us)
+		{
+			return 0;
+		}
+		remaining_ms = (deadline_us - now_us) / 1000;
+		if (remaining_ms == 0)
+		{
+			return 0;
+		}
+		if (delay_ms > remaining_ms)
+		{
+			delay_ms = (unsigned long)remaining_ms;
+		}
+	}
+	return delay_ms;
+}
+
 /*
  * Execute a passthrough IOCTL
  */
-int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd)
+int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd, unsigned long long timeout_us)
 {
 	COMMON_LOG_ENTRY();
 	int rc = NVM_SUCCESS;
 	struct ndctl_ctx *ctx;
 	int retry = 0;
+	unsigned int attempts = 0;
+	unsigned long long start_us = passthrough_time_us();
+	unsigned long long deadline_us = timeout_us ? start_us + timeout_us : 0;
+	unsigned int seed = 0;
 
 	// check input parameters
 	if (p_fw_cmd == NULL)
@@ -462,15 +567,10 @@ int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd)
 		rc = NVM_LIB_ERR_NOTSUPPORTED;
 	}
 #endif
-	else if ((rc = ndctl_new(&ctx)) < 0)
-	{
-		COMMON_LOG_ERROR("Failed to retrieve ctx");
-		rc = linux_err_to_nvm_lib_err(rc);
-	}
 	else
 	{
 		struct ndctl_dimm *p_dimm = NULL;
-		if ((rc = get_dimm_by_handle(ctx, p_fw_cmd->DimmID, &p_dimm)) == NVM_SUCCESS)
+		if ((rc = get_ndctl_dimm(p_fw_cmd->DimmID, &ctx, &p_dimm)) == NVM_SUCCESS)
 		{
 			unsigned int Opcode = BUILD_DSM_OPCODE(p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
 			struct ndctl_cmd *p_vendor_cmd = NULL;
@@ -483,12 +583,15 @@ int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd)
 			}
 			else
 			{
-				while (retry < DSM_MAX_RETRIES)
+				seed = (unsigned int)(start_us ^ (p_fw_cmd->DimmID * 2654435761U)) | 1;
+				// without a deadline keep the historical bound on the attempt count
+				while (deadline_us || retry < DSM_MAX_RETRIES)
 				{
 					int lnx_err_status = 0;
 					unsigned int dsm_vendor_err_status = 0;
           p_fw_cmd->DsmStatus = 0;
           p_fw_cmd->Status = 0;
+					attempts++;
 
 					if (p_fw_cmd->InputPayloadSize > 0)
 					{
@@ -540,7 +643,15 @@ int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd)
 								"DSM returned error %d for command with "
 										"Opcode - 0x%x SubOpcode - 0x%x \n", retry, dsm_vendor_err_status,
 											p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
+							unsigned long delay_ms = passthrough_retry_delay_ms(retry, &seed,
+								passthrough_time_us(), deadline_us);
 							retry++;
+							if (delay_ms == 0 || (!deadline_us && retry >= DSM_MAX_RETRIES))
+							{
+								COMMON_LOG_ERROR_F("Giving up after %u attempts", attempts);
+								break;
+							}
+							os_sleep(delay_ms);
 							continue;
 						}
 						else if (dsm_vendor_err_status != DSM_VENDOR_SUCCESS)
@@ -577,13 +688,27 @@ int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd)
 								"Linux driver returned error %d for command with "
 								"Opcode- 0x%x SubOpcode- 0x%x ", lnx_err_status,
 								p_fw_cmd->Opcode, p_fw_cmd->SubOpcode);
+						// the device node is gone, most likely the driver was rebound
+						// so force the pooled contexts to be rebuilt on their next checkout
+						if (lnx_err_status == -ENOENT || lnx_err_status == -ENXIO ||
+								lnx_err_status == -ENODEV)
+						{
+							invalidate_ndctl_ctx();
+						}
 						break;
 					}
 				}
 				ndctl_cmd_unref(p_vendor_cmd);
 			}
+			put_ndctl_ctx(ctx);
 		}
-		ndctl_unref(ctx);
+	}
+
+	if (p_fw_cmd != NULL)
+	{
+		// reported on every path, a command rejected before submission has 0 attempts
+		p_fw_cmd->Attempts = attempts;
+		p_fw_cmd->ElapsedUs = passthrough_time_us() - start_us;
 	}
 
 	memset(&p_fw_cmd, 0, sizeof(p_fw_cmd));
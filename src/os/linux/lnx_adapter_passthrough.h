@@ -30,5 +30,7 @@ struct pt_bios_get_size {
 
 /*
  * Execute a passthrough IOCTL
+ * DSM_VENDOR_RETRY_SUGGESTED responses are retried with backoff until
+ * timeout_us expires, or up to DSM_MAX_RETRIES times when timeout_us is 0.
  */
-int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd);
+int ioctl_passthrough_fw_cmd(struct fw_cmd *p_fw_cmd, unsigned long long timeout_us);
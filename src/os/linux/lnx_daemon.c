@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * This file contains the Linux implementation of the resident daemon transport.
+ *
+ * The daemon listens on a Unix domain socket. A client sends one command line
+ * together with its working directory and, as SCM_RIGHTS ancillary data, its
+ * stdin, stdout and stderr descriptors. The daemon runs the command with those
+ * descriptors in place of its own, so the output reaches the client directly
+ * and prompts are answered by the client, and replies with the exit code.
+ * Requests are served one at a time.
+ */
+
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <nvm_types.h>
+#include <os_types.h>
+#include <os.h>
+#include "lnx_adapter.h"
+
+#define	DAEMON_REQUEST_MAGIC	0x49504d44 /* IPMD */
+#define	DAEMON_MAX_ARGS		256
+#define	DAEMON_MAX_PAYLOAD	(64 * 1024)
+#define	DAEMON_MAX_HEALTH_EVENTS	64 /* per wait, the rest are reported by the next one */
+#define	DAEMON_LISTEN_BACKLOG	16
+#define	DAEMON_REQUEST_FDS	3 /* stdin, stdout, stderr */
+#define	DAEMON_CLIENT_TIMEOUT_SEC	10 /* bounds socket I/O, not the command itself */
+
+struct daemon_request_header
+{
+	unsigned int magic;
+	unsigned int argc;
+	unsigned int cwd_len; /* including the terminating NUL */
+	unsigned int args_len; /* NUL separated arguments */
+};
+
+static volatile sig_atomic_t g_daemon_stop = 0;
+
+static void daemon_stop_handler(int signum)
+{
+	g_daemon_stop = 1;
+}
+
+static int send_all(int fd, const void *buf, size_t len)
+{
+	const char *p = (const char *)buf;
+
+	while (len > 0)
+	{
+		ssize_t sent = send(fd, p, len, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += sent;
+		len -= (size_t)sent;
+	}
+	return 0;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+	char *p = (char *)buf;
+
+	while (len > 0)
+	{
+		ssize_t received = recv(fd, p, len, 0);
+		if (received < 0 && errno == EINTR)
+			continue;
+		if (received <= 0)
+			return -1;
+		p += received;
+		len -= (size_t)received;
+	}
+	return 0;
+}
+
+static int fill_socket_addr(const char *socket_path, struct sockaddr_un *p_addr)
+{
+	if (strlen(socket_path) >= sizeof(p_addr->sun_path))
+	{
+		return -1;
+	}
+	memset(p_addr, 0, sizeof(*p_addr));
+	p_addr->sun_family = AF_UNIX;
+	strncpy(p_addr->sun_path, socket_path, sizeof(p_addr->sun_path) - 1);
+	return 0;
+}
+
+/*
+ * Register the ACPI health event descriptors of all DIMMs with a health monitor,
+ * which keeps them armed and has no limit on the number of DIMMs. A DIMM that
+ * cannot be registered is logged and left out.
+ */
+static OS_HEALTH_MONITOR *open_health_monitor()
+{
+	OS_HEALTH_MONITOR *p_monitor = NULL;
+	struct ndctl_ctx *ctx = NULL;
+	struct ndctl_bus *bus;
+	struct ndctl_dimm *dimm;
+
+	if (NVM_SUCCESS != os_health_monitor_create(&p_monitor))
+	{
+		COMMON_LOG_ERROR("Failed to create the health monitor, health events are not monitored.");
+		return NULL;
+	}
+	if (NVM_SUCCESS != get_ndctl_ctx(&ctx))
+	{
+		COMMON_LOG_ERROR("Failed to get ndctl context, health events are not monitored.");
+		os_health_monitor_free(p_monitor);
+		return NULL;
+	}
+
+	ndctl_bus_foreach(ctx, bus)
+	{
+		ndctl_dimm_foreach(bus, dimm)
+		{
+			unsigned int handle = ndctl_dimm_get_handle(dimm);
+			if (NVM_SUCCESS != os_health_monitor_add(p_monitor, handle,
+				DIMM_ACPI_EVENT_SMART_HEALTH_MASK))
+			{
+				COMMON_LOG_ERROR_F("DIMM 0x%x is not monitored for health events.", handle);
+			}
+		}
+	}
+	put_ndctl_ctx(ctx);
+	return p_monitor;
+}
+
+/*
+ * Only the user the daemon runs as (or root) may have commands run for it.
+ */
+static int check_peer(int client_fd)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+	{
+		return -1;
+	}
+	if (cred.uid != 0 && cred.uid != geteuid())
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Receive a request header along with the client stdin/stdout/stderr descriptors.
+ */
+static int recv_request_header(int client_fd, struct daemon_request_header *p_header, int *p_fds)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *p_cmsg;
+	char control[CMSG_SPACE(DAEMON_REQUEST_FDS * sizeof(int))];
+	ssize_t received;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = p_header;
+	iov.iov_len = sizeof(*p_header);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	do
+	{
+		received = recvmsg(client_fd, &msg, MSG_CMSG_CLOEXEC);
+	} while (received < 0 && errno == EINTR);
+
+	p_cmsg = CMSG_FIRSTHDR(&msg);
+	if (p_cmsg == NULL || p_cmsg->cmsg_level != SOL_SOCKET || p_cmsg->cmsg_type != SCM_RIGHTS ||
+		p_cmsg->cmsg_len != CMSG_LEN(DAEMON_REQUEST_FDS * sizeof(int)))
+	{
+		return -1;
+	}
+	memcpy(p_fds, CMSG_DATA(p_cmsg), DAEMON_REQUEST_FDS * sizeof(int));
+
+	if (received != (ssize_t)sizeof(*p_header) || (msg.msg_flags & MSG_CTRUNC) ||
+		p_header->magic != DAEMON_REQUEST_MAGIC ||
+		p_header->argc == 0 || p_header->argc > DAEMON_MAX_ARGS ||
+		p_header->cwd_len == 0 || p_header->args_len == 0 ||
+		p_header->cwd_len + p_header->args_len > DAEMON_MAX_PAYLOAD)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Split the NUL separated argument block into argv.
+ */
+static int unpack_args(char *p_args, unsigned int args_len, unsigned int argc, char **argv)
+{
+	unsigned int index = 0;
+	unsigned int offset = 0;
+
+	if (p_args[args_len - 1] != '\0')
+	{
+		return -1;
+	}
+	while (offset < args_len && index < argc)
+	{
+		argv[index++] = p_args + offset;
+		offset += (unsigned int)strlen(p_args + offset) + 1;
+	}
+	argv[index] = NULL;
+	return (index == argc && offset == args_len) ? 0 : -1;
+}
+
+/*
+ * Run one command line with the client descriptors in place of stdin/stdout/stderr.
+ */
+static int run_redirected(const char *cwd, const int *p_fds,
+	int argc, char *argv[], os_daemon_cmd_handler cmd_handler)
+{
+	int exit_code = -1;
+	int saved_cwd_fd = -1;
+	int saved_in_fd = -1;
+	int saved_out_fd = -1;
+	int saved_err_fd = -1;
+
+	if ((saved_cwd_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+	{
+		return -1;
+	}
+	if (chdir(cwd) != 0)
+	{
+		close(saved_cwd_fd);
+		return -1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	/* Input buffered from a previous client must not answer this one's prompts */
+	__fpurge(stdin);
+	saved_in_fd = dup(STDIN_FILENO);
+	saved_out_fd = dup(STDOUT_FILENO);
+	saved_err_fd = dup(STDERR_FILENO);
+	if (saved_in_fd >= 0 && saved_out_fd >= 0 && saved_err_fd >= 0 &&
+		dup2(p_fds[0], STDIN_FILENO) >= 0 && dup2(p_fds[1], STDOUT_FILENO) >= 0 &&
+		dup2(p_fds[2], STDERR_FILENO) >= 0)
+	{
+		exit_code = cmd_handler(argc, argv);
+	}
+	fflush(stdout);
+	fflush(stderr);
+	__fpurge(stdin);
+	clearerr(stdin);
+	clearerr(stdout);
+	clearerr(stderr);
+
+	if (saved_in_fd >= 0)
+	{
+		dup2(saved_in_fd, STDIN_FILENO);
+		close(saved_in_fd);
+	}
+	if (saved_out_fd >= 0)
+	{
+		dup2(saved_out_fd, STDOUT_FILENO);
+		close(saved_out_fd);
+	}
+	if (saved_err_fd >= 0)
+	{
+		dup2(saved_err_fd, STDERR_FILENO);
+		close(saved_err_fd);
+	}
+	if (fchdir(saved_cwd_fd) != 0)
+	{
+		COMMON_LOG_ERROR("Failed to restore the daemon working directory.");
+	}
+	close(saved_cwd_fd);
+	return exit_code;
+}
+
+static void serve_client(int client_fd, os_daemon_cmd_handler cmd_handler)
+{
+	struct daemon_request_header header;
+	char *p_payload = NULL;
+	char *argv[DAEMON_MAX_ARGS + 1];
+	int fds[DAEMON_REQUEST_FDS] = { -1, -1, -1 };
+	struct timeval timeout = { DAEMON_CLIENT_TIMEOUT_SEC, 0 };
+	int exit_code = -1;
+	int i;
+
+	if (check_peer(client_fd) != 0)
+	{
+		COMMON_LOG_ERROR("Rejected a daemon client with insufficient permissions.");
+		return;
+	}
+
+	/* A stalled client must not keep the daemon from serving everybody else */
+	if (setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0 ||
+		setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0)
+	{
+		COMMON_LOG_ERROR("Failed to set the daemon client timeouts.");
+		return;
+	}
+
+	if (recv_request_header(client_fd, &header, fds) != 0)
+	{
+		COMMON_LOG_ERROR("Received a malformed daemon request.");
+		goto finish;
+	}
+
+	if ((p_payload = malloc(header.cwd_len + header.args_len)) == NULL ||
+		recv_all(client_fd, p_payload, header.cwd_len + header.args_len) != 0 ||
+		p_payload[header.cwd_len - 1] != '\0' ||
+		unpack_args(p_payload + header.cwd_len, header.args_len, header.argc, argv) != 0)
+	{
+		COMMON_LOG_ERROR("Received a malformed daemon request.");
+		goto finish;
+	}
+
+	exit_code = run_redirected(p_payload, fds, (int)header.argc, argv, cmd_handler);
+	send_all(client_fd, &exit_code, sizeof(exit_code));
+
+finish:
+	free(p_payload);
+	for (i = 0; i < DAEMON_REQUEST_FDS; i++)
+	{
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+}
+
+/*
+ * Serve command lines on a Unix domain socket until SIGTERM or SIGINT.
+ */
+int os_daemon_serve(const char *socket_path, os_daemon_cmd_handler cmd_handler,
+	os_daemon_event_handler event_handler)
+{
+	struct sockaddr_un addr;
+	struct pollfd fds[2];
+	struct sigaction action;
+	OS_HEALTH_MONITOR *p_health_monitor = NULL;
+	OS_PATH dir_path;
+	nfds_t fd_cnt = 1;
+	int listen_fd = -1;
+	int probe_fd = -1;
+	int rc = -1;
+
+	if (socket_path == NULL || cmd_handler == NULL ||
+		fill_socket_addr(socket_path, &addr) != 0)
+	{
+		return -1;
+	}
+
+	/* Refuse to take over the socket of a daemon that is already running */
+	if ((probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) >= 0)
+	{
+		if (connect(probe_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+		{
+			COMMON_LOG_ERROR("An ipmctl daemon is already running.");
+			close(probe_fd);
+			return -1;
+		}
+		close(probe_fd);
+	}
+
+	snprintf(dir_path, sizeof(dir_path), "%s", socket_path);
+	os_mkdir(dir_path);
+	unlink(socket_path);
+
+	if ((listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+	{
+		return -1;
+	}
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+		chmod(socket_path, S_IRUSR | S_IWUSR) != 0 ||
+		listen(listen_fd, DAEMON_LISTEN_BACKLOG) != 0)
+	{
+		COMMON_LOG_ERROR("Failed to create the daemon socket.");
+		goto finish;
+	}
+
+	/* No SA_RESTART, so poll returns on a stop request */
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = daemon_stop_handler;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGTERM, &action, NULL);
+	sigaction(SIGINT, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	fds[0].fd = listen_fd;
+	fds[0].events = POLLIN;
+	if (event_handler != NULL &&
+		(p_health_monitor = open_health_monitor()) != NULL)
+	{
+		fds[1].fd = os_health_monitor_fd(p_health_monitor);
+		fds[1].events = POLLIN;
+		fd_cnt = 2;
+	}
+
+	rc = 0;
+	while (!g_daemon_stop)
+	{
+		int ready = poll(fds, fd_cnt, -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			rc = -1;
+			break;
+		}
+
+		if (fd_cnt > 1 && (fds[1].revents & POLLIN))
+		{
+			struct os_health_event events[DAEMON_MAX_HEALTH_EVENTS];
+			unsigned int event_cnt = 0;
+			/* re-arms the DIMMs that signalled */
+			if (NVM_SUCCESS == os_health_monitor_wait(p_health_monitor, 0,
+				events, DAEMON_MAX_HEALTH_EVENTS, &event_cnt) && event_cnt > 0)
+			{
+				event_handler();
+			}
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			int client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+			if (client_fd >= 0)
+			{
+				serve_client(client_fd, cmd_handler);
+				close(client_fd);
+			}
+		}
+	}
+
+finish:
+	os_health_monitor_free(p_health_monitor);
+	close(listen_fd);
+	unlink(socket_path);
+	return rc;
+}
+
+/*
+ * Forward a command line to a running daemon.
+ * Returns -1 when no daemon accepted the request, so the caller runs the command itself.
+ * Once the request is sent the command is never run locally, *p_exit_code is -1
+ * if the daemon went away before replying.
+ */
+int os_daemon_forward(const char *socket_path, int argc, char *argv[], int *p_exit_code)
+{
+	struct daemon_request_header header;
+	struct sockaddr_un addr;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *p_cmsg;
+	char control[CMSG_SPACE(DAEMON_REQUEST_FDS * sizeof(int))];
+	int fds[DAEMON_REQUEST_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	OS_PATH cwd;
+	char *p_payload = NULL;
+	size_t args_len = 0;
+	size_t offset;
+	int sock_fd = -1;
+	int exit_code = -1;
+	int rc = -1;
+	int i;
+
+	if (socket_path == NULL || argv == NULL || p_exit_code == NULL ||
+		argc <= 0 || argc > DAEMON_MAX_ARGS ||
+		fill_socket_addr(socket_path, &addr) != 0 ||
+		getcwd(cwd, sizeof(cwd)) == NULL)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < argc; i++)
+	{
+		args_len += strlen(argv[i]) + 1;
+	}
+	header.magic = DAEMON_REQUEST_MAGIC;
+	header.argc = (unsigned int)argc;
+	header.cwd_len = (unsigned int)strlen(cwd) + 1;
+	header.args_len = (unsigned int)args_len;
+	if (header.cwd_len + args_len > DAEMON_MAX_PAYLOAD)
+	{
+		return -1;
+	}
+
+	if ((p_payload = malloc(header.cwd_len + args_len)) == NULL)
+	{
+		return -1;
+	}
+	memcpy(p_payload, cwd, header.cwd_len);
+	offset = header.cwd_len;
+	for (i = 0; i < argc; i++)
+	{
+		size_t len = strlen(argv[i]) + 1;
+		memcpy(p_payload + offset, argv[i], len);
+		offset += len;
+	}
+
+	if ((sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+		connect(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		goto finish;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	iov.iov_base = &header;
+	iov.iov_len = sizeof(header);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	p_cmsg = CMSG_FIRSTHDR(&msg);
+	p_cmsg->cmsg_level = SOL_SOCKET;
+	p_cmsg->cmsg_type = SCM_RIGHTS;
+	p_cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(p_cmsg), fds, sizeof(fds));
+
+	if (sendmsg(sock_fd, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(header))
+	{
+		goto finish;
+	}
+	/* From here on the daemon owns the command */
+	rc = 0;
+	if (send_all(sock_fd, p_payload, offset) == 0 &&
+		recv_all(sock_fd, &exit_code, sizeof(exit_code)) == 0)
+	{
+		*p_exit_code = exit_code;
+	}
+	else
+	{
+		*p_exit_code = -1;
+	}
+
+finish:
+	if (sock_fd >= 0)
+		close(sock_fd);
+	free(p_payload);
+	return rc;
+}
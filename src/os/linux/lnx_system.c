@@ -116,13 +116,29 @@ int os_stop_process(unsigned int process_id)
 /*
  * Create a thread on the current process
  */
-void os_create_thread(unsigned long long *p_thread_id, void *(*callback)(void *), void *callback_arg)
+int os_create_thread(unsigned long long *p_thread_id, void *(*callback)(void *), void *callback_arg)
 {
-	pthread_create(
-			(pthread_t *)p_thread_id,
+	pthread_t thread;
+	// failure when pthread_create(..) != 0
+	int rc = (pthread_create(
+			&thread,
 			NULL, // default attributes
 			callback,
-			callback_arg);
+			callback_arg) == 0);
+	if (rc && p_thread_id)
+	{
+		*p_thread_id = (unsigned long long)thread;
+	}
+	return rc;
+}
+
+/*
+ * Wait for a thread created by os_create_thread to finish
+ */
+int os_join_thread(unsigned long long thread_id)
+{
+	// failure when pthread_join(..) != 0
+	return (pthread_join((pthread_t)thread_id, NULL) == 0);
 }
 
 /*
@@ -133,6 +149,19 @@ unsigned long long os_get_thread_id()
 	return pthread_self();
 }
 
+/*
+ * Retrieve a monotonic timestamp in microseconds, only meaningful as a difference
+ */
+unsigned long long os_get_monotonic_usec()
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+	{
+		return 0;
+	}
+	return ((unsigned long long)ts.tv_sec * 1000000ULL) + ((unsigned long long)ts.tv_nsec / 1000ULL);
+}
+
 /*
  * Initializes a mutex.
  */
@@ -297,6 +326,47 @@ int os_rwlock_delete(OS_RWLOCK *p_rwlock)
 	return (pthread_rwlock_destroy(p_handle) == 0);
 }
 
+/*
+ * Allocates and initializes a rwlock
+ */
+OS_RWLOCK *os_rwlock_create()
+{
+	pthread_rwlock_t *p_handle = (pthread_rwlock_t *)malloc(sizeof(pthread_rwlock_t));
+
+	if (p_handle && !os_rwlock_init(p_handle))
+	{
+		free(p_handle);
+		p_handle = NULL;
+	}
+	return p_handle;
+}
+
+/*
+ * Returns the rwlock stored in *pp_rwlock, creating it on first use
+ */
+OS_RWLOCK *os_rwlock_get_static(OS_RWLOCK *volatile *pp_rwlock)
+{
+	OS_RWLOCK *p_rwlock = *pp_rwlock;
+	OS_RWLOCK *p_installed = NULL;
+
+	if (NULL == p_rwlock)
+	{
+		if (NULL == (p_rwlock = os_rwlock_create()))
+		{
+			return NULL;
+		}
+		// the thread losing the race drops its lock and takes the installed one
+		p_installed = __sync_val_compare_and_swap(pp_rwlock, NULL, p_rwlock);
+		if (NULL != p_installed)
+		{
+			os_rwlock_delete(p_rwlock);
+			free(p_rwlock);
+			p_rwlock = p_installed;
+		}
+	}
+	return p_rwlock;
+}
+
 /*
  * Retrieve the name of the host server.
  */
@@ -371,6 +441,31 @@ int os_get_os_version(char *os_version, const unsigned int os_version_len)
 	return rc;
 }
 
+/*
+ * Retrieve an identifier unique to the current boot of the system.
+ */
+int os_get_boot_id(char *boot_id, const unsigned int boot_id_len)
+{
+	int rc = -1;
+	FILE *p_file = NULL;
+
+	if (boot_id == NULL || boot_id_len == 0)
+	{
+		return -1;
+	}
+
+	if ((p_file = fopen("/proc/sys/kernel/random/boot_id", "r")) != NULL)
+	{
+		if (fgets(boot_id, boot_id_len, p_file) != NULL)
+		{
+			boot_id[strcspn(boot_id, "\n")] = '\0';
+			rc = (boot_id[0] != '\0') ? 0 : -1;
+		}
+		fclose(p_file);
+	}
+	return rc;
+}
+
 int os_get_os_type()
 {
 	return OS_TYPE_LINUX;
@@ -384,7 +479,7 @@ int get_supported_block_sizes(struct nvm_driver_capabilities *p_capabilities)
 
 	p_capabilities->num_block_sizes = 0;
 
-	if ((rc = ndctl_new(&ctx)) >= 0)
+	if ((rc = get_ndctl_ctx(&ctx)) == NVM_SUCCESS)
 	{
 		struct ndctl_bus *bus;
 		ndctl_bus_foreach(ctx, bus)
@@ -421,11 +516,7 @@ int get_supported_block_sizes(struct nvm_driver_capabilities *p_capabilities)
 				break;
 			}
 		}
-		ndctl_unref(ctx);
-	}
-	else
-	{
-		rc = linux_err_to_nvm_lib_err(rc);
+		put_ndctl_ctx(ctx);
 	}
 
 	return rc;
@@ -27,11 +27,13 @@
 #include <os_efi_bs_protocol.h>
 #include <os_efi_simple_file_protocol.h>
 #include <os_efi_shell_parameters_protocol.h>
+#include <os_efi_output.h>
 #include <os_efi_preferences.h>
 #include <os_efi_api.h>
 #include <Common.h>
 #include <NvmDimmConfig.h>
 #include <NvmDimmPassThru.h>
+#include <CoreDiagnostics.h>
 #include <os.h>
 #include <Dimm.h>
 #include <NvmDimmDriver.h>
@@ -41,6 +43,7 @@
 #include <ShellParameters.h>
 #include "LoadCommand.h"
 #include <os_str.h>
+#include <event.h>
 
 #define STRINGIZE2(s) #s
 #define STRINGIZE(s) STRINGIZE2(s)
@@ -50,14 +53,20 @@
 #define INVALID_DIMM_HANDLE     0
 OS_MUTEX *g_api_mutex;
 unsigned int g_dimm_cnt;
+static UINT32 g_dimm_cnt_generation;
 int g_basic_commands = 0;
-DIMM_INFO *g_dimms;
 int get_dimm_id(const char *uid, UINT16 *dimm_id, unsigned int *dimm_handle);
 void dimm_info_to_device_discovery(DIMM_INFO *p_dimm, struct device_discovery *p_device);
 int g_nvm_initialized = 0;
 int get_fw_err_log_stats(const unsigned int dimm_id, const unsigned char log_level, const unsigned char log_type, LOG_INFO_DATA_RETURN *log_info);
+static int get_device_error_log_status(const unsigned int dimm_id, struct device_error_log_status *error_log_stats);
 static int nvm_internal_init(BOOLEAN binding_start);
 static void nvm_internal_uninit(BOOLEAN binding_stop);
+static struct event_store *g_event_store;
+static void free_dimm_index();
+static int get_number_of_devices(unsigned int *count);
+static void log_event(enum event_type type, enum event_severity severity, NVM_UINT16 code,
+  const char *p_uid, const CHAR16 *p_message, enum diagnostic_result diag_result);
 
 extern EFI_SHELL_PARAMETERS_PROTOCOL gOsShellParametersProtocol;
 extern NVMDIMMDRIVER_DATA *gNvmDimmData;
@@ -77,12 +86,130 @@ GetCapacities(IN UINT16 DimmPid, OUT UINT64 *pVolatileCapacity, OUT UINT64 *pApp
 extern EFI_STATUS
 ParseSourceDumpFile(IN CHAR16 *pFilePath, IN EFI_DEVICE_PATH_PROTOCOL *pDevicePath, OUT CHAR8 **pFileString);
 extern EFI_STATUS RegisterCommands();
+extern EFI_STATUS GetDimmInfo(IN DIMM *pDimm, IN DIMM_INFO_CATEGORIES dimmInfoCategories, IN OUT DIMM_INFO *pDimmInfo);
+extern VOID SetDriverBindingWarm(IN BOOLEAN Warm);
+extern VOID SetPromptInputAvailable(IN BOOLEAN Available);
+extern VOID InvalidateDriverBinding();
 extern int g_fast_path;
 
+#define NVM_DAEMON_SOCKET_PATH "/var/run/ipmctl/ipmctl.sock"
+#define NVM_BATCH_STDIN "-"
+#define NVM_BATCH_APP_NAME "ipmctl"
+#define NVM_BATCH_LINE_LEN 4096
+#define NVM_BATCH_MAX_ARGS 256
+#define NVM_BATCH_HEADER_FORMAT L"=== ipmctl batch command %d: %ls\n"
+#define NVM_BATCH_FOOTER_FORMAT L"=== ipmctl batch command %d exit code: %d\n"
+
+/*
+ * The driver topology: the DIMM list, the driver state built on it and the DIMM
+ * lookup index. Queries hold the lock shared for as long as they use a DIMM.
+ * Loading and unloading the driver, CLI commands, which may reload it, and the
+ * entry points changing a DCPMM or the goal configuration hold it exclusively.
+ * Commands to one DIMM are serialized by its mailbox lock instead, so queries of
+ * different DIMMs run in parallel. The lock is not recursive, each entry point
+ * takes it once and its holders call the internal helpers, get_number_of_devices,
+ * get_nvm_capacities and get_dimm_id, which neither take it nor call nvm_init.
+ */
+static OS_RWLOCK *volatile g_topology_lock = NULL;
+/*
+ * Guards the DIMM lookup index, which get_dimm_id rebuilds under the topology lock of its caller.
+ */
+static OS_RWLOCK *volatile g_dimm_index_lock = NULL;
+/*
+ * Guards opening and closing g_event_store, users of the store hold it shared.
+ */
+static OS_RWLOCK *volatile g_event_store_lock = NULL;
+
+static void nvm_topology_r_lock()
+{
+  OS_RWLOCK *p_lock = os_rwlock_get_static(&g_topology_lock);
+  if (p_lock)
+    os_rwlock_r_lock(p_lock);
+}
+
+static void nvm_topology_r_unlock()
+{
+  if (g_topology_lock)
+    os_rwlock_r_unlock(g_topology_lock);
+}
+
+static void nvm_topology_w_lock()
+{
+  OS_RWLOCK *p_lock = os_rwlock_get_static(&g_topology_lock);
+  if (p_lock)
+    os_rwlock_w_lock(p_lock);
+}
+
+static void nvm_topology_w_unlock()
+{
+  if (g_topology_lock)
+    os_rwlock_w_unlock(g_topology_lock);
+}
+
+/*
+ * Take the topology lock, exclusively when the caller changes the DCPMM, and look up
+ * the DIMM ID and device handle of uid the driver protocol is called with. On success
+ * the lock stays held until the caller is done with the DIMM and calls
+ * nvm_topology_w_unlock() or nvm_topology_r_unlock().
+ */
+static int lock_dimm_id(const char *uid, BOOLEAN exclusive, UINT16 *p_dimm_id, unsigned int *p_dimm_handle)
+{
+  int rc;
+
+  if (exclusive) {
+    nvm_topology_w_lock();
+  } else {
+    nvm_topology_r_lock();
+  }
+  if (NVM_SUCCESS != (rc = get_dimm_id(uid, p_dimm_id, p_dimm_handle))) {
+    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+    if (exclusive) {
+      nvm_topology_w_unlock();
+    } else {
+      nvm_topology_r_unlock();
+    }
+  }
+  return rc;
+}
+
+/*
+ * Take the topology lock shared and find the DCPMM of uid. On success the lock
+ * stays held until the caller is done with the DIMM and calls nvm_topology_r_unlock().
+ */
+static int lock_dimm(const char *uid, DIMM **ppDimm)
+{
+  UINT16 dimm_id;
+  int rc;
+
+  if (NVM_SUCCESS != (rc = lock_dimm_id(uid, FALSE, &dimm_id, NULL))) {
+    return rc;
+  }
+  if (NULL == (*ppDimm = GetDimmByPid(dimm_id, &gNvmDimmData->PMEMDev.Dimms))) {
+    NVDIMM_ERR("Failed to get dimm by Pid (%d)\n", dimm_id);
+    nvm_topology_r_unlock();
+    return NVM_ERR_UNKNOWN;
+  }
+  return NVM_SUCCESS;
+}
+
 //todo: add error checking
 NVM_API int nvm_init()
 {
-  return nvm_internal_init(TRUE);
+  int rc;
+
+  // Once loaded the driver only has its PCD cache dropped, which the DIMM locks cover
+  nvm_topology_r_lock();
+  if (g_nvm_initialized) {
+    rc = nvm_internal_init(TRUE);
+    nvm_topology_r_unlock();
+    return rc;
+  }
+  nvm_topology_r_unlock();
+  // Loading binds the driver, nvm_internal_init checks again under the exclusive lock
+  nvm_topology_w_lock();
+  rc = nvm_internal_init(TRUE);
+  nvm_topology_w_unlock();
+  return rc;
 }
 
 //todo: add error checking
@@ -161,7 +288,9 @@ cleanup_mutex:
 
 NVM_API void nvm_uninit()
 {
+  nvm_topology_w_lock();
   nvm_internal_uninit(TRUE);
+  nvm_topology_w_unlock();
 }
 
 static void nvm_internal_uninit(BOOLEAN binding_stop)
@@ -174,6 +303,17 @@ static void nvm_internal_uninit(BOOLEAN binding_stop)
   NvmDimmDriverUnload(FakeBindHandle);
   uninit_protocol_shell_parameters_protocol();
   preferences_uninit();
+  if (g_event_store_lock)
+    os_rwlock_w_lock(g_event_store_lock);
+  event_store_close(g_event_store);
+  g_event_store = NULL;
+  if (g_event_store_lock)
+    os_rwlock_w_unlock(g_event_store_lock);
+  if (g_dimm_index_lock)
+    os_rwlock_w_lock(g_dimm_index_lock);
+  free_dimm_index();
+  if (g_dimm_index_lock)
+    os_rwlock_w_unlock(g_dimm_index_lock);
 
   if (g_api_mutex) {
     os_mutex_delete(g_api_mutex, NVM_API_MUTEX);
@@ -227,6 +367,23 @@ void nvm_current_cmd(struct Command Command)
 
 
 
+/*
+ * gOsShellParametersProtocol.StdOut is a capture file when -o xml is used with a
+ * command that does not print through the printer, convert the captured output.
+ */
+static void nvm_process_cli_output(int rc, int argc, char *argv[])
+{
+  if (gOsShellParametersProtocol.StdOut != stdout) {
+    enum DisplayType dt;
+    UINT8 d;
+    wchar_t disp_name[DISP_NAME_LEN];
+    wchar_t disp_delims[DISP_DELIMS_LEN];
+    GetDisplayInfo(disp_name, DISP_NAME_LEN*sizeof(wchar_t), &d, disp_delims, DISP_DELIMS_LEN * sizeof(wchar_t));
+    dt = (enum DisplayType)d;
+    process_output(dt, disp_name, disp_delims, rc, gOsShellParametersProtocol.StdOut, argc, argv);
+  }
+}
+
 NVM_API int nvm_run_cli(int argc, char *argv[])
 {
   EFI_STATUS rc;
@@ -244,30 +401,270 @@ NVM_API int nvm_run_cli(int argc, char *argv[])
     wprintf(L"");
   }
 
+  nvm_topology_w_lock();
   nvm_status = nvm_internal_init(FALSE);
   if (NVM_ERR_INVALID_PERMISSIONS != nvm_status && NVM_SUCCESS != nvm_status) {
+    nvm_topology_w_unlock();
     CHAR16* ErrStr = GetSingleNvmStatusCodeMessage(NULL, nvm_status);
     wprintf(L"Failed to intialize nvm library (%d): %ls.\n", nvm_status, ErrStr);
     FREE_POOL_SAFE(ErrStr);
     return nvm_status;
   }
   rc = UefiToOsReturnCode(UefiMain(0, NULL));
+  output_sink_flush();
+  nvm_process_cli_output((int)rc, argc, argv);
+  nvm_internal_uninit(FALSE);
+  nvm_topology_w_unlock();
+  return (int)rc;
+}
 
-  //gOsShellParametersProtocol.StdOut will be overriden when
-  //-o xml is used (temp hack)
-  if (gOsShellParametersProtocol.StdOut != stdout) {
-    enum DisplayType dt;
-    UINT8 d;
-    wchar_t disp_name[DISP_NAME_LEN];
-    wchar_t disp_delims[DISP_DELIMS_LEN];
-    GetDisplayInfo(disp_name, DISP_NAME_LEN*sizeof(wchar_t), &d, disp_delims, DISP_DELIMS_LEN * sizeof(wchar_t));
-    dt = (enum DisplayType)d;
-    process_output(dt, disp_name, disp_delims, (int)rc, gOsShellParametersProtocol.StdOut, argc, argv);
+/*
+ * Run one command line in a resident process (daemon or batch mode), against
+ * the driver state kept from the previous commands.
+ */
+static int nvm_run_warm_cmd(int argc, char *argv[])
+{
+  EFI_STATUS rc;
+
+  rc = init_protocol_shell_parameters_protocol(argc, argv);
+  if (rc == EFI_INVALID_PARAMETER) {
+    wprintf(L"Syntax Error: Exceeded input parameters limit.\n");
+    return (int)UefiToOsReturnCode(rc);
   }
-  nvm_internal_uninit(FALSE);
+  else if (EFI_ERROR(rc)) {
+    return (int)UefiToOsReturnCode(rc);
+  }
+
+  nvm_topology_w_lock();
+  rc = UefiToOsReturnCode(UefiMain(0, NULL));
+  nvm_topology_w_unlock();
+  output_sink_flush();
+  nvm_process_cli_output((int)rc, argc, argv);
+  uninit_protocol_shell_parameters_protocol();
   return (int)rc;
 }
 
+/*
+ * A DIMM health event may change anything the driver has read, start over
+ * with the next command.
+ */
+static void nvm_daemon_health_event()
+{
+  nvm_topology_w_lock();
+  InvalidateDriverBinding();
+  nvm_topology_w_unlock();
+}
+
+/*
+ * Run the resident daemon. The driver state is initialized once and kept between
+ * the commands forwarded by ipmctl processes, it is dropped after every command
+ * that may change the configuration and on DIMM health events.
+ */
+NVM_API int nvm_run_cli_daemon()
+{
+  int nvm_status;
+
+  //WA to ensure wprintf work throughout invocation of DCPMM mgmt stack.
+  wprintf(L"");
+
+  nvm_topology_w_lock();
+  nvm_status = nvm_internal_init(FALSE);
+  nvm_topology_w_unlock();
+  if (NVM_ERR_INVALID_PERMISSIONS != nvm_status && NVM_SUCCESS != nvm_status) {
+    CHAR16* ErrStr = GetSingleNvmStatusCodeMessage(NULL, nvm_status);
+    wprintf(L"Failed to intialize nvm library (%d): %ls.\n", nvm_status, ErrStr);
+    FREE_POOL_SAFE(ErrStr);
+    return nvm_status;
+  }
+  if (NVM_ERR_INVALID_PERMISSIONS == nvm_status || g_basic_commands) {
+    wprintf(L"The ipmctl daemon requires administrator privileges.\n");
+    nvm_topology_w_lock();
+    nvm_internal_uninit(FALSE);
+    nvm_topology_w_unlock();
+    return NVM_ERR_INVALID_PERMISSIONS;
+  }
+
+  SetDriverBindingWarm(TRUE);
+  if (0 != os_daemon_serve(NVM_DAEMON_SOCKET_PATH, nvm_run_warm_cmd, nvm_daemon_health_event)) {
+    wprintf(L"Failed to start the ipmctl daemon.\n");
+    nvm_status = NVM_ERR_UNKNOWN;
+  }
+  nvm_topology_w_lock();
+  SetDriverBindingWarm(FALSE);
+  nvm_internal_uninit(FALSE);
+  nvm_topology_w_unlock();
+  return nvm_status;
+}
+
+/*
+ * Split a batch line into arguments in place. Arguments are separated by blanks,
+ * double quotes group an argument containing blanks.
+ */
+static int nvm_batch_split_line(char *p_line, char *argv[], int max_args)
+{
+  int argc = 0;
+  char *p_read = p_line;
+  char *p_write = p_line;
+
+  while (*p_read != '\0') {
+    BOOLEAN quoted = FALSE;
+
+    while (*p_read == ' ' || *p_read == '\t') {
+      p_read++;
+    }
+    if (*p_read == '\0') {
+      break;
+    }
+    if (argc >= max_args) {
+      return -1;
+    }
+    argv[argc++] = p_write;
+    while (*p_read != '\0' && (quoted || (*p_read != ' ' && *p_read != '\t'))) {
+      if (*p_read == '"') {
+        quoted = !quoted;
+      }
+      else {
+        *p_write++ = *p_read;
+      }
+      p_read++;
+    }
+    if (*p_read != '\0') {
+      p_read++;
+    }
+    *p_write++ = '\0';
+  }
+  return argc;
+}
+
+/*
+ * Run newline separated ipmctl command lines from a file, or from stdin when the
+ * path is "-", against one initialized driver instance. Empty lines and lines
+ * starting with '#' are skipped, a leading "ipmctl" on a line is optional.
+ * The output of every command is framed by a header and a footer line carrying
+ * the command number, its command line and its exit code.
+ * When the batch is read from stdin, prompts fail instead of consuming batch lines,
+ * so commands asking for confirmation need -force.
+ * Returns the exit code of the last failed command, 0 when all succeeded.
+ */
+NVM_API int nvm_run_cli_batch(const char *p_path, int stop_on_error)
+{
+  FILE *p_file = NULL;
+  char line[NVM_BATCH_LINE_LEN];
+  char *argv[NVM_BATCH_MAX_ARGS + 1];
+  wchar_t wline[NVM_BATCH_LINE_LEN];
+  int nvm_status;
+  int batch_rc = 0;
+  int cmd_index = 0;
+  int line_index = 0;
+  int argc;
+  int rc;
+  size_t len;
+
+  if (NULL == p_path) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  //WA to ensure wprintf work throughout invocation of DCPMM mgmt stack.
+  wprintf(L"");
+
+  if (0 == strcmp(p_path, NVM_BATCH_STDIN)) {
+    p_file = stdin;
+  }
+  else if (NULL == (p_file = fopen(p_path, "r"))) {
+    wprintf(L"Failed to open the batch file.\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  nvm_topology_w_lock();
+  nvm_status = nvm_internal_init(FALSE);
+  nvm_topology_w_unlock();
+  if (NVM_ERR_INVALID_PERMISSIONS != nvm_status && NVM_SUCCESS != nvm_status) {
+    CHAR16* ErrStr = GetSingleNvmStatusCodeMessage(NULL, nvm_status);
+    wprintf(L"Failed to intialize nvm library (%d): %ls.\n", nvm_status, ErrStr);
+    FREE_POOL_SAFE(ErrStr);
+    if (p_file != stdin) {
+      fclose(p_file);
+    }
+    return nvm_status;
+  }
+
+  SetDriverBindingWarm(TRUE);
+  if (p_file == stdin) {
+    SetPromptInputAvailable(FALSE);
+  }
+  while (NULL != fgets(line, sizeof(line), p_file)) {
+    line_index++;
+    len = strlen(line);
+    if (len == sizeof(line) - 1 && line[len - 1] != '\n' && !feof(p_file)) {
+      wprintf(L"Batch line %d is too long.\n", line_index);
+      batch_rc = NVM_ERR_INVALID_PARAMETER;
+      break;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    len = strspn(line, " \t");
+    if (line[len] == '\0' || line[len] == '#') {
+      continue;
+    }
+    mbstowcs(wline, line + len, NVM_BATCH_LINE_LEN - 1);
+    wline[NVM_BATCH_LINE_LEN - 1] = L'\0';
+
+    // argv[0] is the application name, as on a regular command line
+    argv[0] = NVM_BATCH_APP_NAME;
+    argc = nvm_batch_split_line(line, &argv[1], NVM_BATCH_MAX_ARGS - 1);
+    if (argc > 0 && 0 == strcmp(argv[1], NVM_BATCH_APP_NAME)) {
+      memmove(&argv[1], &argv[2], (argc - 1) * sizeof(char *));
+      argc--;
+    }
+    if (argc <= 0) {
+      wprintf(L"Batch line %d is not a valid command line.\n", line_index);
+      batch_rc = NVM_ERR_INVALID_PARAMETER;
+      if (stop_on_error) {
+        break;
+      }
+      continue;
+    }
+    argc++;
+    argv[argc] = NULL;
+
+    cmd_index++;
+    wprintf(NVM_BATCH_HEADER_FORMAT, cmd_index, wline);
+    fflush(stdout);
+    rc = nvm_run_warm_cmd(argc, argv);
+    wprintf(NVM_BATCH_FOOTER_FORMAT, cmd_index, rc);
+    fflush(stdout);
+
+    if (0 != rc) {
+      batch_rc = rc;
+      if (stop_on_error) {
+        break;
+      }
+    }
+  }
+  SetPromptInputAvailable(TRUE);
+  nvm_topology_w_lock();
+  SetDriverBindingWarm(FALSE);
+  nvm_internal_uninit(FALSE);
+  nvm_topology_w_unlock();
+
+  if (p_file != stdin) {
+    fclose(p_file);
+  }
+  return batch_rc;
+}
+
+/*
+ * Forward a command line to a running daemon.
+ * Returns NVM_SUCCESS with the command exit code in p_rc when the daemon ran it,
+ * an error when there is no daemon to forward to.
+ */
+NVM_API int nvm_forward_cli(int argc, char *argv[], int *p_rc)
+{
+  if (0 != os_daemon_forward(NVM_DAEMON_SOCKET_PATH, argc, argv, p_rc)) {
+    return NVM_ERR_UNKNOWN;
+  }
+  return NVM_SUCCESS;
+}
+
 
 
 NVM_API int nvm_get_host_name(char *host_name, const NVM_SIZE host_name_len)
@@ -470,25 +867,31 @@ NVM_API int nvm_get_number_of_memory_topology_devices(unsigned int *count)
     return NVM_ERR_INVALID_PARAMETER;
   }
 
+  nvm_topology_r_lock();
   ReturnCode = gNvmDimmDriverNvmDimmConfig.GetSystemTopology(&gNvmDimmDriverNvmDimmConfig, &pDimmTopology, (UINT16 *)&DdrDimmCnt);
 
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
-    FREE_POOL_SAFE(pDimmTopology);
-    return NVM_ERR_UNKNOWN;
+    nvm_status = NVM_ERR_UNKNOWN;
+    goto Finish;
   } else if (pDimmTopology == NULL) {
     NVDIMM_ERR("Could not read the system topology.\n");
-    return NVM_ERR_UNKNOWN;
+    nvm_status = NVM_ERR_UNKNOWN;
+    goto Finish;
   }
-  FREE_POOL_SAFE(pDimmTopology);
-  if (NVM_SUCCESS != (nvm_status = nvm_get_number_of_devices(&DpcCnt)))
+  if (NVM_SUCCESS != (nvm_status = get_number_of_devices(&DpcCnt)))
   {
     NVDIMM_ERR("Failed to obtain the number of devices (%d)\n", nvm_status);
-    return NVM_ERR_UNKNOWN;
+    nvm_status = NVM_ERR_UNKNOWN;
+    goto Finish;
   }
 
   *count = DdrDimmCnt + DpcCnt;
-  return NVM_SUCCESS;
+
+Finish:
+  nvm_topology_r_unlock();
+  FREE_POOL_SAFE(pDimmTopology);
+  return nvm_status;
 }
 
 NVM_API int nvm_get_memory_topology(struct memory_topology *  p_devices,
@@ -502,17 +905,17 @@ NVM_API int nvm_get_memory_topology(struct memory_topology *  p_devices,
   unsigned int pm_cnt = 0;
 
   if (NULL == p_devices) {
-    nvm_status = NVM_ERR_INVALID_PARAMETER;
-    goto Finish;
+    return NVM_ERR_INVALID_PARAMETER;
   }
 
   if (NVM_SUCCESS != (nvm_status = nvm_init())) {
     NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
-    goto Finish;
+    return nvm_status;
   }
 
+  nvm_topology_r_lock();
   //get the number of PM dimms
-  if (NVM_SUCCESS != (nvm_status = nvm_get_number_of_devices(&pm_cnt))) {
+  if (NVM_SUCCESS != (nvm_status = get_number_of_devices(&pm_cnt))) {
     NVDIMM_ERR("Failed to get number of PM devices\n");
     goto Finish;
   }
@@ -567,28 +970,22 @@ NVM_API int nvm_get_memory_topology(struct memory_topology *  p_devices,
   }
 
 Finish:
+  nvm_topology_r_unlock();
   FREE_POOL_SAFE(pdimms);
   FREE_POOL_SAFE(p_dimm_topology);
   return nvm_status;
 }
 
-NVM_API int nvm_get_number_of_devices(unsigned int *count)
+/*
+ * DCPMM count, the caller holds the topology lock.
+ */
+static int get_number_of_devices(unsigned int *count)
 {
   EFI_STATUS ReturnCode = EFI_SUCCESS;
   unsigned int dimm_cnt;
-  int nvm_status;
-
-  if (NVM_SUCCESS != (nvm_status = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
-    return nvm_status;
-  }
-
-  if (NULL == count) {
-    NVDIMM_ERR("NULL input parameter\n");
-    return NVM_ERR_INVALID_PARAMETER;
-  }
 
-  if (0 != g_dimm_cnt)
+  // The count is kept until the driver rebuilds the DIMM inventory
+  if (0 != g_dimm_cnt && g_dimm_cnt_generation == GetDimmInventoryGeneration())
     goto Finish;
 
   ReturnCode = gNvmDimmDriverNvmDimmConfig.GetDimmCount(&gNvmDimmDriverNvmDimmConfig, (UINT32 *)&dimm_cnt);
@@ -597,16 +994,40 @@ NVM_API int nvm_get_number_of_devices(unsigned int *count)
     return NVM_ERR_UNKNOWN;
   }
   g_dimm_cnt = dimm_cnt;
+  g_dimm_cnt_generation = GetDimmInventoryGeneration();
 
 Finish:
   *count = g_dimm_cnt;
   return NVM_SUCCESS;
 }
 
-NVM_API int nvm_get_devices(struct device_discovery *p_devices, const NVM_UINT8 count)
+NVM_API int nvm_get_number_of_devices(unsigned int *count)
 {
   int nvm_status;
+
+  if (NVM_SUCCESS != (nvm_status = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
+    return nvm_status;
+  }
+
+  if (NULL == count) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  nvm_topology_r_lock();
+  nvm_status = get_number_of_devices(count);
+  nvm_topology_r_unlock();
+  return nvm_status;
+}
+
+NVM_API int nvm_get_devices(struct device_discovery *p_devices, const NVM_UINT8 count)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  DIMM_INFO *pdimms = NULL;
+  unsigned int actual_count = 0;
   unsigned int i;
+  int nvm_status;
 
   if (NVM_SUCCESS != (nvm_status = nvm_init())) {
     NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
@@ -618,35 +1039,40 @@ NVM_API int nvm_get_devices(struct device_discovery *p_devices, const NVM_UINT8
     return NVM_ERR_INVALID_PARAMETER;
   }
 
-  unsigned int actual_count = 0;
-  if (NVM_SUCCESS != (nvm_status = nvm_get_number_of_devices(&actual_count)))
+  nvm_topology_r_lock();
+  if (NVM_SUCCESS != (nvm_status = get_number_of_devices(&actual_count)))
   {
     NVDIMM_ERR("Failed to obtain the number of devices (%d)\n",nvm_status);
-    return NVM_ERR_OPERATION_FAILED;
+    nvm_status = NVM_ERR_OPERATION_FAILED;
+    goto Finish;
   }
 
-  EFI_STATUS ReturnCode = EFI_SUCCESS;
   if(count != actual_count)
   {
-    return NVM_ERR_BAD_SIZE;
+    nvm_status = NVM_ERR_BAD_SIZE;
+    goto Finish;
   }
 
-  DIMM_INFO *pdimms = (DIMM_INFO *)AllocatePool(sizeof(DIMM_INFO) * actual_count);
+  pdimms = (DIMM_INFO *)AllocatePool(sizeof(DIMM_INFO) * actual_count);
   if (NULL == pdimms) {
     NVDIMM_ERR("Failed to allocate memory\n");
-    return NVM_ERR_NOT_ENOUGH_FREE_SPACE;
+    nvm_status = NVM_ERR_NOT_ENOUGH_FREE_SPACE;
+    goto Finish;
   }
 
   ReturnCode = gNvmDimmDriverNvmDimmConfig.GetDimms(&gNvmDimmDriverNvmDimmConfig, (UINT32)actual_count, DIMM_INFO_CATEGORY_NONE, pdimms);
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
-    FreePool(pdimms);
-    return NVM_ERR_OPERATION_FAILED;
+    nvm_status = NVM_ERR_OPERATION_FAILED;
+    goto Finish;
   }
   for (i = 0; i < actual_count; ++i)
     dimm_info_to_device_discovery(&pdimms[i], &p_devices[i]);
-  FreePool(pdimms);
-  return NVM_SUCCESS;
+
+Finish:
+  nvm_topology_r_unlock();
+  FREE_POOL_SAFE(pdimms);
+  return nvm_status;
 }
 
 NVM_API int nvm_get_devices_nfit(struct device_discovery *p_devices, const NVM_UINT8 count)
@@ -675,11 +1101,11 @@ NVM_API int nvm_get_device_discovery(const NVM_UID    device_uid,
     return nvm_status;
   }
 
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, FALSE, &dimm_id, NULL))) {
     return NVM_ERR_DIMM_NOT_FOUND;
   }
   ReturnCode = gNvmDimmDriverNvmDimmConfig.GetDimm(&gNvmDimmDriverNvmDimmConfig, dimm_id, DIMM_INFO_CATEGORY_NONE, &dimm_info);
+  nvm_topology_r_unlock();
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
     return NVM_ERR_DIMM_NOT_FOUND;
@@ -689,9 +1115,76 @@ NVM_API int nvm_get_device_discovery(const NVM_UID    device_uid,
   return NVM_SUCCESS;
 }
 
-static void dimm_info_to_device_status(DIMM_INFO *p_dimm, struct device_status *p_status)
-{
-   //DIMM_INFO_CATEGORY_PACKAGE_SPARING
+#define DEVICE_QUERY_STATUS       (1 << 0)
+#define DEVICE_QUERY_PERFORMANCE  (1 << 1)
+#define DEVICE_QUERY_SENSORS      (1 << 2)
+#define DEVICE_QUERY_DETAILS      (1 << 3)
+#define DEVICE_QUERY_SNAPSHOT     (1 << 4)
+
+/*
+ * DIMM_INFO categories the fields of the device structures are filled from.
+ * Every category costs one or more firmware commands per DCPMM, so a query
+ * asks GetDimmInfo only for the categories of the fields it returns.
+ * Fields filled from the NFIT, SMBIOS and the driver state need none.
+ */
+static const struct
+{
+  NVM_UINT32 query;                 // DEVICE_QUERY_* returning the field
+  DIMM_INFO_CATEGORIES categories;
+} g_device_field_categories[] =
+{
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_PACKAGE_SPARING          }, // status.package_spares_available
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_ARS_STATUS               }, // status.ars_status
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_SMART_AND_HEALTH         }, // status.health
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_SMART_AND_HEALTH         }, // status.last_shutdown_status_details
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_SMART_AND_HEALTH         }, // status.unlatched_last_shutdown_status_details
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_SMART_AND_HEALTH         }, // status.thermal_throttle_performance_loss_pcnt
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_SMART_AND_HEALTH         }, // status.last_shutdown_time
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_SMART_AND_HEALTH         }, // status.ait_dram_enabled
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_VIRAL_POLICY             }, // status.viral_state
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_OVERWRITE_DIMM_STATUS    }, // status.overwritedimm_status
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_MEM_INFO_PAGE_3          }, // status.injected_media_errors
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_MEM_INFO_PAGE_3          }, // status.injected_non_media_errors
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_NONE                     }, // status.is_new
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_NONE                     }, // status.is_configured
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_NONE                     }, // status.sku_violation
+  { DEVICE_QUERY_STATUS,  DIMM_INFO_CATEGORY_NONE                     }, // status.config_status
+  { DEVICE_QUERY_DETAILS | DEVICE_QUERY_SNAPSHOT, DIMM_INFO_CATEGORY_SECURITY }, // discovery.lock_state
+  { DEVICE_QUERY_DETAILS | DEVICE_QUERY_SNAPSHOT, DIMM_INFO_CATEGORY_SECURITY }, // discovery.master_passphrase_enabled
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_POWER_MGMT_POLICY        }, // peak_power_budget
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_POWER_MGMT_POLICY        }, // avg_power_budget
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_PACKAGE_SPARING          }, // package_sparing_enabled
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_NONE                     }, // form_factor
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_NONE                     }, // data_width
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_NONE                     }, // total_width
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_NONE                     }, // speed
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_NONE                     }, // device_locator
+  { DEVICE_QUERY_DETAILS, DIMM_INFO_CATEGORY_NONE                     }, // bank_label
+};
+
+/*
+ * DIMM_INFO categories needed by the DEVICE_QUERY_* set in what.
+ */
+static DIMM_INFO_CATEGORIES device_query_categories(NVM_UINT32 what)
+{
+  DIMM_INFO_CATEGORIES categories = DIMM_INFO_CATEGORY_NONE;
+  NVM_UINT32 i;
+
+  // Details and snapshots embed the device status
+  if (what & (DEVICE_QUERY_DETAILS | DEVICE_QUERY_SNAPSHOT)) {
+    what |= DEVICE_QUERY_STATUS;
+  }
+  for (i = 0; i < sizeof(g_device_field_categories) / sizeof(g_device_field_categories[0]); ++i) {
+    if (g_device_field_categories[i].query & what) {
+      categories |= g_device_field_categories[i].categories;
+    }
+  }
+  return categories;
+}
+
+static void dimm_info_to_device_status(DIMM_INFO *p_dimm, struct device_status *p_status)
+{
+   //DIMM_INFO_CATEGORY_PACKAGE_SPARING
    p_status->package_spares_available = p_dimm->PackageSparesAvailable; // Number of package spares on the DIMM that are available.
 
    //DIMM_INFO_CATEGORY_ARS_STATUS
@@ -714,7 +1207,7 @@ static void dimm_info_to_device_status(DIMM_INFO *p_dimm, struct device_status *
    p_status->last_shutdown_time = p_dimm->LastShutdownTime;        // Time of the last shutdown - seconds since 1 January 1970
    p_status->ait_dram_enabled = p_dimm->AitDramEnabled;            // Whether or not the AIT DRAM is enabled.
 
-   //DIMM_INFO_CATEGORY_OPTIONAL_CONFIG_DATA_POLICY
+   //DIMM_INFO_CATEGORY_VIRAL_POLICY
    p_status->viral_state = p_dimm->ViralStatus; // Current viral status of DIMM.
 
    // From global dimm struct
@@ -735,34 +1228,26 @@ static void dimm_info_to_device_status(DIMM_INFO *p_dimm, struct device_status *
    p_status->injected_non_media_errors = p_dimm->PoisonErrorInjectionsCounter;     // The number of injected non-media errors on DIMM
 }
 
-NVM_API int nvm_get_device_status(const NVM_UID   device_uid,
-          struct device_status *p_status)
+/*
+ * Fill the #device_status of a DCPMM, leaving the DIMM_INFO it was built from in p_dimm_info.
+ * categories are the DIMM_INFO categories to read, see #device_query_categories.
+ * Issues no calls outside of pDimm, so it can run for several DCPMMs in parallel.
+ */
+static int get_device_status(DIMM *pDimm, DIMM_INFO_CATEGORIES categories, DIMM_INFO *p_dimm_info,
+  struct device_status *p_status)
 {
   EFI_STATUS ReturnCode = EFI_SUCCESS;
-  DIMM_INFO dimm_info = { 0 };
-  UINT16 dimm_id;
-  int nvm_status;
+  DIMM_BSR Bsr;
   UINT16 BootstatusBitmask;
-  if (NULL == p_status) {
-    NVDIMM_ERR("NULL input parameter\n");
-    return NVM_ERR_INVALID_PARAMETER;
-  }
-  if (NVM_SUCCESS != (nvm_status = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
-    return nvm_status;
-  }
-  if (NVM_SUCCESS != (nvm_status = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", nvm_status);
-    p_status->is_missing = TRUE;
-    return NVM_ERR_DIMM_NOT_FOUND;
-  }
-  ReturnCode = gNvmDimmDriverNvmDimmConfig.GetDimm(&gNvmDimmDriverNvmDimmConfig, dimm_id, DIMM_INFO_CATEGORY_ALL, &dimm_info);
+
+  ZeroMem(p_dimm_info, sizeof(*p_dimm_info));
+  ReturnCode = GetDimmInfo(pDimm, categories, p_dimm_info);
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
     p_status->is_missing = TRUE;
     return NVM_ERR_DIMM_NOT_FOUND;
   }
-  ReturnCode = gNvmDimmDriverNvmDimmConfig.GetBSRAndBootStatusBitMask(&gNvmDimmDriverNvmDimmConfig, dimm_id, NULL, &BootstatusBitmask);
+  ReturnCode = PopulateDimmBsrAndBootStatusBitmask(pDimm, &Bsr, &BootstatusBitmask);
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR("Failed to get boot status %d\n", ReturnCode);
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
@@ -770,11 +1255,34 @@ NVM_API int nvm_get_device_status(const NVM_UID   device_uid,
     return NVM_ERR_DIMM_NOT_FOUND;
   }
   p_status->boot_status = BootstatusBitmask;
-  dimm_info_to_device_status(&dimm_info, p_status);
+  dimm_info_to_device_status(p_dimm_info, p_status);
   p_status->mixed_sku = gNvmDimmData->PMEMDev.DimmSkuConsistency;
   return NVM_SUCCESS;
 }
 
+NVM_API int nvm_get_device_status(const NVM_UID   device_uid,
+          struct device_status *p_status)
+{
+  DIMM_INFO dimm_info = { 0 };
+  DIMM *pDimm = NULL;
+  int nvm_status;
+  if (NULL == p_status) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (nvm_status = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
+    return nvm_status;
+  }
+  if (NVM_SUCCESS != lock_dimm(device_uid, &pDimm)) {
+    p_status->is_missing = TRUE;
+    return NVM_ERR_DIMM_NOT_FOUND;
+  }
+  nvm_status = get_device_status(pDimm, device_query_categories(DEVICE_QUERY_STATUS), &dimm_info, p_status);
+  nvm_topology_r_unlock();
+  return nvm_status;
+}
+
 NVM_API int nvm_get_pmon_registers(const NVM_UID   device_uid,
           const NVM_UINT8 SmartDataMask, PMON_REGISTERS *p_output_payload)
 {
@@ -791,11 +1299,11 @@ NVM_API int nvm_get_pmon_registers(const NVM_UID   device_uid,
     NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
     return nvm_status;
   }
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, FALSE, &dimm_id, NULL))) {
     return NVM_ERR_DIMM_NOT_FOUND;
   }
   ReturnCode = gNvmDimmDriverNvmDimmConfig.GetPMONRegisters(&gNvmDimmDriverNvmDimmConfig, dimm_id, (UINT8)SmartDataMask, p_output_payload);
+  nvm_topology_r_unlock();
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
     return NVM_ERR_OPERATION_FAILED;
@@ -814,11 +1322,11 @@ NVM_API int nvm_set_pmon_registers(const NVM_UID   device_uid,
     NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
     return nvm_status;
   }
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, TRUE, &dimm_id, NULL))) {
     return NVM_ERR_DIMM_NOT_FOUND;
   }
   ReturnCode = gNvmDimmDriverNvmDimmConfig.SetPMONRegisters(&gNvmDimmDriverNvmDimmConfig, dimm_id, (UINT8)PMONGroupEnable);
+  nvm_topology_w_unlock();
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
     return NVM_ERR_OPERATION_FAILED;
@@ -826,35 +1334,10 @@ NVM_API int nvm_set_pmon_registers(const NVM_UID   device_uid,
   return NVM_SUCCESS;
 }
 
-NVM_API int nvm_get_device_settings(const NVM_UID   device_uid,
-            struct device_settings *  p_settings)
+static int get_device_settings(DIMM *pDimm, struct device_settings *p_settings)
 {
   EFI_STATUS ReturnCode;
-  DIMM *pDimm = NULL;
-  UINT16 dimm_id;
-  int rc;
   PT_VIRAL_POLICY_PAYLOAD ViralPolicyPayload;
-  int nvm_status;
-
-  if (NVM_SUCCESS != (nvm_status = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
-    return nvm_status;
-  }
-
-  if (NULL == p_settings) {
-    NVDIMM_ERR("NULL input parameter\n");
-    return NVM_ERR_INVALID_PARAMETER;
-  }
-
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
-    return rc;
-  }
-
-  if (NULL == (pDimm = GetDimmByPid(dimm_id, &gNvmDimmData->PMEMDev.Dimms))) {
-    NVDIMM_ERR("Failed to get dimm by Pid (%d)\n", dimm_id);
-    return NVM_ERR_UNKNOWN;
-  }
 
   ReturnCode = FwCmdGetViralPolicy(pDimm, &ViralPolicyPayload);
   if (ReturnCode == EFI_UNSUPPORTED) {
@@ -871,91 +1354,87 @@ NVM_API int nvm_get_device_settings(const NVM_UID   device_uid,
   return NVM_SUCCESS;
 }
 
-NVM_API int nvm_get_device_details(const NVM_UID    device_uid,
-           struct device_details *  p_details)
+NVM_API int nvm_get_device_settings(const NVM_UID   device_uid,
+            struct device_settings *  p_settings)
 {
-  EFI_STATUS ReturnCode = EFI_SUCCESS;
-  DIMM_INFO dimm_info = { 0 };
-  UINT16 dimm_id;
-  int nvm_status;
+  DIMM *pDimm = NULL;
   int rc;
-  SYSTEM_CAPABILITIES_INFO SystemCapabilitiesInfo;
+  int nvm_status;
 
-  if (NULL == p_details)
-    return NVM_ERR_INVALID_PARAMETER;
   if (NVM_SUCCESS != (nvm_status = nvm_init())) {
     NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
     return nvm_status;
   }
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
-    return NVM_ERR_DIMM_NOT_FOUND;
+
+  if (NULL == p_settings) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
   }
-  ReturnCode = gNvmDimmDriverNvmDimmConfig.GetDimm(&gNvmDimmDriverNvmDimmConfig, dimm_id, DIMM_INFO_CATEGORY_ALL, &dimm_info);
-  if (EFI_ERROR(ReturnCode)) {
-    NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
-    return NVM_ERR_DIMM_NOT_FOUND;
+
+  if (NVM_SUCCESS != (rc = lock_dimm(device_uid, &pDimm))) {
+    return rc;
   }
+  rc = get_device_settings(pDimm, p_settings);
+  nvm_topology_r_unlock();
+  return rc;
+}
 
-  // from SMBIOS Type 17 Table
-  p_details->form_factor = dimm_info.FormFactor;                                          // The type of DIMM.
-  p_details->data_width = dimm_info.DataWidth;                                            // The width in bits used to store user data.
-  p_details->total_width = dimm_info.TotalWidth;                                          // The width in bits for data and ECC and/or redundancy.
-  p_details->speed = dimm_info.Speed;                                                     // The speed in nanoseconds.
-  os_memcpy(p_details->device_locator, NVM_DEVICE_LOCATOR_LEN, dimm_info.DeviceLocator, NVM_DEVICE_LOCATOR_LEN);     // The socket or board position label
-  os_memcpy(p_details->bank_label, NVM_BANK_LABEL_LEN, dimm_info.BankLabel, sizeof(dimm_info.BankLabel));                 // The bank label
-  p_details->peak_power_budget = dimm_info.PeakPowerBudget.Data;                               // instantaneous power budget in mW (100-20000 mW).
-  p_details->avg_power_budget = dimm_info.AvgPowerLimit.Data;                                 // average power budget in mW (100-18000 mW).
-  p_details->package_sparing_enabled = dimm_info.PackageSparingEnabled;                   // Enable or disable package sparing.
+static void dimm_info_to_device_details(DIMM_INFO *p_dimm, struct device_details *p_details)
+{
+   // from SMBIOS Type 17 Table
+   p_details->form_factor = p_dimm->FormFactor;                                          // The type of DIMM.
+   p_details->data_width = p_dimm->DataWidth;                                            // The width in bits used to store user data.
+   p_details->total_width = p_dimm->TotalWidth;                                          // The width in bits for data and ECC and/or redundancy.
+   p_details->speed = p_dimm->Speed;                                                     // The speed in nanoseconds.
+   os_memcpy(p_details->device_locator, NVM_DEVICE_LOCATOR_LEN, p_dimm->DeviceLocator, NVM_DEVICE_LOCATOR_LEN);     // The socket or board position label
+   os_memcpy(p_details->bank_label, NVM_BANK_LABEL_LEN, p_dimm->BankLabel, sizeof(p_dimm->BankLabel));                 // The bank label
+   p_details->peak_power_budget = p_dimm->PeakPowerBudget.Data;                               // instantaneous power budget in mW (100-20000 mW).
+   p_details->avg_power_budget = p_dimm->AvgPowerLimit.Data;                                 // average power budget in mW (100-18000 mW).
+   p_details->package_sparing_enabled = p_dimm->PackageSparingEnabled;                   // Enable or disable package sparing.
+}
 
-  ReturnCode = gNvmDimmDriverNvmDimmConfig.GetSystemCapabilitiesInfo(&gNvmDimmDriverNvmDimmConfig,
-    &SystemCapabilitiesInfo);
-  if (EFI_ERROR(ReturnCode)) {
-    NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
-    return NVM_ERR_UNKNOWN;
-  }
+NVM_API int nvm_get_device_details(const NVM_UID    device_uid,
+           struct device_details *  p_details)
+{
+  NVM_UID uid;
 
-  p_details->discovery.security_capabilities.erase_crypto_capable = SystemCapabilitiesInfo.EraseDeviceDataSupported;
-  p_details->discovery.security_capabilities.passphrase_capable = SystemCapabilitiesInfo.ChangeDevicePassphraseSupported;
-  p_details->discovery.security_capabilities.unlock_device_capable = SystemCapabilitiesInfo.UnlockDeviceSecuritySupported;
+  if (NULL == device_uid || NULL == p_details)
+    return NVM_ERR_INVALID_PARAMETER;
+  // A single device bulk query reads the DIMM_INFO once, with only the categories details need
+  AsciiStrnCpyS(uid, sizeof(uid), device_uid, sizeof(uid) - 1);
+  return nvm_get_devices_details((const NVM_UID *)&uid, 1, p_details, NULL);
+}
 
-  // Basic device identifying information.
-  rc = nvm_get_device_discovery(device_uid, &(p_details->discovery));
-  if (rc != NVM_SUCCESS)
-    return rc;
-  // Device health and status.
-  rc = nvm_get_device_status(device_uid, &(p_details->status));
-  if (rc != NVM_SUCCESS)
-    return rc;
-  // The firmware image information for the device.
-  rc = nvm_get_device_fw_image_info(device_uid, &(p_details->fw_info));
-  if (rc != NVM_SUCCESS)
-    return rc;
-  // A snapshot of the performance metrics.
-  rc = nvm_get_device_performance(device_uid, &(p_details->performance));
-  if (rc != NVM_SUCCESS)
-    return rc;
-  // Device sensors.
-  rc = nvm_get_sensors(device_uid, p_details->sensors, NVM_MAX_DEVICE_SENSORS);
-  if (rc != NVM_SUCCESS)
-    return rc;
-  // Partition information
-  rc = nvm_get_nvm_capacities(&(p_details->capacities));
-  if (rc != NVM_SUCCESS)
-    return rc;
-  // Modifiable features of the device.
-  rc = nvm_get_device_settings(device_uid, &(p_details->settings));
-  if (rc != NVM_SUCCESS)
-    return rc;
+/*
+ * Read the performance counters of a DCPMM from memory info page 1.
+ */
+static int get_device_performance(DIMM *pDimm, struct device_performance *p_performance)
+{
+  EFI_STATUS ReturnCode;
+  PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1 *pmem_info_output = NULL;
+
+  ReturnCode = FwCmdGetMemoryInfoPage(pDimm, MEMORY_INFO_PAGE_1,
+    sizeof(PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1), (VOID **)&pmem_info_output);
+  if (EFI_ERROR(ReturnCode) || NULL == pmem_info_output) {
+    NVDIMM_ERR("Failed to get memory info page 1 (%d)\n", ReturnCode);
+    FREE_POOL_SAFE(pmem_info_output);
+    return NVM_ERR_UNKNOWN;
+  }
+  p_performance->bytes_read = pmem_info_output->TotalMediaReads.Uint64;
+  p_performance->bytes_written = pmem_info_output->TotalMediaWrites.Uint64;
+  p_performance->host_reads = pmem_info_output->TotalReadRequests.Uint64;
+  p_performance->host_writes = pmem_info_output->TotalWriteRequests.Uint64;
+  p_performance->block_reads = 0;
+  p_performance->block_writes = 0;
+  p_performance->time = time(NULL);
+  FREE_POOL_SAFE(pmem_info_output);
   return NVM_SUCCESS;
 }
 
 NVM_API int nvm_get_device_performance(const NVM_UID      device_uid,
                struct device_performance *  p_performance)
 {
-  FW_CMD *cmd = NULL;
-  PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1 *pmem_info_output;
-  PT_INPUT_PAYLOAD_MEMORY_INFO mem_info_input;
+  DIMM *pDimm = NULL;
   int rc = NVM_ERR_UNKNOWN;
 
   if (NULL == p_performance) {
@@ -968,42 +1447,11 @@ NVM_API int nvm_get_device_performance(const NVM_UID      device_uid,
     return rc;
   }
 
-  if (NULL == (cmd = (FW_CMD *)AllocatePool(sizeof(FW_CMD)))) {
-    NVDIMM_ERR("Failed to allocate memory\n");
-    goto finish;
-  }
-
-  ZeroMem(cmd, sizeof(FW_CMD));
-  ZeroMem(&mem_info_input, sizeof(mem_info_input));
-  mem_info_input.MemoryPage = 1;
-  UINT16 dimm_id;
-  unsigned int dimm_handle;
-
-  if (NVM_SUCCESS != (rc = get_dimm_id((char *)device_uid, &dimm_id, &dimm_handle))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
-    goto finish;
-  }
-  cmd->DimmID = dimm_id; //PassThruCommand needs the dimm_id (not handle)
-  cmd->Opcode = PtGetLog;
-  cmd->SubOpcode = SubopMemInfo;
-  cmd->InputPayloadSize = sizeof(PT_INPUT_PAYLOAD_MEMORY_INFO);
-  CopyMem_S(cmd->InputPayload, sizeof(cmd->InputPayload), &mem_info_input, cmd->InputPayloadSize);
-  cmd->OutputPayloadSize = sizeof(PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1);
-  if (EFI_SUCCESS == PassThruCommand(cmd, PT_TIMEOUT_INTERVAL)) {
-    pmem_info_output = (PT_OUTPUT_PAYLOAD_MEMORY_INFO_PAGE1 *)cmd->OutPayload;
-    p_performance->bytes_read = pmem_info_output->TotalMediaReads.Uint64;
-    p_performance->bytes_written = pmem_info_output->TotalMediaWrites.Uint64;
-    p_performance->host_reads = pmem_info_output->TotalReadRequests.Uint64;
-    p_performance->host_writes = pmem_info_output->TotalWriteRequests.Uint64;
-    p_performance->block_reads = 0;
-    p_performance->block_writes = 0;
-    p_performance->time = time(NULL);
-    rc = NVM_SUCCESS;
-    goto finish;
+  if (NVM_SUCCESS != (rc = lock_dimm(device_uid, &pDimm))) {
+    return rc;
   }
-
-finish:
-  FREE_POOL_SAFE(cmd);
+  rc = get_device_performance(pDimm, p_performance);
+  nvm_topology_r_unlock();
   return rc;
 }
 
@@ -1123,35 +1571,13 @@ enum fw_update_status firmware_update_status_to_enum(unsigned char last_fw_updat
   return fw_update_status;
 }
 
-NVM_API int nvm_get_device_fw_image_info(const NVM_UID    device_uid,
-           struct device_fw_info *p_fw_info)
+/*
+ * Read the firmware image information of a DCPMM.
+ */
+static int get_device_fw_image_info(DIMM *pDimm, struct device_fw_info *p_fw_info)
 {
   EFI_STATUS ReturnCode;
-  DIMM *pDimm = NULL;
-  UINT16 dimm_id;
-  int rc;
   PT_PAYLOAD_FW_IMAGE_INFO *fw_image_info = NULL;
-  int nvm_status;
-
-  if (NULL == p_fw_info) {
-    NVDIMM_ERR("NULL input parameter\n");
-    return NVM_ERR_INVALID_PARAMETER;
-  }
-
-  if (NVM_SUCCESS != (nvm_status = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
-    return nvm_status;
-  }
-
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
-    return rc;
-  }
-
-  if (NULL == (pDimm = GetDimmByPid(dimm_id, &gNvmDimmData->PMEMDev.Dimms))) {
-    NVDIMM_ERR("Failed to get dimm by Pid (%d)\n", dimm_id);
-    return NVM_ERR_UNKNOWN;
-  }
 
   ReturnCode = FwCmdGetFirmwareImageInfo(pDimm, &fw_image_info);
   if (EFI_ERROR(ReturnCode) || (NULL == fw_image_info)) {
@@ -1173,6 +1599,31 @@ NVM_API int nvm_get_device_fw_image_info(const NVM_UID    device_uid,
   return NVM_SUCCESS;
 }
 
+NVM_API int nvm_get_device_fw_image_info(const NVM_UID    device_uid,
+           struct device_fw_info *p_fw_info)
+{
+  DIMM *pDimm = NULL;
+  int rc;
+  int nvm_status;
+
+  if (NULL == p_fw_info) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  if (NVM_SUCCESS != (nvm_status = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", nvm_status);
+    return nvm_status;
+  }
+
+  if (NVM_SUCCESS != (rc = lock_dimm(device_uid, &pDimm))) {
+    return rc;
+  }
+  rc = get_device_fw_image_info(pDimm, p_fw_info);
+  nvm_topology_r_unlock();
+  return rc;
+}
+
 NVM_API int nvm_update_device_fw(const NVM_UID device_uid,
          const NVM_PATH path, const NVM_SIZE path_len, const NVM_BOOL force)
 {
@@ -1193,13 +1644,13 @@ NVM_API int nvm_update_device_fw(const NVM_UID device_uid,
   ReturnCode = InitializeCommandStatus(&p_command_status);
   if (EFI_ERROR(ReturnCode))
     return NVM_ERR_UNKNOWN;
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, TRUE, &dimm_id, NULL))) {
     FreeCommandStatus(&p_command_status);
-    NVDIMM_ERR("Failed to get DIMM ID %d\n", rc);
     return rc;
   }
   ReturnCode = gNvmDimmDriverNvmDimmConfig.UpdateFw(&gNvmDimmDriverNvmDimmConfig, &dimm_id, 1, AsciiStrToUnicodeStr(path, file_name),
                 NULL, FALSE, force, FALSE, FALSE, p_fw_image_info, p_command_status);
+  nvm_topology_w_unlock();
   if (NVM_SUCCESS != ReturnCode) {
     FreeCommandStatus(&p_command_status);
     NVDIMM_ERR("Failed to update the FW, file %s. Return code %d", path, ReturnCode);
@@ -1230,18 +1681,19 @@ NVM_API int nvm_examine_device_fw(const NVM_UID device_uid,
   ReturnCode = InitializeCommandStatus(&p_command_status);
   if (EFI_ERROR(ReturnCode))
     return NVM_ERR_UNKNOWN;
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, FALSE, &dimm_id, NULL))) {
     FreeCommandStatus(&p_command_status);
-    NVDIMM_ERR("Failed to get DIMM ID %d\n", rc);
     return rc;
   }
   p_fw_image_info = AllocateZeroPool(sizeof(*p_fw_image_info));
   if (p_fw_image_info == NULL) {
     NVDIMM_ERR("Failed to allocate memory");
+    nvm_topology_r_unlock();
     rc = NVM_ERR_UNKNOWN;
   } else {
     ReturnCode = gNvmDimmDriverNvmDimmConfig.UpdateFw(&gNvmDimmDriverNvmDimmConfig, &dimm_id, 1, AsciiStrToUnicodeStr(path, file_name),
                   NULL, TRUE, FALSE, FALSE, FALSE, p_fw_image_info, p_command_status);
+    nvm_topology_r_unlock();
     if (NVM_SUCCESS != ReturnCode) {
       NVDIMM_ERR("Failed to update the FW, file %s. Return code %d", path, ReturnCode);
       rc = NVM_ERR_DUMP_FILE_OPERATION_FAILED;
@@ -1378,7 +1830,10 @@ NVM_API int nvm_get_nvm_capabilities(struct nvm_capabilities *p_capabilties)
     return NVM_SUCCESS;
 }
 
-NVM_API int nvm_get_nvm_capacities(struct device_capacities *p_capacities)
+/*
+ * Sum the capacities of all DCPMMs, the caller holds the topology lock.
+ */
+static int get_nvm_capacities(struct device_capacities *p_capacities)
 {
   UINT64 VolatileCapacity;
   UINT64 AppDirectCapacity;
@@ -1390,16 +1845,7 @@ NVM_API int nvm_get_nvm_capacities(struct device_capacities *p_capacities)
   int rc = NVM_SUCCESS;
   UINT32 dimm_cnt;
 
-  if (NULL == p_capacities) {
-    NVDIMM_ERR("NULL input parameter\n");
-    return NVM_ERR_INVALID_PARAMETER;
-  }
-
-  if (NVM_SUCCESS != (rc = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
-    return rc;
-  }
-  if (NVM_SUCCESS != nvm_get_number_of_devices(&dimm_cnt)) {
+  if (NVM_SUCCESS != get_number_of_devices(&dimm_cnt)) {
     NVDIMM_ERR("Failed to get number of devices\n");
     return NVM_ERR_UNKNOWN;
   }
@@ -1434,6 +1880,26 @@ Finish:
   return rc;
 }
 
+NVM_API int nvm_get_nvm_capacities(struct device_capacities *p_capacities)
+{
+  int rc = NVM_SUCCESS;
+
+  if (NULL == p_capacities) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
+  }
+
+  nvm_topology_r_lock();
+  rc = get_nvm_capacities(p_capacities);
+  nvm_topology_r_unlock();
+  return rc;
+}
+
 NVM_API int nvm_set_passphrase(const NVM_UID device_uid,
              const NVM_PASSPHRASE old_passphrase, const NVM_SIZE old_passphrase_len,
              const NVM_PASSPHRASE new_passphrase, const NVM_SIZE new_passphrase_len)
@@ -1505,8 +1971,7 @@ NVM_API int nvm_remove_passphrase(const NVM_UID device_uid,
     goto Finish;
   }
 
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, &dimm_handle))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, TRUE, &dimm_id, &dimm_handle))) {
     goto Finish;
   }
 
@@ -1514,6 +1979,7 @@ NVM_API int nvm_remove_passphrase(const NVM_UID device_uid,
   ReturnCode = gNvmDimmDriverNvmDimmConfig.SetSecurityState(&gNvmDimmDriverNvmDimmConfig, &dimm_id,
     dimm_count, SECURITY_OPERATION_DISABLE_PASSPHRASE, AsciiStrToUnicodeStr(passphrase, UnicodePassphrase), NULL,
     p_command_status);
+  nvm_topology_w_unlock();
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
     rc = NVM_ERR_UNKNOWN;
@@ -1655,12 +2121,12 @@ NVM_API int nvm_set_master_passphrase(const NVM_UID device_uid,
     rc = NVM_ERR_OPERATION_NOT_SUPPORTED;
   }
 
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, &dimm_handle))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, TRUE, &dimm_id, &dimm_handle))) {
     goto Finish;
   }
 
   if (new_master_passphrase == NULL || new_master_passphrase_len == 0 || new_master_passphrase[0] == '\0') {
+    nvm_topology_w_unlock();
     rc = NVM_ERR_PASSPHRASE_NOT_PROVIDED;
     goto Finish;
   }
@@ -1671,6 +2137,7 @@ NVM_API int nvm_set_master_passphrase(const NVM_UID device_uid,
   ReturnCode = gNvmDimmDriverNvmDimmConfig.SetSecurityState(&gNvmDimmDriverNvmDimmConfig, &dimm_id,
     1, SECURITY_OPERATION_CHANGE_MASTER_PASSPHRASE, UnicodeOldMasterPassphrase,
     UnicodeNewMasterPassphrase, p_command_status);
+  nvm_topology_w_unlock();
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
     rc = p_command_status->GeneralStatus;
@@ -1742,44 +2209,50 @@ int fill_sensor_info(DIMM_SENSOR    DimmSensorsSet[SENSOR_TYPE_COUNT],
   }
 }
 
-NVM_API int nvm_get_sensors(const NVM_UID device_uid, struct sensor *p_sensors,
-          const NVM_UINT16 count)
+/*
+ * Read all SENSOR_TYPE_COUNT health sensors of a DCPMM.
+ */
+static int get_device_sensors(DIMM *pDimm, struct sensor *p_sensors)
 {
   EFI_STATUS ReturnCode;
-  UINT16 dimm_id;
   DIMM_SENSOR DimmSensorsSet[SENSOR_TYPE_COUNT];
   int rc = NVM_SUCCESS;
   int i;
 
-  if (NULL == p_sensors) {
-    NVDIMM_ERR("NULL input parameter\n");
-    rc = NVM_ERR_INVALID_PARAMETER;
-    goto Finish;
+  ReturnCode = GetSensorsInfo(&gNvmDimmDriverNvmDimmConfig, pDimm->DimmID, DimmSensorsSet);
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_ERR_W(L"Failed to GetSensorsInfo\n");
+    return NVM_ERR_UNKNOWN;
   }
 
-  if (NVM_SUCCESS != (rc = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
-    return rc;
+  for (i = 0; i < SENSOR_TYPE_COUNT; ++i) {
+    rc = fill_sensor_info(DimmSensorsSet, &p_sensors[i], (enum sensor_type)i);
   }
+  return rc;
+}
 
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+NVM_API int nvm_get_sensors(const NVM_UID device_uid, struct sensor *p_sensors,
+          const NVM_UINT16 count)
+{
+  DIMM *pDimm = NULL;
+  int rc = NVM_SUCCESS;
+
+  if (NULL == p_sensors) {
+    NVDIMM_ERR("NULL input parameter\n");
+    rc = NVM_ERR_INVALID_PARAMETER;
     goto Finish;
   }
 
-  ReturnCode = GetSensorsInfo(&gNvmDimmDriverNvmDimmConfig, dimm_id, DimmSensorsSet);
-  if (EFI_ERROR(ReturnCode)) {
-    NVDIMM_ERR_W(L"Failed to GetSensorsInfo\n");
-    rc = NVM_ERR_UNKNOWN;
-    goto Finish;
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
   }
 
-  for (i = 0; i < SENSOR_TYPE_COUNT; ++i) {
-    rc = fill_sensor_info(DimmSensorsSet, &p_sensors[i], (enum sensor_type)i);
-    if (EFI_ERROR(ReturnCode)) {
-      rc = NVM_ERR_OPERATION_FAILED;
-    }
+  if (NVM_SUCCESS != (rc = lock_dimm(device_uid, &pDimm))) {
+    goto Finish;
   }
+  rc = get_device_sensors(pDimm, p_sensors);
+  nvm_topology_r_unlock();
 
 Finish:
   return rc;
@@ -1804,12 +2277,12 @@ NVM_API int nvm_get_sensor(const NVM_UID device_uid, const enum sensor_type type
     goto Finish;
   }
 
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, FALSE, &dimm_id, NULL))) {
     goto Finish;
   }
 
   EFIReturnCode = GetSensorsInfo(&gNvmDimmDriverNvmDimmConfig, dimm_id, DimmSensorsSet);
+  nvm_topology_r_unlock();
   if (EFI_ERROR(EFIReturnCode)) {
     NVDIMM_ERR_W(L"Failed to GetSensorsInfo\n");
     rc = NVM_ERR_OPERATION_FAILED;
@@ -1844,13 +2317,13 @@ NVM_API int nvm_set_sensor_settings(const NVM_UID device_uid,
     goto Finish;
   }
 
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, TRUE, &dimm_id, NULL))) {
     goto Finish;
   }
 
   ReturnCode = InitializeCommandStatus(&pCommandStatus);
   if (EFI_ERROR(ReturnCode)) {
+    nvm_topology_w_unlock();
     rc = NVM_ERR_OPERATION_FAILED;
     goto Finish;
   }
@@ -1863,6 +2336,7 @@ NVM_API int nvm_set_sensor_settings(const NVM_UID device_uid,
     (INT16)p_settings->upper_noncritical_threshold,
     (UINT8)p_settings->enabled,
     pCommandStatus);
+  nvm_topology_w_unlock();
 
   if (EFI_ERROR(ReturnCode))
     rc = NVM_ERR_OPERATION_FAILED;
@@ -1872,6 +2346,530 @@ Finish:
   return rc;
 }
 
+/*
+ * One nvm_get_devices_* bulk query, the output arrays hold one entry per device
+ * (NVM_MAX_DEVICE_SENSORS entries per device for p_sensors).
+ */
+struct device_query
+{
+  NVM_UINT32 what;                                // DEVICE_QUERY_*
+  struct device_status *p_status;
+  struct device_performance *p_performance;
+  struct sensor *p_sensors;
+  struct device_details *p_details;
+  struct device_snapshot *p_snapshots;
+  DIMM_INFO_CATEGORIES categories;                // DIMM_INFO categories the query needs
+  SYSTEM_CAPABILITIES_INFO capabilities;          // shared by all devices, for details and snapshots
+  struct device_capacities capacities;            // shared by all devices, for details
+};
+
+struct device_query_work
+{
+  struct device_query *p_query;
+  NVM_UINT32 index;
+  int rc;
+};
+
+static void set_security_capabilities(const SYSTEM_CAPABILITIES_INFO *p_capabilities,
+  struct device_discovery *p_discovery)
+{
+  p_discovery->security_capabilities.erase_crypto_capable = p_capabilities->EraseDeviceDataSupported;
+  p_discovery->security_capabilities.passphrase_capable = p_capabilities->ChangeDevicePassphraseSupported;
+  p_discovery->security_capabilities.unlock_device_capable = p_capabilities->UnlockDeviceSecuritySupported;
+}
+
+/*
+ * Capture every section of a device snapshot. A section that fails is left out
+ * of p_snapshot->sections and the others are still captured, the first failure
+ * is returned.
+ */
+static int get_device_snapshot(DIMM *pDimm, struct device_query *p_query, struct device_snapshot *p_snapshot)
+{
+  DIMM_INFO dimm_info;
+  NVM_UINT64 start = os_get_monotonic_usec();
+  int section_rc;
+  int rc = NVM_SUCCESS;
+
+  // Identity and health come from the same DIMM_INFO read
+  if (NVM_SUCCESS == (section_rc = get_device_status(pDimm, p_query->categories, &dimm_info, &p_snapshot->status))) {
+    dimm_info_to_device_discovery(&dimm_info, &p_snapshot->discovery);
+    set_security_capabilities(&p_query->capabilities, &p_snapshot->discovery);
+    os_memcpy(p_snapshot->uid, sizeof(p_snapshot->uid), p_snapshot->discovery.uid, sizeof(p_snapshot->discovery.uid));
+    p_snapshot->sections |= NVM_SNAPSHOT_IDENTITY | NVM_SNAPSHOT_HEALTH;
+  }
+  rc = section_rc;
+  if (NVM_SUCCESS == (section_rc = get_device_sensors(pDimm, p_snapshot->sensors))) {
+    p_snapshot->sections |= NVM_SNAPSHOT_SENSORS;
+  }
+  rc = (NVM_SUCCESS == rc) ? section_rc : rc;
+  if (NVM_SUCCESS == (section_rc = get_device_performance(pDimm, &p_snapshot->performance))) {
+    p_snapshot->sections |= NVM_SNAPSHOT_PERFORMANCE;
+  }
+  rc = (NVM_SUCCESS == rc) ? section_rc : rc;
+  if (NVM_SUCCESS == (section_rc = get_device_error_log_status(pDimm->DimmID, &p_snapshot->error_log))) {
+    p_snapshot->sections |= NVM_SNAPSHOT_ERROR_LOG;
+  }
+  rc = (NVM_SUCCESS == rc) ? section_rc : rc;
+  if (NVM_SUCCESS == (section_rc = get_device_fw_image_info(pDimm, &p_snapshot->fw_info))) {
+    p_snapshot->sections |= NVM_SNAPSHOT_FW;
+  }
+  rc = (NVM_SUCCESS == rc) ? section_rc : rc;
+
+  p_snapshot->capture_usec = os_get_monotonic_usec() - start;
+  return rc;
+}
+
+/*
+ * DIMM_WORKER filling the entries of one device of a bulk query.
+ */
+static EFI_STATUS device_query_worker(DIMM *pDimm, VOID *pContext)
+{
+  struct device_query_work *p_work = (struct device_query_work *)pContext;
+  struct device_query *p_query = p_work->p_query;
+  struct device_details *p_details;
+  DIMM_INFO dimm_info;
+  NVM_UINT32 i = p_work->index;
+  int rc = NVM_SUCCESS;
+
+  if ((p_query->what & DEVICE_QUERY_STATUS) && NVM_SUCCESS == rc) {
+    rc = get_device_status(pDimm, p_query->categories, &dimm_info, &p_query->p_status[i]);
+  }
+  if ((p_query->what & DEVICE_QUERY_PERFORMANCE) && NVM_SUCCESS == rc) {
+    rc = get_device_performance(pDimm, &p_query->p_performance[i]);
+  }
+  if ((p_query->what & DEVICE_QUERY_SENSORS) && NVM_SUCCESS == rc) {
+    rc = get_device_sensors(pDimm, &p_query->p_sensors[i * NVM_MAX_DEVICE_SENSORS]);
+  }
+  if ((p_query->what & DEVICE_QUERY_DETAILS) && NVM_SUCCESS == rc) {
+    p_details = &p_query->p_details[i];
+    if (NVM_SUCCESS == (rc = get_device_status(pDimm, p_query->categories, &dimm_info, &p_details->status))) {
+      dimm_info_to_device_details(&dimm_info, p_details);
+      dimm_info_to_device_discovery(&dimm_info, &p_details->discovery);
+      set_security_capabilities(&p_query->capabilities, &p_details->discovery);
+      p_details->capacities = p_query->capacities;
+      rc = get_device_fw_image_info(pDimm, &p_details->fw_info);
+    }
+    if (NVM_SUCCESS == rc) {
+      rc = get_device_performance(pDimm, &p_details->performance);
+    }
+    if (NVM_SUCCESS == rc) {
+      rc = get_device_sensors(pDimm, p_details->sensors);
+    }
+    if (NVM_SUCCESS == rc) {
+      rc = get_device_settings(pDimm, &p_details->settings);
+    }
+  }
+  if ((p_query->what & DEVICE_QUERY_SNAPSHOT) && NVM_SUCCESS == rc) {
+    rc = get_device_snapshot(pDimm, p_query, &p_query->p_snapshots[i]);
+  }
+
+  p_work->rc = rc;
+  return (NVM_SUCCESS == rc) ? EFI_SUCCESS : EFI_DEVICE_ERROR;
+}
+
+/*
+ * Run a bulk query for the devices in p_device_uids, or for all devices in
+ * #nvm_get_devices order when it is NULL. The devices are resolved once and
+ * queried in parallel, one firmware command in flight per device, all under
+ * the topology lock.
+ */
+static int get_devices(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_query *p_query, int *p_results)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  DIMM_WORK_ITEM *p_items = NULL;
+  struct device_query_work *p_work = NULL;
+  LIST_ENTRY *pNode = NULL;
+  DIMM *pDimm = NULL;
+  NVM_UINT32 item_cnt = 0;
+  NVM_UINT32 dimm_cnt = 0;
+  NVM_UINT32 i;
+  UINT16 dimm_id;
+  NVM_UINT64 capture_time;
+  int rc = NVM_SUCCESS;
+
+  if (0 == count) {
+    NVDIMM_ERR("Invalid input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
+  }
+
+  nvm_topology_r_lock();
+
+  // The capture pass starts once no CLI command or reload can run in between
+  if (p_query->what & DEVICE_QUERY_SNAPSHOT) {
+    capture_time = (NVM_UINT64)time(NULL);
+    for (i = 0; i < count; ++i) {
+      p_query->p_snapshots[i].time = capture_time;
+    }
+  }
+
+  p_items = (DIMM_WORK_ITEM *)AllocateZeroPool(sizeof(*p_items) * count);
+  p_work = (struct device_query_work *)AllocateZeroPool(sizeof(*p_work) * count);
+  if (NULL == p_items || NULL == p_work) {
+    NVDIMM_ERR("Failed to allocate memory\n");
+    rc = NVM_ERR_NO_MEM;
+    goto Finish;
+  }
+  for (i = 0; i < count; ++i) {
+    p_work[i].p_query = p_query;
+    p_work[i].index = i;
+    p_work[i].rc = NVM_ERR_DIMM_NOT_FOUND;
+  }
+
+  if (NULL == p_device_uids) {
+    // Same devices in the same order as GetDimms, which backs nvm_get_devices
+    LIST_FOR_EACH(pNode, &gNvmDimmData->PMEMDev.Dimms) {
+      pDimm = DIMM_FROM_NODE(pNode);
+      if (pDimm->NonFunctional == TRUE) {
+        continue;
+      }
+      if (dimm_cnt < count) {
+        p_items[dimm_cnt].pDimm = pDimm;
+        p_items[dimm_cnt].pContext = &p_work[dimm_cnt];
+      }
+      dimm_cnt++;
+    }
+    if (dimm_cnt != count) {
+      rc = NVM_ERR_BAD_SIZE;
+      goto Finish;
+    }
+    item_cnt = count;
+  } else {
+    // Devices that are not found keep NVM_ERR_DIMM_NOT_FOUND and are not queried
+    for (i = 0; i < count; ++i) {
+      if (NVM_SUCCESS != get_dimm_id(p_device_uids[i], &dimm_id, NULL) ||
+        NULL == (pDimm = GetDimmByPid(dimm_id, &gNvmDimmData->PMEMDev.Dimms))) {
+        NVDIMM_ERR("Failed to get dimm ID for %s\n", p_device_uids[i]);
+        if (p_query->what & DEVICE_QUERY_STATUS) {
+          p_query->p_status[i].is_missing = TRUE;
+        }
+        if (p_query->what & DEVICE_QUERY_SNAPSHOT) {
+          p_query->p_snapshots[i].status.is_missing = TRUE;
+        }
+        continue;
+      }
+      p_items[item_cnt].pDimm = pDimm;
+      p_items[item_cnt].pContext = &p_work[i];
+      item_cnt++;
+    }
+  }
+
+  p_query->categories = device_query_categories(p_query->what);
+  if (p_query->what & (DEVICE_QUERY_DETAILS | DEVICE_QUERY_SNAPSHOT)) {
+    ReturnCode = gNvmDimmDriverNvmDimmConfig.GetSystemCapabilitiesInfo(&gNvmDimmDriverNvmDimmConfig,
+      &p_query->capabilities);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
+      rc = NVM_ERR_UNKNOWN;
+      goto Finish;
+    }
+  }
+  if (p_query->what & DEVICE_QUERY_DETAILS) {
+    if (NVM_SUCCESS != (rc = get_nvm_capacities(&p_query->capacities))) {
+      goto Finish;
+    }
+  }
+
+  ReturnCode = DispatchDimmWork(p_items, item_cnt, device_query_worker);
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_ERR("Failed to dispatch the device queries (%d)\n", ReturnCode);
+    rc = NVM_ERR_UNKNOWN;
+    goto Finish;
+  }
+
+  // Report the first failure in array order
+  for (i = 0; i < count; ++i) {
+    if (NULL != p_results) {
+      p_results[i] = p_work[i].rc;
+    }
+    if (NVM_SUCCESS == rc && NVM_SUCCESS != p_work[i].rc) {
+      rc = p_work[i].rc;
+    }
+  }
+
+Finish:
+  nvm_topology_r_unlock();
+  FREE_POOL_SAFE(p_items);
+  FREE_POOL_SAFE(p_work);
+  return rc;
+}
+
+NVM_API int nvm_get_devices_status(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_status *p_status, int *p_results)
+{
+  struct device_query query;
+
+  if (NULL == p_status) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  ZeroMem(&query, sizeof(query));
+  ZeroMem(p_status, sizeof(*p_status) * count);
+  query.what = DEVICE_QUERY_STATUS;
+  query.p_status = p_status;
+  return get_devices(p_device_uids, count, &query, p_results);
+}
+
+NVM_API int nvm_get_devices_performance(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_performance *p_performance, int *p_results)
+{
+  struct device_query query;
+
+  if (NULL == p_performance) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  ZeroMem(&query, sizeof(query));
+  ZeroMem(p_performance, sizeof(*p_performance) * count);
+  query.what = DEVICE_QUERY_PERFORMANCE;
+  query.p_performance = p_performance;
+  return get_devices(p_device_uids, count, &query, p_results);
+}
+
+NVM_API int nvm_get_devices_sensors(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct sensor *p_sensors, int *p_results)
+{
+  struct device_query query;
+
+  if (NULL == p_sensors) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  ZeroMem(&query, sizeof(query));
+  ZeroMem(p_sensors, sizeof(*p_sensors) * NVM_MAX_DEVICE_SENSORS * count);
+  query.what = DEVICE_QUERY_SENSORS;
+  query.p_sensors = p_sensors;
+  return get_devices(p_device_uids, count, &query, p_results);
+}
+
+NVM_API int nvm_get_devices_details(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_details *p_details, int *p_results)
+{
+  struct device_query query;
+
+  if (NULL == p_details) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  ZeroMem(&query, sizeof(query));
+  ZeroMem(p_details, sizeof(*p_details) * count);
+  query.what = DEVICE_QUERY_DETAILS;
+  query.p_details = p_details;
+  return get_devices(p_device_uids, count, &query, p_results);
+}
+
+NVM_API int nvm_get_devices_snapshot(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_snapshot *p_snapshots, int *p_results)
+{
+  struct device_query query;
+  NVM_UINT32 i;
+
+  if (NULL == p_snapshots) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  ZeroMem(&query, sizeof(query));
+  ZeroMem(p_snapshots, sizeof(*p_snapshots) * count);
+  // Devices that are not found still carry their UID, so their snapshots can be told apart
+  for (i = 0; i < count; ++i) {
+    p_snapshots[i].version = NVM_DEVICE_SNAPSHOT_VERSION;
+    if (NULL != p_device_uids) {
+      AsciiStrnCpyS(p_snapshots[i].uid, sizeof(p_snapshots[i].uid), p_device_uids[i], sizeof(p_snapshots[i].uid) - 1);
+    }
+  }
+  query.what = DEVICE_QUERY_SNAPSHOT;
+  query.p_snapshots = p_snapshots;
+  return get_devices(p_device_uids, count, &query, p_results);
+}
+
+NVM_API int nvm_get_device_snapshot(const NVM_UID device_uid, struct device_snapshot *p_snapshot)
+{
+  NVM_UID uid;
+
+  if (NULL == device_uid || NULL == p_snapshot)
+    return NVM_ERR_INVALID_PARAMETER;
+  AsciiStrnCpyS(uid, sizeof(uid), device_uid, sizeof(uid) - 1);
+  return nvm_get_devices_snapshot((const NVM_UID *)&uid, 1, p_snapshot, NULL);
+}
+
+/*
+ * Serialized snapshots: the header followed by the device_snapshot structures as
+ * they are in memory, which the layout version and snapshot size pin down.
+ */
+#define DEVICE_SNAPSHOT_MAGIC       0x4E534449 // IDSN
+
+#pragma pack(push)
+#pragma pack(1)
+struct device_snapshot_header
+{
+  NVM_UINT32 magic;
+  NVM_UINT32 version;             // NVM_DEVICE_SNAPSHOT_VERSION
+  NVM_UINT32 snapshot_size;       // sizeof(struct device_snapshot)
+  NVM_UINT32 count;
+  NVM_UINT32 checksum;            // FNV-1a of the snapshots
+  NVM_UINT32 reserved[3];
+};
+#pragma pack(pop)
+
+static NVM_UINT32 snapshot_checksum(const void *p_data, NVM_UINT64 size)
+{
+  const NVM_UINT8 *p_byte = (const NVM_UINT8 *)p_data;
+  NVM_UINT32 hash = 2166136261u;
+
+  while (size--) {
+    hash = (hash ^ *p_byte++) * 16777619u;
+  }
+  return hash;
+}
+
+NVM_API int nvm_serialize_device_snapshots(const struct device_snapshot *p_snapshots,
+  const NVM_UINT32 count, void *p_buf, const NVM_UINT32 buf_size, NVM_UINT32 *p_size)
+{
+  struct device_snapshot_header header;
+  NVM_UINT64 size = sizeof(header) + (NVM_UINT64)sizeof(*p_snapshots) * count;
+
+  if ((NULL == p_snapshots && 0 != count) || NULL == p_size || size > MAX_UINT32) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  *p_size = (NVM_UINT32)size;
+  if (NULL == p_buf) {
+    return NVM_SUCCESS;
+  }
+  if (buf_size < size) {
+    return NVM_ERR_BAD_SIZE;
+  }
+
+  ZeroMem(&header, sizeof(header));
+  header.magic = DEVICE_SNAPSHOT_MAGIC;
+  header.version = NVM_DEVICE_SNAPSHOT_VERSION;
+  header.snapshot_size = sizeof(*p_snapshots);
+  header.count = count;
+  header.checksum = snapshot_checksum(p_snapshots, size - sizeof(header));
+  CopyMem_S(p_buf, buf_size, &header, sizeof(header));
+  if (0 != count) {
+    CopyMem_S((NVM_UINT8 *)p_buf + sizeof(header), buf_size - sizeof(header), p_snapshots, size - sizeof(header));
+  }
+  return NVM_SUCCESS;
+}
+
+NVM_API int nvm_deserialize_device_snapshots(const void *p_buf, const NVM_UINT32 buf_size,
+  struct device_snapshot *p_snapshots, const NVM_UINT32 count, NVM_UINT32 *p_count)
+{
+  struct device_snapshot_header header;
+  NVM_UINT64 size;
+
+  if (NULL == p_buf || NULL == p_count || buf_size < sizeof(header)) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  CopyMem_S(&header, sizeof(header), p_buf, sizeof(header));
+  size = (NVM_UINT64)sizeof(*p_snapshots) * header.count;
+  if (header.magic != DEVICE_SNAPSHOT_MAGIC || header.version != NVM_DEVICE_SNAPSHOT_VERSION ||
+    header.snapshot_size != sizeof(*p_snapshots) || size > buf_size - sizeof(header)) {
+    NVDIMM_ERR("Not a snapshot buffer of this version\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (header.checksum != snapshot_checksum((const NVM_UINT8 *)p_buf + sizeof(header), size)) {
+    NVDIMM_ERR("Snapshot buffer checksum mismatch\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  *p_count = header.count;
+  if (NULL == p_snapshots) {
+    return NVM_SUCCESS;
+  }
+  if (count < header.count) {
+    return NVM_ERR_BAD_SIZE;
+  }
+  if (0 != header.count) {
+    CopyMem_S(p_snapshots, sizeof(*p_snapshots) * count, (const NVM_UINT8 *)p_buf + sizeof(header), size);
+  }
+  return NVM_SUCCESS;
+}
+
+/*
+ * Growth of a lifetime counter, a counter that went back was reset and counts from 0.
+ */
+static NVM_UINT64 counter_delta(NVM_UINT64 old_value, NVM_UINT64 new_value)
+{
+  return (new_value >= old_value) ? new_value - old_value : new_value;
+}
+
+/*
+ * Entries added to an error log, the 16 bit sequence numbers wrap.
+ */
+static NVM_UINT32 error_log_delta(const struct fw_error_log_sequence_numbers *p_old,
+  const struct fw_error_log_sequence_numbers *p_new)
+{
+  return (NVM_UINT16)(p_new->current - p_old->current);
+}
+
+NVM_API int nvm_diff_device_snapshots(const struct device_snapshot *p_old,
+  const struct device_snapshot *p_new, struct device_snapshot_diff *p_diff)
+{
+  int i;
+
+  if (NULL == p_old || NULL == p_new || NULL == p_diff) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (p_old->version != NVM_DEVICE_SNAPSHOT_VERSION || p_new->version != NVM_DEVICE_SNAPSHOT_VERSION ||
+    0 != AsciiStrnCmp(p_old->uid, p_new->uid, sizeof(p_old->uid))) {
+    NVDIMM_ERR("Snapshots of different devices or versions\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  ZeroMem(p_diff, sizeof(*p_diff));
+  p_diff->sections = p_old->sections & p_new->sections;
+  p_diff->interval = (NVM_INT64)(p_new->time - p_old->time);
+
+  if ((p_diff->sections & NVM_SNAPSHOT_IDENTITY) &&
+    0 != CompareMem(&p_old->discovery, &p_new->discovery, sizeof(p_old->discovery))) {
+    p_diff->changed_sections |= NVM_SNAPSHOT_IDENTITY;
+  }
+  if (p_diff->sections & NVM_SNAPSHOT_HEALTH) {
+    p_diff->health_changed = (p_old->status.health != p_new->status.health);
+    if (0 != CompareMem(&p_old->status, &p_new->status, sizeof(p_old->status))) {
+      p_diff->changed_sections |= NVM_SNAPSHOT_HEALTH;
+    }
+  }
+  if (p_diff->sections & NVM_SNAPSHOT_SENSORS) {
+    for (i = 0; i < NVM_MAX_DEVICE_SENSORS; ++i) {
+      p_diff->sensor_deltas[i] = (NVM_INT64)(p_new->sensors[i].reading - p_old->sensors[i].reading);
+      if (0 != p_diff->sensor_deltas[i] || p_old->sensors[i].current_state != p_new->sensors[i].current_state) {
+        p_diff->changed_sections |= NVM_SNAPSHOT_SENSORS;
+      }
+    }
+  }
+  if (p_diff->sections & NVM_SNAPSHOT_PERFORMANCE) {
+    p_diff->bytes_read = counter_delta(p_old->performance.bytes_read, p_new->performance.bytes_read);
+    p_diff->host_reads = counter_delta(p_old->performance.host_reads, p_new->performance.host_reads);
+    p_diff->bytes_written = counter_delta(p_old->performance.bytes_written, p_new->performance.bytes_written);
+    p_diff->host_writes = counter_delta(p_old->performance.host_writes, p_new->performance.host_writes);
+    if (0 != (p_diff->bytes_read | p_diff->host_reads | p_diff->bytes_written | p_diff->host_writes)) {
+      p_diff->changed_sections |= NVM_SNAPSHOT_PERFORMANCE;
+    }
+  }
+  if (p_diff->sections & NVM_SNAPSHOT_ERROR_LOG) {
+    p_diff->new_media_low_errors = error_log_delta(&p_old->error_log.media_low, &p_new->error_log.media_low);
+    p_diff->new_media_high_errors = error_log_delta(&p_old->error_log.media_high, &p_new->error_log.media_high);
+    p_diff->new_therm_low_errors = error_log_delta(&p_old->error_log.therm_low, &p_new->error_log.therm_low);
+    p_diff->new_therm_high_errors = error_log_delta(&p_old->error_log.therm_high, &p_new->error_log.therm_high);
+    if (0 != CompareMem(&p_old->error_log, &p_new->error_log, sizeof(p_old->error_log))) {
+      p_diff->changed_sections |= NVM_SNAPSHOT_ERROR_LOG;
+    }
+  }
+  if (p_diff->sections & NVM_SNAPSHOT_FW) {
+    p_diff->fw_changed = (0 != CompareMem(&p_old->fw_info, &p_new->fw_info, sizeof(p_old->fw_info)));
+    if (p_diff->fw_changed) {
+      p_diff->changed_sections |= NVM_SNAPSHOT_FW;
+    }
+  }
+  return NVM_SUCCESS;
+}
+
 NVM_API int nvm_get_number_of_regions( NVM_UINT8 *count)
 {
 	return nvm_get_number_of_regions_ex( TRUE, count);
@@ -1998,15 +2996,17 @@ NVM_API int nvm_create_config_goal(NVM_UID *p_device_uids, NVM_UINT32 device_uid
     device_uids_count = 0;
   }
 
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
+  }
+
   efi_rc = InitializeCommandStatus(&pCommandStatus);
   if (EFI_ERROR(efi_rc)) {
     return NVM_ERR_UNKNOWN;
   }
 
-  if (NVM_SUCCESS != (rc = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
-    goto Finish;
-  }
+  nvm_topology_w_lock();
 
   // If user passed DIMM uids, convert to id
   if (p_device_uids != NULL && device_uids_count > 0) {
@@ -2034,6 +3034,7 @@ NVM_API int nvm_create_config_goal(NVM_UID *p_device_uids, NVM_UINT32 device_uid
   if (EFI_ERROR(efi_rc))
     rc = NVM_ERR_UNKNOWN;
 Finish:
+  nvm_topology_w_unlock();
     FreeCommandStatus(&pCommandStatus);
     FREE_POOL_SAFE(p_dimm_ids);
   return rc;
@@ -2060,15 +3061,17 @@ NVM_API int nvm_get_config_goal(NVM_UID *p_device_uids, NVM_UINT32 device_uids_c
     device_uids_count = 0;
   }
 
-  efi_rc = InitializeCommandStatus(&pCommandStatus);
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
+  }
+
+  efi_rc = InitializeCommandStatus(&pCommandStatus);
   if (EFI_ERROR(efi_rc)) {
     return NVM_ERR_UNKNOWN;
   }
 
-  if (NVM_SUCCESS != (rc = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
-    goto Finish;
-  }
+  nvm_topology_r_lock();
 
   // If user passed DIMM uids, convert to id
   if (p_device_uids != NULL && device_uids_count > 0) {
@@ -2122,6 +3125,7 @@ NVM_API int nvm_get_config_goal(NVM_UID *p_device_uids, NVM_UINT32 device_uids_c
   }
 
 Finish:
+  nvm_topology_r_unlock();
     FreeCommandStatus(&pCommandStatus);
     FREE_POOL_SAFE(p_dimm_ids);
     FREE_POOL_SAFE(pRegionConfigsInfo);
@@ -2141,15 +3145,17 @@ NVM_API int nvm_delete_config_goal(NVM_UID *p_device_uids, NVM_UINT32 device_uid
     device_uids_count = 0;
   }
 
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
+  }
+
   efi_rc = InitializeCommandStatus(&pCommandStatus);
   if (EFI_ERROR(efi_rc)) {
     return NVM_ERR_UNKNOWN;
   }
 
-  if (NVM_SUCCESS != (rc = nvm_init())) {
-    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
-    goto Finish;
-  }
+  nvm_topology_w_lock();
 
   // If user passed DIMM uids, convert to id
   if (p_device_uids != NULL && device_uids_count > 0) {
@@ -2173,6 +3179,7 @@ NVM_API int nvm_delete_config_goal(NVM_UID *p_device_uids, NVM_UINT32 device_uid
   if (EFI_ERROR(efi_rc))
     rc = NVM_ERR_UNKNOWN;
 Finish:
+  nvm_topology_w_unlock();
     FreeCommandStatus(&pCommandStatus);
     FREE_POOL_SAFE(p_dimm_ids);
   return rc;
@@ -2231,10 +3238,11 @@ NVM_API int nvm_load_goal_config(const NVM_PATH file,
   }
   ReturnCode = InitializeCommandStatus(&p_command_status);
   if (EFI_ERROR(ReturnCode)) {
-    rc = NVM_ERR_UNKNOWN;
-    goto Finish;
+    return NVM_ERR_UNKNOWN;
   }
-  if (NVM_SUCCESS != nvm_get_number_of_devices(&dimm_count)) {
+
+  nvm_topology_w_lock();
+  if (NVM_SUCCESS != get_number_of_devices(&dimm_count)) {
     NVDIMM_ERR("Failed to get number of devices\n");
     rc = NVM_ERR_UNKNOWN;
     goto Finish;
@@ -2286,6 +3294,7 @@ NVM_API int nvm_load_goal_config(const NVM_PATH file,
     goto Finish;
   }
 Finish:
+  nvm_topology_w_unlock();
   FreeCommandStatus(&p_command_status);
   FREE_POOL_SAFE(pdimms);
   FREE_POOL_SAFE(p_dimm_ids);
@@ -2412,6 +3421,7 @@ NVM_API int nvm_gather_support(const NVM_PATH support_file, const NVM_SIZE suppo
     execute_cli_cmd(exec_commands[Index]);
   }
 
+  output_sink_flush();
   fclose(gOsShellParametersProtocol.StdOut);
   gOsShellParametersProtocol.StdOut = stdout;
 
@@ -2440,8 +3450,7 @@ NVM_API int nvm_inject_device_error(const NVM_UID		device_uid,
     NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
     goto Finish;
   }
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &DimmId, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, TRUE, &DimmId, NULL))) {
     goto Finish;
   }
 
@@ -2449,6 +3458,7 @@ NVM_API int nvm_inject_device_error(const NVM_UID		device_uid,
   ReturnCode = gNvmDimmDriverNvmDimmConfig.InjectError(&gNvmDimmDriverNvmDimmConfig, &DimmId, DimmCount,
                    (UINT8)p_error->type, ClearStatus, (UINT64 *)&p_error->temperature, (UINT64 *)&p_error->dpa,
                    (UINT8 *)&p_error->memory_type, (UINT8 *)&p_error->percentageRemaining, pCommandStatus);
+  nvm_topology_w_unlock();
 
   if (EFI_ERROR(ReturnCode))
     rc = NVM_ERR_UNKNOWN;
@@ -2479,8 +3489,7 @@ NVM_API int nvm_clear_injected_device_error(const NVM_UID device_uid,
     NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
     goto Finish;
   }
-  if (NVM_SUCCESS != (rc = get_dimm_id(device_uid, &DimmId, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id(device_uid, TRUE, &DimmId, NULL))) {
     goto Finish;
   }
 
@@ -2488,6 +3497,7 @@ NVM_API int nvm_clear_injected_device_error(const NVM_UID device_uid,
   ReturnCode = gNvmDimmDriverNvmDimmConfig.InjectError(&gNvmDimmDriverNvmDimmConfig, &DimmId, DimmCount,
                    (UINT8)p_error->type, ClearStatus, (UINT64 *)&p_error->temperature, (UINT64 *)&p_error->dpa,
                    (UINT8 *)&p_error->memory_type, (UINT8 *)&p_error->percentageRemaining, pCommandStatus);
+  nvm_topology_w_unlock();
 
   if (EFI_ERROR(ReturnCode))
     rc = NVM_ERR_UNKNOWN;
@@ -2497,6 +3507,31 @@ Finish:
   return rc;
 }
 
+/*
+ * Record the outcome of a diagnostic test in the event store.
+ */
+static void log_diagnostic_event(const NVM_UID device_uid, enum diagnostic_test test, const DIAG_INFO *p_result)
+{
+  static const enum event_type types[] = {
+    EVENT_TYPE_DIAG_QUICK, EVENT_TYPE_DIAG_PLATFORM_CONFIG, EVENT_TYPE_DIAG_SECURITY, EVENT_TYPE_DIAG_FW_CONSISTENCY
+  };
+  enum event_severity severity = EVENT_SEVERITY_INFO;
+  enum diagnostic_result result = DIAGNOSTIC_RESULT_OK;
+
+  if (p_result->StateVal & DIAG_STATE_MASK_ABORTED) {
+    severity = EVENT_SEVERITY_CRITICAL;
+    result = DIAGNOSTIC_RESULT_ABORTED;
+  } else if (p_result->StateVal & DIAG_STATE_MASK_FAILED) {
+    severity = EVENT_SEVERITY_CRITICAL;
+    result = DIAGNOSTIC_RESULT_FAILED;
+  } else if (p_result->StateVal & DIAG_STATE_MASK_WARNING) {
+    severity = EVENT_SEVERITY_WARN;
+    result = DIAGNOSTIC_RESULT_WARNING;
+  }
+  log_event(types[test], severity, (NVM_UINT16)(EVENT_CODE_DIAG_BASE + test), device_uid,
+    (NULL != p_result->Message) ? p_result->Message : p_result->State, result);
+}
+
 NVM_API int nvm_run_diagnostic(const NVM_UID device_uid,
              const struct diagnostic *p_diagnostic, NVM_UINT32 *p_results)
 {
@@ -2517,6 +3552,7 @@ NVM_API int nvm_run_diagnostic(const NVM_UID device_uid,
     return rc;
   }
 
+  nvm_topology_r_lock();
   if (NULL == device_uid) {
     dimm_count = 0;
     p_dimm_id = NULL;
@@ -2551,6 +3587,9 @@ NVM_API int nvm_run_diagnostic(const NVM_UID device_uid,
     DISPLAY_DIMM_ID_UID,
     &pFinalDiagnosticsResult);
 
+  if (NULL != pFinalDiagnosticsResult) {
+    log_diagnostic_event(device_uid, p_diagnostic->test, pFinalDiagnosticsResult);
+  }
   pFinalDiagnosticsResultStr = DiagnosticResultToStr(pFinalDiagnosticsResult);
   Print(FORMAT_STR, pFinalDiagnosticsResultStr);
   FreePool(pFinalDiagnosticsResult);
@@ -2559,6 +3598,7 @@ NVM_API int nvm_run_diagnostic(const NVM_UID device_uid,
     rc = NVM_ERR_UNKNOWN;
 
 Finish:
+  nvm_topology_r_unlock();
   return rc;
 }
 
@@ -2608,12 +3648,12 @@ NVM_API int nvm_clear_dimm_lsa(const NVM_UID device_uid)
   ReturnCode = InitializeCommandStatus(&p_command_status);
   if (EFI_ERROR(ReturnCode))
     return NVM_ERR_UNKNOWN;
-  if (NVM_SUCCESS != (nvm_status = get_dimm_id((char *)device_uid, &dimm_id, NULL))) {
+  if (NVM_SUCCESS != (nvm_status = lock_dimm_id((char *)device_uid, TRUE, &dimm_id, NULL))) {
     FreeCommandStatus(&p_command_status);
-    NVDIMM_ERR("Failed to get dimm ID %d\n", nvm_status);
     return NVM_ERR_DIMM_NOT_FOUND;
   }
   ReturnCode = gNvmDimmDriverNvmDimmConfig.ModifyPcdConfig(&gNvmDimmDriverNvmDimmConfig, &dimm_id, 1, DELETE_PCD_CONFIG_LSA_MASK, p_command_status);
+  nvm_topology_w_unlock();
   if (EFI_ERROR(ReturnCode)) {
     FreeCommandStatus(&p_command_status);
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
@@ -2654,6 +3694,16 @@ NVM_API int nvm_toggle_debug_logging(const NVM_BOOL enabled)
   return DebugLoggerEnable(enabled);
 }
 
+NVM_API int nvm_get_passthrough_count(NVM_UINT64 *p_count)
+{
+  if (NULL == p_count) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  *p_count = get_passthru_count();
+  return NVM_SUCCESS;
+}
+
 NVM_API int nvm_get_jobs(struct job *p_jobs, const NVM_UINT32 count)
 {
   EFI_STATUS ReturnCode = EFI_SUCCESS;
@@ -2676,20 +3726,24 @@ NVM_API int nvm_get_jobs(struct job *p_jobs, const NVM_UINT32 count)
   }
 
   unsigned int actual_count = 0;
-  if (NVM_SUCCESS != (nvm_status = nvm_get_number_of_devices(&actual_count)))
+  nvm_topology_r_lock();
+  if (NVM_SUCCESS != (nvm_status = get_number_of_devices(&actual_count)))
   {
     NVDIMM_ERR("Failed to obtain the number of devices (%d)\n",nvm_status);
-    return NVM_ERR_OPERATION_FAILED;
+    rc = NVM_ERR_OPERATION_FAILED;
+    goto Finish;
   }
 
   if(count != actual_count)
   {
-    return NVM_ERR_BAD_SIZE;
+    rc = NVM_ERR_BAD_SIZE;
+    goto Finish;
   }
 
   if (NULL == (cmd = (FW_CMD *)AllocatePool(sizeof(FW_CMD)))) {
     NVDIMM_ERR("Failed to allocate memory\n");
-    return NVM_ERR_NOT_ENOUGH_FREE_SPACE;
+    rc = NVM_ERR_NOT_ENOUGH_FREE_SPACE;
+    goto Finish;
   }
 
   ZeroMem(cmd, sizeof(FW_CMD));
@@ -2699,8 +3753,8 @@ NVM_API int nvm_get_jobs(struct job *p_jobs, const NVM_UINT32 count)
   ReturnCode = GetDimmList(&gNvmDimmDriverNvmDimmConfig, &CmdStub, DIMM_INFO_CATEGORY_NONE, &pDimms, &DimmCount);
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR("Failed to get dimm list %d\n", (int)ReturnCode);
-    FreePool(cmd);
-    return NVM_ERR_OPERATION_FAILED;
+    rc = NVM_ERR_OPERATION_FAILED;
+    goto Finish;
   }
 
   for (i = 0; i < DimmCount; ++i) {
@@ -2754,8 +3808,12 @@ NVM_API int nvm_get_jobs(struct job *p_jobs, const NVM_UINT32 count)
     p_jobs[i].result = NULL;
     job_index++;
   }
-  FreePool(cmd);
-  return NVM_SUCCESS;
+
+Finish:
+  nvm_topology_r_unlock();
+  FREE_POOL_SAFE(cmd);
+  FREE_POOL_SAFE(pDimms);
+  return rc;
 }
 
 NVM_API int nvm_create_context()
@@ -2809,8 +3867,7 @@ NVM_API int nvm_get_fw_error_log_entry_cmd(
     goto Finish;
   }
 
-  if (NVM_SUCCESS != (rc = get_dimm_id((char *)device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
+  if (NVM_SUCCESS != (rc = lock_dimm_id((char *)device_uid, FALSE, &dimm_id, NULL))) {
     goto Finish;
   }
 
@@ -2826,6 +3883,7 @@ NVM_API int nvm_get_fw_error_log_entry_cmd(
     &max_errors,
     (ERROR_LOG_INFO *)error_entry,
     pCommandStatus);
+  nvm_topology_r_unlock();
 
   if (EFI_ERROR(ReturnCode)) {
     NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
@@ -2857,11 +3915,48 @@ NVM_API int nvm_get_config_int(const char *param_name, int default_val)
   return val;
 }
 
+/*
+ * Read the sequence numbers of the four error logs of a DCPMM. All logs are
+ * read when one fails, the first failure is returned.
+ */
+static int get_device_error_log_status(const unsigned int dimm_id,
+  struct device_error_log_status *error_log_stats)
+{
+  static const struct
+  {
+    unsigned char log_level;
+    unsigned char log_type;
+    size_t offset;
+  } logs[] =
+  {
+    { ErrorLogLowPriority,  ErrorLogTypeMedia,   offsetof(struct device_error_log_status, media_low) },
+    { ErrorLogHighPriority, ErrorLogTypeMedia,   offsetof(struct device_error_log_status, media_high) },
+    { ErrorLogLowPriority,  ErrorLogTypeThermal, offsetof(struct device_error_log_status, therm_low) },
+    { ErrorLogHighPriority, ErrorLogTypeThermal, offsetof(struct device_error_log_status, therm_high) },
+  };
+  struct fw_error_log_sequence_numbers *p_seq;
+  LOG_INFO_DATA_RETURN get_error_log_output;
+  NVM_UINT32 i;
+  int log_rc;
+  int rc = NVM_SUCCESS;
+
+  for (i = 0; i < sizeof(logs) / sizeof(logs[0]); ++i) {
+    ZeroMem(&get_error_log_output, sizeof(get_error_log_output));
+    log_rc = get_fw_err_log_stats(dimm_id, logs[i].log_level, logs[i].log_type, &get_error_log_output);
+    if (NVM_SUCCESS == rc) {
+      rc = log_rc;
+    }
+    p_seq = (struct fw_error_log_sequence_numbers *)((NVM_UINT8 *)error_log_stats + logs[i].offset);
+    p_seq->oldest = get_error_log_output.OldestSequenceNum;
+    p_seq->current = get_error_log_output.CurrentSequenceNum;
+  }
+  return rc;
+}
+
 NVM_API int nvm_get_fw_err_log_stats(const NVM_UID      device_uid,
              struct device_error_log_status * error_log_stats)
 {
   UINT16 dimm_id;
-  LOG_INFO_DATA_RETURN get_error_log_output;
   int rc = NVM_SUCCESS;
 
   if (NVM_SUCCESS != (rc = nvm_init())) {
@@ -2869,40 +3964,10 @@ NVM_API int nvm_get_fw_err_log_stats(const NVM_UID      device_uid,
     return rc;
   }
 
-  if (NVM_SUCCESS != (rc = get_dimm_id((char *)device_uid, &dimm_id, NULL))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
-  } else {
-    get_fw_err_log_stats(
-      dimm_id,
-      ErrorLogLowPriority,
-      ErrorLogTypeMedia,
-      &get_error_log_output);
-    error_log_stats->media_low.oldest = get_error_log_output.OldestSequenceNum;
-    error_log_stats->media_low.current = get_error_log_output.CurrentSequenceNum;
-
-    get_fw_err_log_stats(
-      dimm_id,
-      ErrorLogHighPriority,
-      ErrorLogTypeMedia,
-      &get_error_log_output);
-    error_log_stats->media_high.oldest = get_error_log_output.OldestSequenceNum;
-    error_log_stats->media_high.current = get_error_log_output.CurrentSequenceNum;
-
-    get_fw_err_log_stats(
-      dimm_id,
-      ErrorLogLowPriority,
-      ErrorLogTypeThermal,
-      &get_error_log_output);
-    error_log_stats->therm_low.oldest = get_error_log_output.OldestSequenceNum;
-    error_log_stats->therm_low.current = get_error_log_output.CurrentSequenceNum;
-
-    get_fw_err_log_stats(
-      dimm_id,
-      ErrorLogHighPriority,
-      ErrorLogTypeThermal,
-      &get_error_log_output);
-    error_log_stats->therm_high.oldest = get_error_log_output.OldestSequenceNum;
-    error_log_stats->therm_high.current = get_error_log_output.CurrentSequenceNum;
+  if (NVM_SUCCESS == (rc = lock_dimm_id((char *)device_uid, FALSE, &dimm_id, NULL))) {
+    // A log that cannot be read does not fail the call
+    get_device_error_log_status(dimm_id, error_log_stats);
+    nvm_topology_r_unlock();
   }
   return rc;
 }
@@ -2917,48 +3982,172 @@ NVM_API int nvm_get_dimm_id(const NVM_UID device_uid,
     NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
     return rc;
   }
+  nvm_topology_r_lock();
   rc = get_dimm_id((char *)device_uid, (UINT16 *)dimm_id, dimm_handle);
+  nvm_topology_r_unlock();
   return rc;
 }
 
-int get_dimm_id(const char *uid, UINT16 *dimm_id, unsigned int *dimm_handle)
+/*
+ * UID lookup index of get_dimm_id(), an open addressing table hashed on the
+ * ASCII UID. It is built from one GetDimms enumeration and rebuilt once the
+ * driver DIMM inventory generation changes. DIMM ID and device handle lookups
+ * go through the index of the driver, see GetDimmByPid.
+ */
+struct dimm_index_entry
 {
-  EFI_STATUS rc;
-  CHAR16 uid_wide[MAX_DIMM_UID_LENGTH];
-  unsigned int i;
+  char uid[MAX_DIMM_UID_LENGTH];
+  UINT16 dimm_id;
+  unsigned int dimm_handle;
+};
 
-  if (NULL == g_dimms) {
-    if (NVM_SUCCESS != nvm_get_number_of_devices(&g_dimm_cnt)) {
-      NVDIMM_ERR("Failed to get number of devices\n");
-      return NVM_ERR_UNKNOWN;
+struct dimm_index
+{
+  UINT32 generation;                    // inventory generation the index was built for
+  NVM_UINT32 mask;                      // slots minus one, the slot count is a power of two
+  NVM_UINT32 count;
+  struct dimm_index_entry *p_entries;
+  NVM_UINT32 *p_slots;                  // entry index + 1, 0 for an empty slot
+};
+
+#define DIMM_INDEX_MIN_SLOTS 16
+
+static struct dimm_index g_dimm_index;
+
+static NVM_UINT32 dimm_uid_hash(const char *uid)
+{
+  NVM_UINT32 hash = 2166136261u;
+
+  while (*uid) {
+    hash = (hash ^ (unsigned char)*uid++) * 16777619u;
+  }
+  return hash;
+}
+
+static void free_dimm_index()
+{
+  FREE_POOL_SAFE(g_dimm_index.p_entries);
+  FREE_POOL_SAFE(g_dimm_index.p_slots);
+  ZeroMem(&g_dimm_index, sizeof(g_dimm_index));
+}
+
+/*
+ * Slot of uid, the empty slot it belongs in when the index does not hold it.
+ */
+static NVM_UINT32 dimm_index_slot(const char *uid)
+{
+  NVM_UINT32 slot = dimm_uid_hash(uid) & g_dimm_index.mask;
+
+  while (0 != g_dimm_index.p_slots[slot] &&
+    0 != AsciiStrCmp(uid, g_dimm_index.p_entries[g_dimm_index.p_slots[slot] - 1].uid)) {
+    slot = (slot + 1) & g_dimm_index.mask;
+  }
+  return slot;
+}
+
+static int build_dimm_index()
+{
+  EFI_STATUS ReturnCode;
+  DIMM_INFO *p_dimms = NULL;
+  struct dimm_index_entry *p_entry;
+  unsigned int dimm_cnt = 0;
+  NVM_UINT32 slots = DIMM_INDEX_MIN_SLOTS;
+  NVM_UINT32 slot;
+  NVM_UINT32 i;
+  int rc = NVM_SUCCESS;
+
+  free_dimm_index();
+  if (NVM_SUCCESS != get_number_of_devices(&dimm_cnt)) {
+    NVDIMM_ERR("Failed to get number of devices\n");
+    return NVM_ERR_UNKNOWN;
+  }
+  // Keep the table at most half full so probe sequences stay short
+  while (slots < dimm_cnt * 2) {
+    slots <<= 1;
+  }
+  p_dimms = (DIMM_INFO *)AllocatePool(sizeof(DIMM_INFO) * (dimm_cnt ? dimm_cnt : 1));
+  g_dimm_index.p_entries = (struct dimm_index_entry *)AllocateZeroPool(sizeof(struct dimm_index_entry) * (dimm_cnt ? dimm_cnt : 1));
+  g_dimm_index.p_slots = (NVM_UINT32 *)AllocateZeroPool(sizeof(NVM_UINT32) * slots);
+  if (NULL == p_dimms || NULL == g_dimm_index.p_entries || NULL == g_dimm_index.p_slots) {
+    NVDIMM_ERR("Failed to allocate memory\n");
+    rc = NVM_ERR_NO_MEM;
+    goto Finish;
+  }
+  if (0 != dimm_cnt) {
+    ReturnCode = gNvmDimmDriverNvmDimmConfig.GetDimms(&gNvmDimmDriverNvmDimmConfig, (UINT32)dimm_cnt, DIMM_INFO_CATEGORY_NONE, p_dimms);
+    if (EFI_ERROR(ReturnCode)) {
+      NVDIMM_ERR("GetDimms failed (%d)\n", ReturnCode);
+      rc = NVM_ERR_UNKNOWN;
+      goto Finish;
     }
+  }
 
-    g_dimms = (DIMM_INFO *)AllocatePool(sizeof(DIMM_INFO) * g_dimm_cnt);
-    if (NULL == g_dimms) {
-      NVDIMM_ERR("Failed to allocate memory\n");
-      return NVM_ERR_UNKNOWN;
+  g_dimm_index.mask = slots - 1;
+  for (i = 0; i < dimm_cnt; ++i) {
+    p_entry = &g_dimm_index.p_entries[g_dimm_index.count];
+    UnicodeStrToAsciiStrS(p_dimms[i].DimmUid, p_entry->uid, sizeof(p_entry->uid));
+    // The first DCPMM reported keeps a UID, as the list scan did
+    slot = dimm_index_slot(p_entry->uid);
+    if (0 != g_dimm_index.p_slots[slot]) {
+      continue;
     }
+    p_entry->dimm_id = p_dimms[i].DimmID;
+    p_entry->dimm_handle = p_dimms[i].DimmHandle;
+    g_dimm_index.p_slots[slot] = ++g_dimm_index.count;
+  }
+  g_dimm_index.generation = GetDimmInventoryGeneration();
+
+Finish:
+  FREE_POOL_SAFE(p_dimms);
+  if (NVM_SUCCESS != rc) {
+    free_dimm_index();
+  }
+  return rc;
+}
+
+int get_dimm_id(const char *uid, UINT16 *dimm_id, unsigned int *dimm_handle)
+{
+  OS_RWLOCK *p_lock = os_rwlock_get_static(&g_dimm_index_lock);
+  struct dimm_index_entry *p_entry;
+  NVM_UINT32 slot;
+  int rc = NVM_SUCCESS;
 
-    rc = gNvmDimmDriverNvmDimmConfig.GetDimms(&gNvmDimmDriverNvmDimmConfig, (UINT32)g_dimm_cnt, DIMM_INFO_CATEGORY_NONE, g_dimms);
-    if (EFI_ERROR(rc)) {
-      FreePool(g_dimms);
-      g_dimms = NULL;
-      NVDIMM_ERR("GetDimms failed (%d)\n", rc);
+  if (NULL == uid) {
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NULL == p_lock) {
+    return NVM_ERR_NO_MEM;
+  }
+
+  // Lookups share the index, the first one after the inventory changed rebuilds it
+  os_rwlock_r_lock(p_lock);
+  while (NULL == g_dimm_index.p_slots || g_dimm_index.generation != GetDimmInventoryGeneration()) {
+    os_rwlock_r_unlock(p_lock);
+    os_rwlock_w_lock(p_lock);
+    if (NULL == g_dimm_index.p_slots || g_dimm_index.generation != GetDimmInventoryGeneration()) {
+      rc = build_dimm_index();
+    }
+    os_rwlock_w_unlock(p_lock);
+    if (NVM_SUCCESS != rc) {
       return NVM_ERR_UNKNOWN;
     }
+    os_rwlock_r_lock(p_lock);
   }
 
-  AsciiStrToUnicodeStr(uid, uid_wide);
-  for (i = 0; i < g_dimm_cnt; ++i) {
-    if (0 == StrCmp(uid_wide, g_dimms[i].DimmUid)) {
-      if (dimm_id)
-        *dimm_id = g_dimms[i].DimmID;
-      if (dimm_handle)
-        *dimm_handle = g_dimms[i].DimmHandle;
-      return NVM_SUCCESS;
-    }
+  slot = dimm_index_slot(uid);
+  if (0 == g_dimm_index.p_slots[slot]) {
+    rc = NVM_ERR_UNKNOWN;
+    goto Finish;
   }
-  return NVM_ERR_UNKNOWN;
+  p_entry = &g_dimm_index.p_entries[g_dimm_index.p_slots[slot] - 1];
+  if (dimm_id)
+    *dimm_id = p_entry->dimm_id;
+  if (dimm_handle)
+    *dimm_handle = p_entry->dimm_handle;
+
+Finish:
+  os_rwlock_r_unlock(p_lock);
+  return rc;
 }
 
 void dimm_info_to_device_discovery(DIMM_INFO *p_dimm, struct device_discovery *p_device)
@@ -3043,6 +4232,7 @@ finish:
 NVM_API int nvm_send_device_passthrough_cmd(const NVM_UID   device_uid,
               struct device_pt_cmd *  p_cmd)
 {
+  EFI_STATUS ReturnCode;
   FW_CMD *cmd = NULL;
   UINT16 dimm_id;
   unsigned int dimm_handle;
@@ -3078,12 +4268,6 @@ NVM_API int nvm_send_device_passthrough_cmd(const NVM_UID   device_uid,
 
   ZeroMem(cmd, sizeof(FW_CMD));
 
-  if (NVM_SUCCESS != (rc = get_dimm_id((char *)device_uid, &dimm_id, &dimm_handle))) {
-    NVDIMM_ERR("Failed to get dimm ID %d\n", rc);
-    goto finish;
-  }
-
-  cmd->DimmID = dimm_id; //PassThruCommand needs the dimm_id (not handle)
   cmd->Opcode = p_cmd->opcode;
   cmd->SubOpcode = p_cmd->sub_opcode;
   cmd->InputPayloadSize = p_cmd->input_payload_size;
@@ -3091,16 +4275,30 @@ NVM_API int nvm_send_device_passthrough_cmd(const NVM_UID   device_uid,
   cmd->OutputPayloadSize = p_cmd->output_payload_size;
   cmd->LargeInputPayloadSize = p_cmd->large_input_payload_size;
   cmd->LargeOutputPayloadSize = p_cmd->large_output_payload_size;
-  CopyMem_S(cmd->LargeInputPayload, sizeof(cmd->LargeInputPayload), p_cmd->large_input_payload, cmd->LargeInputPayloadSize);
+  if (EFI_SUCCESS != AllocateFwCmdLargePayloads(cmd)) {
+    NVDIMM_ERR("Failed to allocate large payload memory\n");
+    rc = NVM_ERR_NO_MEM;
+    goto finish;
+  }
+  if (cmd->LargeInputPayloadSize) {
+    CopyMem_S(cmd->LargeInputPayload, cmd->LargeInputPayloadSize, p_cmd->large_input_payload, cmd->LargeInputPayloadSize);
+  }
 
-  if (EFI_SUCCESS != PassThruCommand(cmd, PT_TIMEOUT_INTERVAL))
+  // Any command may change the DCPMM, send it exclusively
+  if (NVM_SUCCESS != (rc = lock_dimm_id((char *)device_uid, TRUE, &dimm_id, &dimm_handle))) {
+    goto finish;
+  }
+  cmd->DimmID = dimm_id; //PassThruCommand needs the dimm_id (not handle)
+  ReturnCode = PassThruCommand(cmd, PT_TIMEOUT_INTERVAL);
+  nvm_topology_w_unlock();
+  if (EFI_SUCCESS != ReturnCode)
   {
-    NVDIMM_ERR("Passthru command failed\n");
+    NVDIMM_ERR("Passthru command failed after %d attempts in %lld us\n", cmd->Attempts, cmd->ElapsedUs);
     goto finish;
   }
   else
   {
-    NVDIMM_DBG("Passthru command executed successfully\n");
+    NVDIMM_DBG("Passthru command executed successfully, %d attempts in %lld us\n", cmd->Attempts, cmd->ElapsedUs);
     rc = NVM_SUCCESS;
   }
 
@@ -3129,6 +4327,398 @@ NVM_API int nvm_send_device_passthrough_cmd(const NVM_UID   device_uid,
     p_cmd->output_payload_size = cmd->OutputPayloadSize;
   }
 finish:
-  FREE_POOL_SAFE(cmd);
+  FREE_FW_CMD_SAFE(cmd);
+  return rc;
+}
+
+/*
+ * Health monitor handed out by nvm_create_health_monitor, with the UID of every
+ * registered DCPMM so that events can be reported without querying the driver.
+ */
+struct nvm_health_monitor
+{
+  OS_HEALTH_MONITOR *p_os_monitor;
+  NVM_UINT32 device_count;
+  struct {
+    NVM_UINT32 handle;
+    NVM_UID uid;
+  } devices[];
+};
+
+/*
+ * Report a DCPMM the health monitor does not watch, so that a monitor covering
+ * only part of the system is visible in the debug log and the event log.
+ */
+static void report_unmonitored_device(NVM_UINT32 handle, CHAR16 *p_dimm_uid)
+{
+  NVM_UID uid;
+
+  ZeroMem(uid, sizeof(uid));
+  UnicodeStrToAsciiStrS(p_dimm_uid, uid, sizeof(uid));
+  NVDIMM_WARN("DIMM 0x%x is not monitored for health events\n", handle);
+  log_event(EVENT_TYPE_HEALTH, EVENT_SEVERITY_WARN, EVENT_CODE_HEALTH_UNMONITORED, uid,
+    L"DCPMM is not monitored for health events", DIAGNOSTIC_RESULT_UNKNOWN);
+}
+
+NVM_API int nvm_create_health_monitor(void **pp_monitor)
+{
+  EFI_STATUS ReturnCode = EFI_SUCCESS;
+  struct nvm_health_monitor *p_monitor = NULL;
+  DIMM_INFO *p_dimms = NULL;
+  unsigned int dimm_cnt = 0;
+  UINT32 uninit_cnt = 0;
+  unsigned int i;
+  int add_rc = NVM_SUCCESS;
+  int rc;
+
+  if (NULL == pp_monitor) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  *pp_monitor = NULL;
+
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
+  }
+
+  nvm_topology_r_lock();
+  if (NVM_SUCCESS != (rc = get_number_of_devices(&dimm_cnt))) {
+    NVDIMM_ERR("Failed to obtain the number of devices (%d)\n", rc);
+    goto Finish;
+  }
+  ReturnCode = gNvmDimmDriverNvmDimmConfig.GetUninitializedDimmCount(&gNvmDimmDriverNvmDimmConfig, &uninit_cnt);
+  if (EFI_ERROR(ReturnCode)) {
+    // Only used to report the DCPMMs left out, the monitor works without it
+    NVDIMM_WARN("Failed to obtain the number of non-functional devices\n");
+    uninit_cnt = 0;
+  }
+
+  p_monitor = (struct nvm_health_monitor *)AllocateZeroPool(sizeof(struct nvm_health_monitor) +
+    dimm_cnt * sizeof(p_monitor->devices[0]));
+  p_dimms = (DIMM_INFO *)AllocatePool(sizeof(DIMM_INFO) * (dimm_cnt + uninit_cnt ? dimm_cnt + uninit_cnt : 1));
+  if (NULL == p_monitor || NULL == p_dimms) {
+    NVDIMM_ERR("Failed to allocate memory\n");
+    rc = NVM_ERR_NO_MEM;
+    goto Finish;
+  }
+
+  ReturnCode = gNvmDimmDriverNvmDimmConfig.GetDimms(&gNvmDimmDriverNvmDimmConfig, (UINT32)dimm_cnt, DIMM_INFO_CATEGORY_NONE, p_dimms);
+  if (EFI_ERROR(ReturnCode)) {
+    NVDIMM_ERR_W(FORMAT_STR_NL, CLI_ERR_INTERNAL_ERROR);
+    rc = NVM_ERR_UNKNOWN;
+    goto Finish;
+  }
+
+  if (NVM_SUCCESS != (rc = os_health_monitor_create(&p_monitor->p_os_monitor))) {
+    NVDIMM_ERR("Failed to create the health monitor (%d)\n", rc);
+    goto Finish;
+  }
+
+  // A DCPMM that cannot be watched is reported and left out, the others are still monitored
+  for (i = 0; i < dimm_cnt; ++i) {
+    if (MANAGEMENT_VALID_CONFIG != p_dimms[i].ManageabilityState) {
+      report_unmonitored_device(p_dimms[i].DimmHandle, p_dimms[i].DimmUid);
+      continue;
+    }
+    if (NVM_SUCCESS != (rc = os_health_monitor_add(p_monitor->p_os_monitor, p_dimms[i].DimmHandle,
+      DIMM_ACPI_EVENT_SMART_HEALTH_MASK))) {
+      NVDIMM_ERR("Failed to monitor DIMM 0x%x (%d)\n", p_dimms[i].DimmHandle, rc);
+      report_unmonitored_device(p_dimms[i].DimmHandle, p_dimms[i].DimmUid);
+      add_rc = rc;
+      continue;
+    }
+    p_monitor->devices[p_monitor->device_count].handle = p_dimms[i].DimmHandle;
+    UnicodeStrToAsciiStrS(p_dimms[i].DimmUid, p_monitor->devices[p_monitor->device_count].uid,
+      sizeof(p_monitor->devices[0].uid));
+    p_monitor->device_count++;
+  }
+
+  if (0 != uninit_cnt && !EFI_ERROR(gNvmDimmDriverNvmDimmConfig.GetUninitializedDimms(
+    &gNvmDimmDriverNvmDimmConfig, uninit_cnt, p_dimms + dimm_cnt))) {
+    for (i = 0; i < uninit_cnt; ++i) {
+      report_unmonitored_device(p_dimms[dimm_cnt + i].DimmHandle, p_dimms[dimm_cnt + i].DimmUid);
+    }
+  }
+
+  // Fail only when DCPMMs could not be added and none could
+  if (0 == p_monitor->device_count && NVM_SUCCESS != add_rc) {
+    rc = add_rc;
+    goto Finish;
+  }
+
+  *pp_monitor = p_monitor;
+  p_monitor = NULL;
+  rc = NVM_SUCCESS;
+
+Finish:
+  nvm_topology_r_unlock();
+  nvm_free_health_monitor(p_monitor);
+  FREE_POOL_SAFE(p_dimms);
+  return rc;
+}
+
+NVM_API int nvm_wait_for_health_events(void *p_monitor, const int timeout_sec,
+  struct device_health_event *p_events, NVM_UINT32 *p_count)
+{
+  struct nvm_health_monitor *p_mon = (struct nvm_health_monitor *)p_monitor;
+  struct os_health_event os_events[64];
+  unsigned int os_event_cnt = 0;
+  unsigned int max_events;
+  NVM_UINT32 event_cnt = 0;
+  unsigned int i;
+  unsigned int j;
+  int rc;
+
+  if (NULL == p_mon || NULL == p_events || NULL == p_count || 0 == *p_count) {
+    NVDIMM_ERR("Invalid input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  // Only SMART health events are signalled, one entry per DCPMM that fired
+  max_events = (*p_count < ARRAY_SIZE(os_events)) ? *p_count : ARRAY_SIZE(os_events);
+  if (NVM_SUCCESS != (rc = os_health_monitor_wait(p_mon->p_os_monitor, timeout_sec, os_events, max_events, &os_event_cnt))) {
+    *p_count = 0;
+    return rc;
+  }
+
+  for (i = 0; i < os_event_cnt && event_cnt < *p_count; ++i) {
+    ZeroMem(&p_events[event_cnt], sizeof(p_events[event_cnt]));
+    p_events[event_cnt].device_handle.handle = os_events[i].dimm_handle;
+    p_events[event_cnt].event_type = ACPI_SMART_HEALTH;
+    for (j = 0; j < p_mon->device_count; ++j) {
+      if (p_mon->devices[j].handle == os_events[i].dimm_handle) {
+        CopyMem_S(p_events[event_cnt].device_uid, sizeof(p_events[event_cnt].device_uid),
+          p_mon->devices[j].uid, sizeof(p_mon->devices[j].uid));
+        break;
+      }
+    }
+    log_event(EVENT_TYPE_HEALTH, EVENT_SEVERITY_WARN, (NVM_UINT16)(EVENT_CODE_HEALTH_BASE + ACPI_SMART_HEALTH),
+      p_events[event_cnt].device_uid, L"DCPMM signalled a SMART health event", DIAGNOSTIC_RESULT_UNKNOWN);
+    event_cnt++;
+  }
+  *p_count = event_cnt;
+  return NVM_SUCCESS;
+}
+
+NVM_API int nvm_dispatch_health_events(void *p_monitor, const int timeout_sec,
+  nvm_health_event_callback callback, void *p_context)
+{
+  struct device_health_event events[64];
+  NVM_UINT32 event_cnt = ARRAY_SIZE(events);
+  NVM_UINT32 i;
+  int rc;
+
+  if (NULL == callback) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+
+  if (NVM_SUCCESS != (rc = nvm_wait_for_health_events(p_monitor, timeout_sec, events, &event_cnt))) {
+    return rc;
+  }
+  for (i = 0; i < event_cnt; ++i) {
+    callback(&events[i], p_context);
+  }
+  return NVM_SUCCESS;
+}
+
+NVM_API int nvm_free_health_monitor(void *p_monitor)
+{
+  struct nvm_health_monitor *p_mon = (struct nvm_health_monitor *)p_monitor;
+
+  if (NULL != p_mon) {
+    os_health_monitor_free(p_mon->p_os_monitor);
+    FreePool(p_mon);
+  }
+  return NVM_SUCCESS;
+}
+
+/*
+ * Open the event store, unless another thread already did.
+ */
+static int open_event_store(OS_RWLOCK *p_lock)
+{
+  EFI_GUID g = { 0x0, 0x0, 0x0, { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 } };
+  OS_PATH dir;
+  OS_PATH path;
+  int max_rows;
+  int rc = NVM_SUCCESS;
+
+  os_rwlock_w_lock(p_lock);
+  if (NULL != g_event_store) {
+    goto Finish;
+  }
+  ZeroMem(dir, sizeof(dir));
+  if (EFI_ERROR(preferences_get_string_ascii("TEMP_FILE_PATH", g, sizeof(dir) - 1, dir)) || '\0' == dir[0]) {
+    NVDIMM_ERR("Failed to get the event store directory\n");
+    rc = NVM_ERR_UNKNOWN;
+    goto Finish;
+  }
+  max_rows = nvm_get_config_int("EVENT_LOG_MAX_ROWS", EVENT_STORE_DEFAULT_ROWS);
+  if (max_rows <= 0 || max_rows > EVENT_STORE_MAX_ROWS) {
+    max_rows = EVENT_STORE_DEFAULT_ROWS;
+  }
+  AsciiSPrint(path, sizeof(path), "%s%s", dir, EVENT_STORE_FILE_NAME);
+  if (NVM_SUCCESS != (rc = event_store_open(path, (NVM_UINT32)max_rows, &g_event_store))) {
+    NVDIMM_ERR("Failed to open the event store %s (%d)\n", path, rc);
+  }
+Finish:
+  os_rwlock_w_unlock(p_lock);
+  return rc;
+}
+
+/*
+ * The event store is opened on first use, in TEMP_FILE_PATH. On success the
+ * event store lock stays held shared until the caller calls put_event_store().
+ * Does not initialize the library, so events can be logged while the topology
+ * lock is held.
+ */
+static int lock_event_store(struct event_store **pp_store)
+{
+  OS_RWLOCK *p_lock = os_rwlock_get_static(&g_event_store_lock);
+  int rc;
+
+  if (NULL == p_lock) {
+    return NVM_ERR_NO_MEM;
+  }
+  os_rwlock_r_lock(p_lock);
+  while (NULL == g_event_store) {
+    os_rwlock_r_unlock(p_lock);
+    if (NVM_SUCCESS != (rc = open_event_store(p_lock))) {
+      return rc;
+    }
+    os_rwlock_r_lock(p_lock);
+  }
+  *pp_store = g_event_store;
+  return NVM_SUCCESS;
+}
+
+static int get_event_store(struct event_store **pp_store)
+{
+  int rc;
+
+  if (NVM_SUCCESS != (rc = nvm_init())) {
+    NVDIMM_ERR("Failed to intialize nvm library %d\n", rc);
+    return rc;
+  }
+  return lock_event_store(pp_store);
+}
+
+static void put_event_store()
+{
+  os_rwlock_r_unlock(g_event_store_lock);
+}
+
+/*
+ * Append an event to the event store. Logging is best effort, a failure
+ * never fails the operation that raised the event.
+ */
+static void log_event(enum event_type type, enum event_severity severity, NVM_UINT16 code,
+  const char *p_uid, const CHAR16 *p_message, enum diagnostic_result diag_result)
+{
+  struct event_store *p_store = NULL;
+  struct event *p_event = NULL;
+
+  if (NULL == (p_event = (struct event *)AllocateZeroPool(sizeof(*p_event)))) {
+    return;
+  }
+  p_event->type = type;
+  p_event->severity = severity;
+  p_event->code = code;
+  p_event->time = time(NULL);
+  p_event->diag_result = diag_result;
+  if (NULL != p_uid) {
+    AsciiStrnCpyS(p_event->uid, sizeof(p_event->uid), p_uid, sizeof(p_event->uid) - 1);
+  }
+  if (NULL != p_message) {
+    UnicodeStrToAsciiStrS(p_message, p_event->message, sizeof(p_event->message));
+  }
+  if (NVM_SUCCESS == lock_event_store(&p_store)) {
+    if (NVM_SUCCESS != event_store_append(p_store, p_event, NULL)) {
+      NVDIMM_WARN("Failed to log event code %d\n", code);
+    }
+    put_event_store();
+  }
+  FreePool(p_event);
+}
+
+NVM_API int nvm_get_number_of_events(const struct event_filter *p_filter, int *count)
+{
+  struct event_store *p_store = NULL;
+  NVM_UINT32 event_cnt = 0;
+  int rc;
+
+  if (NULL == count) {
+    NVDIMM_ERR("NULL input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = get_event_store(&p_store))) {
+    return rc;
+  }
+  rc = event_store_count(p_store, p_filter, &event_cnt);
+  put_event_store();
+  if (NVM_SUCCESS != rc) {
+    NVDIMM_ERR("Failed to count events (%d)\n", rc);
+    return rc;
+  }
+  *count = (int)event_cnt;
+  return NVM_SUCCESS;
+}
+
+NVM_API int nvm_get_events(const struct event_filter *p_filter, struct event *p_events, const NVM_UINT16 count)
+{
+  struct event_store *p_store = NULL;
+  NVM_UINT32 returned = 0;
+  int rc;
+
+  if (NULL == p_events || 0 == count) {
+    NVDIMM_ERR("Invalid input parameter\n");
+    return NVM_ERR_INVALID_PARAMETER;
+  }
+  if (NVM_SUCCESS != (rc = get_event_store(&p_store))) {
+    return rc;
+  }
+  ZeroMem(p_events, sizeof(*p_events) * count);
+  rc = event_store_get(p_store, p_filter, p_events, count, &returned);
+  put_event_store();
+  if (NVM_ERR_BAD_SIZE == rc) {
+    NVDIMM_WARN("More than %d events match, returning the oldest\n", count);
+    return rc;
+  }
+  if (NVM_SUCCESS != rc) {
+    NVDIMM_ERR("Failed to get events (%d)\n", rc);
+    return rc;
+  }
+  return (int)returned;
+}
+
+NVM_API int nvm_purge_events(const struct event_filter *p_filter)
+{
+  struct event_store *p_store = NULL;
+  int rc;
+
+  if (NVM_SUCCESS != (rc = get_event_store(&p_store))) {
+    return rc;
+  }
+  if (NVM_SUCCESS != (rc = event_store_purge(p_store, p_filter))) {
+    NVDIMM_ERR("Failed to purge events (%d)\n", rc);
+  }
+  put_event_store();
+  return rc;
+}
+
+NVM_API int nvm_acknowledge_event(NVM_UINT32 event_id)
+{
+  struct event_store *p_store = NULL;
+  int rc;
+
+  if (NVM_SUCCESS != (rc = get_event_store(&p_store))) {
+    return rc;
+  }
+  if (NVM_SUCCESS != (rc = event_store_acknowledge(p_store, event_id))) {
+    NVDIMM_ERR("Failed to acknowledge event %u (%d)\n", event_id, rc);
+  }
+  put_event_store();
   return rc;
 }
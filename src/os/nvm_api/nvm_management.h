@@ -845,6 +845,59 @@ struct device_details {
   NVM_UINT8			reserved[8];				///< reserved
 };
 
+#define NVM_DEVICE_SNAPSHOT_VERSION   1 ///< Layout version of #device_snapshot
+
+/**
+ * Sections of a #device_snapshot
+ */
+#define NVM_SNAPSHOT_IDENTITY     (1 << 0) ///< discovery
+#define NVM_SNAPSHOT_HEALTH       (1 << 1) ///< status
+#define NVM_SNAPSHOT_SENSORS      (1 << 2) ///< sensors
+#define NVM_SNAPSHOT_PERFORMANCE  (1 << 3) ///< performance
+#define NVM_SNAPSHOT_ERROR_LOG    (1 << 4) ///< error_log
+#define NVM_SNAPSHOT_FW           (1 << 5) ///< fw_info
+#define NVM_SNAPSHOT_ALL          0x3F
+
+/**
+ * Point-in-time state of a device. The structure holds no pointers, it may be
+ * copied, stored and serialized as is.
+ */
+struct device_snapshot {
+  NVM_UINT32                  version;                          ///< NVM_DEVICE_SNAPSHOT_VERSION
+  NVM_UINT32                  sections;                         ///< NVM_SNAPSHOT_* sections captured
+  NVM_UINT64                  time;                             ///< Start of the capture pass, seconds since 1 January 1970
+  NVM_UINT64                  capture_usec;                     ///< Time it took to capture the device, in microseconds
+  NVM_UID                     uid;                              ///< Device identifier.
+  struct device_discovery     discovery;                        ///< Identity of the device.
+  struct device_status        status;                           ///< Health and status.
+  struct sensor               sensors[NVM_MAX_DEVICE_SENSORS];  ///< Health sensors.
+  struct device_performance   performance;                      ///< Performance counters.
+  struct device_error_log_status  error_log;                    ///< Error log sequence numbers.
+  struct device_fw_info       fw_info;                          ///< Firmware state.
+  NVM_UINT8                   reserved[32];                     ///< reserved
+};
+
+/**
+ * Changes between two snapshots of a device, counters are the new minus the old value.
+ */
+struct device_snapshot_diff {
+  NVM_UINT32  sections;               ///< NVM_SNAPSHOT_* sections compared
+  NVM_UINT32  changed_sections;       ///< NVM_SNAPSHOT_* sections whose values differ
+  NVM_INT64   interval;               ///< Seconds between the snapshots
+  NVM_INT64   sensor_deltas[NVM_MAX_DEVICE_SENSORS];  ///< Change of each sensor reading.
+  NVM_UINT64  bytes_read;             ///< 64 byte media reads in the interval
+  NVM_UINT64  host_reads;             ///< DDRT read transactions in the interval
+  NVM_UINT64  bytes_written;          ///< 64 byte media writes in the interval
+  NVM_UINT64  host_writes;            ///< DDRT write transactions in the interval
+  NVM_UINT32  new_media_low_errors;   ///< Low priority media log entries added in the interval
+  NVM_UINT32  new_media_high_errors;  ///< High priority media log entries added in the interval
+  NVM_UINT32  new_therm_low_errors;   ///< Low priority thermal log entries added in the interval
+  NVM_UINT32  new_therm_high_errors;  ///< High priority thermal log entries added in the interval
+  NVM_BOOL    health_changed;         ///< The overall health changed.
+  NVM_BOOL    fw_changed;             ///< The active or staged firmware or the update status changed.
+  NVM_UINT8   reserved[14];           ///< reserved
+};
+
 /**
  * Supported capabilities of a specific memory mode
  */
@@ -1014,7 +1067,7 @@ struct event {
   enum event_type		type;                           ///< The type of the event that occurred.
   enum event_severity	severity;                       ///< The severity of the event.
   NVM_UINT16		code;                           ///< A numerical code for the specific event that occurred.
-  NVM_BOOL		Reserved;                ///< Reserved for future use
+  NVM_BOOL		action_required;         ///< Set until the event is acknowledged with #nvm_acknowledge_event.
   NVM_UID			uid;                            ///< The unique ID of the item that had the event.
   time_t			time;                           ///< The time the event occurred.
   NVM_EVENT_MSG		message;                        ///< A detailed description of the event type that occurred in English.
@@ -1023,6 +1076,14 @@ struct event {
   NVM_UINT8		reserved[8];				///< reserved
 };
 
+#define NVM_FILTER_ON_TYPE      (1 << 0)
+#define NVM_FILTER_ON_SEVERITY  (1 << 1)
+#define NVM_FILTER_ON_CODE      (1 << 2)
+#define NVM_FILTER_ON_UID       (1 << 3)
+#define NVM_FILTER_ON_AFTER     (1 << 4)
+#define NVM_FILTER_ON_BEFORE    (1 << 5)
+#define NVM_FILTER_ON_EVENT     (1 << 6)
+
 /**
  * Limits the events returned by the #nvm_get_events method to
  * those that meet the conditions specified.
@@ -1032,7 +1093,7 @@ struct event_filter {
    * A bit mask specifying the values in this structure used to limit the results.
    * Any combination of the following or 0 to return all events.
    * NVM_FILTER_ON_TYPE
-   * NVM_FITLER_ON_SEVERITY
+   * NVM_FILTER_ON_SEVERITY
    * NVM_FILTER_ON_CODE
    * NVM_FILTER_ON_UID
    * NVM_FILTER_ON_AFTER
@@ -1065,9 +1126,33 @@ struct event_filter {
    */
   int			event_id; ///< filter of specified event
 
-  NVM_UINT8		reserved[21];	///< reserved
+  /**
+   * The event code to retrieve events for.
+   * Only used if NVM_FILTER_ON_CODE is set in the #filter_mask.
+   */
+  NVM_UINT16		code;
+
+  NVM_UINT8		reserved[6];	///< reserved, aligns the times below
+
+  /**
+   * Events at or after this time, in seconds since the epoch.
+   * Only used if NVM_FILTER_ON_AFTER is set in the #filter_mask.
+   */
+  NVM_INT64		after;
+
+  /**
+   * Events at or before this time, in seconds since the epoch.
+   * Only used if NVM_FILTER_ON_BEFORE is set in the #filter_mask.
+   */
+  NVM_INT64		before;
 };
 
+/**
+ * The filter is passed by pointer across the library boundary, the fields above
+ * replaced part of the reserved bytes and must not change its size.
+ */
+typedef char event_filter_size_check[(sizeof(struct event_filter) == 64) ? 1 : -1];
+
 /**
  * An entry in the native API trace log.
  */
@@ -1620,6 +1705,172 @@ NVM_API int nvm_get_nvm_capacities(struct device_capacities *p_capacities);
 */
 NVM_API int nvm_get_sensors(const NVM_UID device_uid, struct sensor *p_sensors, const NVM_UINT16 count);
 
+/**
+ * @brief Retrieve the #device_status of several devices in one call.
+ * @param[in] p_device_uids
+ *              An array of count device identifiers, or NULL for all devices.
+ * @param[in] count
+ *              The number of devices. When p_device_uids is NULL it must be
+ *              the number returned by #nvm_get_number_of_devices.
+ * @param[in,out] p_status
+ *              An array of count #device_status structures allocated by the caller.
+ * @param[out] p_results
+ *              An optional array of count return codes, one per device.
+ * @pre The caller must have administrative privileges.
+ * @remarks When p_device_uids is NULL the devices are returned in #nvm_get_devices order.
+ * @remarks The devices are queried in parallel under the topology lock. The entries of
+ * the devices that succeeded are filled in when others fail.
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER @n
+ *            ::NVM_ERR_BAD_SIZE @n
+ *            ::NVM_ERR_DIMM_NOT_FOUND @n
+ *            ::NVM_ERR_UNKNOWN @n
+ *            or the return code of the first device that failed
+ */
+NVM_API int nvm_get_devices_status(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_status *p_status, int *p_results);
+
+/**
+ * @brief Retrieve a snapshot of the performance metrics of several devices in one call.
+ * @param[in] p_device_uids
+ *              An array of count device identifiers, or NULL for all devices.
+ * @param[in] count
+ *              The number of devices, see #nvm_get_devices_status.
+ * @param[in,out] p_performance
+ *              An array of count #device_performance structures allocated by the caller.
+ * @param[out] p_results
+ *              An optional array of count return codes, one per device.
+ * @pre The caller must have administrative privileges.
+ * @return See #nvm_get_devices_status.
+ */
+NVM_API int nvm_get_devices_performance(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_performance *p_performance, int *p_results);
+
+/**
+ * @brief Retrieve all the health sensors of several devices in one call.
+ * @param[in] p_device_uids
+ *              An array of count device identifiers, or NULL for all devices.
+ * @param[in] count
+ *              The number of devices, see #nvm_get_devices_status.
+ * @param[in,out] p_sensors
+ *              An array of count * NVM_MAX_DEVICE_SENSORS #sensor structures allocated
+ *              by the caller, the sensors of device i start at i * NVM_MAX_DEVICE_SENSORS.
+ * @param[out] p_results
+ *              An optional array of count return codes, one per device.
+ * @pre The caller must have administrative privileges.
+ * @return See #nvm_get_devices_status.
+ */
+NVM_API int nvm_get_devices_sensors(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct sensor *p_sensors, int *p_results);
+
+/**
+ * @brief Retrieve #device_details information about several devices in one call.
+ * @param[in] p_device_uids
+ *              An array of count device identifiers, or NULL for all devices.
+ * @param[in] count
+ *              The number of devices, see #nvm_get_devices_status.
+ * @param[in,out] p_details
+ *              An array of count #device_details structures allocated by the caller.
+ * @param[out] p_results
+ *              An optional array of count return codes, one per device.
+ * @pre The caller must have administrative privileges.
+ * @return See #nvm_get_devices_status.
+ */
+NVM_API int nvm_get_devices_details(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_details *p_details, int *p_results);
+
+/**
+ * @brief Capture a point-in-time snapshot of a device.
+ * @param[in] device_uid
+ *              The device identifier.
+ * @param[out] p_snapshot
+ *              A pointer to a #device_snapshot structure allocated by the caller.
+ * @pre The caller must have administrative privileges.
+ * @return See #nvm_get_devices_snapshot.
+ */
+NVM_API int nvm_get_device_snapshot(const NVM_UID device_uid, struct device_snapshot *p_snapshot);
+
+/**
+ * @brief Capture point-in-time snapshots of several devices in one coordinated pass.
+ * @param[in] p_device_uids
+ *              An array of count device identifiers, or NULL for all devices.
+ * @param[in] count
+ *              The number of devices, see #nvm_get_devices_status.
+ * @param[out] p_snapshots
+ *              An array of count #device_snapshot structures allocated by the caller.
+ * @param[out] p_results
+ *              An optional array of count return codes, one per device.
+ * @pre The caller must have administrative privileges.
+ * @remarks All sections of all devices are read in one pass under the topology lock,
+ * one firmware command in flight per device, and share one capture time. A device that
+ * fails keeps the sections it captured, see device_snapshot.sections.
+ * @return See #nvm_get_devices_status.
+ */
+NVM_API int nvm_get_devices_snapshot(const NVM_UID *p_device_uids, const NVM_UINT32 count,
+  struct device_snapshot *p_snapshots, int *p_results);
+
+/**
+ * @brief Serialize snapshots into a self-contained buffer.
+ * @param[in] p_snapshots
+ *              An array of count snapshots.
+ * @param[in] count
+ *              The number of snapshots.
+ * @param[out] p_buf
+ *              The buffer to serialize into, or NULL to only get the size needed.
+ * @param[in] buf_size
+ *              The size of p_buf in bytes.
+ * @param[out] p_size
+ *              The size of the serialized snapshots in bytes.
+ * @remarks The buffer holds a header with the snapshot layout version and a checksum,
+ * followed by the snapshots. It is read back by the same library version only.
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER @n
+ *            ::NVM_ERR_BAD_SIZE when p_buf is too small, *p_size is set to the size needed
+ */
+NVM_API int nvm_serialize_device_snapshots(const struct device_snapshot *p_snapshots,
+  const NVM_UINT32 count, void *p_buf, const NVM_UINT32 buf_size, NVM_UINT32 *p_size);
+
+/**
+ * @brief Read back snapshots serialized by #nvm_serialize_device_snapshots.
+ * @param[in] p_buf
+ *              The serialized snapshots.
+ * @param[in] buf_size
+ *              The size of p_buf in bytes.
+ * @param[out] p_snapshots
+ *              An array of count snapshots allocated by the caller, or NULL to only
+ *              get the number of snapshots in the buffer.
+ * @param[in] count
+ *              The number of elements in p_snapshots.
+ * @param[out] p_count
+ *              The number of snapshots in the buffer.
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER when the buffer is truncated, corrupted or
+ *              holds another snapshot layout version @n
+ *            ::NVM_ERR_BAD_SIZE when p_snapshots is too small, *p_count is set to the number needed
+ */
+NVM_API int nvm_deserialize_device_snapshots(const void *p_buf, const NVM_UINT32 buf_size,
+  struct device_snapshot *p_snapshots, const NVM_UINT32 count, NVM_UINT32 *p_count);
+
+/**
+ * @brief Compare two snapshots of the same device.
+ * @param[in] p_old
+ *              The earlier snapshot.
+ * @param[in] p_new
+ *              The later snapshot.
+ * @param[out] p_diff
+ *              A pointer to a #device_snapshot_diff structure allocated by the caller.
+ * @remarks Only the sections captured in both snapshots are compared.
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER when the snapshots are of different devices
+ *              or layout versions
+ */
+NVM_API int nvm_diff_device_snapshots(const struct device_snapshot *p_old,
+  const struct device_snapshot *p_new, struct device_snapshot_diff *p_diff);
+
 /**
 * @brief Retrieve a specific health sensor from the specified DCPMM.
 * @param[in] device_uid
@@ -1872,10 +2123,10 @@ NVM_API int nvm_get_number_of_events(const struct event_filter *p_filter, int *c
  * @remarks To allocate the array of #event structures,
  * call #nvm_get_number_of_events before calling this method.
  * @return
- *            ::NVM_SUCCESS @n
+ *            The number of events copied into p_events, 0 when no event matches. @n
  *            ::NVM_ERR_INVALID_PARAMETER @n
  *            ::NVM_ERR_NOT_ENOUGH_FREE_SPACE @n
- *            ::NVM_ERR_BAD_SIZE @n
+ *            ::NVM_ERR_BAD_SIZE when more than count events match, p_events holds the oldest count @n
  */
 NVM_API int nvm_get_events(const struct event_filter *p_filter, struct event *p_events, const NVM_UINT16 count);
 
@@ -2268,6 +2519,18 @@ NVM_API int nvm_debug_logging_enabled();
  */
 NVM_API int nvm_toggle_debug_logging(const NVM_BOOL enabled);
 
+/**
+ * @brief Retrieve the number of firmware passthrough commands the library sent
+ * to the DCPMMs, or to the PBR playback session standing in for them, since it was loaded.
+ * @param[out] p_count
+ *              The number of passthrough commands.
+ * @remarks Sampling the count around an API call gives the firmware commands the call costs.
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER @n
+ */
+NVM_API int nvm_get_passthrough_count(NVM_UINT64 *p_count);
+
 /**
  * @brief Retrieves #job information about each device in the system
  * @param[in,out] p_jobs
@@ -2381,6 +2644,8 @@ NVM_API int nvm_get_fw_err_log_stats(const NVM_UID device_uid, struct device_err
 
 /**
 * @brief Lock API
+* @remarks The API functions do not take this lock, they synchronize internally.
+* It is kept for callers serializing sequences of API calls among themselves.
 */
 NVM_API void nvm_sync_lock_api();
 
@@ -2389,6 +2654,76 @@ NVM_API void nvm_sync_lock_api();
 */
 NVM_API void nvm_sync_unlock_api();
 
+/**
+ * A DCPMM health event reported by a health monitor.
+ */
+struct device_health_event {
+  NVM_UID                 device_uid;     ///< UID of the DCPMM that signalled
+  NVM_NFIT_DEVICE_HANDLE  device_handle;  ///< The unique device handle of the DCPMM
+  enum acpi_event_type    event_type;     ///< The event the DCPMM signalled
+};
+
+/**
+ * Called by #nvm_dispatch_health_events once for every event.
+ */
+typedef void (*nvm_health_event_callback)(const struct device_health_event *p_event, void *p_context);
+
+/**
+ * @brief Create a health monitor watching all manageable DCPMMs.
+ * The DCPMMs are registered once, waiting on the monitor reports only the DCPMMs
+ * that signalled, so the caller does not have to rescan every device.
+ * DCPMMs that are unmanageable, non-functional or cannot be registered are left
+ * out and reported with a warning in the event log. The call fails only when
+ * none of the DCPMMs could be registered.
+ * @param[out] pp_monitor The new monitor, to be freed with #nvm_free_health_monitor
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER @n
+ *            ::NVM_ERR_NO_MEM @n
+ *            ::NVM_ERR_API_NOT_SUPPORTED @n
+ *            ::NVM_ERR_UNKNOWN @n
+ */
+NVM_API int nvm_create_health_monitor(void **pp_monitor);
+
+/**
+ * @brief Wait for health events on the DCPMMs watched by a monitor.
+ * Returns when the timeout expires or at least one DCPMM signals. Events that do
+ * not fit in p_events are reported by the next wait.
+ * @param[in] p_monitor A monitor created by #nvm_create_health_monitor
+ * @param[in] timeout_sec -1 waits without a timeout, any other non-negative value is the timeout in seconds
+ * @param[out] p_events Array receiving the events
+ * @param[in,out] p_count In: number of entries p_events can hold, out: number of events, 0 on timeout
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER @n
+ *            ::NVM_ERR_UNKNOWN @n
+ */
+NVM_API int nvm_wait_for_health_events(void *p_monitor, const int timeout_sec,
+  struct device_health_event *p_events, NVM_UINT32 *p_count);
+
+/**
+ * @brief Wait for health events like #nvm_wait_for_health_events and call the
+ * callback for each of them.
+ * @param[in] p_monitor A monitor created by #nvm_create_health_monitor
+ * @param[in] timeout_sec -1 waits without a timeout, any other non-negative value is the timeout in seconds
+ * @param[in] callback Called for every event
+ * @param[in] p_context Passed to the callback
+ * @return
+ *            ::NVM_SUCCESS @n
+ *            ::NVM_ERR_INVALID_PARAMETER @n
+ *            ::NVM_ERR_UNKNOWN @n
+ */
+NVM_API int nvm_dispatch_health_events(void *p_monitor, const int timeout_sec,
+  nvm_health_event_callback callback, void *p_context);
+
+/**
+ * @brief Free a monitor created by #nvm_create_health_monitor.
+ * @param[in] p_monitor The monitor, may be NULL
+ * @return
+ *            ::NVM_SUCCESS @n
+ */
+NVM_API int nvm_free_health_monitor(void *p_monitor);
+
 #ifdef __cplusplus
 }
 #endif
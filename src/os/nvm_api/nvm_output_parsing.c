@@ -351,9 +351,96 @@ int output_to_esx_xml_error(
    return 0;
 }
 
+/*
+* Output characters of a line as part of a JSON string, escaped to ASCII like
+* the printer escapes its JSON strings
+*/
+static void output_json_chars(
+   const wchar_t *str,
+   size_t len)
+{
+   unsigned int c;
+   for (size_t i = 0; i < len; ++i)
+   {
+      c = (unsigned int)str[i];
+      if (L'"' == c || L'\\' == c)
+         wprintf(L"\\%lc", (wint_t)c);
+      else if (L'\t' == c)
+         wprintf(L"\\t");
+      else if (c > 0xFFFF)
+         wprintf(L"\\u%04x\\u%04x", 0xD800 + ((c - 0x10000) >> 10), 0xDC00 + ((c - 0x10000) & 0x3FF));
+      else if (c < 0x20 || c > 0x7E)
+         wprintf(L"\\u%04x", c);
+      else
+         putwchar((wchar_t)c);
+   }
+}
+
+/*
+* Output every non-empty line of the filestream to stdout as a string item of a
+* JSON result or error object, the form the printer uses for messages
+* The return is 0 on success
+*/
+int output_to_json(
+   FILE *fd,
+   int rc)
+{
+   wchar_t line[READ_FD_LINE_SZ];
+   size_t begin;
+   size_t end;
+   int item_cnt = 0;
+   int in_item = 0;
+   int line_end;
+
+   if (0 == rc)
+      wprintf(JSON_RESULTS_BEGIN);
+   else
+      wprintf(JSON_ERROR_BEGIN, rc);
+
+   //a line longer than the buffer is read in parts, they make up one item
+   while (NULL != fgetws(line, READ_FD_LINE_SZ, fd))
+   {
+      begin = 0;
+      end = wcslen(line);
+      line_end = (end > 0 && L'\n' == line[end - 1]) || feof(fd);
+      if (!in_item)
+      {
+         while (begin < end && iswspace(line[begin]))
+            ++begin;
+      }
+      if (line_end)
+      {
+         while (end > begin && iswspace(line[end - 1]))
+            --end;
+      }
+      if (!in_item && begin == end)
+         continue;
+
+      if (!in_item)
+      {
+         if (0 < item_cnt++)
+            wprintf(JSON_ITEM_DELIM);
+         putwchar(L'"');
+         in_item = 1;
+      }
+      output_json_chars(line + begin, end - begin);
+      if (line_end)
+      {
+         putwchar(L'"');
+         in_item = 0;
+      }
+   }
+   if (in_item)
+      putwchar(L'"');
+
+   wprintf((0 == rc) ? JSON_RESULTS_END : JSON_ERROR_END);
+   return 0;
+}
+
 #define XML_OPTION_ESX_STR  "esx"
 #define XML_OPTION_ESX_TABLE_STR "esxtable"
 #define XML_OPTION_NVM_STR  "nvmxml"
+#define JSON_OPTION_STR     "json"
 //temp WA
 enum OutputType output_type(int argc, char *argv[])
 {
@@ -371,6 +458,10 @@ enum OutputType output_type(int argc, char *argv[])
     {
       return NvmXmlType;
     }
+    else if (0 == s_strncmpi(argv[i], JSON_OPTION_STR, strlen(JSON_OPTION_STR) + 1))
+    {
+      return JsonType;
+    }
   }
 
   return UnknownType;
@@ -411,6 +502,14 @@ int process_output(
    }
 
    fseek(fd, 0, SEEK_SET);
+   //the text views have no JSON schema, the output lines are the result items
+   if (JsonType == out_type)
+   {
+      output_to_json(fd, rc);
+      free(dictionaries);
+      free(line);
+      return (0 == rc) ? 0 : -1;
+   }
    //view_type = display_view_type(cmd, rc);
    if (ErrorView == type)
    {
@@ -49,6 +49,11 @@ extern "C"
 #define ESX_XML_FIELD_BEGIN                     L"<field name = \"%ls\">"
 #define ESX_XML_FIELD_END                       L"</field>"
 #define ESX_XML_STRING_BEGIN_AND_END            L"<string>%ls</string>"
+#define JSON_RESULTS_BEGIN                      L"{\"Results\":[\n"
+#define JSON_RESULTS_END                        L"\n]}\n"
+#define JSON_ERROR_BEGIN                        L"{\"Error\":{\"Type\":%d,\"Results\":[\n"
+#define JSON_ERROR_END                          L"\n]}}\n"
+#define JSON_ITEM_DELIM                         L",\n"
 #ifdef __ESX__
 #define NUM_DICTIONARIES_MAX                    100
 #else
@@ -92,7 +97,8 @@ enum OutputType
 {
    NvmXmlType = 0,
    EsxXmlType = 1,
-   UnknownType = 2
+   JsonType = 2,
+   UnknownType = 3
 };
 
 int process_output(
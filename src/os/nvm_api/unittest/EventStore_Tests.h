@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef EVENT_STORE_TESTS_H
+#define EVENT_STORE_TESTS_H
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include <nvm_management.h>
+#include <event.h>
+}
+
+#define EVENT_STORE_TEST_ROWS       4
+#define EVENT_STORE_TEST_PATH       "ipmctl_events_test.bin"
+/*
+ * Layout of the store file: a 32 byte header, the fixed entries, then one
+ * message per slot.
+ */
+#define EVENT_STORE_TEST_HEADER_SIZE  32
+#define EVENT_STORE_TEST_ENTRY_SIZE   46
+
+class EventStore_Tests : public ::testing::Test
+{
+protected:
+  struct event_store *p_store;
+
+  virtual void SetUp()
+  {
+    p_store = NULL;
+    remove(EVENT_STORE_TEST_PATH);
+    ASSERT_EQ(event_store_open(EVENT_STORE_TEST_PATH, EVENT_STORE_TEST_ROWS, &p_store), NVM_SUCCESS);
+  }
+
+  virtual void TearDown()
+  {
+    event_store_close(p_store);
+    remove(EVENT_STORE_TEST_PATH);
+  }
+
+  NVM_UINT32 Append(enum event_type type, enum event_severity severity, NVM_UINT16 code,
+    const char *p_uid, time_t time)
+  {
+    struct event ev;
+    NVM_UINT32 event_id = 0;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.type = type;
+    ev.severity = severity;
+    ev.code = code;
+    ev.time = time;
+    strncpy(ev.uid, p_uid, sizeof(ev.uid) - 1);
+    snprintf(ev.message, sizeof(ev.message), "event code %d", code);
+    EXPECT_EQ(event_store_append(p_store, &ev, &event_id), NVM_SUCCESS);
+    return event_id;
+  }
+
+  NVM_UINT32 Count(const struct event_filter *p_filter)
+  {
+    NVM_UINT32 count = 0;
+
+    EXPECT_EQ(event_store_count(p_store, p_filter, &count), NVM_SUCCESS);
+    return count;
+  }
+
+  void InitFilter(struct event_filter *p_filter, NVM_UINT8 mask)
+  {
+    memset(p_filter, 0, sizeof(*p_filter));
+    p_filter->filter_mask = mask;
+  }
+};
+
+TEST_F(EventStore_Tests, RingWrapKeepsNewestEvents)
+{
+  struct event events[EVENT_STORE_TEST_ROWS];
+  NVM_UINT32 returned = 0;
+  NVM_UINT32 i;
+
+  for (i = 1; i <= EVENT_STORE_TEST_ROWS + 2; i++) {
+    EXPECT_EQ(Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, (NVM_UINT16)i, "uid", (time_t)i), i);
+  }
+  EXPECT_EQ(Count(NULL), (NVM_UINT32)EVENT_STORE_TEST_ROWS);
+  ASSERT_EQ(event_store_get(p_store, NULL, events, EVENT_STORE_TEST_ROWS, &returned), NVM_SUCCESS);
+  ASSERT_EQ(returned, (NVM_UINT32)EVENT_STORE_TEST_ROWS);
+  for (i = 0; i < EVENT_STORE_TEST_ROWS; i++) {
+    EXPECT_EQ(events[i].event_id, i + 3);
+    EXPECT_EQ(events[i].code, i + 3);
+    EXPECT_STREQ(events[i].uid, "uid");
+  }
+}
+
+TEST_F(EventStore_Tests, GetReportsTooSmallBuffer)
+{
+  struct event events[2];
+  NVM_UINT32 returned = 0;
+
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, 1, "uid", 1);
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, 2, "uid", 2);
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, 3, "uid", 3);
+  EXPECT_EQ(event_store_get(p_store, NULL, events, 2, &returned), NVM_ERR_BAD_SIZE);
+  EXPECT_EQ(returned, 2u);
+  EXPECT_EQ(events[0].event_id, 1u);
+  EXPECT_EQ(events[1].event_id, 2u);
+}
+
+TEST_F(EventStore_Tests, FiltersSelectMatchingEvents)
+{
+  struct event_filter filter;
+  struct event events[EVENT_STORE_TEST_ROWS];
+  NVM_UINT32 returned = 0;
+
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_WARN, 10, "uid-a", 100);
+  Append(EVENT_TYPE_DIAG_QUICK, EVENT_SEVERITY_INFO, 20, "uid-b", 200);
+  Append(EVENT_TYPE_DIAG_SECURITY, EVENT_SEVERITY_WARN, 30, "uid-a", 300);
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, 10, "uid-b", 400);
+
+  InitFilter(&filter, NVM_FILTER_ON_TYPE);
+  filter.type = EVENT_TYPE_HEALTH;
+  EXPECT_EQ(Count(&filter), 2u);
+  filter.type = EVENT_TYPE_DIAG;
+  EXPECT_EQ(Count(&filter), 2u);
+  filter.type = EVENT_TYPE_ALL;
+  EXPECT_EQ(Count(&filter), 4u);
+
+  InitFilter(&filter, NVM_FILTER_ON_SEVERITY);
+  filter.severity = EVENT_SEVERITY_WARN;
+  EXPECT_EQ(Count(&filter), 2u);
+
+  InitFilter(&filter, NVM_FILTER_ON_CODE);
+  filter.code = 10;
+  EXPECT_EQ(Count(&filter), 2u);
+
+  InitFilter(&filter, NVM_FILTER_ON_UID | NVM_FILTER_ON_SEVERITY);
+  strncpy(filter.uid, "uid-a", sizeof(filter.uid) - 1);
+  filter.severity = EVENT_SEVERITY_WARN;
+  EXPECT_EQ(Count(&filter), 2u);
+
+  InitFilter(&filter, NVM_FILTER_ON_AFTER | NVM_FILTER_ON_BEFORE);
+  filter.after = 200;
+  filter.before = 300;
+  EXPECT_EQ(Count(&filter), 2u);
+  ASSERT_EQ(event_store_get(p_store, &filter, events, EVENT_STORE_TEST_ROWS, &returned), NVM_SUCCESS);
+  ASSERT_EQ(returned, 2u);
+  EXPECT_EQ(events[0].code, 20);
+  EXPECT_EQ(events[1].code, 30);
+
+  InitFilter(&filter, NVM_FILTER_ON_EVENT);
+  filter.event_id = 3;
+  ASSERT_EQ(event_store_get(p_store, &filter, events, EVENT_STORE_TEST_ROWS, &returned), NVM_SUCCESS);
+  ASSERT_EQ(returned, 1u);
+  EXPECT_EQ(events[0].event_id, 3u);
+  filter.event_id = 9;
+  EXPECT_EQ(Count(&filter), 0u);
+}
+
+TEST_F(EventStore_Tests, PurgeRemovesMatchingEvents)
+{
+  struct event_filter filter;
+
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_WARN, 10, "uid-a", 100);
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, 20, "uid-b", 200);
+  InitFilter(&filter, NVM_FILTER_ON_UID);
+  strncpy(filter.uid, "uid-a", sizeof(filter.uid) - 1);
+  EXPECT_EQ(event_store_purge(p_store, &filter), NVM_SUCCESS);
+  EXPECT_EQ(Count(&filter), 0u);
+  EXPECT_EQ(Count(NULL), 1u);
+}
+
+TEST_F(EventStore_Tests, AcknowledgeIsSeenByOtherStores)
+{
+  struct event_store *p_other = NULL;
+  struct event ev;
+  struct event_filter filter;
+  NVM_UINT32 returned = 0;
+  NVM_UINT32 event_id;
+
+  event_id = Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_WARN, 10, "uid", 100);
+  InitFilter(&filter, NVM_FILTER_ON_EVENT);
+  filter.event_id = (int)event_id;
+
+  // Opened before the ack, so it holds a copy of the unacknowledged entry
+  ASSERT_EQ(event_store_open(EVENT_STORE_TEST_PATH, EVENT_STORE_TEST_ROWS, &p_other), NVM_SUCCESS);
+  ASSERT_EQ(event_store_get(p_other, &filter, &ev, 1, &returned), NVM_SUCCESS);
+  EXPECT_TRUE(ev.action_required);
+
+  EXPECT_EQ(event_store_acknowledge(p_store, event_id), NVM_SUCCESS);
+  ASSERT_EQ(event_store_get(p_other, &filter, &ev, 1, &returned), NVM_SUCCESS);
+  ASSERT_EQ(returned, 1u);
+  EXPECT_FALSE(ev.action_required);
+  event_store_close(p_other);
+
+  EXPECT_EQ(event_store_acknowledge(p_store, event_id + 1), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST_F(EventStore_Tests, TornEntryIsNeitherCountedNorReturned)
+{
+  struct event events[EVENT_STORE_TEST_ROWS];
+  NVM_UINT32 returned = 0;
+  FILE *p_file;
+  long offset;
+  char garbage = 'X';
+
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, 1, "uid", 1);
+  Append(EVENT_TYPE_HEALTH, EVENT_SEVERITY_INFO, 2, "uid", 2);
+  event_store_close(p_store);
+  p_store = NULL;
+
+  // Damage the message of the second event, as a crash while writing it would
+  offset = EVENT_STORE_TEST_HEADER_SIZE + EVENT_STORE_TEST_ROWS * EVENT_STORE_TEST_ENTRY_SIZE + NVM_EVENT_MSG_LEN + 1;
+  ASSERT_NE(p_file = fopen(EVENT_STORE_TEST_PATH, "r+b"), (FILE *)NULL);
+  ASSERT_EQ(fseek(p_file, offset, SEEK_SET), 0);
+  ASSERT_EQ(fwrite(&garbage, 1, 1, p_file), 1u);
+  fclose(p_file);
+
+  ASSERT_EQ(event_store_open(EVENT_STORE_TEST_PATH, EVENT_STORE_TEST_ROWS, &p_store), NVM_SUCCESS);
+  EXPECT_EQ(Count(NULL), 1u);
+  ASSERT_EQ(event_store_get(p_store, NULL, events, EVENT_STORE_TEST_ROWS, &returned), NVM_SUCCESS);
+  ASSERT_EQ(returned, 1u);
+  EXPECT_EQ(events[0].event_id, 1u);
+}
+
+#endif //EVENT_STORE_TESTS_H
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef HEALTH_MONITOR_TESTS_H
+#define HEALTH_MONITOR_TESTS_H
+
+#include <gtest/gtest.h>
+#ifdef __LINUX__
+#include <poll.h>
+#endif
+
+extern "C" {
+#include <nvm_types.h>
+#include <os.h>
+}
+
+/* The epoll monitor, the Windows adapter does not support health monitors */
+#ifdef __LINUX__
+
+/* No DIMM is registered with this handle, the NFIT handles are far smaller */
+#define HEALTH_MONITOR_TEST_INVALID_HANDLE 0xFFFFFFFF
+#define HEALTH_MONITOR_TEST_MAX_EVENTS     4
+
+class HealthMonitor_Tests : public ::testing::Test
+{
+protected:
+  OS_HEALTH_MONITOR *p_monitor;
+
+  virtual void SetUp()
+  {
+    p_monitor = NULL;
+    ASSERT_EQ(os_health_monitor_create(&p_monitor), NVM_SUCCESS);
+    ASSERT_NE(p_monitor, (OS_HEALTH_MONITOR *)NULL);
+  }
+
+  virtual void TearDown()
+  {
+    os_health_monitor_free(p_monitor);
+  }
+};
+
+TEST(HealthMonitor_Params, CreateRejectsNullOutput)
+{
+  EXPECT_EQ(os_health_monitor_create(NULL), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST(HealthMonitor_Params, FreeAcceptsNull)
+{
+  os_health_monitor_free(NULL);
+}
+
+TEST_F(HealthMonitor_Tests, WaitWithoutDevicesTimesOut)
+{
+  struct os_health_event events[HEALTH_MONITOR_TEST_MAX_EVENTS];
+  unsigned int count = 1;
+
+  EXPECT_EQ(os_health_monitor_wait(p_monitor, 0, events, HEALTH_MONITOR_TEST_MAX_EVENTS, &count), NVM_SUCCESS);
+  EXPECT_EQ(count, 0u);
+}
+
+TEST_F(HealthMonitor_Tests, WaitRejectsInvalidParameters)
+{
+  struct os_health_event events[HEALTH_MONITOR_TEST_MAX_EVENTS];
+  unsigned int count = 0;
+
+  EXPECT_EQ(os_health_monitor_wait(NULL, 0, events, HEALTH_MONITOR_TEST_MAX_EVENTS, &count), NVM_ERR_INVALID_PARAMETER);
+  EXPECT_EQ(os_health_monitor_wait(p_monitor, 0, NULL, HEALTH_MONITOR_TEST_MAX_EVENTS, &count), NVM_ERR_INVALID_PARAMETER);
+  EXPECT_EQ(os_health_monitor_wait(p_monitor, 0, events, 0, &count), NVM_ERR_INVALID_PARAMETER);
+  EXPECT_EQ(os_health_monitor_wait(p_monitor, 0, events, HEALTH_MONITOR_TEST_MAX_EVENTS, NULL), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST_F(HealthMonitor_Tests, AddInvalidHandleFails)
+{
+  EXPECT_EQ(os_health_monitor_add(NULL, HEALTH_MONITOR_TEST_INVALID_HANDLE, DIMM_ACPI_EVENT_SMART_HEALTH_MASK),
+    NVM_ERR_INVALID_PARAMETER);
+  EXPECT_NE(os_health_monitor_add(p_monitor, HEALTH_MONITOR_TEST_INVALID_HANDLE, DIMM_ACPI_EVENT_SMART_HEALTH_MASK),
+    NVM_SUCCESS);
+}
+
+TEST_F(HealthMonitor_Tests, FailedAddLeavesMonitorUsable)
+{
+  struct os_health_event events[HEALTH_MONITOR_TEST_MAX_EVENTS];
+  unsigned int count = 1;
+
+  os_health_monitor_add(p_monitor, HEALTH_MONITOR_TEST_INVALID_HANDLE, DIMM_ACPI_EVENT_SMART_HEALTH_MASK);
+  EXPECT_EQ(os_health_monitor_wait(p_monitor, 0, events, HEALTH_MONITOR_TEST_MAX_EVENTS, &count), NVM_SUCCESS);
+  EXPECT_EQ(count, 0u);
+}
+
+TEST_F(HealthMonitor_Tests, FdWithoutDevicesIsNotReadable)
+{
+  struct pollfd fd;
+
+  EXPECT_EQ(os_health_monitor_fd(NULL), -1);
+  fd.fd = os_health_monitor_fd(p_monitor);
+  fd.events = POLLIN;
+  fd.revents = 0;
+  ASSERT_GE(fd.fd, 0);
+  EXPECT_EQ(poll(&fd, 1, 0), 0);
+}
+
+#endif //__LINUX__
+#endif //HEALTH_MONITOR_TESTS_H
@@ -9,6 +9,25 @@
 #include <gtest/gtest.h>
 #include <nvm_management.h>
 #include <wchar.h> 
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <future>
+#include <memory>
+
+extern "C" {
+#include <os.h>
+#include <AutoGen.h>
+#include <Uefi.h>
+#include <FwUtility.h>
+#include <Pbr.h>
+#include <PbrDcpmm.h>
+#include <Dimm.h>
+#include <NvmDimmPassThru.h>
+#include <os_efi_preferences.h>
+extern EFI_GUID gIntelDimmPbrVariableGuid;
+}
 
 class NvmApi_Tests : public ::testing::Test
 {
@@ -89,6 +108,244 @@ TEST_F(NvmApi_Tests, GetDeviceStatus)
   free(p_devices);
 }
 
+#define STRESS_READER_THREADS 8
+#define STRESS_CALLS_PER_THREAD 50
+#define STRESS_TIMEOUT_SEC 300
+#define STRESS_MIN_SPEEDUP 1.5
+#define STRESS_REPLAY_USEC 2000
+
+/*
+ * Run body(t) on thread_cnt threads and wait up to STRESS_TIMEOUT_SEC for all
+ * of them. Returns false when they did not finish, they are left running.
+ */
+template <typename Body>
+static bool RunThreads(unsigned int thread_cnt, Body body)
+{
+  std::shared_ptr<std::promise<void>> p_done = std::make_shared<std::promise<void>>();
+  std::future<void> done = p_done->get_future();
+
+  std::thread([p_done, thread_cnt, body]() {
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < thread_cnt; t++) {
+      threads.push_back(std::thread(body, t));
+    }
+    for (unsigned int t = 0; t < thread_cnt; t++) {
+      threads[t].join();
+    }
+    p_done->set_value();
+  }).detach();
+  return std::future_status::ready == done.wait_for(std::chrono::seconds(STRESS_TIMEOUT_SEC));
+}
+
+/*
+ * Readers share the lock while one writer changes two fields under it.
+ * No reader may see one field updated without the other.
+ */
+TEST(NvmApi_Locks, RwLockReadersSeeWholeWrites)
+{
+  OS_RWLOCK *p_lock = os_rwlock_create();
+  volatile unsigned int first = 0;
+  volatile unsigned int second = 0;
+  std::atomic<unsigned int> torn(0);
+
+  ASSERT_TRUE(NULL != p_lock);
+  bool finished = RunThreads(STRESS_READER_THREADS + 1, [&](unsigned int t) {
+    for (unsigned int i = 0; i < STRESS_CALLS_PER_THREAD * 100; i++) {
+      if (0 == t) {
+        os_rwlock_w_lock(p_lock);
+        first = first + 1;
+        std::this_thread::yield();
+        second = second + 1;
+        os_rwlock_w_unlock(p_lock);
+      } else {
+        os_rwlock_r_lock(p_lock);
+        if (first != second) {
+          torn++;
+        }
+        os_rwlock_r_unlock(p_lock);
+      }
+    }
+  });
+  ASSERT_TRUE(finished) << "Lock users did not finish, deadlock";
+  EXPECT_EQ(torn.load(), 0u);
+  EXPECT_EQ(second, (unsigned int)(STRESS_CALLS_PER_THREAD * 100));
+
+  os_rwlock_delete(p_lock);
+  free(p_lock);
+}
+
+/*
+ * Status polls of different DIMMs only share the topology lock, and run along
+ * with device list and UID lookups that rebuild the DIMM index. Every poll must
+ * return the same status a poll taken alone does and all of them must finish.
+ */
+TEST_F(NvmApi_Tests, ConcurrentStatusReaders)
+{
+  unsigned int dimm_cnt = 0;
+  std::atomic<unsigned int> failures(0);
+  std::atomic<unsigned int> torn(0);
+
+  nvm_get_number_of_devices(&dimm_cnt);
+  if (dimm_cnt < 2) {
+    GTEST_SKIP() << "Needs at least two DCPMMs";
+  }
+  std::vector<device_discovery> devices(dimm_cnt);
+  std::vector<device_status> expected(dimm_cnt);
+
+  ASSERT_EQ(nvm_get_devices(devices.data(), (NVM_UINT8)dimm_cnt), NVM_SUCCESS);
+  for (unsigned int i = 0; i < dimm_cnt; i++) {
+    ASSERT_EQ(nvm_get_device_status(devices[i].uid, &expected[i]), NVM_SUCCESS);
+  }
+
+  // The last thread lists the devices and looks up their IDs
+  bool finished = RunThreads(STRESS_READER_THREADS + 1, [&](unsigned int t) {
+    std::vector<device_discovery> listed(dimm_cnt);
+    device_status status;
+    unsigned int dimm_id;
+    unsigned int dimm_handle;
+
+    for (unsigned int i = 0; i < STRESS_CALLS_PER_THREAD; i++) {
+      unsigned int d = (t + i) % dimm_cnt;
+      if (STRESS_READER_THREADS == t) {
+        if (NVM_SUCCESS != nvm_get_devices(listed.data(), (NVM_UINT8)dimm_cnt) ||
+            NVM_SUCCESS != nvm_get_dimm_id(devices[d].uid, &dimm_id, &dimm_handle)) {
+          failures++;
+        } else if (dimm_id != devices[d].physical_id || dimm_handle != devices[d].device_handle.handle) {
+          torn++;
+        }
+      } else if (NVM_SUCCESS != nvm_get_device_status(devices[d].uid, &status)) {
+        failures++;
+      } else if (status.is_new != expected[d].is_new || status.is_configured != expected[d].is_configured ||
+          status.sku_violation != expected[d].sku_violation || status.config_status != expected[d].config_status ||
+          status.boot_status != expected[d].boot_status || status.is_missing) {
+        torn++;
+      }
+    }
+  });
+  ASSERT_TRUE(finished) << "Readers did not finish, deadlock";
+  EXPECT_EQ(failures.load(), 0u);
+  EXPECT_EQ(torn.load(), 0u);
+}
+
+/*
+ * Status polls of DIMMs, replayed from a keyed PBR session built in process the
+ * way Pbr_Tests.h does it. Every poll takes STRESS_REPLAY_USEC, the recorded
+ * latency the playback delay scale replays, so the rate does not depend on the
+ * hardware the test runs on.
+ */
+class NvmApi_PlaybackTests : public ::testing::Test
+{
+protected:
+  DIMM m_dimms[STRESS_READER_THREADS];
+
+  virtual void SetUp()
+  {
+    FW_CMD Cmd;
+
+    preferences_init(NULL);
+    SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_ORDER, PBR_PLAYBACK_ORDER_KEYED);
+    SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_REPEAT, PBR_PLAYBACK_REPEAT_LAST);
+    SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_DELAY_SCALE, 100);
+    ASSERT_EQ(PbrSetSession(NULL, 0), EFI_SUCCESS);
+    ASSERT_EQ(PbrSetMode(PBR_RECORD_MODE), EFI_SUCCESS);
+
+    memset(m_dimms, 0, sizeof(m_dimms));
+    for (unsigned int i = 0; i < STRESS_READER_THREADS; i++) {
+      m_dimms[i].DimmID = (UINT16)(i + 1);
+      m_dimms[i].DeviceHandle.AsUint32 = 0x1001 + (i << 8);
+      m_dimms[i].pMailboxLock = os_mutex_init(NULL);
+      ASSERT_TRUE(NULL != m_dimms[i].pMailboxLock);
+      // Recordings address the DIMM by its device handle
+      InitStatusCmd(&Cmd, m_dimms[i].DeviceHandle.AsUint32);
+      Cmd.OutPayload[0] = (UINT8)i;
+      ASSERT_EQ(PbrSetPassThruRecord(PBR_CTX(), &Cmd, EFI_SUCCESS, STRESS_REPLAY_USEC), EFI_SUCCESS);
+    }
+    StartPlayback();
+  }
+
+  virtual void TearDown()
+  {
+    PbrSetMode(PBR_NORMAL_MODE);
+    SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_ORDER, PBR_PLAYBACK_ORDER_RECORDED);
+    SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_DELAY_SCALE, 0);
+    for (unsigned int i = 0; i < STRESS_READER_THREADS; i++) {
+      if (NULL != m_dimms[i].pMailboxLock) {
+        os_mutex_delete((OS_MUTEX *)m_dimms[i].pMailboxLock, NULL);
+      }
+    }
+  }
+
+  /* Playback is configured in memory, nothing is written to the ini file */
+  void SetPlaybackPreference(CONST CHAR16 *pName, UINT32 Value)
+  {
+    preferences_set_var((CHAR16 *)pName, gIntelDimmPbrVariableGuid, &Value, sizeof(Value));
+  }
+
+  /* Get Security State, which every status poll sends */
+  void InitStatusCmd(FW_CMD *pCmd, UINT32 DimmID)
+  {
+    memset(pCmd, 0, sizeof(*pCmd));
+    pCmd->DimmID = DimmID;
+    pCmd->Opcode = PtGetSecInfo;
+    pCmd->SubOpcode = SubopGetSecState;
+    pCmd->OutputPayloadSize = OUT_PAYLOAD_SIZE;
+  }
+
+  void StartPlayback()
+  {
+    VOID *pSession = NULL;
+    UINT32 SessionSize = 0;
+
+    ASSERT_EQ(PbrGetSession(&pSession, &SessionSize), EFI_SUCCESS);
+    ASSERT_EQ(PbrSetSession(pSession, SessionSize), EFI_SUCCESS);
+    ASSERT_EQ(PbrSetMode(PBR_PLAYBACK_MODE), EFI_SUCCESS);
+    FreePool(pSession);
+  }
+
+  /*
+   * Poll the DIMMs from reader_cnt threads, reader t polling DIMM t, the way
+   * PassThru does under the mailbox lock of the DIMM. Returns the polls per
+   * second of all readers together, 0 when they did not finish.
+   */
+  double PollRate(unsigned int reader_cnt, std::atomic<unsigned int> &failures)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool finished = RunThreads(reader_cnt, [&](unsigned int t) {
+      FW_CMD Cmd;
+
+      for (unsigned int i = 0; i < STRESS_CALLS_PER_THREAD; i++) {
+        InitStatusCmd(&Cmd, m_dimms[t].DimmID);
+        LockDimmMailbox(&m_dimms[t]);
+        EFI_STATUS Rc = DefaultPassThru(&m_dimms[t], &Cmd, 0);
+        UnlockDimmMailbox(&m_dimms[t]);
+        if (EFI_SUCCESS != Rc || Cmd.OutPayload[0] != (UINT8)t) {
+          failures++;
+        }
+      }
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return finished ? (reader_cnt * STRESS_CALLS_PER_THREAD) / elapsed.count() : 0;
+  }
+};
+
+/*
+ * Polls of different DIMMs only share the PBR lock for the lookup and wait for
+ * the firmware on their own mailbox lock, so they must scale with the readers.
+ */
+TEST_F(NvmApi_PlaybackTests, ConcurrentStatusReadersScale)
+{
+  std::atomic<unsigned int> failures(0);
+
+  double single_rate = PollRate(1, failures);
+  double multi_rate = PollRate(STRESS_READER_THREADS, failures);
+
+  ASSERT_GT(single_rate, 0) << "Reader did not finish, deadlock";
+  ASSERT_GT(multi_rate, 0) << "Readers did not finish, deadlock";
+  EXPECT_EQ(failures.load(), 0u);
+  EXPECT_GE(multi_rate, single_rate * STRESS_MIN_SPEEDUP);
+}
+
 TEST_F(NvmApi_Tests, GetDimmIdPassThru)
 {
   struct device_pt_cmd get_dimm_id_pt;
@@ -128,6 +385,12 @@ TEST_F(NvmApi_Tests, VerifyGetFwErrLogStatsReturnsErrorWithInvalidParam)
   EXPECT_NE(retval, NVM_SUCCESS);
 }
 
+TEST_F(NvmApi_Tests, VerifyGetDeviceDetailsReturnsErrorWithNullUid)
+{
+  struct device_details details;
+  EXPECT_EQ(nvm_get_device_details(NULL, &details), NVM_ERR_INVALID_PARAMETER);
+}
+
 TEST_F(NvmApi_Tests, VerifyMemTopology)
 {
   unsigned int count;
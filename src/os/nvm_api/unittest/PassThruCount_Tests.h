@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef PASSTHRU_COUNT_TESTS_H
+#define PASSTHRU_COUNT_TESTS_H
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <nvm_management.h>
+
+extern "C" {
+#include <AutoGen.h>
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <FwUtility.h>
+#include <NvmTypes.h>
+#include <Pbr.h>
+#include <PbrDcpmm.h>
+#include <Dimm.h>
+#include <NvmDimmDriver.h>
+#include <os_efi_preferences.h>
+extern EFI_GUID gIntelDimmPbrVariableGuid;
+}
+
+/*
+ * Recorded session (ipmctl dump -session) the counts are taken against.
+ * Keyed playback answers every command of the recorded system the same way,
+ * so the counts do not depend on the hardware, the order or the number of
+ * times a command is sent.
+ */
+#define PASSTHRU_COUNT_SESSION_ENV "IPMCTL_TEST_PBR_SESSION"
+
+/* Boot status of a status query: Get BSR and Get DDRT IO Init Info */
+#define PASSTHRU_COUNT_BOOT_STATUS 2
+
+/*
+ * Firmware commands GetDimmInfo sends for each DIMM_INFO category of
+ * device_status, when every command succeeds.
+ */
+static const struct
+{
+  DIMM_INFO_CATEGORIES categories;
+  UINT64 passthrus;
+} g_status_category_passthrus[] =
+{
+  { DIMM_INFO_CATEGORY_PACKAGE_SPARING,       1 }, // Get Package Sparing Policy
+  { DIMM_INFO_CATEGORY_ARS_STATUS,            1 }, // Get Address Range Scrub
+  { DIMM_INFO_CATEGORY_SMART_AND_HEALTH,      6 }, // SMART and health, device characteristics, 4 error log counts
+  { DIMM_INFO_CATEGORY_VIRAL_POLICY,          1 }, // Get Viral Policy
+  { DIMM_INFO_CATEGORY_OVERWRITE_DIMM_STATUS, 1 }, // Get Long Operation Status
+  { DIMM_INFO_CATEGORY_MEM_INFO_PAGE_3,       1 }, // Get Memory Info page 3
+};
+
+class PassThruCount_Tests : public ::testing::Test
+{
+protected:
+  BOOLEAN m_playback = FALSE;
+  UINT16 m_dimm_id = 0;
+
+  virtual void SetUp()
+  {
+    const char *p_session = getenv(PASSTHRU_COUNT_SESSION_ENV);
+    unsigned int dimm_cnt = 0;
+
+    if (NULL == p_session) {
+      GTEST_SKIP() << PASSTHRU_COUNT_SESSION_ENV " does not name a recorded session";
+    }
+    preferences_init(NULL);
+    SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_ORDER, PBR_PLAYBACK_ORDER_KEYED);
+    SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_REPEAT, PBR_PLAYBACK_REPEAT_LAST);
+    ASSERT_NO_FATAL_FAILURE(LoadSession(p_session));
+    m_playback = TRUE;
+
+    // Rebind the library to the DIMMs of the session
+    nvm_uninit();
+    ASSERT_EQ(nvm_init(), NVM_SUCCESS);
+    ASSERT_EQ(nvm_get_number_of_devices(&dimm_cnt), NVM_SUCCESS);
+    if (0 == dimm_cnt) {
+      GTEST_SKIP() << "The session has no DCPMMs";
+    }
+    ASSERT_NO_FATAL_FAILURE(FindManageableDimm(dimm_cnt));
+  }
+
+  virtual void TearDown()
+  {
+    if (m_playback) {
+      nvm_uninit();
+      PbrSetMode(PBR_NORMAL_MODE);
+      SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_ORDER, PBR_PLAYBACK_ORDER_RECORDED);
+      SetPlaybackPreference(INI_PREFERENCES_PBR_PLAYBACK_REPEAT, PBR_PLAYBACK_REPEAT_LAST);
+    }
+  }
+
+  /* Playback is read from the in-memory configuration, nothing is written to the ini file */
+  void SetPlaybackPreference(CONST CHAR16 *pName, UINT32 Value)
+  {
+    preferences_set_var(pName, gIntelDimmPbrVariableGuid, &Value, sizeof(Value));
+  }
+
+  /* Load a session file for playback, as ipmctl load -session does */
+  void LoadSession(const char *p_path)
+  {
+    FILE *p_file = fopen(p_path, "rb");
+    VOID *pSession = NULL;
+    long size;
+
+    ASSERT_TRUE(NULL != p_file) << "Cannot open " << p_path;
+    fseek(p_file, 0, SEEK_END);
+    size = ftell(p_file);
+    fseek(p_file, 0, SEEK_SET);
+    if (size <= 0 || NULL == (pSession = AllocateZeroPool((UINTN)size)) ||
+        1 != fread(pSession, (size_t)size, 1, p_file)) {
+      fclose(p_file);
+      FREE_POOL_SAFE(pSession);
+      FAIL() << "Cannot read " << p_path;
+    }
+    fclose(p_file);
+    // the session owns the buffer from now on
+    ASSERT_EQ(PbrSetSession(pSession, (UINT32)size), EFI_SUCCESS);
+    ASSERT_EQ(PbrSetMode(PBR_PLAYBACK_MODE), EFI_SUCCESS);
+  }
+
+  /* Unmanageable DCPMMs skip the firmware commands of most categories */
+  void FindManageableDimm(unsigned int dimm_cnt)
+  {
+    DIMM_INFO *pDimms = (DIMM_INFO *)AllocateZeroPool(sizeof(DIMM_INFO) * dimm_cnt);
+    BOOLEAN found = FALSE;
+
+    ASSERT_TRUE(NULL != pDimms);
+    EXPECT_EQ(gNvmDimmDriverNvmDimmConfig.GetDimms(&gNvmDimmDriverNvmDimmConfig, dimm_cnt,
+      DIMM_INFO_CATEGORY_NONE, pDimms), EFI_SUCCESS);
+    for (unsigned int i = 0; i < dimm_cnt && !found; i++) {
+      if (MANAGEMENT_VALID_CONFIG == pDimms[i].ManageabilityState) {
+        m_dimm_id = pDimms[i].DimmID;
+        found = TRUE;
+      }
+    }
+    FreePool(pDimms);
+    if (!found) {
+      GTEST_SKIP() << "The session has no manageable DCPMMs";
+    }
+  }
+
+  /* Firmware commands sent to read the DIMM_INFO categories of the DCPMM */
+  UINT64 CountDimmInfoPassThrus(DIMM_INFO_CATEGORIES categories)
+  {
+    DIMM_INFO DimmInfo;
+    NVM_UINT64 before = 0;
+    NVM_UINT64 after = 0;
+
+    EXPECT_EQ(nvm_get_passthrough_count(&before), NVM_SUCCESS);
+    EXPECT_EQ(gNvmDimmDriverNvmDimmConfig.GetDimm(&gNvmDimmDriverNvmDimmConfig, m_dimm_id,
+      categories, &DimmInfo), EFI_SUCCESS);
+    EXPECT_EQ(nvm_get_passthrough_count(&after), NVM_SUCCESS);
+    return after - before;
+  }
+};
+
+/*
+ * Every category costs exactly its own commands on top of the DIMM_INFO
+ * fields that need none.
+ */
+TEST_F(PassThruCount_Tests, DimmInfoCategoryCounts)
+{
+  UINT64 base = CountDimmInfoPassThrus(DIMM_INFO_CATEGORY_NONE);
+
+  for (size_t i = 0; i < sizeof(g_status_category_passthrus) / sizeof(g_status_category_passthrus[0]); i++) {
+    EXPECT_EQ(CountDimmInfoPassThrus(g_status_category_passthrus[i].categories),
+      base + g_status_category_passthrus[i].passthrus) << "categories 0x" << std::hex
+      << g_status_category_passthrus[i].categories;
+  }
+}
+
+/*
+ * A status poll reads only the categories device_status is built from,
+ * plus the boot status.
+ */
+TEST_F(PassThruCount_Tests, GetDeviceStatusCount)
+{
+  UINT64 expected = CountDimmInfoPassThrus(DIMM_INFO_CATEGORY_NONE) + PASSTHRU_COUNT_BOOT_STATUS;
+  unsigned int dimm_cnt = 0;
+  device_discovery *p_devices = NULL;
+  device_status status;
+  NVM_UINT64 before = 0;
+  NVM_UINT64 after = 0;
+  BOOLEAN found = FALSE;
+
+  for (size_t i = 0; i < sizeof(g_status_category_passthrus) / sizeof(g_status_category_passthrus[0]); i++) {
+    expected += g_status_category_passthrus[i].passthrus;
+  }
+
+  ASSERT_EQ(nvm_get_number_of_devices(&dimm_cnt), NVM_SUCCESS);
+  p_devices = (device_discovery *)malloc(sizeof(device_discovery) * dimm_cnt);
+  ASSERT_TRUE(NULL != p_devices);
+  ASSERT_EQ(nvm_get_devices(p_devices, (NVM_UINT8)dimm_cnt), NVM_SUCCESS);
+  for (unsigned int i = 0; i < dimm_cnt; i++) {
+    if (p_devices[i].physical_id == m_dimm_id) {
+      found = TRUE;
+      EXPECT_EQ(nvm_get_passthrough_count(&before), NVM_SUCCESS);
+      EXPECT_EQ(nvm_get_device_status(p_devices[i].uid, &status), NVM_SUCCESS);
+      EXPECT_EQ(nvm_get_passthrough_count(&after), NVM_SUCCESS);
+      EXPECT_EQ(after - before, expected);
+    }
+  }
+  EXPECT_TRUE(found);
+
+  free(p_devices);
+}
+
+#endif //PASSTHRU_COUNT_TESTS_H
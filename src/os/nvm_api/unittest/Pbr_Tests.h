@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef PBR_TESTS_H
+#define PBR_TESTS_H
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+extern "C" {
+#include <AutoGen.h>
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <FwUtility.h>
+#include <Pbr.h>
+#include <PbrDcpmm.h>
+#include <Dimm.h>
+#include <NvmDimmPassThru.h>
+#include <os_efi_preferences.h>
+extern EFI_GUID gIntelDimmPbrVariableGuid;
+}
+
+#define PBR_TEST_OPCODE     0x06
+#define PBR_TEST_SUBOPCODE  0x01
+#define PBR_TEST_DIMM_CNT   2
+#define PBR_TEST_LARGE_INPUT_SIZE 0x1000
+
+/*
+ * The DIMMs of a recorded system, as the driver knows them (DimmID) and
+ * as the OS and the recordings address them (NFIT device handle).
+ */
+static const UINT32 g_pbr_test_pids[PBR_TEST_DIMM_CNT] = { 0x1, 0x2 };
+static const UINT32 g_pbr_test_handles[PBR_TEST_DIMM_CNT] = { 0x1001, 0x1101 };
+
+class Pbr_Tests : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    preferences_init(NULL);
+    SetPlaybackOrder(PBR_PLAYBACK_ORDER_KEYED);
+    ASSERT_EQ(PbrSetSession(NULL, 0), EFI_SUCCESS);
+    ASSERT_EQ(PbrSetMode(PBR_RECORD_MODE), EFI_SUCCESS);
+  }
+
+  virtual void TearDown()
+  {
+    PbrSetMode(PBR_NORMAL_MODE);
+    SetPlaybackOrder(PBR_PLAYBACK_ORDER_RECORDED);
+  }
+
+  /* Keyed playback is read from the in-memory configuration, nothing is written to the ini file */
+  void SetPlaybackOrder(UINT32 Order)
+  {
+    preferences_set_var(INI_PREFERENCES_PBR_PLAYBACK_ORDER, gIntelDimmPbrVariableGuid, &Order, sizeof(Order));
+  }
+
+  /* Build the command a DIMM query sends, addressed by the driver's DimmID */
+  void InitCmd(FW_CMD *pCmd, UINT32 DimmID, UINT8 Input)
+  {
+    memset(pCmd, 0, sizeof(*pCmd));
+    pCmd->DimmID = DimmID;
+    pCmd->Opcode = PBR_TEST_OPCODE;
+    pCmd->SubOpcode = PBR_TEST_SUBOPCODE;
+    pCmd->InputPayloadSize = 1;
+    pCmd->InputPayload[0] = Input;
+    pCmd->OutputPayloadSize = OUT_PAYLOAD_SIZE;
+  }
+
+  /* Swap the recorded session for playback, as loading a saved session does */
+  void StartPlayback()
+  {
+    VOID *pSession = NULL;
+    UINT32 SessionSize = 0;
+
+    ASSERT_EQ(PbrGetSession(&pSession, &SessionSize), EFI_SUCCESS);
+    ASSERT_EQ(PbrSetSession(pSession, SessionSize), EFI_SUCCESS);
+    ASSERT_EQ(PbrSetMode(PBR_PLAYBACK_MODE), EFI_SUCCESS);
+    FreePool(pSession);
+  }
+};
+
+/*
+ * DefaultPassThru records the passthroughs of a DIMM under its device handle,
+ * keyed playback of the same command issued by DimmID must find them.
+ */
+TEST_F(Pbr_Tests, KeyedPlaybackRoundTrip)
+{
+  FW_CMD Cmd;
+  DIMM Dimm;
+
+  for (UINT32 i = 0; i < PBR_TEST_DIMM_CNT; i++) {
+    InitCmd(&Cmd, g_pbr_test_handles[i], 0x5A);
+    memset(Cmd.OutPayload, 0xA0 + i, OUT_PAYLOAD_SIZE);
+    ASSERT_EQ(PbrSetPassThruRecord(PBR_CTX(), &Cmd, EFI_SUCCESS, 0), EFI_SUCCESS);
+  }
+
+  StartPlayback();
+
+  // replay in reverse, keyed playback does not depend on the recorded order
+  for (UINT32 i = PBR_TEST_DIMM_CNT; i-- > 0;) {
+    memset(&Dimm, 0, sizeof(Dimm));
+    Dimm.DimmID = (UINT16)g_pbr_test_pids[i];
+    Dimm.DeviceHandle.AsUint32 = g_pbr_test_handles[i];
+    InitCmd(&Cmd, g_pbr_test_pids[i], 0x5A);
+
+    EXPECT_EQ(DefaultPassThru(&Dimm, &Cmd, 0), EFI_SUCCESS);
+    EXPECT_EQ(Cmd.DimmID, g_pbr_test_pids[i]);
+    EXPECT_EQ(Cmd.OutputPayloadSize, (UINT32)OUT_PAYLOAD_SIZE);
+    EXPECT_EQ(Cmd.OutPayload[0], 0xA0 + i);
+    EXPECT_EQ(Cmd.OutPayload[OUT_PAYLOAD_SIZE - 1], 0xA0 + i);
+  }
+}
+
+/*
+ * A command with an input that was never recorded has no response by default.
+ */
+TEST_F(Pbr_Tests, KeyedPlaybackMissingInputFails)
+{
+  FW_CMD Cmd;
+  DIMM Dimm;
+
+  InitCmd(&Cmd, g_pbr_test_handles[0], 0x5A);
+  ASSERT_EQ(PbrSetPassThruRecord(PBR_CTX(), &Cmd, EFI_SUCCESS, 0), EFI_SUCCESS);
+
+  StartPlayback();
+
+  memset(&Dimm, 0, sizeof(Dimm));
+  Dimm.DimmID = (UINT16)g_pbr_test_pids[0];
+  Dimm.DeviceHandle.AsUint32 = g_pbr_test_handles[0];
+  InitCmd(&Cmd, g_pbr_test_pids[0], 0x5B);
+
+  EXPECT_NE(DefaultPassThru(&Dimm, &Cmd, 0), EFI_SUCCESS);
+  EXPECT_EQ(Cmd.DimmID, g_pbr_test_pids[0]);
+}
+
+/*
+ * Large inputs are stored once in the payload partition like the outputs,
+ * and keyed playback still tells two large inputs apart.
+ */
+TEST_F(Pbr_Tests, KeyedPlaybackLargeInputStoredOnce)
+{
+  FW_CMD Cmd;
+  DIMM Dimm;
+  UINT8 LargeInput[PBR_TEST_LARGE_INPUT_SIZE];
+  UINT32 BlobCnt = 0;
+  UINT32 PartitionSize = 0;
+  UINT32 PlaybackOffset = 0;
+
+  memset(LargeInput, 0x3C, sizeof(LargeInput));
+  for (UINT32 i = 0; i < PBR_TEST_DIMM_CNT; i++) {
+    InitCmd(&Cmd, g_pbr_test_handles[i], 0x5A);
+    Cmd.LargeInputPayload = LargeInput;
+    Cmd.LargeInputPayloadSize = sizeof(LargeInput);
+    Cmd.OutputPayloadSize = 0;
+    Cmd.Status = (UINT8)i;
+    ASSERT_EQ(PbrSetPassThruRecord(PBR_CTX(), &Cmd, EFI_SUCCESS, 0), EFI_SUCCESS);
+  }
+  ASSERT_EQ(PbrGetDataPlaybackInfo(PBR_PAYLOAD_SIG, &BlobCnt, &PartitionSize, &PlaybackOffset), EFI_SUCCESS);
+  EXPECT_EQ(BlobCnt, 1u);
+  EXPECT_LT(PartitionSize, (UINT32)(PBR_TEST_DIMM_CNT * sizeof(LargeInput)));
+
+  StartPlayback();
+
+  memset(&Dimm, 0, sizeof(Dimm));
+  Dimm.DimmID = (UINT16)g_pbr_test_pids[1];
+  Dimm.DeviceHandle.AsUint32 = g_pbr_test_handles[1];
+  InitCmd(&Cmd, g_pbr_test_pids[1], 0x5A);
+  Cmd.LargeInputPayload = LargeInput;
+  Cmd.LargeInputPayloadSize = sizeof(LargeInput);
+  EXPECT_EQ(DefaultPassThru(&Dimm, &Cmd, 0), EFI_SUCCESS);
+  EXPECT_EQ(Cmd.Status, 1);
+
+  LargeInput[sizeof(LargeInput) - 1] ^= 0xFF;
+  InitCmd(&Cmd, g_pbr_test_pids[0], 0x5A);
+  Dimm.DimmID = (UINT16)g_pbr_test_pids[0];
+  Dimm.DeviceHandle.AsUint32 = g_pbr_test_handles[0];
+  Cmd.LargeInputPayload = LargeInput;
+  Cmd.LargeInputPayloadSize = sizeof(LargeInput);
+  EXPECT_NE(DefaultPassThru(&Dimm, &Cmd, 0), EFI_SUCCESS);
+}
+
+#endif //PBR_TESTS_H
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef SNAPSHOT_TESTS_H
+#define SNAPSHOT_TESTS_H
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include <nvm_management.h>
+}
+
+#define SNAPSHOT_TEST_COUNT 2
+/*
+ * Layout of the serialized snapshots: a 32 byte header of magic, layout version,
+ * snapshot size, count and checksum, then the snapshots.
+ */
+#define SNAPSHOT_TEST_HEADER_SIZE     32
+#define SNAPSHOT_TEST_MAGIC_OFFSET    0
+#define SNAPSHOT_TEST_VERSION_OFFSET  4
+#define SNAPSHOT_TEST_SIZE_OFFSET     8
+
+static const char *g_snapshot_test_uids[SNAPSHOT_TEST_COUNT] = { "8089-a2-1748-00000001", "8089-a2-1748-00000002" };
+
+class Snapshot_Tests : public ::testing::Test
+{
+protected:
+  struct device_snapshot snapshots[SNAPSHOT_TEST_COUNT];
+  std::vector<NVM_UINT8> buf;
+
+  virtual void SetUp()
+  {
+    NVM_UINT32 size = 0;
+
+    memset(snapshots, 0, sizeof(snapshots));
+    for (int i = 0; i < SNAPSHOT_TEST_COUNT; i++) {
+      InitSnapshot(&snapshots[i], g_snapshot_test_uids[i]);
+      snapshots[i].time = 1000 + i;
+      snapshots[i].performance.bytes_read = 0x1000 * (i + 1);
+      snapshots[i].error_log.media_low.current = (NVM_UINT16)(7 + i);
+    }
+    ASSERT_EQ(nvm_serialize_device_snapshots(snapshots, SNAPSHOT_TEST_COUNT, NULL, 0, &size), NVM_SUCCESS);
+    ASSERT_EQ(size, (NVM_UINT32)(SNAPSHOT_TEST_HEADER_SIZE + sizeof(snapshots)));
+    buf.resize(size);
+    ASSERT_EQ(nvm_serialize_device_snapshots(snapshots, SNAPSHOT_TEST_COUNT, buf.data(), size, &size), NVM_SUCCESS);
+  }
+
+  void InitSnapshot(struct device_snapshot *p_snapshot, const char *p_uid)
+  {
+    memset(p_snapshot, 0, sizeof(*p_snapshot));
+    p_snapshot->version = NVM_DEVICE_SNAPSHOT_VERSION;
+    p_snapshot->sections = NVM_SNAPSHOT_ALL;
+    strncpy(p_snapshot->uid, p_uid, sizeof(p_snapshot->uid) - 1);
+  }
+
+  int Deserialize(NVM_UINT32 size, NVM_UINT32 *p_count)
+  {
+    struct device_snapshot read[SNAPSHOT_TEST_COUNT];
+
+    return nvm_deserialize_device_snapshots(buf.data(), size, read, SNAPSHOT_TEST_COUNT, p_count);
+  }
+};
+
+TEST_F(Snapshot_Tests, RoundTrip)
+{
+  struct device_snapshot read[SNAPSHOT_TEST_COUNT];
+  NVM_UINT32 count = 0;
+
+  memset(read, 0xFF, sizeof(read));
+  ASSERT_EQ(nvm_deserialize_device_snapshots(buf.data(), (NVM_UINT32)buf.size(), read, SNAPSHOT_TEST_COUNT, &count),
+    NVM_SUCCESS);
+  EXPECT_EQ(count, (NVM_UINT32)SNAPSHOT_TEST_COUNT);
+  EXPECT_EQ(memcmp(read, snapshots, sizeof(snapshots)), 0);
+}
+
+TEST_F(Snapshot_Tests, SerializeReportsTooSmallBuffer)
+{
+  NVM_UINT32 size = 0;
+
+  EXPECT_EQ(nvm_serialize_device_snapshots(snapshots, SNAPSHOT_TEST_COUNT, buf.data(),
+    (NVM_UINT32)buf.size() - 1, &size), NVM_ERR_BAD_SIZE);
+  EXPECT_EQ(size, (NVM_UINT32)buf.size());
+}
+
+TEST_F(Snapshot_Tests, CountQuery)
+{
+  struct device_snapshot read;
+  NVM_UINT32 count = 0;
+
+  EXPECT_EQ(nvm_deserialize_device_snapshots(buf.data(), (NVM_UINT32)buf.size(), NULL, 0, &count), NVM_SUCCESS);
+  EXPECT_EQ(count, (NVM_UINT32)SNAPSHOT_TEST_COUNT);
+
+  count = 0;
+  EXPECT_EQ(nvm_deserialize_device_snapshots(buf.data(), (NVM_UINT32)buf.size(), &read, 1, &count), NVM_ERR_BAD_SIZE);
+  EXPECT_EQ(count, (NVM_UINT32)SNAPSHOT_TEST_COUNT);
+}
+
+TEST_F(Snapshot_Tests, RejectsTruncatedBuffer)
+{
+  NVM_UINT32 count = 0;
+
+  EXPECT_EQ(Deserialize((NVM_UINT32)buf.size() - 1, &count), NVM_ERR_INVALID_PARAMETER);
+  EXPECT_EQ(Deserialize(SNAPSHOT_TEST_HEADER_SIZE - 1, &count), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST_F(Snapshot_Tests, RejectsBadMagic)
+{
+  NVM_UINT32 count = 0;
+
+  buf[SNAPSHOT_TEST_MAGIC_OFFSET] ^= 0xFF;
+  EXPECT_EQ(Deserialize((NVM_UINT32)buf.size(), &count), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST_F(Snapshot_Tests, RejectsOtherVersion)
+{
+  NVM_UINT32 count = 0;
+
+  buf[SNAPSHOT_TEST_VERSION_OFFSET] += 1;
+  EXPECT_EQ(Deserialize((NVM_UINT32)buf.size(), &count), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST_F(Snapshot_Tests, RejectsOtherSnapshotSize)
+{
+  NVM_UINT32 count = 0;
+
+  buf[SNAPSHOT_TEST_SIZE_OFFSET] += 8;
+  EXPECT_EQ(Deserialize((NVM_UINT32)buf.size(), &count), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST_F(Snapshot_Tests, RejectsChecksumMismatch)
+{
+  NVM_UINT32 count = 0;
+
+  buf[buf.size() - 1] ^= 0x01;
+  EXPECT_EQ(Deserialize((NVM_UINT32)buf.size(), &count), NVM_ERR_INVALID_PARAMETER);
+}
+
+TEST_F(Snapshot_Tests, DiffCountsGrowthAndCounterReset)
+{
+  struct device_snapshot_diff diff;
+  struct device_snapshot later = snapshots[0];
+
+  later.time += 60;
+  later.performance.bytes_read += 100;
+  later.performance.host_reads = 50;
+  // A counter that went back was reset, it counts from 0
+  snapshots[0].performance.bytes_written = 1000;
+  later.performance.bytes_written = 300;
+
+  ASSERT_EQ(nvm_diff_device_snapshots(&snapshots[0], &later, &diff), NVM_SUCCESS);
+  EXPECT_EQ(diff.sections, (NVM_UINT32)NVM_SNAPSHOT_ALL);
+  EXPECT_EQ(diff.interval, 60);
+  EXPECT_EQ(diff.bytes_read, 100u);
+  EXPECT_EQ(diff.host_reads, 50u);
+  EXPECT_EQ(diff.bytes_written, 300u);
+  EXPECT_EQ(diff.host_writes, 0u);
+  EXPECT_EQ(diff.changed_sections, (NVM_UINT32)NVM_SNAPSHOT_PERFORMANCE);
+}
+
+TEST_F(Snapshot_Tests, DiffErrorLogSequenceWraps)
+{
+  struct device_snapshot_diff diff;
+  struct device_snapshot later = snapshots[0];
+
+  snapshots[0].error_log.media_high.current = 0xFFFE;
+  later.error_log.media_high.current = 0x0003;
+  later.error_log.therm_low.current = (NVM_UINT16)(snapshots[0].error_log.therm_low.current + 2);
+
+  ASSERT_EQ(nvm_diff_device_snapshots(&snapshots[0], &later, &diff), NVM_SUCCESS);
+  EXPECT_EQ(diff.new_media_high_errors, 5u);
+  EXPECT_EQ(diff.new_therm_low_errors, 2u);
+  EXPECT_EQ(diff.new_media_low_errors, 0u);
+  EXPECT_EQ(diff.changed_sections, (NVM_UINT32)NVM_SNAPSHOT_ERROR_LOG);
+}
+
+TEST_F(Snapshot_Tests, DiffRejectsOtherDevice)
+{
+  struct device_snapshot_diff diff;
+
+  EXPECT_EQ(nvm_diff_device_snapshots(&snapshots[0], &snapshots[1], &diff), NVM_ERR_INVALID_PARAMETER);
+}
+
+#endif //SNAPSHOT_TESTS_H
@@ -76,8 +76,10 @@ extern int os_mkdir(OS_PATH path);
 extern int os_start_process(const char *process_name, unsigned int *p_process_id);
 extern int os_stop_process(unsigned int process_id);
 extern void os_sleep(unsigned long time);
-extern void os_create_thread(unsigned long long *p_thread_id, void *(*callback)(void *), void *callback_arg);
+extern int os_create_thread(unsigned long long *p_thread_id, void *(*callback)(void *), void *callback_arg);
+extern int os_join_thread(unsigned long long thread_id);
 extern unsigned long long os_get_thread_id();
+extern unsigned long long os_get_monotonic_usec();
 
 extern OS_MUTEX *os_mutex_init(const char *name);
 extern int os_mutex_lock(OS_MUTEX *p_mutex);
@@ -90,14 +92,58 @@ extern int os_rwlock_r_unlock(OS_RWLOCK *p_rwlock);
 extern int os_rwlock_w_lock(OS_RWLOCK *p_rwlock);
 extern int os_rwlock_w_unlock(OS_RWLOCK *p_rwlock);
 extern int os_rwlock_delete(OS_RWLOCK *p_rwlock);
+/*
+ * Allocate and initialize a rwlock, released with os_rwlock_delete() and free().
+ */
+extern OS_RWLOCK *os_rwlock_create();
+/*
+ * Return the rwlock stored in *pp_rwlock, creating it on first use. Threads
+ * racing on the first use all get the same lock. The lock lives until the
+ * process exits. Returns NULL when it cannot be allocated.
+ */
+extern OS_RWLOCK *os_rwlock_get_static(OS_RWLOCK *volatile *pp_rwlock);
 
 extern int os_get_host_name(char *name, const unsigned int name_len);
 extern int os_get_os_name(char *os_name, const unsigned int os_name_len);
 extern int os_get_os_version(char *os_version, const unsigned int os_version_len);
+extern int os_get_boot_id(char *boot_id, const unsigned int boot_id_len);
 extern int os_get_os_type();
 extern int os_get_driver_capabilities(struct nvm_driver_capabilities *p_capabilities);
 extern int os_check_admin_permissions();
 
+/*
+ * Resident daemon transport. The command handler runs one command line with the
+ * stdout/stderr of the requesting client and returns its exit code, the event
+ * handler is called when a DIMM signals an ACPI health event.
+ */
+typedef int (*os_daemon_cmd_handler)(int argc, char *argv[]);
+typedef void (*os_daemon_event_handler)(void);
+extern int os_daemon_serve(const char *socket_path, os_daemon_cmd_handler cmd_handler,
+	os_daemon_event_handler event_handler);
+extern int os_daemon_forward(const char *socket_path, int argc, char *argv[], int *p_exit_code);
+
+/*
+ * DIMM ACPI health event monitor. DIMMs are registered once and stay armed
+ * between waits, a wait reports exactly which DIMMs signalled which events.
+ */
+typedef void OS_HEALTH_MONITOR;
+struct os_health_event
+{
+	unsigned int dimm_handle; // NFIT handle of the DIMM that signalled
+	unsigned int events; // DIMM_ACPI_EVENT_*_MASK bits signalled
+};
+extern int os_health_monitor_create(OS_HEALTH_MONITOR **pp_monitor);
+extern int os_health_monitor_add(OS_HEALTH_MONITOR *p_monitor, unsigned int dimm_handle,
+	unsigned int event_mask);
+extern int os_health_monitor_wait(OS_HEALTH_MONITOR *p_monitor, int timeout_sec,
+	struct os_health_event *p_events, unsigned int max_events, unsigned int *p_count);
+extern void os_health_monitor_free(OS_HEALTH_MONITOR *p_monitor);
+/*
+ * Descriptor that polls readable while a registered DIMM has an event to report,
+ * so the monitor can be waited on together with other descriptors. -1 if not supported.
+ */
+extern int os_health_monitor_fd(OS_HEALTH_MONITOR *p_monitor);
+
 /*
  Get CPUID info for different OSs. Depending on the inputRequestType,
   regs[0...3] will be populated with register values eax....edx
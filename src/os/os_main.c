@@ -5,12 +5,45 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <nvm_management.h>
 #include <os_types.h>
 
+#define DAEMON_OPTION		"-daemon"
+#define BATCH_OPTION		"-batch"
+#define STOP_ON_ERROR_OPTION	"-stoponerror"
+#define NO_DAEMON_ENV_VAR	"IPMCTL_NO_DAEMON"
+
 extern NVM_API int nvm_run_cli(int argc, char *argv[]);
+extern NVM_API int nvm_run_cli_daemon();
+extern NVM_API int nvm_run_cli_batch(const char *p_path, int stop_on_error);
+extern NVM_API int nvm_forward_cli(int argc, char *argv[], int *p_rc);
 
 int main(int argc, char *argv[])
 {
+	int rc = 0;
+
+	if (argc == 2 && 0 == strcmp(argv[1], DAEMON_OPTION))
+	{
+		return nvm_run_cli_daemon();
+	}
+
+	// ipmctl -batch <file|-> [-stoponerror]
+	if (argc > 1 && 0 == strcmp(argv[1], BATCH_OPTION))
+	{
+		if (argc == 3 || (argc == 4 && 0 == strcmp(argv[3], STOP_ON_ERROR_OPTION)))
+		{
+			return nvm_run_cli_batch(argv[2], argc == 4);
+		}
+		fprintf(stderr, "Usage: %s " BATCH_OPTION " <file|-> [" STOP_ON_ERROR_OPTION "]\n", argv[0]);
+		return NVM_ERR_INVALID_PARAMETER;
+	}
+
+	// Let a running daemon execute the command against its initialized state
+	if (NULL == getenv(NO_DAEMON_ENV_VAR) &&
+		NVM_SUCCESS == nvm_forward_cli(argc, argv, &rc))
+	{
+		return rc;
+	}
 	return nvm_run_cli(argc, argv);
 }
@@ -13,6 +13,9 @@
 #define DSM_VENDOR_ERROR(status) ((status & 0xFFFF) >> DSM_VENDOR_ERROR_SHIFT)
 #define DSM_EXTENDED_ERROR(status) ((status & 0xFFFF0000) >> DSM_MAILBOX_ERROR_SHIFT)
 #define DSM_MAX_RETRIES 5
+/* Backoff between DSM_VENDOR_RETRY_SUGGESTED retries, doubled after every attempt */
+#define DSM_RETRY_BACKOFF_MIN_MS 1
+#define DSM_RETRY_BACKOFF_MAX_MS 100
 
 #define BUILD_DSM_OPCODE(Opcode, SubOpcode) (UINT32)(SubOpcode << 8 | Opcode)
 
@@ -91,14 +94,16 @@ struct fw_cmd {
    unsigned int OutputPayloadSize;
    unsigned int LargeOutputPayloadSize;
    unsigned char InputPayload[IN_PAYLOAD_SIZE + IN_PAYLOAD_SIZE_EXT_PAD_OS];
-   unsigned char LargeInputPayload[IN_MB_SIZE];
+   unsigned char *LargeInputPayload;
    unsigned char OutPayload[OUT_PAYLOAD_SIZE];
-   unsigned char LargeOutputPayload[OUT_MB_SIZE];
+   unsigned char *LargeOutputPayload;
    unsigned int DimmID;
    unsigned char Opcode;
    unsigned char SubOpcode;
    unsigned char Status;
    unsigned char DsmStatus;
+   unsigned int Attempts;
+   unsigned long long ElapsedUs;
 };
 #pragma pack(pop)
 
@@ -141,15 +141,36 @@ void os_sleep(unsigned long time)
 /*
  * Create a thread on the current process
  */
-void os_create_thread(unsigned long long *p_thread_id, void *(*callback)(void *), void * callback_arg)
+int os_create_thread(unsigned long long *p_thread_id, void *(*callback)(void *), void * callback_arg)
 {
-	CreateThread(
+	HANDLE handle = CreateThread(
 			NULL, // default security
 			0,  // default stack size
 			(LPTHREAD_START_ROUTINE)callback,
 			(LPVOID)callback_arg,
 			0, // Immediately run thread
-			(LPDWORD)p_thread_id);
+			NULL);
+	// the handle is kept as the id so the thread can be joined later
+	if (handle && p_thread_id)
+	{
+		*p_thread_id = (unsigned long long)handle;
+	}
+	return (handle != NULL);
+}
+
+/*
+ * Wait for a thread created by os_create_thread to finish
+ */
+int os_join_thread(unsigned long long thread_id)
+{
+	int rc = 0;
+	HANDLE handle = (HANDLE)thread_id;
+	if (handle)
+	{
+		rc = (WaitForSingleObject(handle, INFINITE) == WAIT_OBJECT_0);
+		CloseHandle(handle);
+	}
+	return rc;
 }
 
 /*
@@ -160,6 +181,22 @@ unsigned long long os_get_thread_id()
 	return GetCurrentThreadId();
 }
 
+/*
+ * Retrieve a monotonic timestamp in microseconds, only meaningful as a difference
+ */
+unsigned long long os_get_monotonic_usec()
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (!QueryPerformanceFrequency(&frequency) || !QueryPerformanceCounter(&counter) ||
+		0 == frequency.QuadPart)
+	{
+		return 0;
+	}
+	return (unsigned long long)((counter.QuadPart / frequency.QuadPart) * 1000000ULL +
+		((counter.QuadPart % frequency.QuadPart) * 1000000ULL) / frequency.QuadPart);
+}
+
 /*
  * Creates & Initializes a mutex.
  */
@@ -301,6 +338,45 @@ int os_rwlock_delete(OS_RWLOCK *p_rwlock)
 	return 1;
 }
 
+/*
+ * Allocates and initializes a rwlock
+ */
+OS_RWLOCK *os_rwlock_create()
+{
+	SRWLOCK *p_handle = (SRWLOCK *)malloc(sizeof(SRWLOCK));
+
+	if (p_handle)
+	{
+		os_rwlock_init(p_handle);
+	}
+	return p_handle;
+}
+
+/*
+ * Returns the rwlock stored in *pp_rwlock, creating it on first use
+ */
+OS_RWLOCK *os_rwlock_get_static(OS_RWLOCK *volatile *pp_rwlock)
+{
+	OS_RWLOCK *p_rwlock = *pp_rwlock;
+	OS_RWLOCK *p_installed = NULL;
+
+	if (NULL == p_rwlock)
+	{
+		if (NULL == (p_rwlock = os_rwlock_create()))
+		{
+			return NULL;
+		}
+		// the thread losing the race drops its lock and takes the installed one
+		p_installed = InterlockedCompareExchangePointer((PVOID volatile *)pp_rwlock, p_rwlock, NULL);
+		if (NULL != p_installed)
+		{
+			free(p_rwlock);
+			p_rwlock = p_installed;
+		}
+	}
+	return p_rwlock;
+}
+
 /*
  * Retrieve the name of the host server.
  */
@@ -672,6 +748,58 @@ int os_get_os_name(char *os_name, const unsigned int os_name_len)
 	return rc;
 }
 
+/*
+ * Retrieve an identifier unique to the current boot of the system.
+ * Not available on Windows, callers have to do without it.
+ */
+int os_get_boot_id(char *boot_id, const unsigned int boot_id_len)
+{
+	return -1;
+}
+
+/*
+ * The resident daemon is not supported on Windows.
+ */
+int os_daemon_serve(const char *socket_path, os_daemon_cmd_handler cmd_handler,
+	os_daemon_event_handler event_handler)
+{
+	return -1;
+}
+
+int os_daemon_forward(const char *socket_path, int argc, char *argv[], int *p_exit_code)
+{
+	return -1;
+}
+
+/*
+ * The health event monitor is not supported on Windows.
+ */
+int os_health_monitor_create(OS_HEALTH_MONITOR **pp_monitor)
+{
+	return NVM_ERR_API_NOT_SUPPORTED;
+}
+
+int os_health_monitor_add(OS_HEALTH_MONITOR *p_monitor, unsigned int dimm_handle,
+	unsigned int event_mask)
+{
+	return NVM_ERR_API_NOT_SUPPORTED;
+}
+
+int os_health_monitor_wait(OS_HEALTH_MONITOR *p_monitor, int timeout_sec,
+	struct os_health_event *p_events, unsigned int max_events, unsigned int *p_count)
+{
+	return NVM_ERR_API_NOT_SUPPORTED;
+}
+
+void os_health_monitor_free(OS_HEALTH_MONITOR *p_monitor)
+{
+}
+
+int os_health_monitor_fd(OS_HEALTH_MONITOR *p_monitor)
+{
+	return -1;
+}
+
 int get_file_version_info_for_system(LPVOID *pp_version_info)
 {
 	int rc = 0;